@@ -145,6 +145,7 @@ END_MESSAGE_MAP()
 #define SETTING_IGNORE_ANNOYING_CF_DIB 94
 #define SETTING_REGEX_CASE_INSENSITIVE 95
 #define SETTING_DRAW_COPIED_COLOR_CODE 96
+#define SETTING_MAX_SEARCH_TEXT_LENGTH 97
 
 BOOL CAdvGeneral::OnInitDialog()
 {
@@ -221,6 +222,7 @@ BOOL CAdvGeneral::OnInitDialog()
 	pGroupTest->AddSubItem(new CMFCPropertyGridProperty(_T("Ignore annoying CF_DIB when a clip is detected as text content"), CGetSetOptions::GetIgnoreAnnoyingCFDIB(), _T("Case insensitive. Recommended option is \"excel.exe; onenote.exe; powerpnt.exe\" "), SETTING_IGNORE_ANNOYING_CF_DIB));
 
 	pGroupTest->AddSubItem( new CMFCPropertyGridProperty(_T("Maximum clip size in bytes (0 for no limit)"), g_Opt.m_lMaxClipSizeInBytes, _T(""), SETTING_MAX_CLIP_SIZE));
+	pGroupTest->AddSubItem(new CMFCPropertyGridProperty(_T("Maximum characters of a clip's text searched (0 for no limit)"), (long)CGetSetOptions::GetMaxSearchTextLength(), _T("Full text searches only find text before this, applies to clips saved after it's changed"), SETTING_MAX_SEARCH_TEXT_LENGTH));
 		
 	AddTrueFalse(pGroupTest, _T("Maintain search view"), CGetSetOptions::GetMaintainSearchView(), SETTING_MAINTAIN_SEARCH_VIEW);
 
@@ -414,6 +416,12 @@ void CAdvGeneral::OnBnClickedOk()
 					CGetSetOptions::SetMaxClipSizeInBytes(pNewValue->lVal);
 				}
 				break;
+			case SETTING_MAX_SEARCH_TEXT_LENGTH:
+				if (pNewValue->lVal != pOrigValue->lVal)
+				{
+					CGetSetOptions::SetMaxSearchTextLength(max(pNewValue->lVal, 0));
+				}
+				break;
 			case SETTING_CLIP_SEPARATOR:
 				if (wcscmp(pNewValue->bstrVal, pOrigValue->bstrVal) != 0)
 				{
@@ -7,7 +7,7 @@
 
 CAutoSendToClientThread::CAutoSendToClientThread(void)
 {
-	m_waitTimeout = 30000;
+	m_waitTimeout = 10000;
 	m_threadName = "CAutoSendToClientThread";
 	for(int eventEnum = 0; eventEnum < ECAUTOSENDTOCLIENTTHREADEVENTS_COUNT; eventEnum++)
 	{
@@ -17,6 +17,9 @@ CAutoSendToClientThread::CAutoSendToClientThread(void)
 
 CAutoSendToClientThread::~CAutoSendToClientThread(void)
 {
+	Stop();
+
+	ClosePeers(false);
 }
 
 void CAutoSendToClientThread::FireSendToClient(CClipList *pClipList)
@@ -48,6 +51,15 @@ void CAutoSendToClientThread::FireSendToClient(CClipList *pClipList)
 
 void CAutoSendToClientThread::OnTimeOut(void *param)
 {
+	ClosePeers(true);
+
+	//keep running while connections are open so they get closed once idle
+	for(AutoSendPeerMap::iterator it = m_peers.begin(); it != m_peers.end(); it++)
+	{
+		if(it->second.m_pClient != NULL)
+			return;
+	}
+
 	Stop(-1);
 }
 
@@ -108,57 +120,179 @@ bool CAutoSendToClientThread::SendToClient(CClipList *pClipList)
 		if(g_Opt.m_SendClients[nClient].bSendAll && 
 			g_Opt.m_SendClients[nClient].csIP.GetLength() > 0)
 		{
-			CClient client;
-			if(client.OpenConnection(g_Opt.m_SendClients[nClient].csIP) == FALSE)
+			CAutoSendPeer &peer = m_peers[g_Opt.m_SendClients[nClient].csIP];
+
+			if(SendToPeer(nClient, peer, pClipList) == false)
 			{
-				LogSendRecieveInfo(StrF(_T("ERROR opening connection to %s"), g_Opt.m_SendClients[nClient].csIP));
+				ClosePeer(peer);
+			}
+		}
+	}
+
+	ClosePeers(true);
 
-				if(g_Opt.m_SendClients[nClient].bShownFirstError == FALSE)
-				{
-					CString cs;
-					cs.Format(_T("Error opening connection to %s"), g_Opt.m_SendClients[nClient].csIP);
-					::SendMessage(theApp.m_MainhWnd, WM_SEND_RECIEVE_ERROR, (WPARAM)cs.GetBuffer(cs.GetLength()), 0);
-					cs.ReleaseBuffer();
+	LogSendRecieveInfo("@@@@@@@@@@@@@@@ - END OF SendClientThread - @@@@@@@@@@@@@@@");
 
-					g_Opt.m_SendClients[nClient].bShownFirstError = TRUE;
-				}
+	return TRUE;
+}
 
-				continue;
+//Sends the clips one after the other over the peer's connection, if a kept open connection turns out
+//to be dead the batch is sent again once over a new connection, the server drops a batch that didn't finish
+bool CAutoSendToClientThread::SendToPeer(int nClient, CAutoSendPeer &peer, CClipList *pClipList)
+{
+	CString csIP = g_Opt.m_SendClients[nClient].csIP;
+
+	for(int attempt = 0; attempt < 2; attempt++)
+	{
+		bool bReused = false;
+		CClient *pClient = GetPeerConnection(nClient, peer, bReused);
+		if(pClient == NULL)
+			return false;
+
+		bool bSent = true;
+
+		CClip* pClip;
+		POSITION pos;
+		pos = pClipList->GetHeadPosition();
+		while(pos)
+		{
+			pClip = pClipList->GetNext(pos);
+			if(pClip == NULL)
+			{
+				ASSERT(FALSE);
+				LogSendRecieveInfo("Error in GetNext");
+				break;
+			}
+
+			LogSendRecieveInfo(StrF(_T("Sending clip to %s"), csIP));
+
+			if(pClient->SendItem(pClip, false) == FALSE)
+			{
+				bSent = false;
+				break;
 			}
+		}
 
-			//We were connected successfully show an error next time we can't connect
-			g_Opt.m_SendClients[nClient].bShownFirstError = FALSE;
+		if(bSent == false)
+		{
+			ClosePeer(peer);
 
-			CClip* pClip;
-			POSITION pos;
-			pos = pClipList->GetHeadPosition();
-			while(pos)
+			if(bReused)
 			{
-				pClip = pClipList->GetNext(pos);
-				if(pClip == NULL)
-				{
-					ASSERT(FALSE);
-					LogSendRecieveInfo("Error in GetNext");
-					break;
-				}
-
-				LogSendRecieveInfo(StrF(_T("Sending clip to %s"), g_Opt.m_SendClients[nClient].csIP));
-
-				if(client.SendItem(pClip, false) == FALSE)
-				{
-					CString cs;
-					cs.Format(_T("Error sending clip to %s"), g_Opt.m_SendClients[nClient].csIP);
-					::SendMessage(theApp.m_MainhWnd, WM_SEND_RECIEVE_ERROR, (WPARAM)cs.GetBuffer(cs.GetLength()), 0);
-					cs.ReleaseBuffer();
-					break;
-				}
+				LogSendRecieveInfo(StrF(_T("Kept open connection to %s failed, reconnecting"), csIP));
+				continue;
 			}
 
-			client.CloseConnection();
+			CString cs;
+			cs.Format(_T("Error sending clip to %s"), csIP);
+			::SendMessage(theApp.m_MainhWnd, WM_SEND_RECIEVE_ERROR, (WPARAM)cs.GetBuffer(cs.GetLength()), 0);
+			cs.ReleaseBuffer();
+			return false;
+		}
+
+		//older servers only add the clips once the connection is closed
+		bool bKeepOpen = pClient->CanKeepConnectionOpen(peer.m_bOlderServer ? 0 : CGetSetOptions::GetNetworkVersionWaitMS());
+		peer.m_bOlderServer = (bKeepOpen == false);
+
+		if(bKeepOpen == false ||
+			pClient->EndBatch() == FALSE)
+		{
+			ClosePeer(peer);
 		}
+		else
+		{
+			peer.m_lastUsedTick = GetTickCount();
+		}
+
+		return true;
 	}
 
-	LogSendRecieveInfo("@@@@@@@@@@@@@@@ - END OF SendClientThread - @@@@@@@@@@@@@@@");
+	return false;
+}
 
-	return TRUE;
-}
\ No newline at end of file
+CClient *CAutoSendToClientThread::GetPeerConnection(int nClient, CAutoSendPeer &peer, bool &bReused)
+{
+	CString csIP = g_Opt.m_SendClients[nClient].csIP;
+
+	bReused = false;
+
+	if(peer.m_pClient != NULL)
+	{
+		if(peer.m_pClient->IsConnectionAlive())
+		{
+			LogSendRecieveInfo(StrF(_T("Reusing connection to %s"), csIP));
+			bReused = true;
+			return peer.m_pClient;
+		}
+
+		LogSendRecieveInfo(StrF(_T("Kept open connection to %s was closed"), csIP));
+		ClosePeer(peer);
+	}
+
+	if(peer.m_backoffMs > 0 &&
+		(int)(peer.m_retryTick - GetTickCount()) > 0)
+	{
+		LogSendRecieveInfo(StrF(_T("Not connecting to %s, last connect failed, retry in %d ms"), csIP, (int)(peer.m_retryTick - GetTickCount())));
+		return NULL;
+	}
+
+	peer.m_pClient = new CClient();
+	if(peer.m_pClient->OpenConnection(csIP) == FALSE)
+	{
+		LogSendRecieveInfo(StrF(_T("ERROR opening connection to %s"), csIP));
+
+		delete peer.m_pClient;
+		peer.m_pClient = NULL;
+
+		peer.m_backoffMs = min(max(peer.m_backoffMs * 2, (DWORD)1000), (DWORD)CGetSetOptions::GetNetworkPeerMaxBackoffMS());
+		peer.m_retryTick = GetTickCount() + peer.m_backoffMs;
+
+		if(g_Opt.m_SendClients[nClient].bShownFirstError == FALSE)
+		{
+			CString cs;
+			cs.Format(_T("Error opening connection to %s"), csIP);
+			::SendMessage(theApp.m_MainhWnd, WM_SEND_RECIEVE_ERROR, (WPARAM)cs.GetBuffer(cs.GetLength()), 0);
+			cs.ReleaseBuffer();
+
+			g_Opt.m_SendClients[nClient].bShownFirstError = TRUE;
+		}
+
+		return NULL;
+	}
+
+	//We were connected successfully show an error next time we can't connect
+	g_Opt.m_SendClients[nClient].bShownFirstError = FALSE;
+
+	peer.m_backoffMs = 0;
+	peer.m_lastUsedTick = GetTickCount();
+
+	return peer.m_pClient;
+}
+
+void CAutoSendToClientThread::ClosePeer(CAutoSendPeer &peer)
+{
+	if(peer.m_pClient != NULL)
+	{
+		peer.m_pClient->CloseConnection();
+		delete peer.m_pClient;
+		peer.m_pClient = NULL;
+	}
+}
+
+void CAutoSendToClientThread::ClosePeers(bool bOnlyIdle)
+{
+	DWORD idleMs = (DWORD)CGetSetOptions::GetNetworkPeerIdleMS();
+
+	for(AutoSendPeerMap::iterator it = m_peers.begin(); it != m_peers.end(); it++)
+	{
+		if(it->second.m_pClient == NULL)
+			continue;
+
+		if(bOnlyIdle == false ||
+			GetTickCount() - it->second.m_lastUsedTick > idleMs)
+		{
+			LogSendRecieveInfo(StrF(_T("Closing connection to %s"), it->first));
+			ClosePeer(it->second);
+		}
+	}
+}
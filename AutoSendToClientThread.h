@@ -3,7 +3,32 @@
 #include "EventThread.h"
 #include "Clip.h"
 #include <afxmt.h>
+#include <map>
 
+class CClient;
+
+//A connection to an auto send client that is kept open between batches of clips
+class CAutoSendPeer
+{
+public:
+	CAutoSendPeer()
+	{
+		m_pClient = NULL;
+		m_lastUsedTick = 0;
+		m_retryTick = 0;
+		m_backoffMs = 0;
+		m_bOlderServer = false;
+	}
+
+	CClient *m_pClient;
+	DWORD m_lastUsedTick;
+	DWORD m_retryTick;
+	DWORD m_backoffMs;
+	//the server didn't answer with a version last time, don't hold up each batch waiting for one
+	bool m_bOlderServer;
+};
+
+typedef std::map<CString, CAutoSendPeer> AutoSendPeerMap;
 
 class CAutoSendToClientThread : public CEventThread
 {
@@ -26,8 +51,15 @@ protected:
 
 	void OnSendToClient();
 	bool SendToClient(CClipList *pClipList);
+	bool SendToPeer(int nClient, CAutoSendPeer &peer, CClipList *pClipList);
+	CClient *GetPeerConnection(int nClient, CAutoSendPeer &peer, bool &bReused);
+	void ClosePeer(CAutoSendPeer &peer);
+	void ClosePeers(bool bOnlyIdle);
 
 	CCriticalSection m_cs;
 	CClipList m_saveClips;
+
+	//only used on the thread, and in the destructor after it's stopped
+	AutoSendPeerMap m_peers;
 };
 
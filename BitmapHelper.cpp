@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "cp_main.h"
 #include "BitmapHelper.h"
+#include "ImageResampler.h"
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -98,6 +99,89 @@ BOOL CBitmapHelper::GetCBitmap(void	*pClip2, CDC *pDC, CBitmap *pBitMap, int nMa
 	return true;
 }
 
+//Dibs are read directly, png is only decoded by gdi+. Transparent pixels come out premultiplied, the same as drawing
+//them over the black of a new compatible bitmap
+HGLOBAL CBitmapHelper::GetScaledDib(void *pClip2, int nMaxHeight)
+{
+	CClipFormat		*pClip = (CClipFormat *)pClip2;
+
+	if(pClip->m_cfType != CF_DIB &&
+		pClip->m_cfType != theApp.m_PNG_Format)
+		return NULL;
+	if(pClip->m_hgData == NULL)
+		return NULL;
+	if (nMaxHeight <= 0)
+		return NULL;
+
+	std::vector<uint8_t> pixels;
+	int width = 0;
+	int height = 0;
+
+	if (pClip->m_cfType == CF_DIB)
+	{
+		const uint8_t *pDib = (const uint8_t *)GlobalLock(pClip->m_hgData);
+		if (pDib == NULL)
+			return NULL;
+
+		bool decoded = CImageResampler::DecodeDib(pDib, GlobalSize(pClip->m_hgData), pixels, width, height);
+		GlobalUnlock(pClip->m_hgData);
+
+		if (decoded == false)
+			return NULL;
+	}
+	else
+	{
+		Gdiplus::Bitmap *gdipBitmap = pClip->CreateGdiplusBitmap();
+		if (gdipBitmap == NULL)
+			return NULL;
+
+		width = (int)gdipBitmap->GetWidth();
+		height = (int)gdipBitmap->GetHeight();
+
+		Gdiplus::Rect rect(0, 0, width, height);
+		Gdiplus::BitmapData data;
+		if (width <= 0 || height <= 0 ||
+			gdipBitmap->LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppPARGB, &data) != Gdiplus::Ok)
+		{
+			delete gdipBitmap;
+			return NULL;
+		}
+
+		pixels.resize((size_t)width * height * 4);
+		for (int y = 0; y < height; y++)
+		{
+			memcpy(&pixels[(size_t)y * width * 4], (BYTE *)data.Scan0 + (INT_PTR)y * data.Stride, (size_t)width * 4);
+		}
+
+		gdipBitmap->UnlockBits(&data);
+		delete gdipBitmap;
+	}
+
+	const int nHeight = min(nMaxHeight, height);
+	const int nWidth = max(1, (int)(((INT64)nHeight * width) / height));
+
+	std::vector<uint8_t> scaled((size_t)nWidth * nHeight * 4);
+
+	eResampleFilter filter = RESAMPLE_LANCZOS3;
+	if (g_Opt.m_bFastThumbnailMode)
+	{
+		filter = RESAMPLE_BOX;
+	}
+
+	if (CImageResampler::Resize(&pixels[0], width, height, &scaled[0], nWidth, nHeight, filter) == false)
+		return NULL;
+
+	HGLOBAL hDib = GlobalAlloc(GMEM_MOVEABLE, CImageResampler::DibSize(nWidth, nHeight));
+	if (hDib == NULL)
+		return NULL;
+
+	uint8_t *pDib = (uint8_t *)GlobalLock(hDib);
+	CImageResampler::WriteDib(&scaled[0], nWidth, nHeight, pDib);
+	GlobalUnlock(hDib);
+
+	return hDib;
+}
+
 BOOL CBitmapHelper::GetCBitmap(CClipFormats &clips, CDC* pDC, CBitmap* pBitMap, BOOL horizontal)
 {
 	BOOL bRet = FALSE;
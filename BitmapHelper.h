@@ -21,6 +21,8 @@ public:
 	static int		GetCBitmapHeight(const CBitmap & cbm);
 	static BOOL		GetCBitmap(void	*pClip2, CDC *pDC, CBitmap *pBitMap, int nMaxHeight);
 	static BOOL		GetCBitmap(CClipFormats&clips, CDC* pDC, CBitmap* pBitMap, BOOL horizontal);
+	//a dib of the image scaled to nMaxHeight without drawing it with gdi+, NULL if it can't be read
+	static HGLOBAL	GetScaledDib(void *pClip2, int nMaxHeight);
 	static HANDLE	hBitmapToDIB(HBITMAP hBitmap, DWORD dwCompression, HPALETTE hPal);
 	static WORD		PaletteSize(LPSTR lpDIB);
 	static WORD		DIBNumColors(LPSTR lpDIB);
@@ -903,6 +903,9 @@ int CCP_MainApp::ExitInstance()
 
 	DeleteDittoTempFiles(FALSE);
 
+	Log(StrF(_T("Statement cache hits: %d, misses: %d"), m_db.statementCacheHits(), m_db.statementCacheMisses()));
+
+	m_dbReadPool.Close();
 	m_db.close();
 
 	if(m_pUacPasteThread != NULL)
@@ -1060,23 +1063,30 @@ void CCP_MainApp::ShowCommandLineError(CString csTitle, CString csMessage)
 }
 
 BOOL CCP_MainApp::GetClipData(long parentId, CClipFormat &Clip)
+{
+	return GetClipData(parentId, Clip, m_db);
+}
+
+BOOL CCP_MainApp::GetClipData(long parentId, CClipFormat &Clip, CppSQLite3DB &db)
 {
 	BOOL bRet = FALSE;
 
 	try
 	{
-		CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT ooData FROM Data WHERE lParentID = %d AND strClipboardFormat = '%s'"), parentId, GetFormatName(Clip.m_cfType));
+		CppSQLite3Statement stmt = db.cachedStatement(_T("SELECT ooData, lOriginalSize FROM DataContent WHERE lParentID = ? AND strClipboardFormat = ?"));
+		stmt.bind(1, (int)parentId);
+		stmt.bind(2, GetFormatName(Clip.m_cfType));
+
+		CppSQLite3Query q = stmt.execQuery();
 		if(q.eof() == false)
 		{
 			int nDataLen = 0;
 			const unsigned char *cData = q.getBlobField(_T("ooData"), nDataLen);
 			if(cData != NULL)
 			{
-				Clip.m_hgData = NewGlobal(nDataLen);
-
-				::CopyToGlobalHP(Clip.m_hgData, (LPVOID)cData, nDataLen);
+				Clip.m_hgData = CClip::NewGlobalFromData(cData, nDataLen, q.getIntField(_T("lOriginalSize")));
 
-				bRet = TRUE;
+				bRet = Clip.m_hgData != NULL;
 			}
 		}
 	}
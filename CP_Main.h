@@ -22,6 +22,7 @@
 #include "HotKeys.h"
 #include "UAC_Thread.h"
 #include "ICU_String.h"
+#include "DbConnectionPool.h"
 
 extern class CCP_MainApp theApp;
 
@@ -32,6 +33,10 @@ public:
 	~CCP_MainApp();
 
 	CppSQLite3DB m_db;
+	//m_db's write lock, see CppSQLite3DB::setWriteLock. Transactions and savepoints belong to the connection, not the thread,
+	//so a write from another thread would be rolled back or committed with them. CClip::AddToDB holds it for the whole clip
+	CCriticalSection m_dbWriteLock;
+	CDbConnectionPool m_dbReadPool;
 	bool m_databaseOnNetworkShare;
 
 	HANDLE	m_hMutex; // for singleton app
@@ -98,6 +103,7 @@ public:
 
 	void OnDeleteID(long lID);
 	BOOL GetClipData(long lID, CClipFormat& Clip);
+	BOOL GetClipData(long lID, CClipFormat& Clip, CppSQLite3DB &db);
 	bool EditItems(CClipIDs& Ids, bool bShowError);
 
 	CClipTypes* LoadTypesFromDB(); // returns a "new" allocated object
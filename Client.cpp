@@ -10,6 +10,8 @@
 #include "FileRecieve.h"
 #include "FileTransferProgressDlg.h"
 #include "Shared/Tokenizer.h"
+#include "NetworkCompress.h"
+#include <map>
 
 
 #ifdef _DEBUG
@@ -91,6 +93,13 @@ CClient::CClient()
 {
 	m_Connection = NULL;
 	m_connectionPort = 0;
+	m_serverVersion = 0;
+	m_bSentVersion = false;
+	m_bWaitedForVersion = false;
+	m_serverFeatures = 0;
+	m_bFramed = false;
+	m_bAllowFrames = true;
+	m_bSyncClips = false;
 }
 
 CClient::~CClient()
@@ -102,8 +111,25 @@ BOOL CClient::CloseConnection()
 {
 	if(m_Connection != NULL && m_Connection != 0)
 	{
-		CSendInfo Info;
-		m_SendSocket.SendCSendData(Info, MyEnums::EXIT);
+		if(m_bFramed)
+		{
+			m_frame.BeginMessage(NETWORK_MESSAGE_EXIT);
+			m_frame.EndMessage();
+			SendFrame();
+		}
+		else
+		{
+			CSendInfo Info;
+			m_SendSocket.SendCSendData(Info, MyEnums::EXIT);
+		}
+
+		//a newer server may have sent a VERSION reply we never read, let it close first so unread data doesn't reset the connection
+		if(m_bSentVersion)
+		{
+			shutdown(m_Connection, SD_SEND);
+			m_RecieveSocket.SetSocket(m_Connection);
+			m_RecieveSocket.WaitForClose(CGetSetOptions::GetNetworkReadTimeoutMS());
+		}
 
 		closesocket(m_Connection);
 		WSACleanup();
@@ -192,9 +218,64 @@ BOOL CClient::OpenConnection(const TCHAR* servername)
 		return FALSE;	
 	}
 
+	//so a peer that went away is noticed on connections kept open between batches
+	BOOL keepAlive = TRUE;
+	setsockopt(m_Connection, SOL_SOCKET, SO_KEEPALIVE, (const char*)&keepAlive, sizeof(keepAlive));
+
+	m_serverVersion = 0;
+	m_bSentVersion = false;
+	m_bWaitedForVersion = false;
+	m_serverFeatures = 0;
+	m_bFramed = false;
+	m_bAllowFrames = true;
+	m_bSyncClips = false;
+	m_frame.Clear();
+
 	return TRUE;
 }
 
+//True if the server said it will keep reading after a FLUSH, waits for its version reply if it hasn't been read yet
+bool CClient::CanKeepConnectionOpen(int waitMs)
+{
+	if(m_Connection == NULL)
+		return false;
+
+	CheckForVersionReply(waitMs);
+
+	return m_serverVersion >= NETWORK_PERSISTENT_VERSION;
+}
+
+//Has the server add the clips sent so far without closing the connection
+BOOL CClient::EndBatch()
+{
+	if(m_bFramed)
+	{
+		m_frame.BeginMessage(NETWORK_MESSAGE_FLUSH);
+		m_frame.EndMessage();
+		return SendFrame();
+	}
+
+	CSendInfo Info;
+	return m_SendSocket.SendCSendData(Info, MyEnums::FLUSH);
+}
+
+//The server doesn't send anything after its version reply, if the socket is readable it was closed or reset
+bool CClient::IsConnectionAlive()
+{
+	if(m_Connection == NULL)
+		return false;
+
+	m_RecieveSocket.SetSocket(m_Connection);
+
+	CheckForVersionReply(0);
+
+	if(m_RecieveSocket.WaitForData(0) == FALSE)
+		return true;
+
+	char c;
+	return recv(m_Connection, &c, 1, MSG_PEEK) > 0;
+}
+
 BOOL CClient::SendItem(CClip *pClip, bool manualSend)
 {
 	CSendInfo Info;
@@ -223,9 +304,35 @@ BOOL CClient::SendItem(CClip *pClip, bool manualSend)
 	Info.m_cIP[sizeof(Info.m_cIP)-1] = 0;
 
 	m_SendSocket.SetSocket(m_Connection);
+	m_RecieveSocket.SetSocket(m_Connection);
 
-	if(m_SendSocket.SendCSendData(Info, MyEnums::START) == FALSE)
-		return FALSE;
+	if(m_bFramed)
+	{
+		//no fixed size fields in a frame, the whole description goes
+		CStringA desc = CTextConvert::UnicodeToUTF8(pClip->m_Desc);
+
+		m_frame.BeginMessage(NETWORK_MESSAGE_START);
+		m_frame.AddString(NETWORK_FIELD_IP, std::string(Info.m_cIP));
+		m_frame.AddString(NETWORK_FIELD_COMPUTER_NAME, std::string(Info.m_cComputerName));
+		m_frame.AddString(NETWORK_FIELD_DESC, std::string(desc, min(desc.GetLength(), NETWORK_MAX_DESC_SIZE)));
+		m_frame.AddUInt(NETWORK_FIELD_MANUAL_SEND, manualSend ? 1 : 0);
+		m_frame.AddUInt(NETWORK_FIELD_RESPOND_PORT, (unsigned short)Info.m_respondPort);
+		if(m_bSyncClips)
+		{
+			m_frame.AddUInt(NETWORK_FIELD_DATE, (DWORD)pClip->m_Time.GetTime());
+			m_frame.AddUInt(NETWORK_FIELD_CRC, pClip->m_CRC);
+		}
+		m_frame.EndMessage();
+	}
+	else
+	{
+		Info.m_nVersion = NETWORK_PROTOCOL_VERSION;
+
+		if(m_SendSocket.SendCSendData(Info, MyEnums::START) == FALSE)
+			return FALSE;
+
+		m_bSentVersion = true;
+	}
 	
 	CClipFormat* pCF;
 	
@@ -239,7 +346,16 @@ BOOL CClient::SendItem(CClip *pClip, bool manualSend)
 		SendClipFormat(pCF);
 	}
 	
-	if(m_SendSocket.SendCSendData(Info, MyEnums::END) == FALSE)
+	if(m_bFramed)
+	{
+		//the clip's small formats, START and END go out together
+		m_frame.BeginMessage(NETWORK_MESSAGE_END);
+		m_frame.EndMessage();
+
+		if(SendFrame() == FALSE)
+			return FALSE;
+	}
+	else if(m_SendSocket.SendCSendData(Info, MyEnums::END) == FALSE)
 		return FALSE;
 
 	theApp.m_lClipsSent++;
@@ -247,6 +363,184 @@ BOOL CClient::SendItem(CClip *pClip, bool manualSend)
 	return TRUE;
 }
 
+//Sends SYNC instead of START, the server answers with its version and everything after that is framed.
+//FALSE if the server is older or doesn't sync with us
+BOOL CClient::StartSync(int mode)
+{
+	CSendInfo Info;
+	Info.m_nVersion = NETWORK_PROTOCOL_VERSION;
+	Info.m_lParameter1 = mode;
+	Info.m_respondPort = (short)g_Opt.m_lPort;
+
+	CStringA dest = CTextConvert::UnicodeToUTF8(GetComputerName());
+	strncpy(Info.m_cComputerName, dest, sizeof(Info.m_cComputerName));
+
+	dest = CTextConvert::UnicodeToUTF8(GetIPAddress());
+	strncpy(Info.m_cIP, dest, sizeof(Info.m_cIP));
+
+	Info.m_cComputerName[sizeof(Info.m_cComputerName)-1] = 0;
+	Info.m_cIP[sizeof(Info.m_cIP)-1] = 0;
+
+	m_SendSocket.SetSocket(m_Connection);
+	m_RecieveSocket.SetSocket(m_Connection);
+
+	if(m_SendSocket.SendCSendData(Info, MyEnums::SYNC) == FALSE)
+		return FALSE;
+
+	m_bSentVersion = true;
+
+	CheckForVersionReply(CGetSetOptions::GetNetworkReadTimeoutMS());
+
+	if(m_serverVersion < NETWORK_SYNC_VERSION ||
+		(m_serverFeatures & NETWORK_FEATURE_SYNC) == 0)
+	{
+		return FALSE;
+	}
+
+	m_bFramed = true;
+	m_bSyncClips = true;
+	m_frame.Clear();
+
+	return TRUE;
+}
+
+//Reads the server's VERSION reply to our START if it's there, only waits for it the first time
+void CClient::CheckForVersionReply(int waitMs)
+{
+	if(m_bSentVersion == false ||
+		m_serverVersion > 0)
+	{
+		return;
+	}
+
+	if(m_bWaitedForVersion)
+	{
+		waitMs = 0;
+	}
+	else if(waitMs > 0)
+	{
+		m_bWaitedForVersion = true;
+	}
+
+	if(m_RecieveSocket.WaitForData(waitMs))
+	{
+		CSendInfo reply;
+		if(m_RecieveSocket.RecieveCSendInfo(&reply) &&
+			reply.m_Type == MyEnums::VERSION)
+		{
+			m_serverVersion = reply.m_nVersion;
+
+			//servers before the framed version leave this as -1
+			if(m_serverVersion >= NETWORK_FRAMED_VERSION)
+			{
+				m_serverFeatures = reply.m_lParameter1;
+			}
+			LogSendRecieveInfo(StrF(_T("Server version: %d"), m_serverVersion));
+		}
+	}
+}
+
+//Switches to frames once the server has said it reads them, can happen part way through a clip
+bool CClient::UseFrames()
+{
+	if(m_bFramed)
+		return true;
+
+	if(m_bAllowFrames == false ||
+		m_serverVersion < NETWORK_FRAMED_VERSION ||
+		(m_serverFeatures & NETWORK_FEATURE_FRAMES) == 0)
+	{
+		return false;
+	}
+
+	CSendInfo Info;
+	Info.m_nVersion = NETWORK_PROTOCOL_VERSION;
+	Info.m_lParameter1 = NETWORK_FEATURE_FRAMES;
+	if(m_SendSocket.SendCSendData(Info, MyEnums::FRAMES) == FALSE)
+		return false;
+
+	LogSendRecieveInfo("Sending to the server in frames");
+
+	m_bFramed = true;
+	m_frame.Clear();
+
+	return true;
+}
+
+//Small formats are added to the frame and go out with the rest of the clip, larger ones are sent
+//as encrypted records right after the frame that names them
+BOOL CClient::SendFramedFormat(CClipFormat* pCF)
+{
+	INT_PTR length = GlobalSize(pCF->m_hgData);
+	CString formatName = GetFormatName(pCF->m_cfType);
+	CStringA name = CTextConvert::UnicodeToUTF8(formatName);
+
+	bool bCompress = (m_serverFeatures & NETWORK_FEATURE_COMPRESSION) != 0 &&
+					CGetSetOptions::GetNetworkCompressionLevel() > 0 &&
+					length >= CGetSetOptions::GetNetworkCompressMinSize() &&
+					CNetworkCompress::IsCompressedFormat(formatName) == false;
+
+	if(length <= ENCRYPTED_CHUNK_SIZE)
+	{
+		LPVOID pvData = GlobalLock(pCF->m_hgData);
+
+		m_frame.BeginMessage(NETWORK_MESSAGE_FORMAT);
+		m_frame.AddString(NETWORK_FIELD_FORMAT_NAME, std::string(name));
+
+		std::vector<BYTE> compressed;
+		if(bCompress &&
+			CNetworkCompress::Compress((const BYTE*)pvData, (int)length, compressed))
+		{
+			m_frame.AddUInt(NETWORK_FIELD_ORIGINAL_SIZE, (uint64_t)length);
+			m_frame.AddBytes(NETWORK_FIELD_DATA, compressed.data(), compressed.size());
+		}
+		else
+		{
+			m_frame.AddBytes(NETWORK_FIELD_DATA, pvData, length);
+		}
+
+		m_frame.EndMessage();
+
+		GlobalUnlock(pCF->m_hgData);
+
+		if(m_frame.GetSize() >= ENCRYPTED_CHUNK_SIZE)
+			return SendFrame();
+
+		return TRUE;
+	}
+
+	LogSendRecieveInfo(StrF(_T("Sending clip data in encrypted chunks %Id"), length));
+
+	m_frame.BeginMessage(NETWORK_MESSAGE_FORMAT_CHUNKED);
+	m_frame.AddString(NETWORK_FIELD_FORMAT_NAME, std::string(name));
+	m_frame.AddUInt(NETWORK_FIELD_SIZE, (uint64_t)length);
+	if(bCompress)
+	{
+		m_frame.AddUInt(NETWORK_FIELD_COMPRESSED, 1);
+	}
+	m_frame.EndMessage();
+
+	if(SendFrame() == FALSE)
+		return FALSE;
+
+	LPVOID pvData = GlobalLock(pCF->m_hgData);
+	BOOL bRet = m_SendSocket.SendEncryptedChunks((const BYTE*)pvData, length, bCompress);
+	GlobalUnlock(pCF->m_hgData);
+
+	return bRet;
+}
+
+BOOL CClient::SendFrame()
+{
+	if(m_frame.HasMessages() == false)
+		return TRUE;
+
+	BOOL bRet = m_SendSocket.SendFrame(m_frame);
+	m_frame.Clear();
+
+	return bRet;
+}
+
 BOOL CClient::SendClipFormat(CClipFormat* pCF)
 {
 	CSendInfo Info;
@@ -257,6 +551,41 @@ BOOL CClient::SendClipFormat(CClipFormat* pCF)
 	CTextConvert Convert;
 	BOOL bRet = FALSE;
 
+	//only worth waiting on the server's version when chunks would save memory
+	CheckForVersionReply(length > ENCRYPTED_CHUNK_SIZE ? CGetSetOptions::GetNetworkVersionWaitMS() : 0);
+
+	if(UseFrames())
+	{
+		GlobalUnlock(pCF->m_hgData);
+		return SendFramedFormat(pCF);
+	}
+
+	if(m_serverVersion >= NETWORK_CHUNKED_VERSION &&
+		length > 0)
+	{
+		LogSendRecieveInfo(StrF(_T("Sending clip data in encrypted chunks %d"), length));
+
+		Info.m_nVersion = NETWORK_CHUNKED_VERSION;
+		Info.m_lParameter1 = (long)length;
+
+		CStringA dest = CTextConvert::UnicodeToUTF8(GetFormatName(pCF->m_cfType));
+		strncpy(Info.m_cDesc, dest, sizeof(Info.m_cDesc));
+		Info.m_cDesc[sizeof(Info.m_cDesc)-1] = 0;
+
+		if(m_SendSocket.SendCSendData(Info, MyEnums::DATA_START))
+		{
+			bRet = m_SendSocket.SendEncryptedChunks((const BYTE*)pvData, length);
+		}
+
+		GlobalUnlock(pCF->m_hgData);
+
+		if(bRet == FALSE)
+			return FALSE;
+
+		CSendInfo endInfo;
+		return m_SendSocket.SendCSendData(endInfo, MyEnums::DATA_END);
+	}
+
 	LogSendRecieveInfo(StrF(_T("BEFORE Encrypt clip data %d"), length));
 
 	if(m_SendSocket.m_pEncryptor)
@@ -301,10 +630,81 @@ BOOL CClient::SendClipFormat(CClipFormat* pCF)
 	return bRet;
 }
 
+static unsigned int __stdcall FileStreamThread(void *pParam)
+{
+	CFileRequestStream *pStream = (CFileRequestStream*)pParam;
+	int retries = CGetSetOptions::GetNetworkFileRetries();
+
+	for(int attempt = 0; pStream->m_bAbort == false; attempt++)
+	{
+		if(pStream->m_Client.SendFileRequest(pStream->m_requestFrom, *pStream->m_pHDropFormat, NULL))
+		{
+			pStream->m_lRet = pStream->m_Client.RecieveFileStream(pStream->m_csIP, pStream->m_streamIndex, pStream->m_streamCount, NULL, pStream->m_Recieve);
+		}
+
+		pStream->m_Client.CloseConnection();
+
+		if(pStream->m_Recieve.IsComplete() ||
+			pStream->m_bAbort ||
+			theApp.m_bAppExiting ||
+			attempt >= retries)
+		{
+			break;
+		}
+
+		LogSendRecieveInfo(StrF(_T("File stream %d didn't finish, retrying %d of %d"), pStream->m_streamIndex, attempt + 1, retries));
+	}
+
+	return 0;
+}
+
+//Stops the extra connections of a file request and waits for their threads, a stream can still be connecting so it's aborted until it stops
+static void StopFileStreams(std::vector<CFileRequestStream*> &streams)
+{
+	for(size_t i = 0; i < streams.size(); i++)
+	{
+		streams[i]->m_bAbort = true;
+		streams[i]->m_Client.Abort();
+	}
+
+	for(size_t i = 0; i < streams.size(); i++)
+	{
+		while(WaitForSingleObject(streams[i]->m_hThread, 100) == WAIT_TIMEOUT)
+		{
+			streams[i]->m_Client.Abort();
+		}
+
+		CloseHandle(streams[i]->m_hThread);
+		delete streams[i];
+	}
+
+	streams.clear();
+}
+
+//Where each file is in the CF_HDROP the files were requested for, the streams' files are put back in this order
+static void GetFilePositions(CClipFormat &HDropFormat, std::map<CString, INT_PTR> &positions)
+{
+	HDROP drop = (HDROP)GlobalLock(HDropFormat.m_hgData);
+	if(drop == NULL)
+		return;
+
+	int nNumFiles = DragQueryFile(drop, -1, NULL, 0);
+	TCHAR file[MAX_PATH];
+
+	for(int nFile = 0; nFile < nNumFiles; nFile++)
+	{
+		if(DragQueryFile(drop, nFile, file, _countof(file)) > 0 &&
+			positions.find(file) == positions.end())
+		{
+			positions[file] = nFile;
+		}
+	}
+
+	GlobalUnlock(HDropFormat.m_hgData);
+}
+
 HGLOBAL CClient::RequestCopiedFiles(CClipFormat &HDropFormat, CString csIP, CString csComputerName)
 {
-	CSendInfo Info;
-	bool bBreak = false;
 	HGLOBAL hReturn = NULL;
 	CString csErrorString;
 
@@ -329,59 +729,196 @@ HGLOBAL CClient::RequestCopiedFiles(CClipFormat &HDropFormat, CString csIP, CStr
 		requestFrom = csComputerName;
 	}
 
-	do 
+	CFileRecieve Recieve;
+	std::vector<CFileRequestStream*> streams;
+	int streamCount = 0;
+	long lRet = FALSE;
+	int retries = CGetSetOptions::GetNetworkFileRetries();
+
+	//a failed request is made again, files that didn't finish pick up where they stopped
+	for(int attempt = 0; ; attempt++)
 	{
-		if(OpenConnection(requestFrom) == FALSE)
+		lRet = FALSE;
+		csErrorString.Empty();
+
+		if(SendFileRequest(requestFrom, HDropFormat, pProgress) == FALSE)
 		{
-			csErrorString.Format(_T("Error Opening Connection to %s (%s)"), csComputerName, csIP);
-			break;
+			if(m_Connection == NULL)
+			{
+				csErrorString.Format(_T("Error Opening Connection to %s (%s)"), csComputerName, csIP);
+			}
 		}
+		else
+		{
+			//the other connections are started once the first has found out the server can split the files between them
+			if(streamCount == 0)
+			{
+				CheckForVersionReply(CGetSetOptions::GetNetworkVersionWaitMS());
+				streamCount = GetFileStreamCount();
 
-		m_SendSocket.SetSocket(m_Connection);
-		m_SendSocket.SetProgressBar(pProgress);
+				for(int i = 1; i < streamCount; i++)
+				{
+					CFileRequestStream *pStream = new CFileRequestStream;
+					pStream->m_requestFrom = requestFrom;
+					pStream->m_csIP = csIP;
+					pStream->m_pHDropFormat = &HDropFormat;
+					pStream->m_streamIndex = i;
+					pStream->m_streamCount = streamCount;
+					pStream->m_hThread = (HANDLE)_beginthreadex(NULL, 0, FileStreamThread, pStream, 0, NULL);
+
+					if(pStream->m_hThread == NULL)
+					{
+						delete pStream;
+						break;
+					}
+
+					streams.push_back(pStream);
+				}
 
-		if(m_SendSocket.SendCSendData(Info, MyEnums::START) == FALSE)
-			break;
+				//the server gives each stream its share of the files, if one couldn't start they are all requested over this connection
+				if((int)streams.size() + 1 < streamCount)
+				{
+					LogSendRecieveInfo(StrF(_T("Couldn't start file stream %d, requesting the files over one connection"), (int)streams.size() + 1));
+
+					StopFileStreams(streams);
+					streamCount = 1;
+				}
+
+				LogSendRecieveInfo(StrF(_T("Requesting files over %d connections"), (int)streams.size() + 1));
+			}
+
+			pProgress->SetMessage(StrF(_T("Requesting Files from %s (%s)"), csComputerName, csIP));
+
+			lRet = RecieveFileStream(csIP, 0, streamCount, pProgress, Recieve);
+		}
+
+		CloseConnection();
 
-		if(SendClipFormat(&HDropFormat) == FALSE)
+		if(Recieve.IsComplete() ||
+			lRet == USER_CANCELED ||
+			pProgress->Cancelled() ||
+			theApp.m_bAppExiting ||
+			attempt >= retries)
 		{
-			csErrorString = _T("Error sending data request.");
 			break;
 		}
 
-		if(m_SendSocket.SendCSendData(Info, MyEnums::END) == FALSE)
-			break;
-			
-		pProgress->SetMessage(StrF(_T("Requesting Files from %s (%s)"), csComputerName, csIP));
+		LogSendRecieveInfo(StrF(_T("File request to %s didn't finish, retrying %d of %d"), csIP, attempt + 1, retries));
+	}
 
-		if(m_SendSocket.SendCSendData(Info, MyEnums::REQUEST_FILES) == FALSE)
-			break;
+	CFileRecieve Merged;
+	bool bMd5Mismatch = (lRet == MD5_MISMATCH);
 
-		CFileRecieve Recieve;
-		long lRet = Recieve.RecieveFiles(m_Connection, csIP, pProgress);
-		if(lRet == TRUE)
-		{
-			hReturn = Recieve.CreateCF_HDROPBuffer();
-		}
-		else if(lRet == FALSE || lRet == MD5_MISMATCH)
+	if(streams.size() > 0)
+	{
+		pProgress->SetMessage(StrF(_T("Waiting on files from %s (%s)"), csComputerName, csIP));
+	}
+
+	for(size_t i = 0; i < streams.size(); i++)
+	{
+		while(WaitForSingleObject(streams[i]->m_hThread, 100) == WAIT_TIMEOUT)
 		{
-			if(pProgress != NULL && pProgress->Cancelled())
-			{
-				//Don't show an error message the user canceled things
-			}
-			else	
+			pProgress->PumpMessages();
+
+			if(pProgress->Cancelled() ||
+				lRet == USER_CANCELED ||
+				theApp.m_bAppExiting)
 			{
-				csErrorString = _T("Error receiving files.");
-				if (lRet == MD5_MISMATCH)
+				for(size_t abort = i; abort < streams.size(); abort++)
 				{
-					csErrorString += _T(" MD5 Match Error.");
+					streams[abort]->m_bAbort = true;
+					streams[abort]->m_Client.Abort();
 				}
 			}
 		}
 
-	} while(false);
+		CloseHandle(streams[i]->m_hThread);
 
-	CloseConnection();
+		if(streams[i]->m_lRet == MD5_MISMATCH)
+			bMd5Mismatch = true;
+	}
+
+	//files are split round robin between the streams, put them back in the order they were copied. A file is found by
+	//the name the server sent for it, a file that was skipped doesn't move the ones after it
+	std::map<CString, INT_PTR> positions;
+	GetFilePositions(HDropFormat, positions);
+
+	std::multimap<INT_PTR, CString> orderedFiles;
+	bool bAllComplete = true;
+	int expectedFiles = 0;
+	int receivedFiles = 0;
+
+	for(size_t i = 0; i <= streams.size(); i++)
+	{
+		CFileRecieve &streamRecieve = (i == 0) ? Recieve : streams[i - 1]->m_Recieve;
+		int streamIndex = (i == 0) ? 0 : streams[i - 1]->m_streamIndex;
+
+		if(streamRecieve.IsComplete() == false)
+		{
+			LogSendRecieveInfo(StrF(_T("File stream %d didn't finish"), streamIndex));
+			bAllComplete = false;
+		}
+		else if(streamRecieve.GetFileCount() < streamRecieve.GetExpectedFileCount())
+		{
+			LogSendRecieveInfo(StrF(_T("File stream %d received %d of %d files"), streamIndex, (int)streamRecieve.GetFileCount(), streamRecieve.GetExpectedFileCount()));
+		}
+
+		expectedFiles += streamRecieve.GetExpectedFileCount();
+		receivedFiles += (int)streamRecieve.GetFileCount();
+
+		for(INT_PTR nFile = 0; nFile < streamRecieve.GetFileCount(); nFile++)
+		{
+			INT_PTR position = nFile * streamCount + streamIndex;
+
+			std::map<CString, INT_PTR>::iterator found = positions.find(streamRecieve.GetRemoteFile(nFile));
+			if(found != positions.end())
+			{
+				position = found->second;
+			}
+
+			orderedFiles.insert(std::make_pair(position, streamRecieve.GetFile(nFile)));
+		}
+	}
+
+	for(std::multimap<INT_PTR, CString>::iterator file = orderedFiles.begin(); file != orderedFiles.end(); file++)
+	{
+		Merged.AddFile(file->second);
+	}
+
+	for(size_t i = 0; i < streams.size(); i++)
+	{
+		delete streams[i];
+	}
+	streams.clear();
+
+	Merged.RemoveResumeFiles();
+
+	if(pProgress->Cancelled() || lRet == USER_CANCELED)
+	{
+		//Don't show an error message the user canceled things
+	}
+	else if(bMd5Mismatch)
+	{
+		csErrorString = _T("Error receiving files. MD5 Match Error.");
+	}
+	//only all of the files, a CF_HDROP that's missing some would be pasted as if it was the whole copy
+	else if(bAllComplete &&
+		receivedFiles > 0 &&
+		receivedFiles >= expectedFiles)
+	{
+		hReturn = Merged.CreateCF_HDROPBuffer();
+	}
+	else if(csErrorString.IsEmpty())
+	{
+		if(bAllComplete && receivedFiles < expectedFiles)
+		{
+			csErrorString.Format(_T("Error receiving files. Received %d of %d files."), receivedFiles, expectedFiles);
+		}
+		else
+		{
+			csErrorString = _T("Error receiving files.");
+		}
+	}
 
 	if(hReturn == NULL && csErrorString.IsEmpty() == FALSE)
 	{
@@ -394,3 +931,77 @@ HGLOBAL CClient::RequestCopiedFiles(CClipFormat &HDropFormat, CString csIP, CStr
 
 	return hReturn;
 }
+
+//Opens the connection and sends the CF_HDROP the files are wanted for, REQUEST_FILES follows in RecieveFileStream
+BOOL CClient::SendFileRequest(CString requestFrom, CClipFormat &HDropFormat, CFileTransferProgressDlg *pProgress)
+{
+	if(OpenConnection(requestFrom) == FALSE)
+		return FALSE;
+
+	CSendInfo Info;
+
+	m_SendSocket.SetSocket(m_Connection);
+	m_SendSocket.SetProgressBar(pProgress);
+	m_RecieveSocket.SetSocket(m_Connection);
+
+	//the file request and the server's replies stay as CSendInfo messages
+	m_bAllowFrames = false;
+
+	Info.m_nVersion = NETWORK_PROTOCOL_VERSION;
+
+	if(m_SendSocket.SendCSendData(Info, MyEnums::START) == FALSE)
+		return FALSE;
+
+	m_bSentVersion = true;
+	Info.m_nVersion = 1;
+
+	if(SendClipFormat(&HDropFormat) == FALSE)
+	{
+		LogSendRecieveInfo("Error sending data request.");
+		return FALSE;
+	}
+
+	if(m_SendSocket.SendCSendData(Info, MyEnums::END) == FALSE)
+		return FALSE;
+
+	return TRUE;
+}
+
+long CClient::RecieveFileStream(CString csIP, int streamIndex, int streamCount, CFileTransferProgressDlg *pProgress, CFileRecieve &Recieve)
+{
+	CSendInfo Info;
+
+	//lets a newer server send the files compressed, resume ones that didn't finish, split them between connections
+	//and check them with a hash that's faster than md5
+	Info.m_nVersion = NETWORK_PROTOCOL_VERSION;
+	Info.m_lParameter1 = NETWORK_FEATURE_RESUME | NETWORK_FEATURE_FAST_HASH;
+	if(CGetSetOptions::GetNetworkCompressionLevel() > 0)
+	{
+		Info.m_lParameter1 |= NETWORK_FEATURE_COMPRESSION;
+	}
+	Info.m_lParameter2 = MAKELONG(streamIndex, streamCount);
+
+	if(m_SendSocket.SendCSendData(Info, MyEnums::REQUEST_FILES) == FALSE)
+		return FALSE;
+
+	return Recieve.RecieveFiles(m_Connection, csIP, pProgress, Info.m_lParameter1);
+}
+
+//Only servers that know about streams get more than one, the client doesn't know how many files there are so a stream can end up with none
+int CClient::GetFileStreamCount()
+{
+	if(m_serverVersion < NETWORK_RESUME_VERSION)
+		return 1;
+
+	return max(1, min(CGetSetOptions::GetNetworkFileStreams(), 16));
+}
+
+//Called from another thread to stop a transfer that's blocked reading
+void CClient::Abort()
+{
+	SOCKET connection = m_Connection;
+	if(connection != NULL)
+	{
+		shutdown(connection, SD_BOTH);
+	}
+}
@@ -12,6 +12,8 @@
 #include "Server.h"
 #include "EncryptDecrypt\Encryption.h"
 #include "SendSocket.h"
+#include "RecieveSocket.h"
+#include "FileRecieve.h"
 #include "Popup.h"
 
 class CSendToFriendInfo
@@ -47,24 +49,84 @@ public:
 	virtual ~CClient();
 
 	BOOL SendItem(CClip *pClip, bool manualSend);
+	BOOL StartSync(int mode);
 	
 	BOOL OpenConnection(const TCHAR* servername);
 	BOOL CloseConnection();
+	BOOL IsConnected()	{ return m_Connection != NULL; }
+
+	bool CanKeepConnectionOpen(int waitMs);
+	BOOL EndBatch();
+	bool IsConnectionAlive();
 
 	HGLOBAL RequestCopiedFiles(CClipFormat &HDropFormat, CString csIP, CString csComputerName);
 
+	BOOL SendFileRequest(CString requestFrom, CClipFormat &HDropFormat, CFileTransferProgressDlg *pProgress);
+	long RecieveFileStream(CString csIP, int streamIndex, int streamCount, CFileTransferProgressDlg *pProgress, CFileRecieve &Recieve);
+	void Abort();
+
+	CSendSocket &GetSendSocket()			{ return m_SendSocket; }
+	CRecieveSocket &GetRecieveSocket()		{ return m_RecieveSocket; }
+
 protected:
 	SOCKET m_Connection;
 	int m_connectionPort;
 
 	CSendSocket m_SendSocket;
+	CRecieveSocket m_RecieveSocket;
+
+	//version from the server's VERSION reply, 0 until it's read, older servers never send one
+	int m_serverVersion;
+	bool m_bSentVersion;
+	bool m_bWaitedForVersion;
+	long m_serverFeatures;
+
+	//after the FRAMES message everything is sent as frames, m_frame collects messages until they're sent
+	bool m_bFramed;
+	bool m_bAllowFrames;
+	CNetworkFrameWriter m_frame;
+
+	//clips sent for a history sync keep their date and crc
+	bool m_bSyncClips;
 
 	BOOL SendClipFormat(CClipFormat* pCF);
+	void CheckForVersionReply(int waitMs);
+	bool UseFrames();
+	BOOL SendFramedFormat(CClipFormat* pCF);
+	BOOL SendFrame();
+	int GetFileStreamCount();
 	
 protected:
 	
 };
 
+//One of the extra connections a file request is split over, the first one is the requesting CClient's own
+class CFileRequestStream
+{
+public:
+	CFileRequestStream()
+	{
+		m_pHDropFormat = NULL;
+		m_streamIndex = 0;
+		m_streamCount = 1;
+		m_lRet = FALSE;
+		m_bAbort = false;
+		m_hThread = NULL;
+	}
+
+	CString m_requestFrom;
+	CString m_csIP;
+	CClipFormat *m_pHDropFormat;
+	int m_streamIndex;
+	int m_streamCount;
+
+	CClient m_Client;
+	CFileRecieve m_Recieve;
+	long m_lRet;
+	volatile bool m_bAbort;
+	HANDLE m_hThread;
+};
+
 BOOL SendToFriend(CSendToFriendInfo &Info);
 
 UINT  SendClientThread(LPVOID pParam);
@@ -7,14 +7,17 @@
 #include "Clip.h"
 #include "DatabaseUtilities.h"
 #include "Crc32Dynamic.h"
+#include "RTFCrcFilter.h"
 #include "sqlite\CppSQLite3.h"
 #include "shared/TextConvert.h"
 #include "zlib/zlib.h"
 #include "Misc.h"
 #include "Md5.h"
+#include "EncryptDecrypt\sha2.h"
 #include "ChaiScriptOnCopy.h"
 #include "DittoChaiScript.h"
 #include "ImageHelper.h"
+#include "Thumbnails.h"
 
 #include <Mmsystem.h>
 #include <memory>
@@ -730,9 +733,22 @@ bool CClip::AddToDB(bool bCheckForDuplicates)
 	bool bResult;
 	try
 	{
-		m_Time = CTime::GetCurrentTime().GetTime();
+		//synced clips keep the date and crc they have on the other computer and go where their date puts them
+		if((m_param1 & REMOTE_CLIP_SYNC) == 0)
+		{
+			m_Time = CTime::GetCurrentTime().GetTime();
 
-		m_CRC = GenerateCRC();
+			m_CRC = GenerateCRC();
+		}
+		else if(FindSyncDuplicate())
+		{
+			return true;
+		}
+		else
+		{
+			MakeOrderFromDate();
+			bCheckForDuplicates = false;
+		}
 
 		if(bCheckForDuplicates &&
 			m_parentId < 0)
@@ -743,28 +759,28 @@ bool CClip::AddToDB(bool bCheckForDuplicates)
 				MakeLatestOrder();
 				MakeLatestGroupOrder();
 
-				CString sql;
-				
-				sql.Format(_T("UPDATE Main SET clipOrder = %f where lID = %d;"), 
-								m_clipOrder, nID);
+				CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("UPDATE Main SET clipOrder = ? where lID = ?;"));
+				stmt.bind(1, m_clipOrder);
+				stmt.bind(2, nID);
 
-				int ret = theApp.m_db.execDML(sql);
+				int ret = stmt.execDML();
 
 				int groupRet = -1;
 
 				if(m_parentId > -1)
 				{
-					sql.Format(_T("UPDATE Main SET clipGroupOrder = %f where lID = %d;"), 
-						m_clipGroupOrder, nID);
+					CppSQLite3Statement groupStmt = theApp.m_db.cachedStatement(_T("UPDATE Main SET clipGroupOrder = ? where lID = ?;"));
+					groupStmt.bind(1, m_clipGroupOrder);
+					groupStmt.bind(2, nID);
 
-					groupRet = theApp.m_db.execDML(sql);
+					groupRet = groupStmt.execDML();
 				}
 
 
 				m_id = nID;
 
-				Log(StrF(_T("Found duplicate clip in db, Id: %d, ParentId: %d crc: %d, NewOrder: %f, GroupOrder %f, Ret: %d, GroupRet: %d, SQL: %s"), 
-										nID, m_parentId, m_CRC, m_clipOrder, m_clipGroupOrder, ret, groupRet, sql));
+				Log(StrF(_T("Found duplicate clip in db, Id: %d, ParentId: %d crc: %d, NewOrder: %f, GroupOrder %f, Ret: %d, GroupRet: %d"), 
+										nID, m_parentId, m_CRC, m_clipOrder, m_clipGroupOrder, ret, groupRet));
 
 				return true;
 			}
@@ -789,14 +805,61 @@ bool CClip::AddToDB(bool bCheckForDuplicates)
 	}
 	
 	bResult = false;
-	if(AddToMainTable())
-	{		
-		bResult = AddToDataTable();
+
+	//scaled before the savepoint so the db isn't held while it's done, AddToDataTable empties m_Formats
+	int thumbnailHeight = CGetSetOptions::GetThumbnailHeight();
+	HGLOBAL hThumbnail = NULL;
+	if(thumbnailHeight > 0)
+	{
+		hThumbnail = CThumbnails::Create(m_Formats, thumbnailHeight);
+	}
+
+	//main and data rows are saved together, one commit for the clip instead of one per row
+	//a savepoint so this can still be called while a transaction is open, the write lock keeps the other threads' writes out of it
+	ATL::CCritSecLock writeLock(theApp.m_dbWriteLock.m_sect);
+
+	try
+	{
+		theApp.m_db.execDML(_T("SAVEPOINT AddClip;"));
+
+		if(AddToMainTable())
+		{		
+			bResult = AddToDataTable();
+		}
+
+		if(bResult && hThumbnail)
+		{
+			CThumbnails::Save(m_id, thumbnailHeight, hThumbnail);
+		}
+
+		if(bResult)
+		{
+			theApp.m_db.execDML(_T("RELEASE AddClip;"));
+		}
+		else
+		{
+			theApp.m_db.execDML(_T("ROLLBACK TO AddClip;"));
+			theApp.m_db.execDML(_T("RELEASE AddClip;"));
+		}
+	}
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("SQLITE Exception %d - %s"), e.errorCode(), e.errorMessage()));
+		ASSERT(FALSE);
+		bResult = false;
+	}
+
+	writeLock.Unlock();
+
+	if(hThumbnail)
+	{
+		GlobalFree(hThumbnail);
 	}
 
 	if(bResult)
 	{
-		if(g_Opt.m_csPlaySoundOnCopy.IsEmpty() == FALSE)
+		if(g_Opt.m_csPlaySoundOnCopy.IsEmpty() == FALSE &&
+			(m_param1 & REMOTE_CLIP_SYNC) == 0)
 			PlaySound(g_Opt.m_csPlaySoundOnCopy, NULL, SND_FILENAME|SND_ASYNC);
 
 		if (removeStickySettingClipId > 0)
@@ -828,8 +891,10 @@ int CClip::FindDuplicate()
 		}
 		else
 		{
-			CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT lID FROM Main WHERE CRC = %d"), m_CRC);
-				
+			CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT lID FROM Main WHERE CRC = ?"));
+			stmt.bind(1, (int)m_CRC);
+
+			CppSQLite3Query q = stmt.execQuery();
 			if(q.eof() == false)
 			{
 				return q.getIntField(_T("lID"));
@@ -841,6 +906,64 @@ int CClip::FindDuplicate()
 	return -1;
 }
 
+//A synced clip that's already here isn't added again. Without duplicates a clip with the same crc is the same clip,
+//the earlier of the two dates is kept so the next sync sees the same key on both sides
+bool CClip::FindSyncDuplicate()
+{
+	try
+	{
+		if(g_Opt.m_bAllowDuplicates)
+		{
+			CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT lID FROM Main WHERE lDate = ? AND CRC = ? AND bIsGroup = 0"));
+			stmt.bind(1, (int)m_Time.GetTime());
+			stmt.bind(2, (int)m_CRC);
+
+			CppSQLite3Query q = stmt.execQuery();
+			if(q.eof() == false)
+			{
+				m_id = q.getIntField(_T("lID"));
+				return true;
+			}
+		}
+		else
+		{
+			int existingDate = 0;
+			int nID = -1;
+			{
+				CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT lID, lDate FROM Main WHERE CRC = ? AND bIsGroup = 0"));
+				stmt.bind(1, (int)m_CRC);
+
+				CppSQLite3Query q = stmt.execQuery();
+				if(q.eof() == false)
+				{
+					nID = q.getIntField(_T("lID"));
+					existingDate = q.getIntField(_T("lDate"));
+				}
+			}
+
+			if(nID >= 0)
+			{
+				if((int)m_Time.GetTime() < existingDate)
+				{
+					CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("UPDATE Main SET lDate = ? WHERE lID = ?;"));
+					stmt.bind(1, (int)m_Time.GetTime());
+					stmt.bind(2, nID);
+					stmt.execDML();
+				}
+
+				m_id = nID;
+
+				Log(StrF(_T("Found synced clip in db, Id: %d, crc: %d, date: %d, existing date: %d"), nID, m_CRC, (int)m_Time.GetTime(), existingDate));
+
+				return true;
+			}
+		}
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	return false;
+}
+
 
 
 DWORD CClip::GenerateCRC()
@@ -848,65 +971,52 @@ DWORD CClip::GenerateCRC()
 	CClipFormat* pCF;
 	DWORD dwCRC = 0xFFFFFFFF;
 
-	CCrc32Dynamic *pCrc32 = new CCrc32Dynamic;
-	if(pCrc32)
-	{
-		//Generate a CRC value for all copied data
+	//Generate a CRC value for all copied data
 
-		INT_PTR size = m_Formats.GetSize();
-		for(int i = 0; i < size ; i++)
+	INT_PTR size = m_Formats.GetSize();
+	for(int i = 0; i < size ; i++)
+	{
+		pCF = & m_Formats.ElementAt(i);
+		
+		const unsigned char *Data = (const unsigned char *)GlobalLock(pCF->m_hgData);
+		if(Data)
 		{
-			pCF = & m_Formats.ElementAt(i);
-			
-			const unsigned char *Data = (const unsigned char *)GlobalLock(pCF->m_hgData);
-			if(Data)
+			if (CGetSetOptions::GetAdjustClipsForCRC())
 			{
-				if (CGetSetOptions::GetAdjustClipsForCRC())
+				//Try and remove known things that change in rtf (word and outlook)
+				if (pCF->m_cfType == theApp.m_RTFFormat)
 				{
-					//Try and remove known things that change in rtf (word and outlook)
-					if (pCF->m_cfType == theApp.m_RTFFormat)
-					{
-						CStringA CStringData((char*)Data);
-
-						//In word and outlook I was finding that data in the \\datastore section was always changing, remove this for the crc check
-						RemoveRTFSection(CStringData, "{\\*\\datastore");
-
-						//In word and outlook rsid values are always changing, remove these for the crc check
-						DeleteParamFromRTF(CStringData, "\\rsid", true);
-						DeleteParamFromRTF(CStringData, "\\insrsid", true);
-						DeleteParamFromRTF(CStringData, "\\mdispDef1", false);
+					//In word and outlook the \\datastore section and rsid values are always changing, these are left out of the crc check
+					size_t rtfLength = strnlen((const char*)Data, GlobalSize(pCF->m_hgData));
 
-						pCrc32->GenerateCrc32((const LPBYTE)CStringData.GetBuffer(), (DWORD)CStringData.GetLength(), dwCRC);
-					}
-					else
-					{
-						//i've seen examble where the text size was 10 but the data size was 20, leading to random crc values
-						//try and only check the crc for the actual text
-						int dataLength = (int)GlobalSize(pCF->m_hgData);
-						if (pCF->m_cfType == CF_TEXT)
-						{
-							dataLength = min(dataLength, ((int)strlen((char*)Data) + 1));
-						}
-						else if (pCF->m_cfType == CF_UNICODETEXT)
-						{
-							dataLength = min(dataLength, (((int)wcslen((wchar_t*)Data) + 1) * 2));
-						}
-						pCrc32->GenerateCrc32((const LPBYTE)Data, (DWORD)dataLength, dwCRC);
-					}
+					dwCRC = CRTFCrcFilter::UpdateCrc32(dwCRC, (const char*)Data, rtfLength);
 				}
 				else
 				{
-					pCrc32->GenerateCrc32((const LPBYTE)Data, (DWORD)GlobalSize(pCF->m_hgData), dwCRC);
+					//i've seen examble where the text size was 10 but the data size was 20, leading to random crc values
+					//try and only check the crc for the actual text
+					int dataLength = (int)GlobalSize(pCF->m_hgData);
+					if (pCF->m_cfType == CF_TEXT)
+					{
+						dataLength = min(dataLength, ((int)strlen((char*)Data) + 1));
+					}
+					else if (pCF->m_cfType == CF_UNICODETEXT)
+					{
+						dataLength = min(dataLength, (((int)wcslen((wchar_t*)Data) + 1) * 2));
+					}
+					dwCRC = CCrc32Dynamic::UpdateCrc32(dwCRC, Data, dataLength);
 				}
 			}
-			GlobalUnlock(pCF->m_hgData);
+			else
+			{
+				dwCRC = CCrc32Dynamic::UpdateCrc32(dwCRC, Data, GlobalSize(pCF->m_hgData));
+			}
 		}
-
-		dwCRC = ~dwCRC;
-
-		delete pCrc32;
+		GlobalUnlock(pCF->m_hgData);
 	}
 
+	dwCRC = ~dwCRC;
+
 	return dwCRC;
 }
 
@@ -915,30 +1025,27 @@ bool CClip::AddToMainTable()
 {
 	try
 	{
-		m_Desc.Replace(_T("'"), _T("''"));
-		m_csQuickPaste.Replace(_T("'"), _T("''"));
-
-		CString cs;
-		cs.Format(_T("INSERT into Main (lDate, mText, lShortCut, lDontAutoDelete, CRC, bIsGroup, lParentID, QuickPasteText, clipOrder, clipGroupOrder, globalShortCut, lastPasteDate, stickyClipOrder, stickyClipGroupOrder, MoveToGroupShortCut, GlobalMoveToGroupShortCut) ")
-						_T("values(%d, '%s', %d, %d, %d, %d, %d, '%s', %f, %f, %d, %d, %f, %f, %d, %d);"),
-							(int)m_Time.GetTime(),
-							m_Desc,
-							m_shortCut,
-							m_dontAutoDelete,
-							m_CRC,
-							m_bIsGroup,
-							m_parentId,
-							m_csQuickPaste,
-							m_clipOrder,
-							m_clipGroupOrder,
-							m_globalShortCut,
-							(int)CTime::GetCurrentTime().GetTime(),
-							m_stickyClipOrder,
-							m_stickyClipGroupOrder,
-							m_moveToGroupShortCut,
-							m_globalMoveToGroupShortCut);
-
-		theApp.m_db.execDML(cs);
+		CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("INSERT into Main (lDate, mText, lShortCut, lDontAutoDelete, CRC, bIsGroup, lParentID, QuickPasteText, clipOrder, clipGroupOrder, globalShortCut, lastPasteDate, stickyClipOrder, stickyClipGroupOrder, MoveToGroupShortCut, GlobalMoveToGroupShortCut) ")
+						_T("values(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);"));
+
+		stmt.bind(1, (int)m_Time.GetTime());
+		stmt.bind(2, m_Desc);
+		stmt.bind(3, m_shortCut);
+		stmt.bind(4, m_dontAutoDelete);
+		stmt.bind(5, (int)m_CRC);
+		stmt.bind(6, m_bIsGroup);
+		stmt.bind(7, m_parentId);
+		stmt.bind(8, m_csQuickPaste);
+		stmt.bind(9, m_clipOrder);
+		stmt.bind(10, m_clipGroupOrder);
+		stmt.bind(11, m_globalShortCut);
+		stmt.bind(12, (int)CTime::GetCurrentTime().GetTime());
+		stmt.bind(13, m_stickyClipOrder);
+		stmt.bind(14, m_stickyClipGroupOrder);
+		stmt.bind(15, m_moveToGroupShortCut);
+		stmt.bind(16, m_globalMoveToGroupShortCut);
+
+		stmt.execDML();
 
 		m_id = (long)theApp.m_db.lastRowId();
 
@@ -957,35 +1064,35 @@ bool CClip::ModifyMainTable()
 	bool bRet = false;
 	try
 	{
-		m_Desc.Replace(_T("'"), _T("''"));
-		m_csQuickPaste.Replace(_T("'"), _T("''"));
-
-		theApp.m_db.execDMLEx(_T("UPDATE Main SET lShortCut = %d, ")
-			_T("mText = '%s', ")
-			_T("lParentID = %d, ")
-			_T("lDontAutoDelete = %d, ")
-			_T("QuickPasteText = '%s', ")
-			_T("clipOrder = %f, ")
-			_T("clipGroupOrder = %f, ")
-			_T("globalShortCut = %d, ")
-			_T("stickyClipOrder = %f, ")
-			_T("stickyClipGroupOrder = %f, ")
-			_T("MoveToGroupShortCut = %d, ")
-			_T("GlobalMoveToGroupShortCut = %d ")
-			_T("WHERE lID = %d;"), 
-			m_shortCut, 
-			m_Desc, 
-			m_parentId, 
-			m_dontAutoDelete, 
-			m_csQuickPaste,
-			m_clipOrder,
-			m_clipGroupOrder,
-			m_globalShortCut,
-			m_stickyClipOrder,
-			m_stickyClipGroupOrder,
-			m_moveToGroupShortCut,
-			m_globalMoveToGroupShortCut,
-			m_id);
+		CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("UPDATE Main SET lShortCut = ?, ")
+			_T("mText = ?, ")
+			_T("lParentID = ?, ")
+			_T("lDontAutoDelete = ?, ")
+			_T("QuickPasteText = ?, ")
+			_T("clipOrder = ?, ")
+			_T("clipGroupOrder = ?, ")
+			_T("globalShortCut = ?, ")
+			_T("stickyClipOrder = ?, ")
+			_T("stickyClipGroupOrder = ?, ")
+			_T("MoveToGroupShortCut = ?, ")
+			_T("GlobalMoveToGroupShortCut = ? ")
+			_T("WHERE lID = ?;"));
+
+		stmt.bind(1, m_shortCut);
+		stmt.bind(2, m_Desc);
+		stmt.bind(3, m_parentId);
+		stmt.bind(4, m_dontAutoDelete);
+		stmt.bind(5, m_csQuickPaste);
+		stmt.bind(6, m_clipOrder);
+		stmt.bind(7, m_clipGroupOrder);
+		stmt.bind(8, m_globalShortCut);
+		stmt.bind(9, m_stickyClipOrder);
+		stmt.bind(10, m_stickyClipGroupOrder);
+		stmt.bind(11, m_moveToGroupShortCut);
+		stmt.bind(12, m_globalMoveToGroupShortCut);
+		stmt.bind(13, m_id);
+
+		stmt.execDML();
 
 		bRet = true;
 	}
@@ -999,12 +1106,11 @@ bool CClip::ModifyDescription()
 	bool bRet = false;
 	try
 	{
-		m_Desc.Replace(_T("'"), _T("''"));
+		CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("UPDATE Main SET mText = ? WHERE lID = ?;"));
+		stmt.bind(1, m_Desc);
+		stmt.bind(2, m_id);
 
-		theApp.m_db.execDMLEx(_T("UPDATE Main SET mText = '%s' ")
-			_T("WHERE lID = %d;"),
-			m_Desc,
-			m_id);
+		stmt.execDML();
 
 		bRet = true;
 	}
@@ -1020,7 +1126,9 @@ bool CClip::AddToDataTable()
 
 	try
 	{
-		CppSQLite3Statement stmt = theApp.m_db.compileStatement(_T("insert into Data values (NULL, ?, ?, ?);"));
+		CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("INSERT INTO Data (lParentID, strClipBoardFormat, ooData, blobID, lOriginalSize) VALUES (?, ?, ?, ?, ?);"));
+		int blobMinSize = CGetSetOptions::GetDataBlobMinSize();
+		std::vector<BYTE> compressed;
 		
 		for(INT_PTR i = m_Formats.GetSize()-1; i >= 0 ; i--)
 		{
@@ -1028,15 +1136,51 @@ bool CClip::AddToDataTable()
 
 			CString formatName = GetFormatName(pCF->m_cfType);
 			int clipSize = 0;
+			int savedSize = 0;
 			
 			stmt.bind(1, m_id);
 			stmt.bind(2, formatName);
+			stmt.bindNull(3);
+			stmt.bindNull(4);
+			stmt.bindNull(5);
+
+			bool hasSearchText = false;
+			CString searchText;
+			int blobId = 0;
 
 			const unsigned char *Data = (const unsigned char *)GlobalLock(pCF->m_hgData);
 			if(Data)
 			{
 				clipSize = (int)GlobalSize(pCF->m_hgData);
-				stmt.bind(3, Data, clipSize);
+				savedSize = clipSize;
+
+				//large formats are saved once in DataBlobs and shared, the Data row only points at it
+				if(blobMinSize > 0 && clipSize >= blobMinSize)
+				{
+					blobId = SaveDataBlob(theApp.m_db, Data, clipSize, CompressFormat(pCF->m_cfType, clipSize));
+				}
+
+				if(blobId > 0)
+				{
+					stmt.bind(4, blobId);
+				}
+				else if(CompressFormat(pCF->m_cfType, clipSize) && 
+						CompressData(Data, clipSize, compressed))
+				{
+					savedSize = (int)compressed.size();
+					stmt.bind(3, compressed.data(), savedSize);
+					stmt.bind(5, clipSize);
+				}
+				else
+				{
+					stmt.bind(3, Data, clipSize);
+				}
+
+				if(pCF->m_cfType == CF_UNICODETEXT)
+				{
+					searchText = GetDataSearchText(Data, clipSize);
+					hasSearchText = true;
+				}
 			}
 			GlobalUnlock(pCF->m_hgData);
 			
@@ -1045,7 +1189,13 @@ bool CClip::AddToDataTable()
 
 			pCF->m_dataId = (long)theApp.m_db.lastRowId();
 
-			Log(StrF(_T("Added ClipData to DB, Id: %d, ParentId: %d Type: %s, size: %d"), pCF->m_dataId, m_id, formatName, clipSize));
+			//save the searchable text once here so full text searches never have to read the data blobs
+			if(hasSearchText)
+			{
+				SaveDataSearchText(theApp.m_db, m_id, searchText);
+			}
+
+			Log(StrF(_T("Added ClipData to DB, Id: %d, ParentId: %d Type: %s, size: %d, saved size: %d, blob Id: %d"), pCF->m_dataId, m_id, formatName, clipSize, savedSize, blobId));
 		}
 	}
 	CATCH_SQLITE_EXCEPTION_AND_RETURN(false)
@@ -1053,6 +1203,147 @@ bool CClip::AddToDataTable()
 	return true;
 }
 
+//CF_UNICODETEXT is read by sql (unicodetext() for the full text index, regex searches) so it's always saved as is
+bool CClip::CompressFormat(CLIPFORMAT cfType, int dataLength)
+{
+	int compressMinSize = CGetSetOptions::GetDataCompressMinSize();
+
+	return compressMinSize > 0 &&
+		dataLength >= compressMinSize &&
+		cfType != CF_UNICODETEXT;
+}
+
+//zlib compresses data into compressed, returns false if it didn't save at least 1/8 of the size, the data is saved as is then
+bool CClip::CompressData(const unsigned char *data, int dataLength, std::vector<BYTE> &compressed)
+{
+	uLongf compressedSize = compressBound((uLong)dataLength);
+	compressed.resize(compressedSize);
+
+	int ret = compress2(compressed.data(), &compressedSize, data, (uLong)dataLength, CGetSetOptions::GetDataCompressionLevel());
+	if(ret != Z_OK)
+	{
+		Log(StrF(_T("Error compressing clip data, zlib: %d, size: %d"), ret, dataLength));
+		return false;
+	}
+
+	if(compressedSize >= (uLongf)(dataLength - dataLength / 8))
+	{
+		return false;
+	}
+
+	compressed.resize(compressedSize);
+
+	return true;
+}
+
+//Copies a Data.ooData value into a new global, uncompressing it if lOriginalSize was set when it was saved
+HGLOBAL CClip::NewGlobalFromData(const unsigned char *data, int dataLength, int originalSize)
+{
+	if(originalSize <= 0)
+	{
+		return NewGlobalP((LPVOID)data, dataLength);
+	}
+
+	HGLOBAL hGlobal = NewGlobal(originalSize);
+	if(hGlobal == NULL)
+	{
+		Log(StrF(_T("Error allocating memory to uncompress size = %d"), originalSize));
+		return NULL;
+	}
+
+	uLongf uncompressedSize = (uLongf)originalSize;
+	Bytef *pUncompressed = (Bytef *)GlobalLock(hGlobal);
+	int ret = uncompress(pUncompressed, &uncompressedSize, data, (uLong)dataLength);
+	GlobalUnlock(hGlobal);
+
+	if(ret != Z_OK || uncompressedSize != (uLongf)originalSize)
+	{
+		Log(StrF(_T("Error uncompressing clip data, zlib: %d, size: %d, original size: %d"), ret, dataLength, originalSize));
+		GlobalFree(hGlobal);
+		return NULL;
+	}
+
+	return hGlobal;
+}
+
+CString CClip::GetDataSearchText(const unsigned char *data, int dataLength)
+{
+	const wchar_t *text = (const wchar_t *)data;
+	int maxChars = dataLength / sizeof(wchar_t);
+
+	int searchLength = CGetSetOptions::GetMaxSearchTextLength();
+	if(searchLength > 0)
+	{
+		maxChars = min(maxChars, searchLength);
+	}
+
+	int length = 0;
+	while(length < maxChars && text[length] != 0)
+	{
+		length++;
+	}
+
+	CString searchText(text, length);
+	searchText.MakeLower();
+
+	return searchText;
+}
+
+void CClip::SaveDataSearchText(CppSQLite3DB &db, int parentId, CString searchText)
+{
+	CppSQLite3Statement stmt = db.cachedStatement(_T("INSERT OR REPLACE INTO DataSearchText (lParentID, searchText) VALUES (?, ?);"));
+
+	stmt.bind(1, parentId);
+	stmt.bind(2, searchText);
+	stmt.execDML();
+}
+
+//Returns the DataBlobs id holding this data, adding it if no blob has the same hash, the refCount is kept by the triggers on Data
+//the hash is of the uncompressed data so a blob is found no matter how it was saved, returns 0 if a blob with the same
+//hash has a different length so the caller saves the data in the Data row
+int CClip::SaveDataBlob(CppSQLite3DB &db, const unsigned char *data, int dataLength, bool compress)
+{
+	unsigned char hash[SHA256_DIGEST_SIZE];
+	sha256Lib(hash, data, dataLength);
+
+	{
+		CppSQLite3Statement stmt = db.cachedStatement(_T("SELECT lID, IFNULL(lOriginalSize, length(ooData)) FROM DataBlobs WHERE hash = ?;"));
+		stmt.bind(1, hash, SHA256_DIGEST_SIZE);
+
+		CppSQLite3Query q = stmt.execQuery();
+		if(q.eof() == false)
+		{
+			if(q.getIntField(1) != dataLength)
+			{
+				Log(StrF(_T("DataBlobs hash matched blob Id: %d with a different length, saving the data in the Data row"), q.getIntField(0)));
+				return 0;
+			}
+
+			return q.getIntField(0);
+		}
+	}
+
+	CppSQLite3Statement stmt = db.cachedStatement(_T("INSERT INTO DataBlobs (hash, refCount, ooData, lOriginalSize) VALUES (?, 0, ?, ?);"));
+	stmt.bind(1, hash, SHA256_DIGEST_SIZE);
+
+	std::vector<BYTE> compressed;
+	if(compress && 
+		CompressData(data, dataLength, compressed))
+	{
+		stmt.bind(2, compressed.data(), (int)compressed.size());
+		stmt.bind(3, dataLength);
+	}
+	else
+	{
+		stmt.bind(2, data, dataLength);
+		stmt.bindNull(3);
+	}
+
+	stmt.execDML();
+
+	return (int)db.lastRowId();
+}
+
 void CClip::MoveUp(int parentId)
 {
 	try
@@ -1448,6 +1739,46 @@ void CClip::MakeLastGroupOrder()
 	}
 }
 
+//Between the newest clip copied before this one and the clip above it
+void CClip::MakeOrderFromDate()
+{
+	bool bFound = false;
+	double lowerOrder = 0;
+
+	try
+	{
+		{
+			CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT clipOrder FROM Main WHERE lDate <= ? AND bIsGroup = 0 AND clipOrder notnull ORDER BY lDate DESC, clipOrder DESC LIMIT 1"));
+			stmt.bind(1, (int)m_Time.GetTime());
+
+			CppSQLite3Query q = stmt.execQuery();
+			if(q.eof() == false)
+			{
+				lowerOrder = q.getFloatField(_T("clipOrder"));
+				bFound = true;
+			}
+		}
+
+		if(bFound == false)
+		{
+			MakeLastOrder();
+			return;
+		}
+
+		m_clipOrder = lowerOrder + 1;
+
+		CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT clipOrder FROM Main WHERE clipOrder > ? ORDER BY clipOrder ASC LIMIT 1"));
+		stmt.bind(1, lowerOrder);
+
+		CppSQLite3Query q = stmt.execQuery();
+		if(q.eof() == false)
+		{
+			m_clipOrder = (lowerOrder + q.getFloatField(_T("clipOrder"))) / 2;
+		}
+	}
+	CATCH_SQLITE_EXCEPTION
+}
+
 double CClip::GetNewOrder(int parentId, int clipId)
 {
 	double newOrder = 0;
@@ -1458,7 +1789,9 @@ double CClip::GetNewOrder(int parentId, int clipId)
 	{
 		if(parentId < 0)
 		{
-			CppSQLite3Query q = theApp.m_db.execQuery(_T("SELECT clipOrder, mText FROM Main ORDER BY clipOrder DESC LIMIT 1"));			
+			CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT clipOrder, mText FROM Main ORDER BY clipOrder DESC LIMIT 1"));
+
+			CppSQLite3Query q = stmt.execQuery();
 			if(q.eof() == false)
 			{
 				existingMaxOrder = q.getFloatField(_T("clipOrder"));
@@ -1468,7 +1801,10 @@ double CClip::GetNewOrder(int parentId, int clipId)
 		}
 		else
 		{
-			CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT clipGroupOrder, mText FROM Main WHERE lParentID = %d ORDER BY clipGroupOrder DESC LIMIT 1"), parentId);			
+			CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT clipGroupOrder, mText FROM Main WHERE lParentID = ? ORDER BY clipGroupOrder DESC LIMIT 1"));
+			stmt.bind(1, parentId);
+
+			CppSQLite3Query q = stmt.execQuery();
 			if(q.eof() == false)
 			{
 				existingMaxOrder = q.getFloatField(_T("clipGroupOrder"));
@@ -1565,10 +1901,10 @@ HGLOBAL CClip::LoadFormat(int id, UINT cfType)
 		CString csSQL;
 		
 		csSQL.Format(
-			_T("SELECT Data.ooData FROM Data ")
-			_T("INNER JOIN Main ON Main.lID = Data.lParentID ")
+			_T("SELECT DataContent.ooData, DataContent.lOriginalSize FROM DataContent ")
+			_T("INNER JOIN Main ON Main.lID = DataContent.lParentID ")
 			_T("WHERE Main.lID = %d ")
-			_T("AND Data.strClipBoardFormat = \'%s\'"),
+			_T("AND DataContent.strClipBoardFormat = \'%s\'"),
 			id,
 			GetFormatName(cfType));
 
@@ -1583,7 +1919,7 @@ HGLOBAL CClip::LoadFormat(int id, UINT cfType)
 				return false;
 			}
 
-			hGlobal = NewGlobalP((LPVOID)cData, nDataLen);
+			hGlobal = NewGlobalFromData(cData, nDataLen, q.getIntField(1));
 		}
 	}
 	CATCH_SQLITE_EXCEPTION
@@ -1622,8 +1958,8 @@ bool CClip::LoadFormats(int id, bool bOnlyLoad_CF_TEXT, bool includeRichTextForT
 		}
 
 		csSQL.Format(
-			_T("SELECT lID, lParentID, strClipBoardFormat, ooData FROM Data ")
-			_T("WHERE %s lParentID = %d ORDER BY Data.lID desc"), textFilter, id);
+			_T("SELECT lID, lParentID, strClipBoardFormat, ooData, lOriginalSize FROM DataContent ")
+			_T("WHERE %s lParentID = %d ORDER BY DataContent.lID desc"), textFilter, id);
 
 		CppSQLite3Query q = theApp.m_db.execQuery(csSQL);
 
@@ -1649,7 +1985,7 @@ bool CClip::LoadFormats(int id, bool bOnlyLoad_CF_TEXT, bool includeRichTextForT
 			const unsigned char *cData = q.getBlobField(_T("ooData"), nDataLen);
 			if(cData != NULL)
 			{
-				hGlobal = NewGlobalP((LPVOID)cData, nDataLen);
+				hGlobal = NewGlobalFromData(cData, nDataLen, q.getIntField(_T("lOriginalSize")));
 			}
 			
 			cf.m_hgData = hGlobal;
@@ -1712,8 +2048,11 @@ bool CClip::SaveFromEditWnd(BOOL bUpdateDesc)
 		
 		if(bUpdateDesc)
 		{
-			m_Desc.Replace(_T("'"), _T("''"));
-			theApp.m_db.execDMLEx(_T("UPDATE Main SET mText = '%s' WHERE lID = %d"), m_Desc, m_id);
+			CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("UPDATE Main SET mText = ? WHERE lID = ?;"));
+			stmt.bind(1, m_Desc);
+			stmt.bind(2, m_id);
+
+			stmt.execDML();
 		}
 
 		bRet = true;
@@ -2011,7 +2350,8 @@ int CClipList::AddToDB(bool bLatestOrder)
 		pClip = GetNext(pos);
 		ASSERT(pClip);
 		
-		if(bLatestOrder)
+		if(bLatestOrder &&
+			(pClip->m_param1 & REMOTE_CLIP_SYNC) == 0)
 		{
 			pClip->MakeLatestOrder();
 			pClip->MakeLatestGroupOrder();
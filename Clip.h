@@ -11,6 +11,7 @@
 #include <afxole.h>
 #include <afxtempl.h>
 #include <memory>
+#include <vector>
 #include "tinyxml\tinyxml.h"
 #include "Shared\IClip.h"
 #include "Misc.h"
@@ -180,6 +181,7 @@ public:
 	void MakeLatestGroupOrder();
 	void MakeLastOrder();
 	void MakeLastGroupOrder();
+	void MakeOrderFromDate();
 	void MakeStickyTop(int parentId);
 	void MakeStickyLast(int parentId);
 	bool RemoveStickySetting(int parentId);
@@ -209,6 +211,16 @@ public:
 	static double GetExistingTopStickyClipId(int parentId);
 	static bool RemoveStickySetting(int clipId, int parentId);
 
+	// Lower cased text of a CF_UNICODETEXT format, capped at MaxSearchTextLength if it is set,, stored in DataSearchText for full text searches
+	static CString GetDataSearchText(const unsigned char *data, int dataLength);
+	static void SaveDataSearchText(CppSQLite3DB &db, int parentId, CString searchText);
+	static int SaveDataBlob(CppSQLite3DB &db, const unsigned char *data, int dataLength, bool compress);
+
+	// Formats at least DataCompressMinSize are zlib compressed in Data/DataBlobs.ooData with lOriginalSize set
+	static bool CompressFormat(CLIPFORMAT cfType, int dataLength);
+	static bool CompressData(const unsigned char *data, int dataLength, std::vector<BYTE> &compressed);
+	static HGLOBAL NewGlobalFromData(const unsigned char *data, int dataLength, int originalSize);
+
 	bool AddFileDataToData(CString &errorMessage);
 
 	Gdiplus::Bitmap *CreateGdiplusBitmap();
@@ -217,6 +229,7 @@ protected:
 	bool AddToMainTable();
 	bool AddToDataTable();
 	int FindDuplicate();
+	bool FindSyncDuplicate();
 
 	AddToDbStickyEnum::AddToDbSticky m_addToDbStickyEnum;
 };
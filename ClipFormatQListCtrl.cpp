@@ -30,6 +30,18 @@ HGLOBAL CClipFormatQListCtrl::GetDibFittingToHeight(CDC *pDc, int height)
 
 	m_convertedToSmallImage = true;
 
+	HGLOBAL hScaled = CBitmapHelper::GetScaledDib(this, height);
+	if(hScaled != NULL)
+	{
+		this->m_autoDeleteData = true;
+		this->Free();
+		this->m_autoDeleteData = false;
+
+		this->m_hgData = hScaled;
+		return this->m_hgData;
+	}
+
+	//anything the resampler can't read is drawn by gdi+
 	CBitmap Bitmap;
 	if( !CBitmapHelper::GetCBitmap(this, pDc, &Bitmap, height) )
 	{
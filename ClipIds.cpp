@@ -126,7 +126,6 @@ void CClipIDs::GetTypes(CClipTypes& types)
 
 bool CClipIDs::AggregateData(IClipAggregator &Aggregator, UINT cfType, BOOL bReverse, bool textOnly)
 {
-	CString csSQL;
 	LPWSTR Text = NULL;
 	int nTextSize = 0;
 	INT_PTR numIDs = GetSize();
@@ -143,23 +142,23 @@ bool CClipIDs::AggregateData(IClipAggregator &Aggregator, UINT cfType, BOOL bRev
 				nIndex = numIDs - i - 1;
 			}
 
-			CString sqlCF_HDROP = _T("");
+			//without files to add the second format is the same as the first
+			CString secondFormat = GetFormatName(cfType);
 			if (textOnly &&
 				cfType == CF_UNICODETEXT || cfType == CF_TEXT)
 			{
-				sqlCF_HDROP.Format(_T("OR Data.strClipBoardFormat = '%s'"), GetFormatName(CF_HDROP));
+				secondFormat = GetFormatName(CF_HDROP);
 			}
 
-			csSQL.Format(_T("SELECT * FROM Data ")
-				_T("INNER JOIN Main ON Main.lID = Data.lParentID ")
-				_T("WHERE (Data.strClipBoardFormat = '%s'")
-				_T(" %s) ")
-				_T("AND Main.lID = %d"),
-				GetFormatName(cfType),
-				sqlCF_HDROP,
-				ElementAt(nIndex));
+			CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT DataContent.strClipBoardFormat, DataContent.ooData, DataContent.lOriginalSize FROM DataContent ")
+				_T("INNER JOIN Main ON Main.lID = DataContent.lParentID ")
+				_T("WHERE (DataContent.strClipBoardFormat = ? OR DataContent.strClipBoardFormat = ?) ")
+				_T("AND Main.lID = ?"));
+			stmt.bind(1, GetFormatName(cfType));
+			stmt.bind(2, secondFormat);
+			stmt.bind(3, ElementAt(nIndex));
 
-			CppSQLite3Query q = theApp.m_db.execQuery(csSQL);
+			CppSQLite3Query q = stmt.execQuery();
 
 			if(q.eof() == false)
 			{
@@ -170,10 +169,31 @@ bool CClipIDs::AggregateData(IClipAggregator &Aggregator, UINT cfType, BOOL bRev
 					continue;
 				}
 
+				//compressed data is uncompressed into a global just for the aggregator
+				HGLOBAL hUncompressed = NULL;
+				int originalSize = q.getIntField(_T("lOriginalSize"));
+				if(originalSize > 0)
+				{
+					hUncompressed = CClip::NewGlobalFromData((const unsigned char *)pData, nDataLen, originalSize);
+					if(hUncompressed == NULL)
+					{
+						continue;
+					}
+
+					pData = GlobalLock(hUncompressed);
+					nDataLen = originalSize;
+				}
+
 				if(Aggregator.AddClip(pData, nDataLen, (int)i, (int)numIDs, GetFormatID(q.getStringField(_T("strClipBoardFormat")))))
 				{
 					bRet |= true;
 				}
+
+				if(hUncompressed != NULL)
+				{
+					GlobalUnlock(hUncompressed);
+					GlobalFree(hUncompressed);
+				}
 			}
 			else
 			{
@@ -293,7 +313,12 @@ BOOL CClipIDs::CopyTo(int parentId)
 
 		theApp.m_db.execDML(_T("commit transaction;"));
 	}
-	CATCH_SQLITE_EXCEPTION
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("SQLITE Exception %d - %s"), e.errorCode(), e.errorMessage()));
+		ASSERT(FALSE);
+		theApp.m_db.rollbackOpenTransaction();
+	}
 		
 	return TRUE;
 }
@@ -1,51 +1,65 @@
 #include "stdafx.h"
 #include "Crc32Dynamic.h"
-//#include <fstream.h>
+#include <string.h>
 
-CCrc32Dynamic::CCrc32Dynamic() : m_pdwCrc32Table(NULL)
-{
-	Init();
-}
-
-CCrc32Dynamic::~CCrc32Dynamic()
-{
-	Free();
-}
+#if defined(_M_IX86) || defined(_M_X64)
+#define CRC32_CLMUL
+#include <intrin.h>
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#endif
 
-void CCrc32Dynamic::Init()
+namespace
 {
 	// This is the official polynomial used by CRC32 in PKZip.
 	// Often times the polynomial shown reversed as 0x04C11DB7.
-	DWORD dwPolynomial = 0xEDB88320;
-	int i, j;
+	const DWORD Crc32Polynomial = 0xEDB88320;
 
-	Free();
-	m_pdwCrc32Table = new DWORD[256];
+	struct Crc32Tables
+	{
+		DWORD table[8][256];
+	};
 
-	DWORD dwCrc;
-	for(i = 0; i < 256; i++)
+	// table[0] is the byte at a time table, table[n] is the crc of a byte followed by n zero bytes, used to process 8 bytes per step
+	constexpr Crc32Tables MakeCrc32Tables()
 	{
-		dwCrc = i;
-		for(j = 8; j > 0; j--)
+		Crc32Tables tables = {};
+
+		for (DWORD i = 0; i < 256; i++)
 		{
-			if(dwCrc & 1)
-				dwCrc = (dwCrc >> 1) ^ dwPolynomial;
-			else
-				dwCrc >>= 1;
+			DWORD dwCrc = i;
+			for (int j = 8; j > 0; j--)
+			{
+				if (dwCrc & 1)
+					dwCrc = (dwCrc >> 1) ^ Crc32Polynomial;
+				else
+					dwCrc >>= 1;
+			}
+			tables.table[0][i] = dwCrc;
 		}
-		m_pdwCrc32Table[i] = dwCrc;
+
+		for (int slice = 1; slice < 8; slice++)
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				DWORD previous = tables.table[slice - 1][i];
+				tables.table[slice][i] = (previous >> 8) ^ tables.table[0][previous & 0xFF];
+			}
+		}
+
+		return tables;
 	}
+
+	constexpr Crc32Tables s_crc32Tables = MakeCrc32Tables();
 }
 
-void CCrc32Dynamic::Free()
+CCrc32Dynamic::CCrc32Dynamic()
 {
-	delete m_pdwCrc32Table;
-	m_pdwCrc32Table = NULL;
 }
 
-inline void CCrc32Dynamic::CalcCrc32(const BYTE byte, DWORD &dwCrc32) const
+CCrc32Dynamic::~CCrc32Dynamic()
 {
-	dwCrc32 = ((dwCrc32) >> 8) ^ m_pdwCrc32Table[(byte) ^ ((dwCrc32) & 0x000000FF)];
 }
 
 DWORD CCrc32Dynamic::GenerateCrc32(const LPBYTE lpbArray, DWORD dSize, DWORD &dwCrc32)
@@ -54,25 +68,201 @@ DWORD CCrc32Dynamic::GenerateCrc32(const LPBYTE lpbArray, DWORD dSize, DWORD &dw
 
 //	dwCrc32 = 0xFFFFFFFF;
 
-	try
+	if (lpbArray == NULL && dSize > 0)
 	{
-		// Is the table initialized?
-		if(m_pdwCrc32Table == NULL)
-			throw 0;
+		return ERROR_CRC;
+	}
 
-		for(DWORD i = 0; i < dSize; i++)
-		{
-			CalcCrc32(lpbArray[i], dwCrc32);
-		}
+	dwCrc32 = UpdateCrc32(dwCrc32, lpbArray, dSize);
+
+//	dwCrc32 = ~dwCrc32;
+
+	return dwErrorCode;
+}
+
+DWORD CCrc32Dynamic::UpdateCrc32(DWORD dwCrc32, const BYTE *pData, size_t size)
+{
+	//clmul needs at least 4 blocks of 16 bytes, anything left over goes through the tables
+	if (size >= 64 && HasClmul())
+	{
+		size_t clmulSize = size & ~((size_t)15);
+		dwCrc32 = UpdateClmul(dwCrc32, pData, clmulSize);
+		pData += clmulSize;
+		size -= clmulSize;
 	}
-	catch(...)
+
+	return UpdateSlicingBy8(dwCrc32, pData, size);
+}
+
+DWORD CCrc32Dynamic::UpdateSlicingBy8(DWORD dwCrc32, const BYTE *pData, size_t size)
+{
+	const DWORD (&table)[8][256] = s_crc32Tables.table;
+
+	while (size >= 8)
 	{
-		// An unknown exception happened, or the table isn't initialized
-		dwErrorCode = ERROR_CRC;
+		DWORD one;
+		DWORD two;
+		memcpy(&one, pData, sizeof(one));
+		memcpy(&two, pData + 4, sizeof(two));
+
+		one ^= dwCrc32;
+
+		dwCrc32 = table[7][one & 0xFF] ^
+				table[6][(one >> 8) & 0xFF] ^
+				table[5][(one >> 16) & 0xFF] ^
+				table[4][one >> 24] ^
+				table[3][two & 0xFF] ^
+				table[2][(two >> 8) & 0xFF] ^
+				table[1][(two >> 16) & 0xFF] ^
+				table[0][two >> 24];
+
+		pData += 8;
+		size -= 8;
 	}
 
-//	dwCrc32 = ~dwCrc32;
+	while (size > 0)
+	{
+		dwCrc32 = (dwCrc32 >> 8) ^ table[0][(*pData) ^ (dwCrc32 & 0x000000FF)];
 
-	return dwErrorCode;
+		pData++;
+		size--;
+	}
+
+	return dwCrc32;
 }
 
+bool CCrc32Dynamic::HasClmul()
+{
+#ifdef CRC32_CLMUL
+	static int hasClmul = -1;
+	if (hasClmul < 0)
+	{
+		int cpuInfo[4] = { 0 };
+		__cpuid(cpuInfo, 1);
+
+		//ecx bit 1 PCLMULQDQ, bit 19 SSE4.1 for _mm_extract_epi32
+		hasClmul = ((cpuInfo[2] & (1 << 1)) != 0 && (cpuInfo[2] & (1 << 19)) != 0) ? 1 : 0;
+	}
+
+	return hasClmul == 1;
+#else
+	return false;
+#endif
+}
+
+// Folds 64 bytes at a time with carry-less multiplies, then Barrett reduces to the 32 bit crc
+// From "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel), the constants are
+// for the bit reflected PKZip polynomial. size must be at least 64 and a multiple of 16
+DWORD CCrc32Dynamic::UpdateClmul(DWORD dwCrc32, const BYTE *pData, size_t size)
+{
+#ifdef CRC32_CLMUL
+	__declspec(align(16)) static const unsigned __int64 k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+	__declspec(align(16)) static const unsigned __int64 k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+	__declspec(align(16)) static const unsigned __int64 k5k0[] = { 0x0163cd6124, 0x0000000000 };
+	__declspec(align(16)) static const unsigned __int64 poly[] = { 0x01db710641, 0x01f7011641 };
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	x1 = _mm_loadu_si128((const __m128i *)(pData + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(pData + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(pData + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(pData + 0x30));
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)dwCrc32));
+
+	x0 = _mm_load_si128((const __m128i *)k1k2);
+
+	pData += 64;
+	size -= 64;
+
+	//fold 4 blocks of 16 in parallel
+	while (size >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+		y5 = _mm_loadu_si128((const __m128i *)(pData + 0x00));
+		y6 = _mm_loadu_si128((const __m128i *)(pData + 0x10));
+		y7 = _mm_loadu_si128((const __m128i *)(pData + 0x20));
+		y8 = _mm_loadu_si128((const __m128i *)(pData + 0x30));
+
+		x1 = _mm_xor_si128(x1, x5);
+		x2 = _mm_xor_si128(x2, x6);
+		x3 = _mm_xor_si128(x3, x7);
+		x4 = _mm_xor_si128(x4, x8);
+
+		x1 = _mm_xor_si128(x1, y5);
+		x2 = _mm_xor_si128(x2, y6);
+		x3 = _mm_xor_si128(x3, y7);
+		x4 = _mm_xor_si128(x4, y8);
+
+		pData += 64;
+		size -= 64;
+	}
+
+	//fold the 4 blocks into 1
+	x0 = _mm_load_si128((const __m128i *)k3k4);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(x1, x2);
+	x1 = _mm_xor_si128(x1, x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(x1, x3);
+	x1 = _mm_xor_si128(x1, x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(x1, x4);
+	x1 = _mm_xor_si128(x1, x5);
+
+	//remaining blocks of 16
+	while (size >= 16)
+	{
+		x2 = _mm_loadu_si128((const __m128i *)pData);
+
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(x1, x2);
+		x1 = _mm_xor_si128(x1, x5);
+
+		pData += 16;
+		size -= 16;
+	}
+
+	//fold 128 bits to 64
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	//Barrett reduce to 32 bits
+	x0 = _mm_load_si128((const __m128i *)poly);
+
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (DWORD)_mm_extract_epi32(x1, 1);
+#else
+	return UpdateSlicingBy8(dwCrc32, pData, size);
+#endif
+}
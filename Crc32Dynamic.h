@@ -1,6 +1,8 @@
 #ifndef _CRC32DYNAMIC_H_
 #define _CRC32DYNAMIC_H_
 
+// CRC32 with the PKZip polynomial, the caller passes in the running crc (start with 0xFFFFFFFF, no final xor)
+// so values match what has always been saved in Main.CRC
 class CCrc32Dynamic
 {
 public:
@@ -9,13 +11,12 @@ public:
 
 	DWORD GenerateCrc32(const LPBYTE lpbArray, DWORD dSize, DWORD &dwCrc32);
 
-protected:
-	inline void CalcCrc32(const BYTE byte, DWORD &dwCrc32) const;
-	
-	void Init();
-	void Free();
+	static DWORD UpdateCrc32(DWORD dwCrc32, const BYTE *pData, size_t size);
 
-	DWORD *m_pdwCrc32Table;
+protected:
+	static DWORD UpdateSlicingBy8(DWORD dwCrc32, const BYTE *pData, size_t size);
+	static DWORD UpdateClmul(DWORD dwCrc32, const BYTE *pData, size_t size);
+	static bool HasClmul();
 };
 
 #endif
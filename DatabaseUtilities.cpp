@@ -11,6 +11,12 @@
 #include "InternetUpdate.h"
 #include "zlib/zlib.h"
 #include "Shared/TextConvert.h"
+#include <process.h>
+
+//bumped when a database is opened, a migration thread for the one before stops at its next batch
+static volatile LONG s_dataSearchTextMigrationRun = 0;
+static volatile LONG s_dataSearchTextMigrated = TRUE;
+static volatile LONG s_fullTextSearchIndexAvailable = FALSE;
 using namespace nsPath;
 
 //////////////////////////////////////////////////////////////////////
@@ -211,11 +217,23 @@ BOOL OpenDatabase(CString dbPath)
 		}
 		
 
+		theApp.m_dbReadPool.Close();
 		theApp.m_db.close();
 		theApp.m_db.open(dbPath);
 
 		theApp.m_db.setBusyTimeout(CGetSetOptions::GetDbTimeout());
+		theApp.m_db.setWriteLock(&theApp.m_dbWriteLock);
 		theApp.m_db.SetRegexCaseInsensitive(CGetSetOptions::GetRegexCaseInsensitive());
+		theApp.m_db.setStatementCacheSize(CGetSetOptions::GetDbStatementCacheSize());
+
+		//in WAL mode readers don't block on the writer, so list loading gets its own read only connections
+		if (SetDbJournalMode(theApp.m_db))
+		{
+			theApp.m_dbReadPool.Open(dbPath, CGetSetOptions::GetDbReadConnections(), CGetSetOptions::GetDbTimeout());
+		}
+
+		StartDataSearchTextMigration(dbPath);
+		CheckFullTextSearchIndex(theApp.m_db);
 
 		return TRUE;
 	}
@@ -224,6 +242,43 @@ BOOL OpenDatabase(CString dbPath)
 	return FALSE;
 }
 
+//returns TRUE if the db is in WAL mode
+BOOL SetDbJournalMode(CppSQLite3DB &db)
+{
+	BOOL walMode = FALSE;
+
+	try
+	{
+		//WAL needs shared memory between processes so it can't be used when the db is on a network share
+		CString journalMode = _T("DELETE");
+		if (CGetSetOptions::GetDbWalMode() &&
+			theApp.m_databaseOnNetworkShare == false)
+		{
+			journalMode = _T("WAL");
+		}
+
+		{
+			//the journal mode can't be changed if another connection has the db open, use what the db reports back
+			CppSQLite3Query q = db.execQueryEx(_T("PRAGMA journal_mode = %s;"), journalMode);
+			if (q.eof() == false)
+			{
+				walMode = (CString(q.getStringField(0)).CompareNoCase(_T("wal")) == 0);
+			}
+		}
+
+		//NORMAL is only safe against power loss in WAL mode, otherwise leave the default of FULL
+		if (walMode)
+		{
+			db.execDMLEx(_T("PRAGMA synchronous = %d;"), CGetSetOptions::GetDbSynchronous());
+		}
+
+		Log(StrF(_T("Set db journal mode, requested: %s, WAL: %d, synchronous: %d"), journalMode, walMode, CGetSetOptions::GetDbSynchronous()));
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	return walMode;
+}
+
 void ReOrderStickyClips(int parentID, CppSQLite3DB &db)
 {
 	try
@@ -482,12 +537,629 @@ BOOL ValidDB(CString csPath, BOOL bUpgrade)
 		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_ShortCut2 on Main(lShortCut DESC, globalShortCut DESC)"));
 		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_MoveToGroup on Main(MoveToGroupShortCut DESC, GlobalMoveToGroupShortCut DESC)"));
 		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_CRC on Main(CRC ASC)"));
+		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_DateCRC on Main(lDate ASC, CRC ASC, bIsGroup ASC)"));
+
+		try
+		{
+			db.execQuery(_T("SELECT blobID FROM Data"));
+		}
+		catch (CppSQLite3Exception& e)
+		{
+			e.errorCode();
+
+			db.execDML(_T("ALTER TABLE Data ADD blobID INTEGER"));
+
+			//this read new.ooData, CreateFullTextSearchIndex adds it back reading from DataBlobs when the data is there
+			db.execDML(_T("DROP TRIGGER IF EXISTS MainFts_data_insert_trigger"));
+
+			//existing formats are moved into DataBlobs by MigrateDataBlobs
+			db.execDML(_T("CREATE TABLE DataBlobsMigration(lastDataID INTEGER, endDataID INTEGER)"));
+			db.execDML(_T("INSERT INTO DataBlobsMigration SELECT 0, IFNULL(MAX(lID), 0) FROM Data"));
+		}
+
+		try
+		{
+			db.execQuery(_T("SELECT lOriginalSize FROM Data"));
+		}
+		catch (CppSQLite3Exception& e)
+		{
+			e.errorCode();
+
+			//set to the uncompressed size when ooData is zlib compressed
+			db.execDML(_T("ALTER TABLE Data ADD lOriginalSize INTEGER"));
+			if (db.tableExists(_T("DataBlobs")))
+			{
+				db.execDML(_T("ALTER TABLE DataBlobs ADD lOriginalSize INTEGER"));
+			}
+
+			db.execDML(_T("DROP VIEW IF EXISTS DataContent"));
+		}
+
+		CreateDataBlobsTable(db);
+		CreateThumbnailsTable(db);
+		CreateMainCountsTable(db);
+
+		try
+		{
+			db.execQuery(_T("SELECT lParentID, searchText FROM DataSearchText"));
+		}
+		catch (CppSQLite3Exception& e)
+		{
+			e.errorCode();
+
+			CreateDataSearchTextTable(db);
+
+			//existing clips are filled in by MigrateDataSearchText, anything added after this is saved by CClip::AddToDataTable
+			db.execDML(_T("CREATE TABLE DataSearchTextMigration(lastDataID INTEGER, endDataID INTEGER)"));
+			db.execDML(_T("INSERT INTO DataSearchTextMigration SELECT 0, IFNULL(MAX(lID), 0) FROM Data"));
+		}
+
+		MigrateDataBlobs(db);
+
+		if (CGetSetOptions::GetUseFullTextSearchIndex())
+		{
+			if (CreateFullTextSearchIndex(db) == FALSE)
+			{
+				Log(_T("Failed to create the full text search index, searches will use LIKE"));
+			}
+		}
+		else
+		{
+			DropFullTextSearchIndex(db);
+		}
 	}
 	CATCH_SQLITE_EXCEPTION_AND_RETURN(FALSE)
 
 	return TRUE;                                                     
 }
 
+//Lower cased text of each clip's CF_UNICODETEXT data, full text searches use this so they don't have to read the Data blobs
+BOOL CreateDataSearchTextTable(CppSQLite3DB &db)
+{
+	try
+	{
+		db.execDML(_T("CREATE TABLE IF NOT EXISTS DataSearchText(")
+			_T("lParentID INTEGER PRIMARY KEY, ")
+			_T("searchText TEXT)"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS DataSearchText_delete_trigger AFTER DELETE ON Data FOR EACH ROW WHEN old.strClipBoardFormat = 'CF_UNICODETEXT'\n")
+			_T("BEGIN\n")
+				_T("DELETE FROM DataSearchText WHERE lParentID = old.lParentID;\n")
+			_T("END\n"));
+	}
+	CATCH_SQLITE_EXCEPTION_AND_RETURN(FALSE)
+
+	return TRUE;
+}
+
+class CDataSearchTextMigration
+{
+public:
+	CString m_dbPath;
+	LONG m_run;
+};
+
+static unsigned int __stdcall DataSearchTextMigrationThread(void *pParam)
+{
+	CDataSearchTextMigration *pMigration = (CDataSearchTextMigration*)pParam;
+
+	try
+	{
+		CppSQLite3DB db;
+		db.open(pMigration->m_dbPath);
+		db.setBusyTimeout(CGetSetOptions::GetDbTimeout());
+
+		if (MigrateDataSearchText(db, pMigration->m_run) &&
+			pMigration->m_run == s_dataSearchTextMigrationRun)
+		{
+			InterlockedExchange(&s_dataSearchTextMigrated, TRUE);
+		}
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	delete pMigration;
+
+	return 0;
+}
+
+//Clips saved before DataSearchText existed are filled in on another thread with its own connection so startup doesn't wait
+//on it, until it's done searches read the text of clips that don't have a row yet from Data, see DataSearchTextMigrated
+void StartDataSearchTextMigration(CString dbPath)
+{
+	LONG run = InterlockedIncrement(&s_dataSearchTextMigrationRun);
+
+	bool migrated = true;
+	try
+	{
+		migrated = (theApp.m_db.tableExists(_T("DataSearchTextMigration")) == false);
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	InterlockedExchange(&s_dataSearchTextMigrated, migrated ? TRUE : FALSE);
+
+	if (migrated)
+	{
+		return;
+	}
+
+	CDataSearchTextMigration *pMigration = new CDataSearchTextMigration;
+	pMigration->m_dbPath = dbPath;
+	pMigration->m_run = run;
+
+	HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, DataSearchTextMigrationThread, pMigration, 0, NULL);
+	if (hThread == NULL)
+	{
+		Log(_T("Failed to start the DataSearchText migration thread, it's tried again the next time the db is opened"));
+		delete pMigration;
+		return;
+	}
+
+	CloseHandle(hThread);
+}
+
+bool DataSearchTextMigrated()
+{
+	return s_dataSearchTextMigrated != FALSE;
+}
+
+//Fills DataSearchText for clips that were saved before the table existed, each batch is committed
+//along with the last Data.lID processed so if Ditto is closed it picks up where it left off.
+//A run from StartDataSearchTextMigration stops between batches once another db is opened
+BOOL MigrateDataSearchText(CppSQLite3DB &db, LONG run)
+{
+	try
+	{
+		if (db.tableExists(_T("DataSearchTextMigration")) == false)
+		{
+			return TRUE;
+		}
+
+		int lastDataId = 0;
+		int endDataId = 0;
+		{
+			CppSQLite3Query q = db.execQuery(_T("SELECT lastDataID, endDataID FROM DataSearchTextMigration"));
+			if (q.eof() == false)
+			{
+				lastDataId = q.getIntField(_T("lastDataID"));
+				endDataId = q.getIntField(_T("endDataID"));
+			}
+		}
+
+		Log(StrF(_T("Start migrating DataSearchText, from Data Id: %d, to: %d"), lastDataId, endDataId));
+		DWORD startTick = GetTickCount();
+		int batchSize = max(CGetSetOptions::GetDataSearchTextMigrationBatch(), 1);
+		int count = 0;
+
+		while (lastDataId < endDataId)
+		{
+			if (theApp.m_bAppExiting ||
+				(run != 0 && run != s_dataSearchTextMigrationRun))
+			{
+				Log(StrF(_T("Stopped migrating DataSearchText at Data Id: %d of %d, clips: %d"), lastDataId, endDataId, count));
+				return FALSE;
+			}
+
+			int batchEndId = min(lastDataId + batchSize, endDataId);
+
+			db.execDML(_T("begin transaction;"));
+
+			CppSQLite3Query q = db.execQueryEx(_T("SELECT lParentID, ooData FROM DataContent WHERE lID > %d AND lID <= %d AND strClipBoardFormat = 'CF_UNICODETEXT'"), lastDataId, batchEndId);
+			while (q.eof() == false)
+			{
+				int dataLength = 0;
+				const unsigned char *data = q.getBlobField(_T("ooData"), dataLength);
+				if (data != NULL)
+				{
+					CClip::SaveDataSearchText(db, q.getIntField(_T("lParentID")), CClip::GetDataSearchText(data, dataLength));
+					count++;
+				}
+
+				q.nextRow();
+			}
+			q.finalize();
+
+			db.execDMLEx(_T("UPDATE DataSearchTextMigration SET lastDataID = %d"), batchEndId);
+
+			db.execDML(_T("commit transaction;"));
+
+			lastDataId = batchEndId;
+
+			Log(StrF(_T("Migrating DataSearchText, at Data Id: %d of %d, clips: %d"), lastDataId, endDataId, count));
+		}
+
+		db.execDML(_T("DROP TABLE DataSearchTextMigration"));
+
+		Log(StrF(_T("Done migrating DataSearchText, clips: %d, time: %d(ms)"), count, GetTickCount() - startTick));
+	}
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("SQLITE Exception migrating DataSearchText %d - %s"), e.errorCode(), e.errorMessage()));
+
+		//the batch that failed is rolled back and tried again the next time the db is opened
+		try
+		{
+			db.execDML(_T("rollback transaction;"));
+		}
+		catch (CppSQLite3Exception& rollbackException)
+		{
+			rollbackException.errorCode();
+		}
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//Formats are stored once per sha256 hash in DataBlobs and Data.blobID points at it, Data.ooData is NULL for these.
+//The triggers on Data keep refCount so every path that deletes Data rows (delete_data_trigger -> MainDeletes cleanup,
+//deleting formats, edits) drops the blob once nothing uses it. DataContent has the data from either place, read Data through it
+BOOL CreateDataBlobsTable(CppSQLite3DB &db)
+{
+	try
+	{
+		db.execDML(_T("CREATE TABLE IF NOT EXISTS DataBlobs(")
+			_T("lID INTEGER PRIMARY KEY AUTOINCREMENT, ")
+			_T("hash BLOB UNIQUE, ")
+			_T("refCount INTEGER, ")
+			_T("ooData BLOB, ")
+			_T("lOriginalSize INTEGER)"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS DataBlobs_insert_trigger AFTER INSERT ON Data FOR EACH ROW WHEN new.blobID IS NOT NULL\n")
+			_T("BEGIN\n")
+				_T("UPDATE DataBlobs SET refCount = refCount + 1 WHERE lID = new.blobID;\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS DataBlobs_update_trigger AFTER UPDATE OF blobID ON Data FOR EACH ROW WHEN new.blobID IS NOT old.blobID\n")
+			_T("BEGIN\n")
+				_T("UPDATE DataBlobs SET refCount = refCount + 1 WHERE lID = new.blobID;\n")
+				_T("UPDATE DataBlobs SET refCount = refCount - 1 WHERE lID = old.blobID;\n")
+				_T("DELETE FROM DataBlobs WHERE lID = old.blobID AND refCount <= 0;\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS DataBlobs_delete_trigger AFTER DELETE ON Data FOR EACH ROW WHEN old.blobID IS NOT NULL\n")
+			_T("BEGIN\n")
+				_T("UPDATE DataBlobs SET refCount = refCount - 1 WHERE lID = old.blobID;\n")
+				_T("DELETE FROM DataBlobs WHERE lID = old.blobID AND refCount <= 0;\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE VIEW IF NOT EXISTS DataContent AS ")
+			_T("SELECT Data.lID AS lID, Data.lParentID AS lParentID, Data.strClipBoardFormat AS strClipBoardFormat, IFNULL(Data.ooData, DataBlobs.ooData) AS ooData, ")
+			_T("CASE WHEN Data.ooData IS NULL THEN DataBlobs.lOriginalSize ELSE Data.lOriginalSize END AS lOriginalSize ")
+			_T("FROM Data LEFT JOIN DataBlobs ON DataBlobs.lID = Data.blobID"));
+	}
+	CATCH_SQLITE_EXCEPTION_AND_RETURN(FALSE)
+
+	return TRUE;
+}
+
+//Image clips scaled to the list's row height, see CThumbnails. Existing clips get theirs the first time the list shows them,
+//deleting a clip or its image deletes them
+BOOL CreateThumbnailsTable(CppSQLite3DB &db)
+{
+	try
+	{
+		db.execDML(_T("CREATE TABLE IF NOT EXISTS Thumbnails(")
+			_T("lParentID INTEGER, ")
+			_T("lHeight INTEGER, ")
+			_T("ooData BLOB, ")
+			_T("lOriginalSize INTEGER, ")
+			_T("PRIMARY KEY(lParentID, lHeight))"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS Thumbnails_delete_trigger AFTER DELETE ON Data FOR EACH ROW WHEN old.strClipBoardFormat IN ('CF_DIB', 'PNG')\n")
+			_T("BEGIN\n")
+				_T("DELETE FROM Thumbnails WHERE lParentID = old.lParentID;\n")
+			_T("END\n"));
+	}
+	CATCH_SQLITE_EXCEPTION_AND_RETURN(FALSE)
+
+	return TRUE;
+}
+
+//Number of clips in Main for each lParentID and bIsGroup, kept by triggers so the list count when there's no search
+//doesn't scan Main. A null lParentID or bIsGroup is counted as -2 or -1 so it never matches the list filters, the same as in Main
+BOOL CreateMainCountsTable(CppSQLite3DB &db)
+{
+	try
+	{
+		bool fill = (db.tableExists(_T("MainCounts")) == false);
+
+		db.execDML(_T("begin transaction;"));
+
+		db.execDML(_T("CREATE TABLE IF NOT EXISTS MainCounts(")
+			_T("lParentID INTEGER NOT NULL, ")
+			_T("bIsGroup INTEGER NOT NULL, ")
+			_T("lCount INTEGER, ")
+			_T("PRIMARY KEY(lParentID, bIsGroup))"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainCounts_insert_trigger AFTER INSERT ON Main FOR EACH ROW\n")
+			_T("BEGIN\n")
+				_T("INSERT INTO MainCounts VALUES(IFNULL(new.lParentID, -2), IFNULL(new.bIsGroup, -1), 1) ON CONFLICT(lParentID, bIsGroup) DO UPDATE SET lCount = lCount + 1;\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainCounts_delete_trigger AFTER DELETE ON Main FOR EACH ROW\n")
+			_T("BEGIN\n")
+				_T("UPDATE MainCounts SET lCount = lCount - 1 WHERE lParentID = IFNULL(old.lParentID, -2) AND bIsGroup = IFNULL(old.bIsGroup, -1);\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainCounts_update_trigger AFTER UPDATE OF lParentID, bIsGroup ON Main FOR EACH ROW ")
+			_T("WHEN IFNULL(old.lParentID, -2) <> IFNULL(new.lParentID, -2) OR IFNULL(old.bIsGroup, -1) <> IFNULL(new.bIsGroup, -1)\n")
+			_T("BEGIN\n")
+				_T("UPDATE MainCounts SET lCount = lCount - 1 WHERE lParentID = IFNULL(old.lParentID, -2) AND bIsGroup = IFNULL(old.bIsGroup, -1);\n")
+				_T("INSERT INTO MainCounts VALUES(IFNULL(new.lParentID, -2), IFNULL(new.bIsGroup, -1), 1) ON CONFLICT(lParentID, bIsGroup) DO UPDATE SET lCount = lCount + 1;\n")
+			_T("END\n"));
+
+		//the first time, count the clips that are already there. Done in the same transaction as the triggers so nothing is counted twice or missed
+		if (fill)
+		{
+			Log(_T("Start filling MainCounts"));
+			DWORD startTick = GetTickCount();
+
+			db.execDML(_T("INSERT INTO MainCounts SELECT IFNULL(lParentID, -2), IFNULL(bIsGroup, -1), COUNT(*) FROM Main GROUP BY 1, 2"));
+
+			Log(StrF(_T("End filling MainCounts, time: %d"), GetTickCount() - startTick));
+		}
+
+		db.execDML(_T("commit transaction;"));
+	}
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("SQLITE Exception creating MainCounts %d - %s"), e.errorCode(), e.errorMessage()));
+
+		try
+		{
+			db.execDML(_T("rollback transaction;"));
+		}
+		catch (CppSQLite3Exception& rollbackException)
+		{
+			rollbackException.errorCode();
+		}
+
+		ASSERT(FALSE);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//Moves formats saved before DataBlobs existed into it, compressing them the same as new clips,
+//same batching as MigrateDataSearchText so it resumes where it left off
+BOOL MigrateDataBlobs(CppSQLite3DB &db)
+{
+	try
+	{
+		int blobMinSize = CGetSetOptions::GetDataBlobMinSize();
+		if (blobMinSize <= 0 ||
+			db.tableExists(_T("DataBlobsMigration")) == false)
+		{
+			return TRUE;
+		}
+
+		int lastDataId = 0;
+		int endDataId = 0;
+		{
+			CppSQLite3Query q = db.execQuery(_T("SELECT lastDataID, endDataID FROM DataBlobsMigration"));
+			if (q.eof() == false)
+			{
+				lastDataId = q.getIntField(_T("lastDataID"));
+				endDataId = q.getIntField(_T("endDataID"));
+			}
+		}
+
+		Log(StrF(_T("Start migrating DataBlobs, from Data Id: %d, to: %d"), lastDataId, endDataId));
+		DWORD startTick = GetTickCount();
+		int batchSize = max(CGetSetOptions::GetDataBlobMigrationBatch(), 1);
+		int count = 0;
+		__int64 movedBytes = 0;
+
+		while (lastDataId < endDataId)
+		{
+			int batchEndId = min(lastDataId + batchSize, endDataId);
+
+			db.execDML(_T("begin transaction;"));
+
+			//ids first, the rows are updated as they are moved
+			CArray<int> dataIds;
+			{
+				CppSQLite3Query q = db.execQueryEx(_T("SELECT lID FROM Data WHERE lID > %d AND lID <= %d AND blobID IS NULL AND length(ooData) >= %d"), lastDataId, batchEndId, blobMinSize);
+				while (q.eof() == false)
+				{
+					dataIds.Add(q.getIntField(0));
+					q.nextRow();
+				}
+			}
+
+			for (INT_PTR i = 0; i < dataIds.GetSize(); i++)
+			{
+				int blobId = 0;
+				int dataLength = 0;
+				{
+					CppSQLite3Query q = db.execQueryEx(_T("SELECT strClipBoardFormat, ooData, lOriginalSize FROM Data WHERE lID = %d"), dataIds[i]);
+					if (q.eof() == false)
+					{
+						CLIPFORMAT cfType = GetFormatID(q.getStringField(_T("strClipBoardFormat")));
+						const unsigned char *data = q.getBlobField(_T("ooData"), dataLength);
+						int originalSize = q.getIntField(_T("lOriginalSize"));
+
+						//blobs are hashed uncompressed
+						if (data != NULL && originalSize > 0)
+						{
+							HGLOBAL hGlobal = CClip::NewGlobalFromData(data, dataLength, originalSize);
+							if (hGlobal != NULL)
+							{
+								blobId = CClip::SaveDataBlob(db, (const unsigned char *)GlobalLock(hGlobal), originalSize, CClip::CompressFormat(cfType, originalSize));
+								GlobalUnlock(hGlobal);
+								GlobalFree(hGlobal);
+							}
+						}
+						else if (data != NULL)
+						{
+							blobId = CClip::SaveDataBlob(db, data, dataLength, CClip::CompressFormat(cfType, dataLength));
+						}
+					}
+				}
+
+				if (blobId > 0)
+				{
+					db.execDMLEx(_T("UPDATE Data SET ooData = NULL, lOriginalSize = NULL, blobID = %d WHERE lID = %d"), blobId, dataIds[i]);
+					count++;
+					movedBytes += dataLength;
+				}
+			}
+
+			db.execDMLEx(_T("UPDATE DataBlobsMigration SET lastDataID = %d"), batchEndId);
+
+			db.execDML(_T("commit transaction;"));
+
+			lastDataId = batchEndId;
+
+			Log(StrF(_T("Migrating DataBlobs, at Data Id: %d of %d, formats: %d"), lastDataId, endDataId, count));
+		}
+
+		db.execDML(_T("DROP TABLE DataBlobsMigration"));
+
+		//format bytes is what the moved formats used to take, blob bytes is what they take now
+		CppSQLite3Query q = db.execQuery(_T("SELECT COUNT(lID), IFNULL(SUM(length(ooData)), 0) FROM DataBlobs"));
+
+		Log(StrF(_T("Done migrating DataBlobs, formats: %d, format bytes: %I64d, blobs: %d, blob bytes: %.0f, time: %d(ms)"), count, movedBytes, q.getIntField(0), q.getFloatField(1), GetTickCount() - startTick));
+	}
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("SQLITE Exception migrating DataBlobs %d - %s"), e.errorCode(), e.errorMessage()));
+
+		//the batch that failed is rolled back and tried again the next time the db is validated
+		try
+		{
+			db.execDML(_T("rollback transaction;"));
+		}
+		catch (CppSQLite3Exception& rollbackException)
+		{
+			rollbackException.errorCode();
+		}
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//Trigram FTS5 index over the description, quick paste text and CF_UNICODETEXT data of each clip, rowid is Main.lID
+//the trigram tokenizer matches sub strings so searches return the same rows as LIKE '%text%'
+//Created with its triggers in one savepoint, if any of it fails (no fts5 or trigram tokenizer, out of space) none of it is left
+BOOL CreateFullTextSearchIndex(CppSQLite3DB &db)
+{
+	try
+	{
+		db.execDML(_T("SAVEPOINT CreateFullTextSearchIndex;"));
+
+		if (db.tableExists(_T("MainFts")) == false)
+		{
+			Log(_T("Start creating full text search index"));
+			DWORD startTick = GetTickCount();
+
+			db.execDML(_T("CREATE VIRTUAL TABLE MainFts USING fts5(mText, QuickPasteText, FullText, tokenize = 'trigram');"));
+
+			db.execDML(_T("INSERT INTO MainFts(rowid, mText, QuickPasteText, FullText) ")
+				_T("SELECT Main.lID, Main.mText, Main.QuickPasteText, ")
+				_T("(SELECT unicodetext(DataContent.ooData) FROM DataContent WHERE DataContent.lParentID = Main.lID AND DataContent.strClipBoardFormat = 'CF_UNICODETEXT' LIMIT 1) ")
+				_T("FROM Main;"));
+
+			Log(StrF(_T("Done creating full text search index, time: %d(ms)"), GetTickCount() - startTick));
+		}
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainFts_insert_trigger AFTER INSERT ON Main FOR EACH ROW\n")
+			_T("BEGIN\n")
+				_T("INSERT INTO MainFts(rowid, mText, QuickPasteText, FullText) VALUES(new.lID, new.mText, new.QuickPasteText, NULL);\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainFts_update_trigger AFTER UPDATE OF mText, QuickPasteText ON Main FOR EACH ROW\n")
+			_T("BEGIN\n")
+				_T("UPDATE MainFts SET mText = new.mText, QuickPasteText = new.QuickPasteText WHERE rowid = new.lID;\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainFts_delete_trigger AFTER DELETE ON Main FOR EACH ROW\n")
+			_T("BEGIN\n")
+				_T("DELETE FROM MainFts WHERE rowid = old.lID;\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainFts_data_insert_trigger AFTER INSERT ON Data FOR EACH ROW WHEN new.strClipBoardFormat = 'CF_UNICODETEXT'\n")
+			_T("BEGIN\n")
+				_T("UPDATE MainFts SET FullText = unicodetext(IFNULL(new.ooData, (SELECT ooData FROM DataBlobs WHERE lID = new.blobID))) WHERE rowid = new.lParentID;\n")
+			_T("END\n"));
+
+		db.execDML(_T("CREATE TRIGGER IF NOT EXISTS MainFts_data_delete_trigger AFTER DELETE ON Data FOR EACH ROW WHEN old.strClipBoardFormat = 'CF_UNICODETEXT'\n")
+			_T("BEGIN\n")
+				_T("UPDATE MainFts SET FullText = NULL WHERE rowid = old.lParentID;\n")
+			_T("END\n"));
+
+		db.execDML(_T("RELEASE CreateFullTextSearchIndex;"));
+	}
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("SQLITE Exception creating full text search index %d - %s"), e.errorCode(), e.errorMessage()));
+
+		try
+		{
+			db.execDML(_T("ROLLBACK TO CreateFullTextSearchIndex;"));
+			db.execDML(_T("RELEASE CreateFullTextSearchIndex;"));
+		}
+		catch (CppSQLite3Exception& rollbackException)
+		{
+			rollbackException.errorCode();
+		}
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//The index is only searched if it's on in the options and MainFts is there with all of its triggers,
+//otherwise FormatSQL's MATCH would fail or miss clips and searches use LIKE
+void CheckFullTextSearchIndex(CppSQLite3DB &db)
+{
+	bool available = false;
+
+	if (CGetSetOptions::GetUseFullTextSearchIndex())
+	{
+		try
+		{
+			available = db.tableExists(_T("MainFts")) &&
+				db.execScalar(_T("SELECT COUNT(*) FROM sqlite_master WHERE type = 'trigger' AND name IN ('MainFts_insert_trigger', 'MainFts_update_trigger', ")
+					_T("'MainFts_delete_trigger', 'MainFts_data_insert_trigger', 'MainFts_data_delete_trigger')")) == 5;
+		}
+		CATCH_SQLITE_EXCEPTION
+
+		if (available == false)
+		{
+			Log(_T("Full text search index is on but MainFts isn't complete, searches will use LIKE"));
+		}
+	}
+
+	InterlockedExchange(&s_fullTextSearchIndexAvailable, available ? TRUE : FALSE);
+}
+
+bool FullTextSearchIndexAvailable()
+{
+	return s_fullTextSearchIndexAvailable != FALSE;
+}
+
+BOOL DropFullTextSearchIndex(CppSQLite3DB &db)
+{
+	try
+	{
+		db.execDML(_T("DROP TRIGGER IF EXISTS MainFts_insert_trigger"));
+		db.execDML(_T("DROP TRIGGER IF EXISTS MainFts_update_trigger"));
+		db.execDML(_T("DROP TRIGGER IF EXISTS MainFts_delete_trigger"));
+		db.execDML(_T("DROP TRIGGER IF EXISTS MainFts_data_insert_trigger"));
+		db.execDML(_T("DROP TRIGGER IF EXISTS MainFts_data_delete_trigger"));
+		db.execDML(_T("DROP TABLE IF EXISTS MainFts"));
+	}
+	CATCH_SQLITE_EXCEPTION_AND_RETURN(FALSE)
+
+	return TRUE;
+}
+
 BOOL BackupDB(CString dbPath, CString backupPath)
 {
 	CRect r = DefaultMonitorRect();
@@ -722,7 +1394,9 @@ BOOL CreateDB(CString csFile)
 							_T("lID INTEGER PRIMARY KEY AUTOINCREMENT, ")
 							_T("lParentID INTEGER, ")
 							_T("strClipBoardFormat TEXT, ")
-							_T("ooData BLOB);"));
+							_T("ooData BLOB, ")
+							_T("blobID INTEGER, ")
+							_T("lOriginalSize INTEGER);"));
 
 		db.execDML(_T("CREATE TABLE Types(")
 							_T("lID INTEGER PRIMARY KEY AUTOINCREMENT, ")
@@ -764,6 +1438,20 @@ BOOL CreateDB(CString csFile)
 		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_ShortCut2 on Main(lShortCut DESC, globalShortCut DESC)"));
 		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_MoveToGroup on Main(MoveToGroupShortCut DESC, GlobalMoveToGroupShortCut DESC)"));
 		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_CRC on Main(CRC ASC)"));
+		db.execDML(_T("CREATE INDEX IF NOT EXISTS Main_DateCRC on Main(lDate ASC, CRC ASC, bIsGroup ASC)"));
+
+		CreateDataSearchTextTable(db);
+		CreateDataBlobsTable(db);
+		CreateThumbnailsTable(db);
+		CreateMainCountsTable(db);
+
+		if (CGetSetOptions::GetUseFullTextSearchIndex())
+		{
+			if (CreateFullTextSearchIndex(db) == FALSE)
+			{
+				Log(_T("Failed to create the full text search index, searches will use LIKE"));
+			}
+		}
 
 		db.close();
 	}
@@ -19,6 +19,7 @@ BOOL CreateBackup(CString csPath);
 CString GetDBName();
 CString GetDefaultDBName();
 BOOL OpenDatabase(CString csDB);
+BOOL SetDbJournalMode(CppSQLite3DB &db);
 BOOL IsDatabaseOpen();
 
 BOOL CheckDBExists(CString csDBPath);
@@ -37,6 +38,19 @@ BOOL RestoreDB(CString backupPath);
 
 void ReOrderStickyClips(int parentID, CppSQLite3DB &db);
 
+BOOL CreateDataSearchTextTable(CppSQLite3DB &db);
+BOOL MigrateDataSearchText(CppSQLite3DB &db, LONG run = 0);
+void StartDataSearchTextMigration(CString dbPath);
+bool DataSearchTextMigrated();
+BOOL CreateDataBlobsTable(CppSQLite3DB &db);
+BOOL MigrateDataBlobs(CppSQLite3DB &db);
+BOOL CreateThumbnailsTable(CppSQLite3DB &db);
+BOOL CreateMainCountsTable(CppSQLite3DB &db);
+BOOL CreateFullTextSearchIndex(CppSQLite3DB &db);
+void CheckFullTextSearchIndex(CppSQLite3DB &db);
+bool FullTextSearchIndexAvailable();
+BOOL DropFullTextSearchIndex(CppSQLite3DB &db);
+
 //BOOL CopyDownDatabase();
 //BOOL CopyUpDatabase();
 
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "DbConnectionPool.h"
+#include "Misc.h"
+#include "cp_main.h"
+#include <algorithm>
+
+CDbConnectionPool::CDbConnectionPool()
+{
+	m_availableSemaphore = NULL;
+	m_busyTimeout = 5000;
+}
+
+CDbConnectionPool::~CDbConnectionPool()
+{
+	Close();
+}
+
+BOOL CDbConnectionPool::Open(CString dbPath, int connectionCount, int busyTimeout)
+{
+	Close();
+
+	ATL::CCritSecLock csLock(m_critSection.m_sect);
+
+	m_busyTimeout = busyTimeout;
+
+	try
+	{
+		for (int i = 0; i < connectionCount; i++)
+		{
+			CppSQLite3DB *db = new CppSQLite3DB();
+			m_connections.push_back(db);
+
+			db->open(dbPath, true);
+			db->setBusyTimeout(busyTimeout);
+			db->SetRegexCaseInsensitive(CGetSetOptions::GetRegexCaseInsensitive());
+			db->setStatementCacheSize(CGetSetOptions::GetDbStatementCacheSize());
+
+			m_freeConnections.push_back(db);
+		}
+	}
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("Failed to open read connection pool, SQLITE Exception %d - %s"), e.errorCode(), e.errorMessage()));
+
+		for (std::vector<CppSQLite3DB*>::iterator it = m_connections.begin(); it != m_connections.end(); it++)
+		{
+			delete *it;
+		}
+		m_connections.clear();
+		m_freeConnections.clear();
+
+		return FALSE;
+	}
+
+	m_availableSemaphore = CreateSemaphore(NULL, (LONG)m_freeConnections.size(), (LONG)m_freeConnections.size(), NULL);
+
+	Log(StrF(_T("Opened read connection pool, connections: %d"), m_connections.size()));
+
+	return TRUE;
+}
+
+void CDbConnectionPool::Close()
+{
+	if (m_availableSemaphore == NULL)
+	{
+		return;
+	}
+
+	//wait for connections that are in use to be returned before closing them, CDbReadConnection always releases them.
+	//A long query, like counting a search, is interrupted if it isn't back within the busy timeout
+	size_t count = m_connections.size();
+	size_t returned = WaitForReturned(count, 0, m_busyTimeout);
+
+	if (returned < count)
+	{
+		ATL::CCritSecLock csLock(m_critSection.m_sect);
+
+		Log(StrF(_T("Read connections still in use when closing the pool, interrupting %d"), count - returned));
+
+		for (std::vector<CppSQLite3DB*>::iterator it = m_connections.begin(); it != m_connections.end(); it++)
+		{
+			if (std::find(m_freeConnections.begin(), m_freeConnections.end(), *it) == m_freeConnections.end())
+			{
+				(*it)->interrupt();
+			}
+		}
+	}
+
+	returned = WaitForReturned(count, returned, m_busyTimeout);
+
+	ATL::CCritSecLock csLock(m_critSection.m_sect);
+
+	//anything still out is left open, Release closes it when it comes back
+	for (std::vector<CppSQLite3DB*>::iterator it = m_connections.begin(); it != m_connections.end(); it++)
+	{
+		if (std::find(m_freeConnections.begin(), m_freeConnections.end(), *it) != m_freeConnections.end())
+		{
+			delete *it;
+		}
+	}
+
+	if (returned < count)
+	{
+		Log(StrF(_T("Read connections not returned when closing the pool, leaving %d open until they are"), count - returned));
+	}
+
+	m_connections.clear();
+	m_freeConnections.clear();
+
+	CloseHandle(m_availableSemaphore);
+	m_availableSemaphore = NULL;
+}
+
+//returns how many of count connections are back, waiting at most timeoutMs for the rest
+size_t CDbConnectionPool::WaitForReturned(size_t count, size_t returned, int timeoutMs)
+{
+	DWORD startTick = GetTickCount();
+
+	while (returned < count)
+	{
+		DWORD elapsed = GetTickCount() - startTick;
+		if (elapsed >= (DWORD)timeoutMs ||
+			WaitForSingleObject(m_availableSemaphore, (DWORD)timeoutMs - elapsed) != WAIT_OBJECT_0)
+		{
+			break;
+		}
+
+		returned++;
+	}
+
+	return returned;
+}
+
+CppSQLite3DB *CDbConnectionPool::Acquire()
+{
+	HANDLE semaphore = NULL;
+	{
+		ATL::CCritSecLock csLock(m_critSection.m_sect);
+		semaphore = m_availableSemaphore;
+	}
+
+	if (semaphore != NULL &&
+		WaitForSingleObject(semaphore, m_busyTimeout) == WAIT_OBJECT_0)
+	{
+		ATL::CCritSecLock csLock(m_critSection.m_sect);
+
+		if (m_freeConnections.size() > 0)
+		{
+			CppSQLite3DB *db = m_freeConnections.back();
+			m_freeConnections.pop_back();
+			return db;
+		}
+	}
+
+	return &theApp.m_db;
+}
+
+void CDbConnectionPool::Release(CppSQLite3DB *db)
+{
+	if (db == &theApp.m_db)
+	{
+		return;
+	}
+
+	ATL::CCritSecLock csLock(m_critSection.m_sect);
+
+	//the pool was closed while this was out
+	if (std::find(m_connections.begin(), m_connections.end(), db) == m_connections.end())
+	{
+		delete db;
+		return;
+	}
+
+	m_freeConnections.push_back(db);
+
+	if (m_availableSemaphore != NULL)
+	{
+		ReleaseSemaphore(m_availableSemaphore, 1, NULL);
+	}
+}
+
+CDbReadConnection::CDbReadConnection()
+{
+	m_db = theApp.m_dbReadPool.Acquire();
+}
+
+CDbReadConnection::~CDbReadConnection()
+{
+	theApp.m_dbReadPool.Release(m_db);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "sqlite/CppSQLite3.h"
+#include <vector>
+
+//Small pool of read only connections, used when the db is in WAL mode so list loading and searches
+//don't wait on clips being written through theApp.m_db (the single writer connection)
+class CDbConnectionPool
+{
+public:
+	CDbConnectionPool();
+	~CDbConnectionPool();
+
+	BOOL Open(CString dbPath, int connectionCount, int busyTimeout);
+	void Close();
+	BOOL IsOpen() { return m_connections.size() > 0; }
+
+	//returns theApp.m_db if the pool isn't open or all connections are busy for longer than the busy timeout
+	CppSQLite3DB *Acquire();
+	void Release(CppSQLite3DB *db);
+
+protected:
+	size_t WaitForReturned(size_t count, size_t returned, int timeoutMs);
+
+	CCriticalSection m_critSection;
+	HANDLE m_availableSemaphore;
+	std::vector<CppSQLite3DB*> m_connections;
+	std::vector<CppSQLite3DB*> m_freeConnections;
+	int m_busyTimeout;
+};
+
+//Acquires a pooled read connection for the lifetime of the object
+class CDbReadConnection
+{
+public:
+	CDbReadConnection();
+	~CDbReadConnection();
+
+	CppSQLite3DB &Db() { return *m_db; }
+
+protected:
+	CppSQLite3DB *m_db;
+};
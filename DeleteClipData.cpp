@@ -156,10 +156,12 @@ void CDeleteClipData::LoadItems()
 		}
 	}
 
-	CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT Main.lID, Main.mText, Main.lDate, Main.lastPasteDate, Main.QuickPasteText, Data.lID AS DataID, Data.strClipBoardFormat, length(Data.ooData) AS DataLength ")
-													_T("FROM Data ")
-													_T("INNER JOIN Main on Main.lID = Data.lParentID ")
-													_T("ORDER BY length(ooData) DESC"));
+	CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT Main.lID, Main.mText, Main.lDate, Main.lastPasteDate, Main.QuickPasteText, DataContent.lID AS DataID, DataContent.strClipBoardFormat, ")
+													//compressed formats are shown at the size of the clip, not what's stored
+													_T("IFNULL(DataContent.lOriginalSize, length(DataContent.ooData)) AS DataLength ")
+													_T("FROM DataContent ")
+													_T("INNER JOIN Main on Main.lID = DataContent.lParentID ")
+													_T("ORDER BY DataLength DESC"));
 
 	int row = 0;
 	while (q.eof() == false)
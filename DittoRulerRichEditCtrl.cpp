@@ -161,27 +161,31 @@ int CDittoRulerRichEditCtrl::SaveToDB(BOOL bUpdateDesc)
 			return FALSE;
 		}
 
+		//asked before the transaction is opened, it holds m_db's write lock and the other threads would wait on the dialog
+		bool bAddClip = false;
+		if(m_lID < 0)
+		{
+			bSetModifyToFalse = false;
+			Clip.MakeLatestOrder();
+			CCopyProperties Prop(-1, this, &Clip);
+			Prop.SetHandleKillFocus(true);
+			Prop.SetToTopMost(false);
+			bAddClip = (Prop.DoModal() == IDOK);
+		}
+
 		theApp.m_db.execDML(_T("begin transaction;"));
 
 		if(m_lID >= 0)
 		{
 			Clip.SaveFromEditWnd(bUpdateDesc);
 		}
-		else
+		else if(bAddClip)
 		{
-			bSetModifyToFalse = false;
-			Clip.MakeLatestOrder();
-			CCopyProperties Prop(-1, this, &Clip);
-			Prop.SetHandleKillFocus(true);
-			Prop.SetToTopMost(false);
-			if(Prop.DoModal() == IDOK)
-			{
-				Clip.AddToDB();
-				m_csDescription = Clip.m_Desc;
-				m_lID = Clip.m_id;
-				bUpdateDesc = TRUE;
-				bSetModifyToFalse = true;
-			}
+			Clip.AddToDB();
+			m_csDescription = Clip.m_Desc;
+			m_lID = Clip.m_id;
+			bUpdateDesc = TRUE;
+			bSetModifyToFalse = true;
 		}
 
 		nRet = SAVED_CLIP_TO_DB;
@@ -191,7 +195,12 @@ int CDittoRulerRichEditCtrl::SaveToDB(BOOL bUpdateDesc)
 		if(bUpdateDesc)
 			theApp.RefreshView();
 	}
-	CATCH_SQLITE_EXCEPTION
+	catch (CppSQLite3Exception& e)
+	{
+		Log(StrF(_T("SQLITE Exception %d - %s"), e.errorCode(), e.errorMessage()));
+		ASSERT(FALSE);
+		theApp.m_db.rollbackOpenTransaction();
+	}
 
 	if(bSetModifyToFalse)
 		m_rtf.SetModify(FALSE);
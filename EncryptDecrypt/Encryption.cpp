@@ -9,6 +9,74 @@
 #include "rijndael.h"
 #include "sha2.h"
 
+#include <afxmt.h>
+
+#define TD_TRANSFORMED_KEY_CACHE_SIZE	16
+
+namespace
+{
+	// Keys made by _TransformMasterKey, shared by every CEncryption so a connection only pays
+	// for the 100000 rounds on its first message, oldest entry is replaced when full
+	struct TransformedKey
+	{
+		BYTE aMasterKey[32];
+		BYTE aKeySeed[32];
+		DWORD dwKeyEncRounds;
+		BYTE aTransformedMasterKey[32];
+	};
+
+	CCriticalSection s_transformedKeysLock;
+	TransformedKey s_transformedKeys[TD_TRANSFORMED_KEY_CACHE_SIZE];
+	int s_transformedKeyCount = 0;
+	int s_nextTransformedKey = 0;
+
+	// Key ids made by _GetKeyId, one per password so only the first message sent with a password stretches it for the id
+	struct KeyId
+	{
+		BYTE aMasterKey[32];
+		BYTE aKeyId[TD_KEYID_SIZE];
+	};
+
+	KeyId s_keyIds[TD_TRANSFORMED_KEY_CACHE_SIZE];
+	int s_keyIdCount = 0;
+	int s_nextKeyId = 0;
+
+	// The key id is made by stretching the password over the hash of this and then a HMAC of this with the stretched key,
+	// the same for every message so the receiver can work out the id of each of its passwords once
+	const char s_keyIdText[] = "Ditto network password key id";
+
+	void HmacSha256(const BYTE *pKey, int nKeyLen, const BYTE *pData, unsigned long uDataLen, BYTE *pMac)
+	{
+		BYTE aInnerPad[64];
+		BYTE aOuterPad[64];
+		BYTE aInner[32];
+		sha256_ctx sha32;
+
+		ASSERT(nKeyLen <= 64);
+
+		memset(aInnerPad, 0x36, 64);
+		memset(aOuterPad, 0x5c, 64);
+		for(int i = 0; i < nKeyLen; i++)
+		{
+			aInnerPad[i] ^= pKey[i];
+			aOuterPad[i] ^= pKey[i];
+		}
+
+		sha256_begin(&sha32);
+		sha256_hash(aInnerPad, 64, &sha32);
+		sha256_hash((unsigned char *)pData, uDataLen, &sha32);
+		sha256_end(aInner, &sha32);
+
+		sha256_begin(&sha32);
+		sha256_hash(aOuterPad, 64, &sha32);
+		sha256_hash(aInner, 32, &sha32);
+		sha256_end(pMac, &sha32);
+
+		mem_erase(aInnerPad, 64);
+		mem_erase(aOuterPad, 64);
+	}
+}
+
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
@@ -20,12 +88,15 @@ CEncryption::CEncryption()
 
 	memset(m_pMasterKey, 0, 32);
 
+	m_bSessionSeed2Set = false;
+
 	m_random.Initialize();
 }
 
 CEncryption::~CEncryption()
 {
 	mem_erase(m_pMasterKey, 32);
+	mem_erase(m_aSessionSeed2, 32);
 
 	m_random.Reset();
 }
@@ -65,7 +136,15 @@ bool CEncryption::Encrypt(const unsigned char* pInput, int nLenInput, const char
 		// Make up the master key hash seed and the encryption IV
 		m_random.GetRandomBuffer(hdr.aMasterSeed, 16);
 		m_random.GetRandomBuffer((BYTE *)hdr.aEncryptionIV, 16);
-		m_random.GetRandomBuffer(hdr.aMasterSeed2, 32);
+
+		// The salt is made once for this connection
+		if(m_bSessionSeed2Set == false)
+		{
+			DWORD dwKeyIdSignature = TD_KEYIDSIG;
+			memcpy(m_aSessionSeed2, &dwKeyIdSignature, sizeof(DWORD));
+			m_random.GetRandomBuffer(m_aSessionSeed2 + sizeof(DWORD) + TD_KEYID_SIZE, TD_KEYSALT_SIZE);
+			m_bSessionSeed2Set = true;
+		}
 
 		// Create MasterKey by hashing szPassword
 		uKeyLen = (unsigned long)strlen(szPassword);
@@ -78,9 +157,16 @@ bool CEncryption::Encrypt(const unsigned char* pInput, int nLenInput, const char
 			sha256_hash((unsigned char *)szPassword, uKeyLen, &sha32);
 			sha256_end(m_pMasterKey, &sha32);
 
+			// The key id doesn't depend on the salt, the key the message is encrypted with is stretched over the salt
+			BYTE aKeySeed[32];
+			BOOL bKeyId = _GetKeyId(m_aSessionSeed2 + sizeof(DWORD));
+			_GetKeySeed(m_aSessionSeed2, aKeySeed);
+
 			// Generate m_pTransformedMasterKey from m_pMasterKey
-			if(TRUE == _TransformMasterKey(hdr.aMasterSeed2))
+			if(TRUE == bKeyId && TRUE == _GetTransformedMasterKey(aKeySeed))
 			{
+				memcpy(hdr.aMasterSeed2, m_aSessionSeed2, 32);
+
 				// Hash the master password with the generated hash salt
 				sha256_begin(&sha32);
 				sha256_hash(hdr.aMasterSeed, 16, &sha32);
@@ -164,8 +250,9 @@ bool CEncryption::Decrypt(const unsigned char* pInput, int nLenInput, const char
 	// to verify integrity of header
 	if(0 == memcmp(hdr.aHeaderHash, uFinalKey, 32))
 	{
-		// Check if we can open this
-		if((hdr.dwSignature1 == TD_TLSIG_1) && (hdr.dwSignature2 == TD_TLSIG_2))
+		// Check if we can open this, every version sends the standard rounds so anything else isn't stretched
+		if((hdr.dwSignature1 == TD_TLSIG_1) && (hdr.dwSignature2 == TD_TLSIG_2) &&
+			(hdr.dwKeyEncRounds == TD_STD_KEYENCROUNDS))
 		{
 			// Allocate enough memory
 			pOutput = new unsigned char[nLenInput];
@@ -184,8 +271,11 @@ bool CEncryption::Decrypt(const unsigned char* pInput, int nLenInput, const char
 
 					m_dwKeyEncRounds = hdr.dwKeyEncRounds;
 
+					BYTE aKeySeed[32];
+					_GetKeySeed(hdr.aMasterSeed2, aKeySeed);
+
 					// Generate m_pTransformedMasterKey from m_pMasterKey
-					if(TRUE == _TransformMasterKey(hdr.aMasterSeed2))
+					if(TRUE == _GetTransformedMasterKey(aKeySeed))
 					{
 						// Hash the master password with the generated hash salt
 						sha256_begin(&sha32);
@@ -240,6 +330,136 @@ void CEncryption::FreeBuffer(unsigned char*& pBuffer)
 	SAFE_DELETE_ARRAY(pBuffer);
 }
 
+bool CEncryption::GetKeyId(const char* szPassword, unsigned char* pKeyId)
+{
+	ASSERT(NULL != szPassword); if(NULL == szPassword) return false;
+	ASSERT(NULL != pKeyId);		if(NULL == pKeyId)		return false;
+
+	unsigned long uKeyLen = (unsigned long)strlen(szPassword);
+	ASSERT(0 != uKeyLen); if(0 == uKeyLen) return false;
+
+	sha256_ctx sha32;
+	sha256_begin(&sha32);
+	sha256_hash((unsigned char *)szPassword, uKeyLen, &sha32);
+	sha256_end(m_pMasterKey, &sha32);
+
+	return (_GetKeyId(pKeyId) == TRUE);
+}
+
+bool CEncryption::GetHeaderKeyId(const unsigned char* pInput, int nLenInput, unsigned char* pKeyId, bool& bHasKeyId)
+{
+	TD_TLHEADER		hdr;
+	BYTE			aHeaderHash[32];
+	sha256_ctx		sha32;
+
+	bHasKeyId = false;
+
+	ASSERT(NULL != pInput);						if(NULL == pInput)					return false;
+	ASSERT(NULL != pKeyId);						if(NULL == pKeyId)					return false;
+	if(sizeof(TD_TLHEADER) > (unsigned int)nLenInput) return false;
+
+	memcpy(&hdr, pInput, sizeof(TD_TLHEADER));
+
+	sha256_begin(&sha32);
+	sha256_hash((unsigned char *)&hdr + 32, sizeof(TD_TLHEADER) - 32, &sha32);
+	sha256_end(aHeaderHash, &sha32);
+
+	if(memcmp(hdr.aHeaderHash, aHeaderHash, 32) != 0 ||
+		hdr.dwSignature1 != TD_TLSIG_1 ||
+		hdr.dwSignature2 != TD_TLSIG_2)
+	{
+		return false;
+	}
+
+	// Nothing in the header is authenticated until the body is decrypted, the rounds decide how long stretching a key takes
+	if(hdr.dwKeyEncRounds != TD_STD_KEYENCROUNDS)
+	{
+		return false;
+	}
+
+	DWORD dwKeyIdSignature;
+	memcpy(&dwKeyIdSignature, hdr.aMasterSeed2, sizeof(DWORD));
+	if(dwKeyIdSignature == TD_KEYIDSIG)
+	{
+		memcpy(pKeyId, hdr.aMasterSeed2 + sizeof(DWORD), TD_KEYID_SIZE);
+		bHasKeyId = true;
+	}
+
+	return true;
+}
+
+BOOL CEncryption::_GetKeyId(BYTE *pKeyId)
+{
+	{
+		CSingleLock lock(&s_transformedKeysLock, TRUE);
+
+		for(int i = 0; i < s_keyIdCount; i++)
+		{
+			if(memcmp(s_keyIds[i].aMasterKey, m_pMasterKey, 32) == 0)
+			{
+				memcpy(pKeyId, s_keyIds[i].aKeyId, TD_KEYID_SIZE);
+				return TRUE;
+			}
+		}
+	}
+
+	BYTE aKeySeed[32];
+	sha256_ctx sha32;
+	sha256_begin(&sha32);
+	sha256_hash((unsigned char *)s_keyIdText, (unsigned long)strlen(s_keyIdText), &sha32);
+	sha256_end(aKeySeed, &sha32);
+
+	// Always the standard rounds, the id has to be the same whatever the header says
+	DWORD dwKeyEncRounds = m_dwKeyEncRounds;
+	m_dwKeyEncRounds = TD_STD_KEYENCROUNDS;
+	BOOL bTransformed = _TransformMasterKey(aKeySeed);
+	m_dwKeyEncRounds = dwKeyEncRounds;
+
+	if(bTransformed == FALSE)
+	{
+		return FALSE;
+	}
+
+	BYTE aMac[32];
+	HmacSha256(m_pTransformedMasterKey, 32, (const BYTE *)s_keyIdText, (unsigned long)strlen(s_keyIdText), aMac);
+	mem_erase(m_pTransformedMasterKey, 32);
+
+	memcpy(pKeyId, aMac, TD_KEYID_SIZE);
+
+	CSingleLock lock(&s_transformedKeysLock, TRUE);
+
+	KeyId &keyId = s_keyIds[s_nextKeyId];
+	memcpy(keyId.aMasterKey, m_pMasterKey, 32);
+	memcpy(keyId.aKeyId, pKeyId, TD_KEYID_SIZE);
+
+	s_nextKeyId = (s_nextKeyId + 1) % TD_TRANSFORMED_KEY_CACHE_SIZE;
+	if(s_keyIdCount < TD_TRANSFORMED_KEY_CACHE_SIZE)
+	{
+		s_keyIdCount++;
+	}
+
+	return TRUE;
+}
+
+void CEncryption::_GetKeySeed(const BYTE *pMasterSeed2, BYTE *pKeySeed)
+{
+	DWORD dwKeyIdSignature;
+	memcpy(&dwKeyIdSignature, pMasterSeed2, sizeof(DWORD));
+
+	if(dwKeyIdSignature != TD_KEYIDSIG)
+	{
+		memcpy(pKeySeed, pMasterSeed2, 32);
+		return;
+	}
+
+	// The key id can't be part of the seed, it's made from the key
+	sha256_ctx sha32;
+	sha256_begin(&sha32);
+	sha256_hash((unsigned char *)pMasterSeed2, sizeof(DWORD), &sha32);
+	sha256_hash((unsigned char *)pMasterSeed2 + sizeof(DWORD) + TD_KEYID_SIZE, TD_KEYSALT_SIZE, &sha32);
+	sha256_end(pKeySeed, &sha32);
+}
+
 
 
 /*
@@ -314,4 +534,44 @@ BOOL CEncryption::_TransformMasterKey(BYTE *pKeySeed)
 	return TRUE;
 }
 
+BOOL CEncryption::_GetTransformedMasterKey(BYTE *pKeySeed)
+{
+	ASSERT(pKeySeed != NULL); if(pKeySeed == NULL) return FALSE;
+
+	{
+		CSingleLock lock(&s_transformedKeysLock, TRUE);
+
+		for(int i = 0; i < s_transformedKeyCount; i++)
+		{
+			TransformedKey &key = s_transformedKeys[i];
+			if(key.dwKeyEncRounds == m_dwKeyEncRounds &&
+				memcmp(key.aKeySeed, pKeySeed, 32) == 0 &&
+				memcmp(key.aMasterKey, m_pMasterKey, 32) == 0)
+			{
+				memcpy(m_pTransformedMasterKey, key.aTransformedMasterKey, 32);
+				return TRUE;
+			}
+		}
+	}
+
+	if(_TransformMasterKey(pKeySeed) == FALSE)
+	{
+		return FALSE;
+	}
+
+	CSingleLock lock(&s_transformedKeysLock, TRUE);
+
+	TransformedKey &key = s_transformedKeys[s_nextTransformedKey];
+	memcpy(key.aMasterKey, m_pMasterKey, 32);
+	memcpy(key.aKeySeed, pKeySeed, 32);
+	key.dwKeyEncRounds = m_dwKeyEncRounds;
+	memcpy(key.aTransformedMasterKey, m_pTransformedMasterKey, 32);
 
+	s_nextTransformedKey = (s_nextTransformedKey + 1) % TD_TRANSFORMED_KEY_CACHE_SIZE;
+	if(s_transformedKeyCount < TD_TRANSFORMED_KEY_CACHE_SIZE)
+	{
+		s_transformedKeyCount++;
+	}
+
+	return TRUE;
+}
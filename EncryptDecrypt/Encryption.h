@@ -20,6 +20,12 @@
 
 #define TD_STD_KEYENCROUNDS		100000
 
+// Marks an aMasterSeed2 that starts with a key id, followed by TD_KEYID_SIZE bytes of key id and then TD_KEYSALT_SIZE
+// random bytes of salt. The key is stretched over the salt, not the whole seed, so the key id isn't part of what it's stretched with
+#define TD_KEYIDSIG				0x6A1F03C6
+#define TD_KEYID_SIZE			8
+#define TD_KEYSALT_SIZE			(32 - sizeof(DWORD) - TD_KEYID_SIZE)
+
 #pragma pack(1)
 
 typedef struct _TD_TLHEADER // The database header
@@ -54,14 +60,37 @@ public:
 						 unsigned char*& pOutput, int& nLenOutput);
 	void FreeBuffer(unsigned char*& pBuffer);
 
+	// Short id of a password, sent at the start of aMasterSeed2 so the receiver knows which password to decrypt with.
+	// It's a HMAC made with the password stretched over a fixed seed, so it's the same for every message and the
+	// receiver can work out the id of each of its passwords once, checking a guess still costs the full stretching
+	bool GetKeyId(const char* szPassword, unsigned char* pKeyId);
+
+	// Checks the header of an encrypted message and reads its key id, bHasKeyId is false for messages
+	// from versions that didn't send one, those have to be tried with each password
+	static bool GetHeaderKeyId(const unsigned char* pInput, int nLenInput, unsigned char* pKeyId, bool& bHasKeyId);
+
 private:
 	// Encrypt the master key a few times to make brute-force key-search harder
 	BOOL _TransformMasterKey(BYTE *pKeySeed);
 
+	// Same as _TransformMasterKey but returns the key from the cache if this password, seed and rounds were already transformed
+	BOOL _GetTransformedMasterKey(BYTE *pKeySeed);
+
+	// Key id of m_pMasterKey, from the cache if it was already made
+	BOOL _GetKeyId(BYTE *pKeyId);
+
+	// The seed the key of a message is stretched with, a hash of the salt when aMasterSeed2 has a key id, otherwise aMasterSeed2 itself
+	static void _GetKeySeed(const BYTE *pMasterSeed2, BYTE *pKeySeed);
+
 	BYTE	m_pMasterKey[32]; // Master key used to encrypt the whole database
 	BYTE	m_pTransformedMasterKey[32]; // Master key encrypted several times
 	DWORD	m_dwKeyEncRounds;
 
+	// aMasterSeed2 used for everything this object encrypts, each socket has its own CEncryption so the salt is
+	// random for each connection and the key is stretched once for it, on both sides. aMasterSeed and the IV are still new for each message
+	BYTE	m_aSessionSeed2[32];
+	bool	m_bSessionSeed2Set;
+
 	CNewRandom	m_random; // Pseudo-random number generator
 
 };
@@ -0,0 +1,227 @@
+#include "FastHash.h"
+#include <string.h>
+
+namespace
+{
+	const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+	const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+	const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+	inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	//little endian, same as every platform this builds for
+	inline uint64_t Read64(const unsigned char *pData)
+	{
+		uint64_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t Read32(const unsigned char *pData)
+	{
+		uint32_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t Round(uint64_t acc, uint64_t input)
+	{
+		acc += input * PRIME2;
+		acc = RotateLeft(acc, 31);
+		return acc * PRIME1;
+	}
+
+	inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+	{
+		acc ^= Round(0, value);
+		return acc * PRIME1 + PRIME4;
+	}
+}
+
+CFastHash::CFastHash(uint64_t seed)
+{
+	Reset(seed);
+}
+
+void CFastHash::Reset(uint64_t seed)
+{
+	m_seed = seed;
+	m_v1 = seed + PRIME1 + PRIME2;
+	m_v2 = seed + PRIME2;
+	m_v3 = seed;
+	m_v4 = seed - PRIME1;
+	m_totalLength = 0;
+	m_bufferUsed = 0;
+}
+
+void CFastHash::Update(const void *pData, size_t length)
+{
+	const unsigned char *p = (const unsigned char *)pData;
+	const unsigned char *pEnd = p + length;
+
+	m_totalLength += length;
+
+	if (m_bufferUsed + length < sizeof(m_buffer))
+	{
+		memcpy(m_buffer + m_bufferUsed, p, length);
+		m_bufferUsed += length;
+		return;
+	}
+
+	if (m_bufferUsed > 0)
+	{
+		size_t fill = sizeof(m_buffer) - m_bufferUsed;
+		memcpy(m_buffer + m_bufferUsed, p, fill);
+		p += fill;
+
+		m_v1 = Round(m_v1, Read64(m_buffer));
+		m_v2 = Round(m_v2, Read64(m_buffer + 8));
+		m_v3 = Round(m_v3, Read64(m_buffer + 16));
+		m_v4 = Round(m_v4, Read64(m_buffer + 24));
+		m_bufferUsed = 0;
+	}
+
+	//the four lanes don't depend on each other so the cpu can run them side by side
+	uint64_t v1 = m_v1;
+	uint64_t v2 = m_v2;
+	uint64_t v3 = m_v3;
+	uint64_t v4 = m_v4;
+
+	while (pEnd - p >= 32)
+	{
+		v1 = Round(v1, Read64(p));
+		v2 = Round(v2, Read64(p + 8));
+		v3 = Round(v3, Read64(p + 16));
+		v4 = Round(v4, Read64(p + 24));
+		p += 32;
+	}
+
+	m_v1 = v1;
+	m_v2 = v2;
+	m_v3 = v3;
+	m_v4 = v4;
+
+	if (p < pEnd)
+	{
+		m_bufferUsed = pEnd - p;
+		memcpy(m_buffer, p, m_bufferUsed);
+	}
+}
+
+uint64_t CFastHash::Digest() const
+{
+	uint64_t hash;
+
+	if (m_totalLength >= 32)
+	{
+		hash = RotateLeft(m_v1, 1) + RotateLeft(m_v2, 7) + RotateLeft(m_v3, 12) + RotateLeft(m_v4, 18);
+		hash = MergeRound(hash, m_v1);
+		hash = MergeRound(hash, m_v2);
+		hash = MergeRound(hash, m_v3);
+		hash = MergeRound(hash, m_v4);
+	}
+	else
+	{
+		hash = m_seed + PRIME5;
+	}
+
+	hash += m_totalLength;
+
+	const unsigned char *p = m_buffer;
+	const unsigned char *pEnd = m_buffer + m_bufferUsed;
+
+	while (pEnd - p >= 8)
+	{
+		hash ^= Round(0, Read64(p));
+		hash = RotateLeft(hash, 27) * PRIME1 + PRIME4;
+		p += 8;
+	}
+
+	if (pEnd - p >= 4)
+	{
+		hash ^= (uint64_t)Read32(p) * PRIME1;
+		hash = RotateLeft(hash, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+
+	while (p < pEnd)
+	{
+		hash ^= (*p) * PRIME5;
+		hash = RotateLeft(hash, 11) * PRIME1;
+		p++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+uint64_t CFastHash::Hash(const void *pData, size_t length, uint64_t seed)
+{
+	CFastHash hash(seed);
+	hash.Update(pData, length);
+	return hash.Digest();
+}
+
+CChunkedHash::CChunkedHash(size_t chunkSize)
+{
+	m_chunkSize = chunkSize;
+	m_chunkUsed = 0;
+	m_length = 0;
+}
+
+void CChunkedHash::Update(const void *pData, size_t length)
+{
+	const unsigned char *p = (const unsigned char *)pData;
+
+	m_length += length;
+
+	while (length > 0)
+	{
+		size_t take = m_chunkSize - m_chunkUsed;
+		if (take > length)
+		{
+			take = length;
+		}
+
+		m_chunk.Update(p, take);
+		m_chunkUsed += take;
+		p += take;
+		length -= take;
+
+		if (m_chunkUsed == m_chunkSize)
+		{
+			EndChunk();
+		}
+	}
+}
+
+void CChunkedHash::EndChunk()
+{
+	uint64_t chunkHash = m_chunk.Digest();
+	m_chunks.Update(&chunkHash, sizeof(chunkHash));
+
+	m_chunk.Reset();
+	m_chunkUsed = 0;
+}
+
+uint64_t CChunkedHash::Final()
+{
+	if (m_chunkUsed > 0)
+	{
+		EndChunk();
+	}
+
+	m_chunks.Update(&m_length, sizeof(m_length));
+
+	return m_chunks.Digest();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//64 bit xxHash (XXH64), fed a piece at a time. Kept free of windows and mfc so it can be built on its own
+class CFastHash
+{
+public:
+	CFastHash(uint64_t seed = 0);
+
+	void Reset(uint64_t seed = 0);
+	void Update(const void *pData, size_t length);
+	uint64_t Digest() const;
+
+	static uint64_t Hash(const void *pData, size_t length, uint64_t seed = 0);
+
+protected:
+	uint64_t m_v1;
+	uint64_t m_v2;
+	uint64_t m_v3;
+	uint64_t m_v4;
+	uint64_t m_seed;
+	uint64_t m_totalLength;
+	unsigned char m_buffer[32];
+	size_t m_bufferUsed;
+};
+
+//Hash of a file made from the hash of each chunkSize piece of it, then the length. Every chunk can be checked on its own
+//and the chunk hashes don't depend on each other, the data can be passed in any size pieces
+class CChunkedHash
+{
+public:
+	CChunkedHash(size_t chunkSize);
+
+	void Update(const void *pData, size_t length);
+	uint64_t Final();
+
+protected:
+	void EndChunk();
+
+	CFastHash m_chunk;
+	CFastHash m_chunks;
+	size_t m_chunkSize;
+	size_t m_chunkUsed;
+	uint64_t m_length;
+};
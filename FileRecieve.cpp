@@ -6,6 +6,9 @@
 #include "Path.h"
 #include "UnicodeMacros.h"
 #include "Md5.h"
+#include "TransferHash.h"
+#include "NetworkCompress.h"
+#include "Crc32Dynamic.h"
 
 
 #ifdef _DEBUG
@@ -17,13 +20,15 @@ static char THIS_FILE[]=__FILE__;
 CFileRecieve::CFileRecieve()
 {
 	m_pProgress = NULL;
+	m_bComplete = false;
+	m_nExpectedFiles = 0;
 }
 
 CFileRecieve::~CFileRecieve()
 {
 }
 
-long CFileRecieve::RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgressDlg *pProgress)
+long CFileRecieve::RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgressDlg *pProgress, DWORD requestedFeatures)
 {
 	CSendInfo Info;
 	BOOL bBreak = false;
@@ -36,6 +41,11 @@ long CFileRecieve::RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgress
 	m_csReceivingFromIP = csIP;
 	m_Sock.SetSocket(sock);
 	m_Sock.SetProgressBar(pProgress);
+	m_Send.SetSocket(sock);
+	m_RecievedFiles.RemoveAll();
+	m_RecievedRemoteFiles.RemoveAll();
+	m_bComplete = false;
+	m_nExpectedFiles = 0;
 
 	while(true)
 	{
@@ -46,6 +56,7 @@ long CFileRecieve::RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgress
 		{
 		case MyEnums::START:
 			nNumFiles = Info.m_lParameter1;
+			m_nExpectedFiles = nNumFiles;
 			if(m_pProgress != NULL)
 			{
 				m_pProgress->SetNumFiles(nNumFiles);
@@ -75,7 +86,12 @@ long CFileRecieve::RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgress
 
 			LogSendRecieveInfo(StrF(_T("START of receiving the file %s, size: %d, File %d of %d"), csFileName, lFileSize, nFilesRecieved, nNumFiles));
 
-			long lRecieveRet = RecieveFileData(lFileSize, csFileName, lastMd5);
+			//the server only uses what we asked for and what its version knows about
+			bool bCompressed = (requestedFeatures & NETWORK_FEATURE_COMPRESSION) && Info.m_nVersion >= NETWORK_COMPRESSED_VERSION;
+			bool bResume = (requestedFeatures & NETWORK_FEATURE_RESUME) && Info.m_nVersion >= NETWORK_RESUME_VERSION;
+			bool bFastHash = (requestedFeatures & NETWORK_FEATURE_FAST_HASH) && Info.m_nVersion >= NETWORK_FAST_HASH_VERSION;
+
+			long lRecieveRet = RecieveFileData(lFileSize, csFileName, lastMd5, bCompressed, bResume, bFastHash, (DWORD)Info.m_lParameter2);
 			if(lRecieveRet == USER_CANCELED)
 			{
 				lRet = USER_CANCELED;
@@ -147,9 +163,14 @@ long CFileRecieve::RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgress
 		break;
 
 		case MyEnums::END:
+			m_bComplete = true;
 			bBreak = true;
 			break;
 
+		case MyEnums::VERSION:
+			//reply to the version sent in our START
+			break;
+
 		default:
 			LogSendRecieveInfo("::ERROR unknown action type exiting");
 			bBreak = true;
@@ -162,7 +183,7 @@ long CFileRecieve::RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgress
 	return lRet;
 }
 
-long CFileRecieve::RecieveFileData(ULONG lFileSize, CString csFileName, CString &md5String)
+long CFileRecieve::RecieveFileData(ULONG lFileSize, CString csFileName, CString &md5String, bool bCompressed, bool bResume, bool bFastHash, DWORD fileTime)
 {
 	CString csFile = CGetSetOptions::GetPath(PATH_REMOTE_FILES);
 	CreateDirectory(csFile, NULL);
@@ -174,32 +195,75 @@ long CFileRecieve::RecieveFileData(ULONG lFileSize, CString csFileName, CString
 	nsPath::CPath path(csFileName);
 	csFile += path.GetName();
 
+	CTransferHash hash(bFastHash);
+
+	BOOL calcMd5 = CGetSetOptions::GetCheckMd5OnFileTransfers();
+
+	char *pBuffer = new char[CHUNK_WRITE_SIZE];
+	if(pBuffer == NULL)
+	{
+		LogSendRecieveInfo("Error creating buffer in RequestCopiedFiles");
+		return FALSE;
+	}
+
+	ULONG lBytesRead = 0;
+	CString csResumeFile = csFile + RESUME_FILE_EXTENSION;
+	CFile ResumeFile;
+
+	if(bResume)
+	{
+		lBytesRead = GetResumeOffset(csFile, lFileSize, fileTime, pBuffer, calcMd5 ? &hash : NULL);
+
+		//the crc file has to be kept for the part we resume from, if it can't be the file is started over
+		if(OpenResumeFile(ResumeFile, csResumeFile, lFileSize, fileTime, lBytesRead / CHUNK_WRITE_SIZE) == FALSE &&
+			lBytesRead > 0)
+		{
+			LogSendRecieveInfo(StrF(_T("Can't keep the crcs of %s, starting it over"), csFile));
+
+			lBytesRead = 0;
+			hash.Reset();
+		}
+
+		//tell the server where to start, 0 if there was nothing to resume
+		CSendInfo Info;
+		Info.m_lParameter1 = (long)lBytesRead;
+		if(m_Send.SendCSendData(Info, MyEnums::RESUME) == FALSE)
+		{
+			delete []pBuffer;
+			return FALSE;
+		}
+	}
+
 	CFile File;
 	CFileException ex;
-	if(File.Open(csFile, CFile::modeWrite|CFile::modeCreate|CFile::typeBinary, &ex) == FALSE)
+	UINT openFlags = CFile::modeWrite|CFile::modeCreate|CFile::typeBinary;
+	if(lBytesRead > 0)
+	{
+		openFlags |= CFile::modeNoTruncate;
+	}
+
+	if(File.Open(csFile, openFlags, &ex) == FALSE)
 	{
 		TCHAR szError[200];
 		ex.GetErrorMessage(szError, 200);
 		LogSendRecieveInfo(StrF(_T("Error opening file in RequestCopiedFiles, error: %s"), szError));
 
+		delete []pBuffer;
 		return FALSE;
 	}
+
+	if(lBytesRead > 0)
+	{
+		LogSendRecieveInfo(StrF(_T("Resuming %s at %u of %u"), csFile, lBytesRead, lFileSize));
+
+		File.SetLength(lBytesRead);
+		File.SeekToEnd();
+	}
 	
-	ULONG lBytesRead = 0;
 	long lBytesNeeded = 0;
 	int nPercent = 0;
 	int nPrevPercent = 0;
-	CMd5 md5;
-	md5.MD5Init();
-
-	char *pBuffer = new char[CHUNK_WRITE_SIZE];
-	if(pBuffer == NULL)
-	{
-		LogSendRecieveInfo("Error creating buffer in RequestCopiedFiles");
-		return FALSE;
-	}
-
-	BOOL calcMd5 = CGetSetOptions::GetCheckMd5OnFileTransfers();
+	std::vector<BYTE> compressed;
 
 	BOOL bRet = FALSE;
 	while(true)
@@ -208,7 +272,14 @@ long CFileRecieve::RecieveFileData(ULONG lFileSize, CString csFileName, CString
 		if(lFileSize - lBytesRead < CHUNK_WRITE_SIZE)
 			lBytesNeeded = lFileSize - lBytesRead;
 
-		if(m_Sock.RecieveExactSize(pBuffer, lBytesNeeded) == FALSE)
+		if(bCompressed && lBytesNeeded > 0)
+		{
+			if(RecieveCompressedBlock(pBuffer, lBytesNeeded, compressed) == FALSE)
+			{
+				break;
+			}
+		}
+		else if(m_Sock.RecieveExactSize(pBuffer, lBytesNeeded) == FALSE)
 		{
 			break;
 		}
@@ -217,19 +288,34 @@ long CFileRecieve::RecieveFileData(ULONG lFileSize, CString csFileName, CString
 
 		if (calcMd5)
 		{
-			md5.MD5Update((unsigned char*)pBuffer, lBytesNeeded);
+			hash.Update(pBuffer, lBytesNeeded);
+		}
+
+		//crc of each whole chunk written, a later request checks these before resuming
+		if(ResumeFile.m_hFile != CFile::hFileNull &&
+			lBytesNeeded == CHUNK_WRITE_SIZE)
+		{
+			File.Flush();
+
+			DWORD crc = ~CCrc32Dynamic::UpdateCrc32(0xFFFFFFFF, (BYTE*)pBuffer, lBytesNeeded);
+			ResumeFile.Write(&crc, sizeof(crc));
+			ResumeFile.Flush();
 		}
 
 		lBytesRead += lBytesNeeded;
 
 		if(lBytesRead >= lFileSize)
 		{
-			m_pProgress->SetSingleFilePos(100);
+			if(m_pProgress != NULL)
+			{
+				m_pProgress->SetSingleFilePos(100);
+			}
 			bRet = TRUE;
 			break;
 		}
 
-		if(lBytesNeeded > 0)
+		if(lBytesNeeded > 0 &&
+			m_pProgress != NULL)
 		{
 			nPercent = (int)((lBytesRead / (double)lFileSize) * 100);
 			if((nPercent - nPrevPercent) > 5)
@@ -249,11 +335,18 @@ long CFileRecieve::RecieveFileData(ULONG lFileSize, CString csFileName, CString
 
 	File.Close();
 
-	md5String = md5.MD5FinalToString();
+	//kept until the whole request is done so a retry only sends the end of the files that finished, see RemoveResumeFiles
+	if(ResumeFile.m_hFile != CFile::hFileNull)
+	{
+		ResumeFile.Close();
+	}
+
+	md5String = hash.FinalToString();
 
-	if(bRet)
+	if(bRet == TRUE)
 	{
 		m_RecievedFiles.Add(csFile);
+		m_RecievedRemoteFiles.Add(csFileName);
 	}
 
 	delete []pBuffer;
@@ -262,6 +355,116 @@ long CFileRecieve::RecieveFileData(ULONG lFileSize, CString csFileName, CString
 	return bRet;
 }
 
+//Checks what's left from an earlier try at this file against the crcs saved for it, returns how much of it can be kept.
+//Only whole chunks are kept and only if the file on the server has the same size and write time
+ULONG CFileRecieve::GetResumeOffset(CString csFile, ULONG lFileSize, DWORD fileTime, char *pBuffer, CTransferHash *pHash)
+{
+	CFile ResumeFile;
+	CFile File;
+	if(ResumeFile.Open(csFile + RESUME_FILE_EXTENSION, CFile::modeRead|CFile::typeBinary|CFile::shareDenyNone) == FALSE ||
+		File.Open(csFile, CFile::modeRead|CFile::typeBinary|CFile::shareDenyNone) == FALSE)
+	{
+		return 0;
+	}
+
+	CResumeHeader header;
+	if(ResumeFile.Read(&header, sizeof(header)) != sizeof(header) ||
+		header.m_magic != RESUME_FILE_MAGIC ||
+		header.m_fileSize != lFileSize ||
+		header.m_fileTime != fileTime ||
+		header.m_chunkSize != CHUNK_WRITE_SIZE)
+	{
+		return 0;
+	}
+
+	ULONG offset = 0;
+	DWORD savedCrc = 0;
+
+	while(offset + CHUNK_WRITE_SIZE <= lFileSize &&
+		ResumeFile.Read(&savedCrc, sizeof(savedCrc)) == sizeof(savedCrc))
+	{
+		if(File.Read(pBuffer, CHUNK_WRITE_SIZE) != CHUNK_WRITE_SIZE)
+			break;
+
+		DWORD crc = ~CCrc32Dynamic::UpdateCrc32(0xFFFFFFFF, (BYTE*)pBuffer, CHUNK_WRITE_SIZE);
+		if(crc != savedCrc)
+		{
+			LogSendRecieveInfo(StrF(_T("Partial file %s doesn't match its saved crc at %u"), csFile, offset));
+			break;
+		}
+
+		if(pHash != NULL)
+		{
+			pHash->Update(pBuffer, CHUNK_WRITE_SIZE);
+		}
+
+		offset += CHUNK_WRITE_SIZE;
+	}
+
+	return offset;
+}
+
+//Starts the crc file for this transfer or keeps the crcs of the chunks being resumed from, returns FALSE if nothing before keepChunks can be kept
+BOOL CFileRecieve::OpenResumeFile(CFile &ResumeFile, CString csResumeFile, ULONG lFileSize, DWORD fileTime, ULONG keepChunks)
+{
+	UINT openFlags = CFile::modeReadWrite|CFile::modeCreate|CFile::typeBinary;
+	if(keepChunks > 0)
+	{
+		openFlags |= CFile::modeNoTruncate;
+	}
+
+	if(ResumeFile.Open(csResumeFile, openFlags) == FALSE)
+	{
+		LogSendRecieveInfo(StrF(_T("Error opening resume file %s"), csResumeFile));
+		return FALSE;
+	}
+
+	CResumeHeader header;
+	header.m_magic = RESUME_FILE_MAGIC;
+	header.m_fileSize = lFileSize;
+	header.m_fileTime = fileTime;
+	header.m_chunkSize = CHUNK_WRITE_SIZE;
+
+	ResumeFile.SeekToBegin();
+	ResumeFile.Write(&header, sizeof(header));
+	ResumeFile.SetLength(sizeof(header) + keepChunks * sizeof(DWORD));
+	ResumeFile.SeekToEnd();
+
+	return keepChunks > 0;
+}
+
+//One block of a file sent by CFileSend with compression, either zlib data or the bytes as they are
+BOOL CFileRecieve::RecieveCompressedBlock(char *pBuffer, long lBytesNeeded, std::vector<BYTE> &compressed)
+{
+	long blockSize = 0;
+	if(m_Sock.RecieveExactSize((char*)&blockSize, sizeof(blockSize)) == FALSE)
+		return FALSE;
+
+	if(blockSize < 0)
+	{
+		if(-blockSize != lBytesNeeded)
+		{
+			LogSendRecieveInfo(StrF(_T("Invalid file block size %d, expected %d"), -blockSize, lBytesNeeded));
+			return FALSE;
+		}
+
+		return m_Sock.RecieveExactSize(pBuffer, lBytesNeeded);
+	}
+
+	//only sent compressed when it's smaller
+	if(blockSize == 0 || blockSize > lBytesNeeded)
+	{
+		LogSendRecieveInfo(StrF(_T("Invalid compressed file block size %d, block is %d"), blockSize, lBytesNeeded));
+		return FALSE;
+	}
+
+	compressed.resize(blockSize);
+	if(m_Sock.RecieveExactSize((char*)compressed.data(), blockSize) == FALSE)
+		return FALSE;
+
+	return CNetworkCompress::Uncompress(compressed.data(), blockSize, (BYTE*)pBuffer, lBytesNeeded);
+}
+
 HGLOBAL CFileRecieve::CreateCF_HDROPBufferAsString()
 {
 	CString data;
@@ -277,6 +480,14 @@ HGLOBAL CFileRecieve::CreateCF_HDROPBufferAsString()
 	return hReturn;
 }
 
+void CFileRecieve::RemoveResumeFiles()
+{
+	for(INT_PTR i = 0; i < m_RecievedFiles.GetCount(); i++)
+	{
+		::DeleteFile(m_RecievedFiles[i] + RESUME_FILE_EXTENSION);
+	}
+}
+
 HGLOBAL CFileRecieve::CreateCF_HDROPBuffer()
 {
 	int nFileArraySize = (int)m_RecievedFiles.GetSize();
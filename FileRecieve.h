@@ -1,31 +1,63 @@
 #pragma once
 
 #include "RecieveSocket.h"
+#include "SendSocket.h"
 #include "FileTransferProgressDlg.h"
+#include "TransferHash.h"
 
 #define USER_CANCELED -2
 #define MD5_MISMATCH -3
 
+//kept next to a file that didn't finish, a crc for each whole chunk written so a later request can pick up where it stopped
+#define RESUME_FILE_EXTENSION _T(".dittopartial")
+#define RESUME_FILE_MAGIC 0x50544944
+
+struct CResumeHeader
+{
+	DWORD m_magic;
+	ULONG m_fileSize;
+	DWORD m_fileTime;
+	DWORD m_chunkSize;
+};
+
 class CFileRecieve
 {
 public:
 	CFileRecieve();
 	virtual ~CFileRecieve();
 
-	long RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgressDlg *pProgress);
+	long RecieveFiles(SOCKET sock, CString csIP, CFileTransferProgressDlg *pProgress, DWORD requestedFeatures);
 	
 	HGLOBAL CreateCF_HDROPBuffer();
 
 	HGLOBAL CreateCF_HDROPBufferAsString();
 
 	void AddFile(CString csFile)	{ m_RecievedFiles.Add(csFile); }
+	INT_PTR GetFileCount()			{ return m_RecievedFiles.GetCount(); }
+	CString GetFile(INT_PTR i)		{ return m_RecievedFiles[i]; }
+	//the name the file has on the server, as it is in the CF_HDROP the files were requested for
+	CString GetRemoteFile(INT_PTR i)	{ return m_RecievedRemoteFiles[i]; }
+	//how many files the server said it would send
+	int GetExpectedFileCount()		{ return m_nExpectedFiles; }
+
+	//true once the server's END was read, everything it had to send was sent
+	bool IsComplete()				{ return m_bComplete; }
+
+	void RemoveResumeFiles();
 
 protected:
-	long RecieveFileData(ULONG lFileSize, CString csFileName, CString &md5String);
+	long RecieveFileData(ULONG lFileSize, CString csFileName, CString &md5String, bool bCompressed, bool bResume, bool bFastHash, DWORD fileTime);
+	BOOL RecieveCompressedBlock(char *pBuffer, long lBytesNeeded, std::vector<BYTE> &compressed);
+	ULONG GetResumeOffset(CString csFile, ULONG lFileSize, DWORD fileTime, char *pBuffer, CTransferHash *pHash);
+	BOOL OpenResumeFile(CFile &ResumeFile, CString csResumeFile, ULONG lFileSize, DWORD fileTime, ULONG keepChunks);
 
 protected:
 	CRecieveSocket m_Sock;
+	CSendSocket m_Send;
 	CString m_csReceivingFromIP;
 	CStringArray m_RecievedFiles;
+	CStringArray m_RecievedRemoteFiles;
+	int m_nExpectedFiles;
 	CFileTransferProgressDlg *m_pProgress;
+	bool m_bComplete;
 };
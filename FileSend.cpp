@@ -7,7 +7,8 @@
 #include "FileSend.h"
 #include "Server.h"
 #include "shared/TextConvert.h"
-#include "Md5.h"
+#include "TransferHash.h"
+#include "NetworkCompress.h"
 
 #include <shlwapi.h>
 
@@ -23,7 +24,7 @@ static char THIS_FILE[]=__FILE__;
 
 CFileSend::CFileSend()
 {
-
+	m_bConnectionError = false;
 }
 
 CFileSend::~CFileSend()
@@ -31,7 +32,7 @@ CFileSend::~CFileSend()
 
 }
 
-BOOL CFileSend::SendClientFiles(SOCKET sock, CClipList *pClipList)
+BOOL CFileSend::SendClientFiles(SOCKET sock, CClipList *pClipList, DWORD features, int streamIndex, int streamCount)
 {
 	if(!pClipList || pClipList->GetCount() <= 0)
 	{
@@ -40,6 +41,7 @@ BOOL CFileSend::SendClientFiles(SOCKET sock, CClipList *pClipList)
 	}
 
 	m_Send.SetSocket(sock);
+	m_Recieve.SetSocket(sock);
 
 	CSendInfo Info;
 	BOOL bRet = FALSE;
@@ -57,7 +59,9 @@ BOOL CFileSend::SendClientFiles(SOCKET sock, CClipList *pClipList)
  		{
  			if(DragQueryFile(drop, nFile, file, sizeof(file)) > 0)
  			{
-				if(PathIsDirectory(file) == FALSE)
+				//the other streams of this request send the rest
+				if(PathIsDirectory(file) == FALSE &&
+					nFile % streamCount == streamIndex)
 				{
 					CopyFiles.Add(file);
 				}
@@ -74,7 +78,10 @@ BOOL CFileSend::SendClientFiles(SOCKET sock, CClipList *pClipList)
 		{
 			for(int nFile = 0; nFile < Info.m_lParameter1; nFile++)
 			{
-				SendFile(CopyFiles[nFile]);
+				SendFile(CopyFiles[nFile], features);
+
+				if(m_bConnectionError)
+					break;
 			}
 		}
 	}
@@ -106,11 +113,14 @@ CClipFormat* CFileSend::GetCF_HDROP_Data(CClipList *pClipList)
 	return NULL;
 }
  
-BOOL CFileSend::SendFile(CString csFile)
+BOOL CFileSend::SendFile(CString csFile, DWORD features)
 {
 	CFile file;
 	BOOL bRet = FALSE;
 	CSendInfo Info;
+	bool bCompress = (features & NETWORK_FEATURE_COMPRESSION) != 0;
+	bool bResume = (features & NETWORK_FEATURE_RESUME) != 0;
+	bool bFastHash = (features & NETWORK_FEATURE_FAST_HASH) != 0;
 	
 	char *pBuffer = new char[CHUNK_WRITE_SIZE];
 	if(pBuffer == NULL)
@@ -128,35 +138,117 @@ BOOL CFileSend::SendFile(CString csFile)
 			strncpy(Info.m_cDesc, dest, sizeof(Info.m_cDesc));
 			Info.m_cDesc[sizeof(Info.m_cDesc)-1] = 0;			
 
-			Info.m_lParameter1 = (long)file.GetLength();
+			ULONG fileLength = (ULONG)file.GetLength();
+			Info.m_lParameter1 = (long)fileLength;
+
+			//the client can only tell what follows DATA_START from the version
+			if(features != 0)
+			{
+				Info.m_nVersion = NETWORK_PROTOCOL_VERSION;
+			}
+
+			if(bResume)
+			{
+				//with the size this is what the client checks its partial file against
+				FILETIME lastWriteTime;
+				if(GetFileTime(file, NULL, NULL, &lastWriteTime))
+				{
+					Info.m_lParameter2 = lastWriteTime.dwLowDateTime;
+				}
+			}
+
+			bool bTryCompress = bCompress &&
+								CGetSetOptions::GetNetworkCompressionLevel() > 0 &&
+								CNetworkCompress::IsCompressedFile(csFile) == false;
+			int blocksNotCompressed = 0;
+			std::vector<BYTE> compressed;
+
 			if(m_Send.SendCSendData(Info, MyEnums::DATA_START))
 			{
 				long lReadBytes = 0;
 				BOOL bError = FALSE;
-				CMd5 md5;
-				md5.MD5Init();
-
 				BOOL calcMd5 = CGetSetOptions::GetCheckMd5OnFileTransfers();
+				CTransferHash hash(bFastHash);
+
+				//the fast hash is worked out on another thread reading the file, md5 for older clients is done here as it's sent
+				CFileHasher hasher;
+				bool bHashHere = calcMd5 && (bFastHash == false || hasher.Start(csFile) == false);
 
 				DWORD d = GetTickCount();
-				
-				do
+
+				ULONG offset = 0;
+				if(bResume)
 				{
-					lReadBytes = file.Read(pBuffer, CHUNK_WRITE_SIZE);
-					
-					if(m_Send.SendExactSize(pBuffer, lReadBytes, false) == FALSE)
+					if(GetResumeOffset(fileLength, offset) == FALSE ||
+						SkipToOffset(file, offset, pBuffer, bHashHere ? &hash : NULL) == FALSE)
 					{
-						LogSendRecieveInfo("Error sending SendExactSize in SendFile");
 						bError = TRUE;
-						break;
+						m_bConnectionError = true;
 					}
+				}
 
-					if (calcMd5)
+				//nothing to do to the data, let windows send it straight from the file
+				if(bError == FALSE &&
+					bCompress == false &&
+					bHashHere == false)
+				{
+					if(m_Send.TransmitFileData(file.m_hFile, fileLength - offset) == FALSE)
 					{
-						md5.MD5Update((unsigned char *)pBuffer, lReadBytes);
+						bError = TRUE;
+						m_bConnectionError = true;
 					}
-					
-				}while(lReadBytes >= CHUNK_WRITE_SIZE);
+				}
+				else if(bError == FALSE)
+				{
+					do
+					{
+						lReadBytes = file.Read(pBuffer, CHUNK_WRITE_SIZE);
+
+						BOOL bSent = FALSE;
+						if(bCompress)
+						{
+							if(lReadBytes == 0)
+							{
+								bSent = TRUE;
+							}
+							//stop trying once a few blocks in a row didn't compress, the rest of the file likely won't either
+							else if(bTryCompress &&
+								blocksNotCompressed < 4 &&
+								CNetworkCompress::Compress((BYTE*)pBuffer, lReadBytes, compressed))
+							{
+								long blockSize = (long)compressed.size();
+								bSent = m_Send.SendExactSize((char*)&blockSize, sizeof(blockSize), false) &&
+										m_Send.SendExactSize((char*)compressed.data(), blockSize, false);
+								blocksNotCompressed = 0;
+							}
+							else
+							{
+								long blockSize = -lReadBytes;
+								bSent = m_Send.SendExactSize((char*)&blockSize, sizeof(blockSize), false) &&
+										m_Send.SendExactSize(pBuffer, lReadBytes, false);
+								blocksNotCompressed++;
+							}
+						}
+						else
+						{
+							bSent = m_Send.SendExactSize(pBuffer, lReadBytes, false);
+						}
+						
+						if(bSent == FALSE)
+						{
+							LogSendRecieveInfo("Error sending SendExactSize in SendFile");
+							bError = TRUE;
+							m_bConnectionError = true;
+							break;
+						}
+
+						if (bHashHere)
+						{
+							hash.Update(pBuffer, lReadBytes);
+						}
+						
+					}while(lReadBytes >= CHUNK_WRITE_SIZE);
+				}
 				
 				DWORD end = GetTickCount() - d;
 
@@ -175,7 +267,16 @@ BOOL CFileSend::SendFile(CString csFile)
 						Info.m_lParameter2 = lastWriteTime.dwHighDateTime;
 					}
 										
-					CStringA csMd5 = md5.MD5FinalToString();
+					//older clients always get an md5, even of nothing, a fast hash is left out if it wasn't worked out
+					CStringA csMd5;
+					if(bHashHere || bFastHash == false)
+					{
+						csMd5 = hash.FinalToString();
+					}
+					else if(calcMd5)
+					{
+						csMd5 = hasher.Wait();
+					}
 					strncpy(Info.m_md5, csMd5, sizeof(Info.m_md5));
 
 					LogSendRecieveInfo(StrF(_T("Sending data_end for file: %s, md5: %s"), csFile, CTextConvert::AnsiToUnicode(csMd5)));
@@ -184,6 +285,10 @@ BOOL CFileSend::SendFile(CString csFile)
 						bRet = TRUE;
 				}
 			}
+			else
+			{
+				m_bConnectionError = true;
+			}
 		}
 		else
 		{
@@ -197,10 +302,63 @@ BOOL CFileSend::SendFile(CString csFile)
 		TCHAR szError[100];
 		e->GetErrorMessage(szError, 100);
 		LogSendRecieveInfo(StrF(_T("Exception - Error in Send file, error: %s"), szError));
+
+		//part of the file may have been sent, the client can't tell where the next one starts
+		m_bConnectionError = true;
 	}
 	
 	delete []pBuffer;
 	pBuffer = NULL;
 	
 	return bRet;
-}
\ No newline at end of file
+}
+
+//The client answers DATA_START with where its copy of the file stops matching
+BOOL CFileSend::GetResumeOffset(ULONG fileLength, ULONG &offset)
+{
+	CSendInfo Info;
+	if(m_Recieve.RecieveCSendInfo(&Info) == FALSE ||
+		Info.m_Type != MyEnums::RESUME)
+	{
+		LogSendRecieveInfo("Error reading resume offset in SendFile");
+		return FALSE;
+	}
+
+	offset = (ULONG)Info.m_lParameter1;
+	if(offset > fileLength ||
+		offset % CHUNK_WRITE_SIZE != 0)
+	{
+		LogSendRecieveInfo(StrF(_T("Invalid resume offset %u, file size %u"), offset, fileLength));
+		return FALSE;
+	}
+
+	if(offset > 0)
+	{
+		LogSendRecieveInfo(StrF(_T("Client has the first %u bytes of %u, resuming"), offset, fileLength));
+	}
+
+	return TRUE;
+}
+
+//The hash is of the whole file so the part the client already has is still read for it
+BOOL CFileSend::SkipToOffset(CFile &file, ULONG offset, char *pBuffer, CTransferHash *pHash)
+{
+	if(pHash == NULL)
+	{
+		file.Seek(offset, CFile::begin);
+		return TRUE;
+	}
+
+	for(ULONG read = 0; read < offset; read += CHUNK_WRITE_SIZE)
+	{
+		if(file.Read(pBuffer, CHUNK_WRITE_SIZE) != CHUNK_WRITE_SIZE)
+		{
+			LogSendRecieveInfo("Error reading up to the resume offset in SendFile");
+			return FALSE;
+		}
+
+		pHash->Update(pBuffer, CHUNK_WRITE_SIZE);
+	}
+
+	return TRUE;
+}
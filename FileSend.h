@@ -1,6 +1,8 @@
 #pragma once
 
 #include "SendSocket.h"
+#include "RecieveSocket.h"
+#include "TransferHash.h"
 
 class CFileSend  
 {
@@ -8,12 +10,16 @@ public:
 	CFileSend();
 	virtual ~CFileSend();
 
-	BOOL SendClientFiles(SOCKET sock, CClipList *pClipList);
+	BOOL SendClientFiles(SOCKET sock, CClipList *pClipList, DWORD features = 0, int streamIndex = 0, int streamCount = 1);
 
 protected:
 	CClipFormat* GetCF_HDROP_Data(CClipList *pClipList);
-	BOOL SendFile(CString csFile);
+	BOOL SendFile(CString csFile, DWORD features);
+	BOOL GetResumeOffset(ULONG fileLength, ULONG &offset);
+	BOOL SkipToOffset(CFile &file, ULONG offset, char *pBuffer, CTransferHash *pHash);
 
 protected:
 	CSendSocket m_Send;
+	CRecieveSocket m_Recieve;
+	bool m_bConnectionError;
 };
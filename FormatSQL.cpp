@@ -138,6 +138,17 @@ bool CFormatSQL::AddToSQL(CString cs, eSpecialTypes &eNOTValue, eSpecialTypes &e
 	{
 		csThisSQL.Format(_T("%s REGEXP \'%s\'"), m_csVariable, cs);
 	}
+	else if (m_csFullTextColumn.IsEmpty() == FALSE)
+	{
+		if (CGetSetOptions::GetSimpleTextSearch())
+		{
+			csThisSQL = GetFullTextIndexSQL(cs, eINVALID);
+		}
+		else
+		{
+			csThisSQL = GetFullTextIndexSQL(cs, eNOTValue);
+		}
+	}
 	else if (CGetSetOptions::GetSimpleTextSearch())
 	{
 		if (m_csVariable.Find(_T("%")))
@@ -178,3 +189,27 @@ bool CFormatSQL::AddToSQL(CString cs, eSpecialTypes &eNOTValue, eSpecialTypes &e
 
 	return true;
 }
+
+CString CFormatSQL::GetFullTextIndexSQL(CString cs, eSpecialTypes eNOTValue)
+{
+	CString csThisSQL;
+
+	//the trigram tokenizer needs at least 3 characters to use the index, shorter words fall back to LIKE on the index text
+	//this still avoids reading Main or Data rows
+	if (cs.GetLength() >= 3)
+	{
+		CString local(cs);
+		local.Replace(_T("\""), _T("\"\""));
+
+		csThisSQL.Format(_T("Main.lID%sIN (SELECT rowid FROM MainFts WHERE MainFts MATCH \'{%s} : \"%s\"\')"), GetKeyWordString(eNOTValue), m_csFullTextColumn, local);
+	}
+	else
+	{
+		CString local(cs);
+		local.Replace(_T("%"), _T("\\%"));
+
+		csThisSQL.Format(_T("Main.lID%sIN (SELECT rowid FROM MainFts WHERE MainFts.%s LIKE \'%%%s%%\' ESCAPE \'\\\')"), GetKeyWordString(eNOTValue), m_csFullTextColumn, local);
+	}
+
+	return csThisSQL;
+}
@@ -19,16 +19,20 @@ public:
 
 	CString GetSQLString()				{ return _T("(") + m_csWhere + _T(")"); }
 	void	SetVariable(CString cs)		{ m_csVariable = cs;}
+	//search the MainFts full text index column instead of using LIKE on m_csVariable
+	void	SetFullTextIndexColumn(CString cs)	{ m_csFullTextColumn = cs;}
 
 protected:
 	CString m_csWhere;
 	CString m_csVariable;
+	CString m_csFullTextColumn;
 	enum eSpecialTypes{eINVALID, eNOT, eAND, eOR};
 	
 
 	bool AddToSQL(CString cs, eSpecialTypes &eNOTValue, eSpecialTypes &eORValue);
 	CFormatSQL::eSpecialTypes ConvetToKey(CString cs);
 	CString GetKeyWordString(eSpecialTypes eKeyWord);
+	CString GetFullTextIndexSQL(CString cs, eSpecialTypes eNOTValue);
 };
 
 #endif // !defined(AFX_FORMATSQL_H__3D7AC79C_FDD8_4948_B7CD_601FB513F208__INCLUDED_)
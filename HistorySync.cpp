@@ -0,0 +1,687 @@
+#include "stdafx.h"
+#include "cp_main.h"
+#include "HistorySync.h"
+#include "Client.h"
+#include "DbConnectionPool.h"
+#include "WildCardMatch.h"
+#include "Shared\Tokenizer.h"
+#include <algorithm>
+
+//each message stays under ENCRYPTED_CHUNK_SIZE, a bucket is at most 20 bytes and a key at most 9
+#define SYNC_BUCKETS_PER_MESSAGE 2048
+#define SYNC_KEYS_PER_MESSAGE 4096
+//the other side adds the clips it has after this many
+#define SYNC_CLIPS_PER_BATCH 50
+
+void CHistorySync::StartSyncThread()
+{
+	AfxBeginThread(CHistorySync::SyncThread, NULL, THREAD_PRIORITY_LOWEST);
+}
+
+UINT CHistorySync::SyncThread(LPVOID pParam)
+{
+	//the last sync can still be going if it had a lot to send
+	static volatile LONG running = 0;
+	if(InterlockedExchange(&running, 1) == 1)
+		return 0;
+
+	CTokenizer token(CGetSetOptions::GetNetworkSyncHosts(), _T(","));
+	CString host;
+
+	while(token.Next(host))
+	{
+		host.Trim();
+
+		//wild cards only say who can sync with us
+		if(host == _T("") || host.FindOneOf(_T("*?")) >= 0)
+			continue;
+
+		if(theApp.m_bAppExiting)
+			break;
+
+		SyncWith(host);
+	}
+
+	InterlockedExchange(&running, 0);
+
+	return 0;
+}
+
+BOOL CHistorySync::SyncWith(CString server)
+{
+	DWORD startTick = GetTickCount();
+
+	LogSendRecieveInfo(StrF(_T("History sync with %s -- START"), server));
+
+	CClient client;
+	if(client.OpenConnection(server) == FALSE)
+	{
+		LogSendRecieveInfo(StrF(_T("History sync, failed to connect to %s"), server));
+		return FALSE;
+	}
+
+	if(client.StartSync(NETWORK_SYNC_MODE_SUMMARY) == FALSE)
+	{
+		LogSendRecieveInfo(StrF(_T("History sync, %s is older or doesn't sync with us"), server));
+		client.CloseConnection();
+		return FALSE;
+	}
+
+	std::vector<CSyncBucket> buckets;
+	BuildSummary(buckets);
+
+	CSendSocket &send = client.GetSendSocket();
+	CNetworkFrameWriter frame;
+
+	for(size_t i = 0; i < buckets.size(); i += SYNC_BUCKETS_PER_MESSAGE)
+	{
+		std::vector<unsigned char> data;
+		PutBuckets(data, &buckets[i], min(buckets.size() - i, (size_t)SYNC_BUCKETS_PER_MESSAGE));
+
+		frame.BeginMessage(NETWORK_MESSAGE_SYNC_SUMMARY);
+		frame.AddBytes(NETWORK_FIELD_SYNC_BUCKETS, &data[0], data.size());
+		frame.EndMessage();
+
+		if(SendIfFull(send, frame) == FALSE)
+			return FALSE;
+	}
+
+	frame.BeginMessage(NETWORK_MESSAGE_SYNC_SUMMARY_END);
+	frame.EndMessage();
+	if(send.SendFrame(frame) == FALSE)
+		return FALSE;
+	frame.Clear();
+
+	size_t bucketCount = buckets.size();
+	buckets.clear();
+
+	//the other side's keys for each bucket that's different, the clips only one side has are collected up to NetworkSyncMaxClips
+	size_t maxClips = (size_t)max(0, CGetSetOptions::GetNetworkSyncMaxClips());
+	std::vector<int> sendIds;
+	std::vector<CSyncKey> wanted;
+	std::vector<CSyncKey> remoteKeys;
+	int differentBuckets = 0;
+	bool bDone = false;
+
+	while(bDone == false)
+	{
+		std::vector<unsigned char> data;
+		if(client.GetRecieveSocket().ReceiveFrame(data) == FALSE)
+		{
+			LogSendRecieveInfo(StrF(_T("History sync, failed to read keys from %s"), server));
+			return FALSE;
+		}
+
+		CNetworkFrameReader reader(&data[0], data.size());
+		CNetworkFrameMessage message;
+
+		while(reader.Next(message))
+		{
+			if(message.GetType() == NETWORK_MESSAGE_SYNC_KEYS)
+			{
+				uint64_t bucket = 0;
+				uint64_t more = 0;
+				message.GetUInt(NETWORK_FIELD_SYNC_BUCKET, bucket);
+				message.GetUInt(NETWORK_FIELD_SYNC_MORE, more);
+
+				if(bucket > 0xFFFFFFFF ||
+					GetKeys(message, remoteKeys) == false)
+				{
+					LogSendRecieveInfo(StrF(_T("History sync, invalid keys from %s"), server));
+					return FALSE;
+				}
+
+				if(more == 0)
+				{
+					CompareBucket((DWORD)bucket, remoteKeys, sendIds, wanted, maxClips);
+					remoteKeys.clear();
+					differentBuckets++;
+				}
+			}
+			else if(message.GetType() == NETWORK_MESSAGE_SYNC_KEYS_END)
+			{
+				bDone = true;
+			}
+		}
+
+		if(reader.Failed())
+		{
+			LogSendRecieveInfo(StrF(_T("History sync, invalid frame from %s"), server));
+			return FALSE;
+		}
+	}
+
+	//what we want is asked for before anything else is sent, the other side sends it over its own connection
+	std::sort(wanted.begin(), wanted.end());
+
+	for(size_t i = 0; i < wanted.size(); i += SYNC_KEYS_PER_MESSAGE)
+	{
+		std::vector<unsigned char> data;
+		PutKeys(data, &wanted[i], min(wanted.size() - i, (size_t)SYNC_KEYS_PER_MESSAGE));
+
+		frame.BeginMessage(NETWORK_MESSAGE_SYNC_REQUEST);
+		frame.AddBytes(NETWORK_FIELD_SYNC_KEYS, &data[0], data.size());
+		frame.EndMessage();
+
+		if(SendIfFull(send, frame) == FALSE)
+			return FALSE;
+	}
+
+	frame.BeginMessage(NETWORK_MESSAGE_SYNC_REQUEST_END);
+	frame.EndMessage();
+	if(send.SendFrame(frame) == FALSE)
+		return FALSE;
+	frame.Clear();
+
+	BOOL bRet = SendClips(client, sendIds);
+
+	client.CloseConnection();
+
+	LogSendRecieveInfo(StrF(_T("History sync with %s -- END, buckets: %d, different: %d, clips sent: %d, clips requested: %d, time: %d"),
+							server, (int)bucketCount, differentBuckets, (int)sendIds.size(), (int)wanted.size(), GetTickCount() - startTick));
+
+	return bRet;
+}
+
+BOOL CHistorySync::SendClips(CClient &client, const std::vector<int> &ids)
+{
+	int batchCount = 0;
+
+	for(size_t i = 0; i < ids.size(); i++)
+	{
+		if(theApp.m_bAppExiting)
+			return FALSE;
+
+		CClip clip;
+		if(clip.LoadMainTable(ids[i]) == FALSE ||
+			clip.m_bIsGroup)
+		{
+			continue;
+		}
+
+		clip.LoadFormats(ids[i]);
+		if(clip.m_Formats.GetSize() == 0)
+			continue;
+
+		if(client.SendItem(&clip, false) == FALSE)
+			return FALSE;
+
+		if(++batchCount >= SYNC_CLIPS_PER_BATCH)
+		{
+			if(client.EndBatch() == FALSE)
+				return FALSE;
+
+			batchCount = 0;
+		}
+	}
+
+	return TRUE;
+}
+
+void CHistorySync::StartSendClips(CString server, const std::vector<int> &ids)
+{
+	CHistorySyncSendInfo *pInfo = new CHistorySyncSendInfo;
+	pInfo->m_server = server;
+	pInfo->m_ids = ids;
+
+	AfxBeginThread(CHistorySync::SendClipsThread, pInfo, THREAD_PRIORITY_LOWEST);
+}
+
+UINT CHistorySync::SendClipsThread(LPVOID pParam)
+{
+	CHistorySyncSendInfo *pInfo = (CHistorySyncSendInfo*)pParam;
+
+	CClient client;
+	if(client.OpenConnection(pInfo->m_server) &&
+		client.StartSync(NETWORK_SYNC_MODE_CLIPS))
+	{
+		SendClips(client, pInfo->m_ids);
+
+		LogSendRecieveInfo(StrF(_T("History sync, sent %d requested clips to %s"), (int)pInfo->m_ids.size(), pInfo->m_server));
+	}
+	else
+	{
+		LogSendRecieveInfo(StrF(_T("History sync, failed to connect back to %s"), pInfo->m_server));
+	}
+
+	client.CloseConnection();
+
+	delete pInfo;
+
+	return 0;
+}
+
+//Wild cards are matched against the ip, names are looked up
+bool CHistorySync::IsSyncHost(CString ip)
+{
+	CTokenizer token(CGetSetOptions::GetNetworkSyncHosts(), _T(","));
+	CString line;
+
+	while(token.Next(line))
+	{
+		line.Trim();
+
+		//the port is only used to connect
+		int colon = line.Find(_T(':'));
+		if(colon >= 0)
+		{
+			line = line.Left(colon);
+		}
+
+		if(line == _T(""))
+			continue;
+
+		if(CWildCardMatch::WildMatch(line, ip, _T("")))
+			return true;
+
+		if(line.FindOneOf(_T("*?")) < 0)
+		{
+			CStringA nameA = CTextConvert::UnicodeToAnsi(line);
+			struct hostent *hp = gethostbyname(nameA);
+			if(hp != NULL && hp->h_addrtype == AF_INET)
+			{
+				for(int i = 0; hp->h_addr_list[i] != NULL; i++)
+				{
+					in_addr addr;
+					memcpy(&addr, hp->h_addr_list[i], sizeof(addr));
+
+					if(ip == CString(inet_ntoa(addr)))
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+//One pass over the date index, a key that's there more than once is only counted once
+void CHistorySync::BuildSummary(std::vector<CSyncBucket> &buckets)
+{
+	buckets.clear();
+
+	try
+	{
+		CDbReadConnection connection;
+		CppSQLite3Query q = connection.Db().execQuery(_T("SELECT lDate, CRC FROM Main WHERE bIsGroup = 0 ORDER BY lDate, CRC"));
+
+		DWORD lastDate = 0;
+		DWORD lastCrc = 0;
+
+		while(q.eof() == false)
+		{
+			DWORD date = (DWORD)q.getIntField(0);
+			DWORD crc = (DWORD)q.getIntField(1);
+			q.nextRow();
+
+			if(buckets.empty() == false &&
+				date == lastDate &&
+				crc == lastCrc)
+			{
+				continue;
+			}
+
+			lastDate = date;
+			lastCrc = crc;
+
+			DWORD bucket = date / NETWORK_SYNC_BUCKET_SECONDS;
+			if(buckets.empty() || buckets.back().m_bucket != bucket)
+			{
+				CSyncBucket newBucket;
+				newBucket.m_bucket = bucket;
+				buckets.push_back(newBucket);
+			}
+
+			buckets.back().m_count++;
+			buckets.back().m_hash += HashKey(date, crc);
+		}
+	}
+	CATCH_SQLITE_EXCEPTION
+}
+
+//Sorted and without repeats
+void CHistorySync::LoadKeys(DWORD bucket, std::vector<CSyncKey> &keys)
+{
+	keys.clear();
+
+	try
+	{
+		INT64 start = (INT64)bucket * NETWORK_SYNC_BUCKET_SECONDS;
+		INT64 end = start + NETWORK_SYNC_BUCKET_SECONDS;
+
+		CDbReadConnection connection;
+		CppSQLite3Query q = connection.Db().execQueryEx(_T("SELECT lID, lDate, CRC FROM Main WHERE lDate >= %I64d AND lDate < %I64d AND bIsGroup = 0"), start, end);
+
+		while(q.eof() == false)
+		{
+			keys.push_back(CSyncKey((DWORD)q.getIntField(1), (DWORD)q.getIntField(2), q.getIntField(0)));
+			q.nextRow();
+		}
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+int CHistorySync::FindClip(const CSyncKey &key)
+{
+	try
+	{
+		CDbReadConnection connection;
+		CppSQLite3Query q = connection.Db().execQueryEx(_T("SELECT lID FROM Main WHERE lDate = %d AND CRC = %d AND bIsGroup = 0 LIMIT 1"), (int)key.m_date, (int)key.m_crc);
+		if(q.eof() == false)
+		{
+			return q.getIntField(0);
+		}
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	return -1;
+}
+
+//splitmix64, so buckets that have the same count but different clips end up with different sums
+uint64_t CHistorySync::HashKey(DWORD date, DWORD crc)
+{
+	uint64_t x = ((uint64_t)date << 32) | crc;
+
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+	return x ^ (x >> 31);
+}
+
+//Both key lists are for the same bucket, keys only we have are sent and keys only they have are asked for
+void CHistorySync::CompareBucket(DWORD bucket, std::vector<CSyncKey> &remoteKeys, std::vector<int> &sendIds, std::vector<CSyncKey> &wanted, size_t maxClips)
+{
+	std::vector<CSyncKey> localKeys;
+	LoadKeys(bucket, localKeys);
+
+	std::sort(remoteKeys.begin(), remoteKeys.end());
+	remoteKeys.erase(std::unique(remoteKeys.begin(), remoteKeys.end()), remoteKeys.end());
+
+	size_t local = 0;
+	size_t remote = 0;
+
+	while(local < localKeys.size() || remote < remoteKeys.size())
+	{
+		if(remote == remoteKeys.size() ||
+			(local < localKeys.size() && localKeys[local] < remoteKeys[remote]))
+		{
+			if(sendIds.size() < maxClips)
+			{
+				sendIds.push_back(localKeys[local].m_id);
+			}
+			local++;
+		}
+		else if(local == localKeys.size() ||
+			remoteKeys[remote] < localKeys[local])
+		{
+			if(wanted.size() < maxClips)
+			{
+				wanted.push_back(remoteKeys[remote]);
+			}
+			remote++;
+		}
+		else
+		{
+			local++;
+			remote++;
+		}
+	}
+}
+
+void CHistorySync::PutBuckets(std::vector<unsigned char> &out, const CSyncBucket *pBuckets, size_t count)
+{
+	DWORD last = 0;
+
+	for(size_t i = 0; i < count; i++)
+	{
+		CNetworkFrameWriter::PutVarint(out, pBuckets[i].m_bucket - last);
+		CNetworkFrameWriter::PutVarint(out, pBuckets[i].m_count);
+
+		for(int byte = 0; byte < 8; byte++)
+		{
+			out.push_back((unsigned char)(pBuckets[i].m_hash >> (byte * 8)));
+		}
+
+		last = pBuckets[i].m_bucket;
+	}
+}
+
+bool CHistorySync::GetBuckets(const CNetworkFrameMessage &message, std::vector<CSyncBucket> &buckets)
+{
+	const unsigned char *pData = NULL;
+	size_t length = 0;
+	if(message.GetBytes(NETWORK_FIELD_SYNC_BUCKETS, pData, length) == false)
+		return false;
+
+	const unsigned char *pEnd = pData + length;
+	uint64_t last = 0;
+
+	while(pData < pEnd)
+	{
+		uint64_t delta = 0;
+		CSyncBucket bucket;
+		if(CNetworkFrameReader::GetVarint(pData, pEnd, delta) == false ||
+			CNetworkFrameReader::GetVarint(pData, pEnd, bucket.m_count) == false ||
+			pEnd - pData < 8 ||
+			last + delta > 0xFFFFFFFF)
+		{
+			return false;
+		}
+
+		last += delta;
+		bucket.m_bucket = (DWORD)last;
+
+		for(int byte = 0; byte < 8; byte++)
+		{
+			bucket.m_hash |= (uint64_t)*pData++ << (byte * 8);
+		}
+
+		buckets.push_back(bucket);
+	}
+
+	return true;
+}
+
+//keys have to be sorted
+void CHistorySync::PutKeys(std::vector<unsigned char> &out, const CSyncKey *pKeys, size_t count)
+{
+	DWORD last = 0;
+
+	for(size_t i = 0; i < count; i++)
+	{
+		CNetworkFrameWriter::PutVarint(out, pKeys[i].m_date - last);
+
+		for(int byte = 0; byte < 4; byte++)
+		{
+			out.push_back((unsigned char)(pKeys[i].m_crc >> (byte * 8)));
+		}
+
+		last = pKeys[i].m_date;
+	}
+}
+
+bool CHistorySync::GetKeys(const CNetworkFrameMessage &message, std::vector<CSyncKey> &keys)
+{
+	const unsigned char *pData = NULL;
+	size_t length = 0;
+	if(message.GetBytes(NETWORK_FIELD_SYNC_KEYS, pData, length) == false)
+		return true;
+
+	const unsigned char *pEnd = pData + length;
+	uint64_t last = 0;
+
+	while(pData < pEnd)
+	{
+		uint64_t delta = 0;
+		if(CNetworkFrameReader::GetVarint(pData, pEnd, delta) == false ||
+			pEnd - pData < 4 ||
+			last + delta > 0xFFFFFFFF)
+		{
+			return false;
+		}
+
+		last += delta;
+
+		DWORD crc = 0;
+		for(int byte = 0; byte < 4; byte++)
+		{
+			crc |= (DWORD)*pData++ << (byte * 8);
+		}
+
+		keys.push_back(CSyncKey((DWORD)last, crc));
+	}
+
+	return true;
+}
+
+//A bucket with more keys than fit in a message goes over several with NETWORK_FIELD_SYNC_MORE on all but the last
+BOOL CHistorySync::SendKeys(CSendSocket &send, CNetworkFrameWriter &frame, DWORD bucket, const std::vector<CSyncKey> &keys)
+{
+	size_t i = 0;
+
+	do
+	{
+		size_t count = min(keys.size() - i, (size_t)SYNC_KEYS_PER_MESSAGE);
+
+		frame.BeginMessage(NETWORK_MESSAGE_SYNC_KEYS);
+		frame.AddUInt(NETWORK_FIELD_SYNC_BUCKET, bucket);
+		if(count > 0)
+		{
+			std::vector<unsigned char> data;
+			PutKeys(data, &keys[i], count);
+			frame.AddBytes(NETWORK_FIELD_SYNC_KEYS, &data[0], data.size());
+		}
+		if(i + count < keys.size())
+		{
+			frame.AddUInt(NETWORK_FIELD_SYNC_MORE, 1);
+		}
+		frame.EndMessage();
+
+		if(SendIfFull(send, frame) == FALSE)
+			return FALSE;
+
+		i += count;
+	}
+	while(i < keys.size());
+
+	return TRUE;
+}
+
+BOOL CHistorySync::SendIfFull(CSendSocket &send, CNetworkFrameWriter &frame)
+{
+	if(frame.GetSize() < ENCRYPTED_CHUNK_SIZE)
+		return TRUE;
+
+	BOOL bRet = send.SendFrame(frame);
+	frame.Clear();
+
+	return bRet;
+}
+
+bool CHistorySyncReply::AddSummary(const CNetworkFrameMessage &message)
+{
+	std::vector<CSyncBucket> buckets;
+	if(CHistorySync::GetBuckets(message, buckets) == false)
+		return false;
+
+	for(size_t i = 0; i < buckets.size(); i++)
+	{
+		m_remoteBuckets[buckets[i].m_bucket] = buckets[i];
+	}
+
+	return true;
+}
+
+//Our keys for every bucket that's only on one side or has a different count or hash, a bucket they have
+//and we don't is sent with no keys
+BOOL CHistorySyncReply::SendDifferences(CSendSocket &send)
+{
+	std::vector<CSyncBucket> localBuckets;
+	CHistorySync::BuildSummary(localBuckets);
+
+	CNetworkFrameWriter frame;
+	std::vector<CSyncKey> keys;
+	std::map<DWORD, CSyncBucket>::const_iterator remote = m_remoteBuckets.begin();
+	size_t local = 0;
+	int differentBuckets = 0;
+
+	while(local < localBuckets.size() || remote != m_remoteBuckets.end())
+	{
+		DWORD bucket = 0;
+		bool bDifferent = true;
+
+		if(remote == m_remoteBuckets.end() ||
+			(local < localBuckets.size() && localBuckets[local].m_bucket < remote->first))
+		{
+			bucket = localBuckets[local].m_bucket;
+			local++;
+		}
+		else if(local == localBuckets.size() ||
+			remote->first < localBuckets[local].m_bucket)
+		{
+			bucket = remote->first;
+			remote++;
+		}
+		else
+		{
+			bucket = remote->first;
+			bDifferent = localBuckets[local].m_count != remote->second.m_count ||
+						localBuckets[local].m_hash != remote->second.m_hash;
+			local++;
+			remote++;
+		}
+
+		if(bDifferent == false)
+			continue;
+
+		CHistorySync::LoadKeys(bucket, keys);
+		if(CHistorySync::SendKeys(send, frame, bucket, keys) == FALSE)
+			return FALSE;
+
+		differentBuckets++;
+	}
+
+	frame.BeginMessage(NETWORK_MESSAGE_SYNC_KEYS_END);
+	frame.EndMessage();
+
+	LogSendRecieveInfo(StrF(_T("::SYNC buckets here: %d, there: %d, different: %d"), (int)localBuckets.size(), (int)m_remoteBuckets.size(), differentBuckets));
+
+	m_remoteBuckets.clear();
+
+	return send.SendFrame(frame);
+}
+
+bool CHistorySyncReply::AddRequest(const CNetworkFrameMessage &message)
+{
+	std::vector<CSyncKey> keys;
+	if(CHistorySync::GetKeys(message, keys) == false)
+		return false;
+
+	size_t maxClips = (size_t)max(0, CGetSetOptions::GetNetworkSyncMaxClips());
+
+	for(size_t i = 0; i < keys.size() && m_requestedIds.size() < maxClips; i++)
+	{
+		int id = CHistorySync::FindClip(keys[i]);
+		if(id >= 0)
+		{
+			m_requestedIds.push_back(id);
+		}
+	}
+
+	return true;
+}
+
+void CHistorySyncReply::SendRequested(CString server)
+{
+	LogSendRecieveInfo(StrF(_T("::SYNC_REQUEST_END %d clips requested by %s"), (int)m_requestedIds.size(), server));
+
+	if(m_requestedIds.size() > 0)
+	{
+		CHistorySync::StartSendClips(server, m_requestedIds);
+		m_requestedIds.clear();
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "NetworkFrame.h"
+#include "SendSocket.h"
+#include <map>
+#include <vector>
+
+class CClient;
+
+//A clip as the history sync sees it, the same clip on two computers has the same date and crc
+class CSyncKey
+{
+public:
+	CSyncKey()
+	{
+		m_date = 0;
+		m_crc = 0;
+		m_id = -1;
+	}
+	CSyncKey(DWORD date, DWORD crc, int id = -1)
+	{
+		m_date = date;
+		m_crc = crc;
+		m_id = id;
+	}
+
+	bool operator<(const CSyncKey &other) const
+	{
+		return m_date < other.m_date || (m_date == other.m_date && m_crc < other.m_crc);
+	}
+	bool operator==(const CSyncKey &other) const
+	{
+		return m_date == other.m_date && m_crc == other.m_crc;
+	}
+
+	DWORD m_date;
+	DWORD m_crc;
+	//only known on the computer that has the clip
+	int m_id;
+};
+
+//The clips with lDate in one NETWORK_SYNC_BUCKET_SECONDS range, the hash is a sum of the key hashes so it doesn't
+//depend on the order the clips were read in
+class CSyncBucket
+{
+public:
+	CSyncBucket()
+	{
+		m_bucket = 0;
+		m_count = 0;
+		m_hash = 0;
+	}
+
+	DWORD m_bucket;
+	uint64_t m_count;
+	uint64_t m_hash;
+};
+
+//Syncs the history with the computers in NetworkSyncHosts, only the buckets that are different are compared
+//key by key and only the clips missing on one side are sent
+class CHistorySync
+{
+public:
+	//connects to server, sends it the clips it doesn't have and asks it for the ones we don't have
+	static BOOL SyncWith(CString server);
+	//sends the clips over a connection started with StartSync
+	static BOOL SendClips(CClient &client, const std::vector<int> &ids);
+	//connects to server and sends it the clips on a thread of its own
+	static void StartSendClips(CString server, const std::vector<int> &ids);
+
+	//syncs with each of NetworkSyncHosts on a thread of its own
+	static void StartSyncThread();
+
+	static bool IsSyncHost(CString ip);
+
+	static void BuildSummary(std::vector<CSyncBucket> &buckets);
+	static void LoadKeys(DWORD bucket, std::vector<CSyncKey> &keys);
+	static int FindClip(const CSyncKey &key);
+
+	static void PutBuckets(std::vector<unsigned char> &out, const CSyncBucket *pBuckets, size_t count);
+	static bool GetBuckets(const CNetworkFrameMessage &message, std::vector<CSyncBucket> &buckets);
+	static void PutKeys(std::vector<unsigned char> &out, const CSyncKey *pKeys, size_t count);
+	static bool GetKeys(const CNetworkFrameMessage &message, std::vector<CSyncKey> &keys);
+
+	//messages are collected in frame and sent once it's past ENCRYPTED_CHUNK_SIZE
+	static BOOL SendKeys(CSendSocket &send, CNetworkFrameWriter &frame, DWORD bucket, const std::vector<CSyncKey> &keys);
+	static BOOL SendIfFull(CSendSocket &send, CNetworkFrameWriter &frame);
+
+protected:
+	static uint64_t HashKey(DWORD date, DWORD crc);
+	static void CompareBucket(DWORD bucket, std::vector<CSyncKey> &remoteKeys, std::vector<int> &sendIds, std::vector<CSyncKey> &wanted, size_t maxClips);
+	static UINT SyncThread(LPVOID pParam);
+	static UINT SendClipsThread(LPVOID pParam);
+};
+
+class CHistorySyncSendInfo
+{
+public:
+	CString m_server;
+	std::vector<int> m_ids;
+};
+
+//The side that was asked to sync, one for each connection that sent SYNC with NETWORK_SYNC_MODE_SUMMARY
+class CHistorySyncReply
+{
+public:
+	bool AddSummary(const CNetworkFrameMessage &message);
+	BOOL SendDifferences(CSendSocket &send);
+	bool AddRequest(const CNetworkFrameMessage &message);
+	void SendRequested(CString server);
+
+protected:
+	std::map<DWORD, CSyncBucket> m_remoteBuckets;
+	std::vector<int> m_requestedIds;
+};
@@ -0,0 +1,581 @@
+#include "ImageResampler.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define RESAMPLE_SSE2
+#include <emmintrin.h>
+#endif
+
+//weights are 2.14 fixed point so two of them times a byte still fit the 32 bit sums from _mm_madd_epi16
+#define RESAMPLE_WEIGHT_BITS 14
+#define RESAMPLE_WEIGHT_ONE (1 << RESAMPLE_WEIGHT_BITS)
+
+//images smaller than this are scaled on the calling thread
+#define RESAMPLE_THREAD_MIN_PIXELS (1024 * 1024)
+#define RESAMPLE_MAX_THREADS 4
+
+//same as the windows values, this doesn't include windows.h
+#define RESAMPLE_BI_RGB 0
+#define RESAMPLE_BI_BITFIELDS 3
+#define RESAMPLE_INFO_HEADER_SIZE 40
+
+namespace
+{
+	const double Pi = 3.14159265358979323846;
+
+	double Sinc(double x)
+	{
+		if (x == 0.0)
+		{
+			return 1.0;
+		}
+
+		x *= Pi;
+		return sin(x) / x;
+	}
+
+	double Kernel(eResampleFilter filter, double x)
+	{
+		if (filter == RESAMPLE_BOX)
+		{
+			return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+		}
+
+		if (x <= -3.0 || x >= 3.0)
+		{
+			return 0.0;
+		}
+
+		return Sinc(x) * Sinc(x / 3.0);
+	}
+
+	uint32_t Read32(const uint8_t *p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	uint16_t Read16(const uint8_t *p)
+	{
+		return (uint16_t)(p[0] | (p[1] << 8));
+	}
+
+	void Write32(uint8_t *p, uint32_t value)
+	{
+		p[0] = (uint8_t)value;
+		p[1] = (uint8_t)(value >> 8);
+		p[2] = (uint8_t)(value >> 16);
+		p[3] = (uint8_t)(value >> 24);
+	}
+
+	//where a dib color mask starts and how many bits it has, so the channel can be read as a byte
+	class CMaskChannel
+	{
+	public:
+		CMaskChannel(uint32_t mask)
+		{
+			m_mask = mask;
+			m_shift = 0;
+			m_bits = 0;
+
+			if (mask != 0)
+			{
+				while ((mask & 1) == 0)
+				{
+					mask >>= 1;
+					m_shift++;
+				}
+				while ((mask & 1) != 0)
+				{
+					mask >>= 1;
+					m_bits++;
+				}
+			}
+		}
+
+		uint8_t Get(uint32_t pixel) const
+		{
+			if (m_bits == 0)
+			{
+				return 0;
+			}
+
+			uint32_t value = (pixel & m_mask) >> m_shift;
+			if (m_bits >= 8)
+			{
+				return (uint8_t)(value >> (m_bits - 8));
+			}
+
+			return (uint8_t)((value * 255) / ((1u << m_bits) - 1));
+		}
+
+		uint32_t m_mask;
+		int m_shift;
+		int m_bits;
+	};
+
+	uint8_t ClampByte(int32_t sum)
+	{
+		sum = (sum + (RESAMPLE_WEIGHT_ONE / 2)) >> RESAMPLE_WEIGHT_BITS;
+		if (sum < 0)
+		{
+			return 0;
+		}
+		if (sum > 255)
+		{
+			return 255;
+		}
+
+		return (uint8_t)sum;
+	}
+
+	//splits [0, rows) over up to RESAMPLE_MAX_THREADS threads, the calling thread does the first part
+	template <class Work>
+	void RunRows(int rows, size_t pixels, Work work)
+	{
+		int threadCount = 1;
+		if (pixels >= RESAMPLE_THREAD_MIN_PIXELS)
+		{
+			threadCount = (int)std::min<unsigned int>(std::thread::hardware_concurrency(), RESAMPLE_MAX_THREADS);
+			threadCount = std::max(1, std::min(threadCount, rows));
+		}
+
+		std::vector<std::thread> threads;
+		int rowsEach = (rows + threadCount - 1) / threadCount;
+
+		for (int i = 1; i < threadCount; i++)
+		{
+			int firstRow = i * rowsEach;
+			int endRow = std::min(rows, firstRow + rowsEach);
+			if (firstRow < endRow)
+			{
+				threads.push_back(std::thread(work, firstRow, endRow));
+			}
+		}
+
+		work(0, std::min(rows, rowsEach));
+
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+}
+
+//Each output pixel is centered on the source pixels it covers, when shrinking the kernel is stretched over all of them
+void CImageResampler::MakeWeights(int srcSize, int dstSize, eResampleFilter filter, CResampleWeights &weights)
+{
+	double scale = (double)dstSize / srcSize;
+	double filterScale = std::min(scale, 1.0);
+	double radius = (filter == RESAMPLE_BOX) ? 0.5 : 3.0;
+	double support = radius / filterScale;
+
+	int taps = std::min(srcSize, (int)ceil(support * 2.0) + 1);
+
+	weights.m_taps = taps;
+	weights.m_start.resize(dstSize);
+	weights.m_weights.resize((size_t)dstSize * taps);
+
+	std::vector<double> values(taps);
+
+	for (int i = 0; i < dstSize; i++)
+	{
+		double center = (i + 0.5) / scale;
+
+		int start = (int)floor(center - support);
+		start = std::max(0, std::min(start, srcSize - taps));
+
+		double total = 0.0;
+		for (int k = 0; k < taps; k++)
+		{
+			values[k] = Kernel(filter, (start + k + 0.5 - center) * filterScale);
+			total += values[k];
+		}
+
+		int16_t *pWeights = &weights.m_weights[(size_t)i * taps];
+
+		//past the edge of a small image nothing may be under the kernel, use the nearest pixel
+		if (total <= 0.0)
+		{
+			int nearest = std::max(0, std::min((int)center - start, taps - 1));
+			for (int k = 0; k < taps; k++)
+			{
+				pWeights[k] = (int16_t)(k == nearest ? RESAMPLE_WEIGHT_ONE : 0);
+			}
+		}
+		else
+		{
+			int sum = 0;
+			int largest = 0;
+			for (int k = 0; k < taps; k++)
+			{
+				pWeights[k] = (int16_t)floor(values[k] / total * RESAMPLE_WEIGHT_ONE + 0.5);
+				sum += pWeights[k];
+
+				if (pWeights[k] > pWeights[largest])
+				{
+					largest = k;
+				}
+			}
+
+			//rounding can leave the total a little off, a flat color has to stay the same color
+			pWeights[largest] = (int16_t)(pWeights[largest] + (RESAMPLE_WEIGHT_ONE - sum));
+		}
+
+		weights.m_start[i] = start;
+	}
+}
+
+//Scales each row in [firstRow, endRow) from srcWidth to dstWidth
+void CImageResampler::ResizeRows(const uint8_t *pSrc, int srcWidth, uint8_t *pDst, int dstWidth, const CResampleWeights &weights, int firstRow, int endRow)
+{
+	const int taps = weights.m_taps;
+
+	for (int y = firstRow; y < endRow; y++)
+	{
+		const uint8_t *pSrcRow = pSrc + (size_t)y * srcWidth * 4;
+		uint8_t *pDstRow = pDst + (size_t)y * dstWidth * 4;
+
+		for (int x = 0; x < dstWidth; x++)
+		{
+			const uint8_t *pPixel = pSrcRow + (size_t)weights.m_start[x] * 4;
+			const int16_t *pWeights = &weights.m_weights[(size_t)x * taps];
+
+#ifdef RESAMPLE_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			__m128i sum = _mm_setzero_si128();
+
+			int k = 0;
+			for (; k + 1 < taps; k += 2)
+			{
+				//two pixels as words, then b0 b1 g0 g1 r0 r1 a0 a1 so each pair of words is multiplied by the two weights
+				__m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pPixel + k * 4)), zero);
+				pixels = _mm_unpacklo_epi16(pixels, _mm_srli_si128(pixels, 8));
+
+				__m128i pair = _mm_set1_epi32((int)(((uint32_t)(uint16_t)pWeights[k + 1] << 16) | (uint16_t)pWeights[k]));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, pair));
+			}
+
+			if (k < taps)
+			{
+				__m128i pixels = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)Read32(pPixel + k * 4)), zero);
+				pixels = _mm_unpacklo_epi16(pixels, zero);
+
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, _mm_set1_epi32((uint16_t)pWeights[k])));
+			}
+
+			sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(RESAMPLE_WEIGHT_ONE / 2)), RESAMPLE_WEIGHT_BITS);
+			sum = _mm_packs_epi32(sum, sum);
+			sum = _mm_packus_epi16(sum, sum);
+
+			Write32(pDstRow + x * 4, (uint32_t)_mm_cvtsi128_si32(sum));
+#else
+			int32_t sum[4] = { 0, 0, 0, 0 };
+			for (int k = 0; k < taps; k++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					sum[c] += pPixel[k * 4 + c] * pWeights[k];
+				}
+			}
+
+			for (int c = 0; c < 4; c++)
+			{
+				pDstRow[x * 4 + c] = ClampByte(sum[c]);
+			}
+#endif
+		}
+	}
+}
+
+//Makes each output row in [firstRow, endRow) from the source rows under it, the width is already the output width
+void CImageResampler::ResizeColumns(const uint8_t *pSrc, int width, uint8_t *pDst, const CResampleWeights &weights, int firstRow, int endRow)
+{
+	const int taps = weights.m_taps;
+	const size_t rowBytes = (size_t)width * 4;
+
+	for (int y = firstRow; y < endRow; y++)
+	{
+		const uint8_t *pFirst = pSrc + (size_t)weights.m_start[y] * rowBytes;
+		const int16_t *pWeights = &weights.m_weights[(size_t)y * taps];
+		uint8_t *pDstRow = pDst + (size_t)y * rowBytes;
+
+		size_t i = 0;
+
+#ifdef RESAMPLE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+
+		//4 pixels at a time, each sum is one channel of one pixel
+		for (; i + 16 <= rowBytes; i += 16)
+		{
+			__m128i sum0 = _mm_setzero_si128();
+			__m128i sum1 = _mm_setzero_si128();
+			__m128i sum2 = _mm_setzero_si128();
+			__m128i sum3 = _mm_setzero_si128();
+
+			for (int k = 0; k < taps; k += 2)
+			{
+				__m128i row0 = _mm_loadu_si128((const __m128i *)(pFirst + k * rowBytes + i));
+				__m128i row1 = zero;
+				uint16_t weight1 = 0;
+				if (k + 1 < taps)
+				{
+					row1 = _mm_loadu_si128((const __m128i *)(pFirst + (k + 1) * rowBytes + i));
+					weight1 = (uint16_t)pWeights[k + 1];
+				}
+
+				__m128i pair = _mm_set1_epi32((int)(((uint32_t)weight1 << 16) | (uint16_t)pWeights[k]));
+
+				__m128i low0 = _mm_unpacklo_epi8(row0, zero);
+				__m128i low1 = _mm_unpacklo_epi8(row1, zero);
+				__m128i high0 = _mm_unpackhi_epi8(row0, zero);
+				__m128i high1 = _mm_unpackhi_epi8(row1, zero);
+
+				sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi16(low0, low1), pair));
+				sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi16(low0, low1), pair));
+				sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_unpacklo_epi16(high0, high1), pair));
+				sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_unpackhi_epi16(high0, high1), pair));
+			}
+
+			const __m128i round = _mm_set1_epi32(RESAMPLE_WEIGHT_ONE / 2);
+			sum0 = _mm_srai_epi32(_mm_add_epi32(sum0, round), RESAMPLE_WEIGHT_BITS);
+			sum1 = _mm_srai_epi32(_mm_add_epi32(sum1, round), RESAMPLE_WEIGHT_BITS);
+			sum2 = _mm_srai_epi32(_mm_add_epi32(sum2, round), RESAMPLE_WEIGHT_BITS);
+			sum3 = _mm_srai_epi32(_mm_add_epi32(sum3, round), RESAMPLE_WEIGHT_BITS);
+
+			__m128i packed = _mm_packus_epi16(_mm_packs_epi32(sum0, sum1), _mm_packs_epi32(sum2, sum3));
+			_mm_storeu_si128((__m128i *)(pDstRow + i), packed);
+		}
+#endif
+
+		for (; i < rowBytes; i++)
+		{
+			int32_t sum = 0;
+			for (int k = 0; k < taps; k++)
+			{
+				sum += pFirst[k * rowBytes + i] * pWeights[k];
+			}
+
+			pDstRow[i] = ClampByte(sum);
+		}
+	}
+}
+
+bool CImageResampler::Resize(const uint8_t *pSrc, int srcWidth, int srcHeight, uint8_t *pDst, int dstWidth, int dstHeight, eResampleFilter filter)
+{
+	if (pSrc == NULL || pDst == NULL ||
+		srcWidth <= 0 || srcHeight <= 0 ||
+		dstWidth <= 0 || dstHeight <= 0)
+	{
+		return false;
+	}
+
+	if (srcWidth == dstWidth && srcHeight == dstHeight)
+	{
+		memcpy(pDst, pSrc, (size_t)srcWidth * srcHeight * 4);
+		return true;
+	}
+
+	CResampleWeights columnWeights;
+	CResampleWeights rowWeights;
+	MakeWeights(srcWidth, dstWidth, filter, columnWeights);
+	MakeWeights(srcHeight, dstHeight, filter, rowWeights);
+
+	//rows are narrowed first, every source row is read once and the second pass only reads the narrow rows
+	std::vector<uint8_t> narrow((size_t)dstWidth * srcHeight * 4);
+	uint8_t *pNarrow = &narrow[0];
+
+	RunRows(srcHeight, (size_t)srcWidth * srcHeight,
+		[=, &columnWeights](int firstRow, int endRow) { ResizeRows(pSrc, srcWidth, pNarrow, dstWidth, columnWeights, firstRow, endRow); });
+
+	RunRows(dstHeight, (size_t)dstWidth * srcHeight,
+		[=, &rowWeights](int firstRow, int endRow) { ResizeColumns(pNarrow, dstWidth, pDst, rowWeights, firstRow, endRow); });
+
+	return true;
+}
+
+//Reads the uncompressed formats and bit fields, anything else (rle, jpeg or png in a dib) returns false
+bool CImageResampler::DecodeDib(const uint8_t *pDib, size_t length, std::vector<uint8_t> &pixels, int &width, int &height)
+{
+	if (pDib == NULL ||
+		length < RESAMPLE_INFO_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	uint32_t headerSize = Read32(pDib);
+	if (headerSize < RESAMPLE_INFO_HEADER_SIZE ||
+		headerSize > length)
+	{
+		return false;
+	}
+
+	int32_t dibWidth = (int32_t)Read32(pDib + 4);
+	int32_t dibHeight = (int32_t)Read32(pDib + 8);
+	int bitCount = Read16(pDib + 14);
+	uint32_t compression = Read32(pDib + 16);
+	uint32_t colorsUsed = Read32(pDib + 32);
+
+	bool bottomUp = dibHeight > 0;
+	if (dibHeight < 0)
+	{
+		dibHeight = -dibHeight;
+	}
+
+	//dibHeight of INT_MIN is still negative
+	if (dibWidth <= 0 || dibHeight <= 0 ||
+		(uint64_t)dibWidth * dibHeight > (1 << 28))
+	{
+		return false;
+	}
+
+	size_t offset = headerSize;
+
+	uint32_t masks[3] = { 0, 0, 0 };
+	if (compression == RESAMPLE_BI_BITFIELDS &&
+		(bitCount == 16 || bitCount == 32))
+	{
+		//the masks follow a BITMAPINFOHEADER, the larger headers have them inside
+		const uint8_t *pMasks = pDib + RESAMPLE_INFO_HEADER_SIZE;
+		if (headerSize == RESAMPLE_INFO_HEADER_SIZE)
+		{
+			offset += 12;
+		}
+		if (offset > length)
+		{
+			return false;
+		}
+
+		masks[0] = Read32(pMasks);
+		masks[1] = Read32(pMasks + 4);
+		masks[2] = Read32(pMasks + 8);
+	}
+	else if (compression == RESAMPLE_BI_RGB)
+	{
+		if (bitCount == 16)
+		{
+			masks[0] = 0x7C00;
+			masks[1] = 0x03E0;
+			masks[2] = 0x001F;
+		}
+		else if (bitCount == 32)
+		{
+			masks[0] = 0x00FF0000;
+			masks[1] = 0x0000FF00;
+			masks[2] = 0x000000FF;
+		}
+		else if (bitCount != 1 && bitCount != 4 && bitCount != 8 && bitCount != 24)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	uint32_t colors = colorsUsed;
+	if (bitCount <= 8)
+	{
+		if (colors == 0 || colors > (1u << bitCount))
+		{
+			colors = 1u << bitCount;
+		}
+	}
+
+	const uint8_t *pColors = pDib + offset;
+	if ((uint64_t)colors * 4 > length - offset)
+	{
+		return false;
+	}
+	offset += (size_t)colors * 4;
+
+	size_t stride = (((size_t)dibWidth * bitCount + 31) / 32) * 4;
+	if ((uint64_t)stride * dibHeight > length - offset)
+	{
+		return false;
+	}
+
+	width = dibWidth;
+	height = dibHeight;
+	pixels.resize((size_t)width * height * 4);
+
+	CMaskChannel red(masks[0]);
+	CMaskChannel green(masks[1]);
+	CMaskChannel blue(masks[2]);
+	bool standard32 = bitCount == 32 && masks[0] == 0x00FF0000 && masks[1] == 0x0000FF00 && masks[2] == 0x000000FF;
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t *pRow = pDib + offset + stride * (bottomUp ? (height - 1 - y) : y);
+		uint8_t *pOut = &pixels[(size_t)y * width * 4];
+
+		if (standard32)
+		{
+			memcpy(pOut, pRow, (size_t)width * 4);
+			for (int x = 0; x < width; x++)
+			{
+				pOut[x * 4 + 3] = 255;
+			}
+			continue;
+		}
+
+		for (int x = 0; x < width; x++, pOut += 4)
+		{
+			if (bitCount <= 8)
+			{
+				int bitPos = x * bitCount;
+				int index = (pRow[bitPos / 8] >> (8 - bitCount - (bitPos % 8))) & ((1 << bitCount) - 1);
+				if ((uint32_t)index >= colors)
+				{
+					index = 0;
+				}
+
+				memcpy(pOut, pColors + index * 4, 3);
+			}
+			else if (bitCount == 24)
+			{
+				memcpy(pOut, pRow + x * 3, 3);
+			}
+			else
+			{
+				uint32_t pixel = (bitCount == 16) ? Read16(pRow + x * 2) : Read32(pRow + x * 4);
+				pOut[0] = blue.Get(pixel);
+				pOut[1] = green.Get(pixel);
+				pOut[2] = red.Get(pixel);
+			}
+
+			pOut[3] = 255;
+		}
+	}
+
+	return true;
+}
+
+size_t CImageResampler::DibSize(int width, int height)
+{
+	return RESAMPLE_INFO_HEADER_SIZE + (size_t)width * height * 4;
+}
+
+void CImageResampler::WriteDib(const uint8_t *pPixels, int width, int height, uint8_t *pDib)
+{
+	memset(pDib, 0, RESAMPLE_INFO_HEADER_SIZE);
+
+	Write32(pDib, RESAMPLE_INFO_HEADER_SIZE);
+	Write32(pDib + 4, (uint32_t)width);
+	Write32(pDib + 8, (uint32_t)height);
+	pDib[12] = 1;
+	pDib[14] = 32;
+	Write32(pDib + 16, RESAMPLE_BI_RGB);
+	Write32(pDib + 20, (uint32_t)((size_t)width * height * 4));
+
+	size_t rowBytes = (size_t)width * 4;
+	uint8_t *pBits = pDib + RESAMPLE_INFO_HEADER_SIZE;
+
+	for (int y = 0; y < height; y++)
+	{
+		memcpy(pBits + (size_t)(height - 1 - y) * rowBytes, pPixels + (size_t)y * rowBytes, rowBytes);
+	}
+}
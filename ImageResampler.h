@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//Decodes dibs and scales images for the list thumbnails without gdi. Kept free of windows and mfc so it can be built on its own.
+//
+//Pixels are 4 bytes each in b, g, r, a order with the top row first and no padding between rows. Scaling is done
+//one direction at a time with fixed point weights, using sse2 when it's there. Large images are split over a few threads.
+
+enum eResampleFilter
+{
+	RESAMPLE_BOX,
+	RESAMPLE_LANCZOS3
+};
+
+class CImageResampler
+{
+public:
+	static bool Resize(const uint8_t *pSrc, int srcWidth, int srcHeight, uint8_t *pDst, int dstWidth, int dstHeight, eResampleFilter filter);
+
+	//a packed dib, the header, masks, colors then bits as it is on the clipboard. Alpha is set to 255, the same as gdi+ reads them
+	static bool DecodeDib(const uint8_t *pDib, size_t length, std::vector<uint8_t> &pixels, int &width, int &height);
+
+	//a 32 bit bottom up dib with a BITMAPINFOHEADER, the same layout CBitmapHelper::hBitmapToDIB makes
+	static size_t DibSize(int width, int height);
+	static void WriteDib(const uint8_t *pPixels, int width, int height, uint8_t *pDib);
+
+protected:
+	class CResampleWeights
+	{
+	public:
+		int m_taps;
+		std::vector<int> m_start;
+		//m_taps weights for each output pixel, they add up to RESAMPLE_WEIGHT_ONE
+		std::vector<int16_t> m_weights;
+	};
+
+	static void MakeWeights(int srcSize, int dstSize, eResampleFilter filter, CResampleWeights &weights);
+	static void ResizeRows(const uint8_t *pSrc, int srcWidth, uint8_t *pDst, int dstWidth, const CResampleWeights &weights, int firstRow, int endRow);
+	static void ResizeColumns(const uint8_t *pSrc, int width, uint8_t *pDst, const CResampleWeights &weights, int firstRow, int endRow);
+};
@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "ListRows.h"
+#include <algorithm>
+
+CListRows::CListRows()
+{
+	m_descUnused = 0;
+}
+
+void CListRows::Clear()
+{
+	m_ids.clear();
+	m_flags.clear();
+	m_clipOrder.clear();
+	m_clipGroupOrder.clear();
+	m_stickyClipOrder.clear();
+	m_stickyClipGroupOrder.clear();
+	m_dateCopied.clear();
+	m_datePasted.clear();
+	m_descStart.clear();
+	m_descLength.clear();
+	m_descText.clear();
+	m_descUnused = 0;
+}
+
+void CListRows::Set(int row, const CMainTable &table)
+{
+	if (row < 0)
+	{
+		return;
+	}
+
+	if (row >= GetCount())
+	{
+		size_t count = row + 1;
+		m_ids.resize(count, -1);
+		m_flags.resize(count, 0);
+		m_clipOrder.resize(count, 0);
+		m_clipGroupOrder.resize(count, 0);
+		m_stickyClipOrder.resize(count, 0);
+		m_stickyClipGroupOrder.resize(count, 0);
+		m_dateCopied.resize(count, 0);
+		m_datePasted.resize(count, 0);
+		m_descStart.resize(count, 0);
+		m_descLength.resize(count, 0);
+	}
+
+	BYTE flags = 0;
+	if (table.m_bDontAutoDelete)
+		flags |= LIST_ROW_DONT_AUTO_DELETE;
+	if (table.m_bIsGroup)
+		flags |= LIST_ROW_IS_GROUP;
+	if (table.m_bHasShortCut)
+		flags |= LIST_ROW_HAS_SHORTCUT;
+	if (table.m_bHasParent)
+		flags |= LIST_ROW_HAS_PARENT;
+	if (table.m_QuickPaste.IsEmpty() == FALSE)
+		flags |= LIST_ROW_HAS_QUICK_PASTE;
+
+	m_ids[row] = table.m_lID;
+	m_flags[row] = flags;
+	m_clipOrder[row] = table.m_clipOrder;
+	m_clipGroupOrder[row] = table.m_clipGroupOrder;
+	m_stickyClipOrder[row] = table.m_stickyClipOrder;
+	m_stickyClipGroupOrder[row] = table.m_stickyClipGroupOrder;
+	m_dateCopied[row] = table.m_dateCopied;
+	m_datePasted[row] = table.m_datePasted;
+
+	SetDescription(row, table.m_Desc);
+}
+
+void CListRows::Erase(int row)
+{
+	if (row < 0 || row >= GetCount())
+	{
+		return;
+	}
+
+	m_descUnused += m_descLength[row];
+
+	m_ids.erase(m_ids.begin() + row);
+	m_flags.erase(m_flags.begin() + row);
+	m_clipOrder.erase(m_clipOrder.begin() + row);
+	m_clipGroupOrder.erase(m_clipGroupOrder.begin() + row);
+	m_stickyClipOrder.erase(m_stickyClipOrder.begin() + row);
+	m_stickyClipGroupOrder.erase(m_stickyClipGroupOrder.begin() + row);
+	m_dateCopied.erase(m_dateCopied.begin() + row);
+	m_datePasted.erase(m_datePasted.begin() + row);
+	m_descStart.erase(m_descStart.begin() + row);
+	m_descLength.erase(m_descLength.begin() + row);
+}
+
+int CListRows::Find(int id) const
+{
+	std::vector<int>::const_iterator iter = std::find(m_ids.begin(), m_ids.end(), id);
+	if (iter == m_ids.end())
+	{
+		return -1;
+	}
+
+	return (int)(iter - m_ids.begin());
+}
+
+//Sorts the row numbers then moves each column into that order once
+void CListRows::Sort(bool group)
+{
+	std::vector<int> order(m_ids.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = (int)i;
+	}
+
+	const std::vector<double> &sticky = group ? m_stickyClipGroupOrder : m_stickyClipOrder;
+	const std::vector<double> &clipOrder = group ? m_clipGroupOrder : m_clipOrder;
+	const std::vector<BYTE> &flags = m_flags;
+
+	std::stable_sort(order.begin(), order.end(), [&](int row1, int row2)
+	{
+		if (sticky[row1] != sticky[row2])
+			return sticky[row1] > sticky[row2];
+
+		bool isGroup1 = (flags[row1] & LIST_ROW_IS_GROUP) != 0;
+		bool isGroup2 = (flags[row2] & LIST_ROW_IS_GROUP) != 0;
+		if (isGroup1 != isGroup2)
+			return isGroup1 < isGroup2;
+
+		return clipOrder[row1] > clipOrder[row2];
+	});
+
+	Reorder(m_ids, order);
+	Reorder(m_flags, order);
+	Reorder(m_clipOrder, order);
+	Reorder(m_clipGroupOrder, order);
+	Reorder(m_stickyClipOrder, order);
+	Reorder(m_stickyClipGroupOrder, order);
+	Reorder(m_dateCopied, order);
+	Reorder(m_datePasted, order);
+	Reorder(m_descStart, order);
+	Reorder(m_descLength, order);
+}
+
+void CListRows::SetFlag(int row, BYTE flag, bool set)
+{
+	if (set)
+	{
+		m_flags[row] |= flag;
+	}
+	else
+	{
+		m_flags[row] &= ~flag;
+	}
+}
+
+void CListRows::SetOrders(int row, double clipOrder, double clipGroupOrder)
+{
+	m_clipOrder[row] = clipOrder;
+	m_clipGroupOrder[row] = clipGroupOrder;
+}
+
+void CListRows::SetStickyOrders(int row, double stickyClipOrder, double stickyClipGroupOrder)
+{
+	m_stickyClipOrder[row] = stickyClipOrder;
+	m_stickyClipGroupOrder[row] = stickyClipGroupOrder;
+}
+
+CString CListRows::GetDescription(int row) const
+{
+	if (m_descLength[row] == 0)
+	{
+		return _T("");
+	}
+
+	return CString(&m_descText[m_descStart[row]], m_descLength[row]);
+}
+
+size_t CListRows::GetBytes() const
+{
+	return m_ids.capacity() * sizeof(int) +
+		m_flags.capacity() * sizeof(BYTE) +
+		(m_clipOrder.capacity() + m_clipGroupOrder.capacity() + m_stickyClipOrder.capacity() + m_stickyClipGroupOrder.capacity()) * sizeof(double) +
+		(m_dateCopied.capacity() + m_datePasted.capacity()) * sizeof(int) +
+		m_descStart.capacity() * sizeof(UINT) +
+		m_descLength.capacity() * sizeof(WORD) +
+		m_descText.capacity() * sizeof(TCHAR);
+}
+
+//The old text of the row is left in the buffer, it's removed once more than half the buffer is unused
+void CListRows::SetDescription(int row, const CString &desc)
+{
+	m_descUnused += m_descLength[row];
+
+	int length = min(desc.GetLength(), LIST_ROW_DESC_PREFIX);
+
+	m_descStart[row] = (UINT)m_descText.size();
+	m_descLength[row] = (WORD)length;
+	m_descText.insert(m_descText.end(), (LPCTSTR)desc, (LPCTSTR)desc + length);
+
+	if (m_descUnused > 4096 &&
+		m_descUnused > m_descText.size() / 2)
+	{
+		CompactDescriptions();
+	}
+}
+
+void CListRows::CompactDescriptions()
+{
+	std::vector<TCHAR> text;
+	text.reserve(m_descText.size() - m_descUnused);
+
+	for (size_t row = 0; row < m_descStart.size(); row++)
+	{
+		UINT start = (UINT)text.size();
+		if (m_descLength[row] > 0)
+		{
+			text.insert(text.end(), m_descText.begin() + m_descStart[row], m_descText.begin() + m_descStart[row] + m_descLength[row]);
+		}
+		m_descStart[row] = start;
+	}
+
+	m_descText.swap(text);
+	m_descUnused = 0;
+}
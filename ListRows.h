@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+
+//One row of the quick paste list as it's read from Main, the list keeps them in a CListRows
+class CMainTable
+{
+public:
+    CMainTable():
+		m_lID( - 1),
+		m_bDontAutoDelete(false),
+		m_bIsGroup(false),
+		m_bHasShortCut(false),
+		m_bHasParent(false),
+		m_clipOrder(0),
+		m_clipGroupOrder(0),
+		m_stickyClipOrder(0),
+		m_stickyClipGroupOrder(0),
+		m_dateCopied(0),
+		m_datePasted(0)
+	{
+
+	}
+
+    long m_lID;
+    CString m_Desc;
+    bool m_bDontAutoDelete;
+    bool m_bIsGroup;
+    bool m_bHasShortCut;
+    bool m_bHasParent;
+    CString m_QuickPaste;
+	double m_clipOrder;
+	double m_clipGroupOrder;
+	double m_stickyClipOrder;
+	double m_stickyClipGroupOrder;
+	int m_dateCopied;
+	int m_datePasted;
+};
+
+#define LIST_ROW_DONT_AUTO_DELETE	0x01
+#define LIST_ROW_IS_GROUP			0x02
+#define LIST_ROW_HAS_SHORTCUT		0x04
+#define LIST_ROW_HAS_PARENT			0x08
+#define LIST_ROW_HAS_QUICK_PASTE	0x10
+
+//characters of the description kept for a row, more than the list shows at the default description size.
+//The full text is read from Main when it's needed
+#define LIST_ROW_DESC_PREFIX 1024
+
+//The rows of the quick paste list stored a column at a time. Ids, flags, orders and dates are fixed width and the
+//descriptions are prefixes kept end to end in one buffer, so a list of a million clips is a handful of allocations
+//instead of two strings a row. Not locked, callers hold CQPasteWnd::m_CritSection
+class CListRows
+{
+public:
+	CListRows();
+
+	int GetCount() const { return (int)m_ids.size(); }
+	void Clear();
+
+	//rows past the end are added, any gap before row is filled with empty rows that have an id of -1
+	void Set(int row, const CMainTable &table);
+	void Erase(int row);
+
+	//the row with id, -1 if it isn't loaded
+	int Find(int id) const;
+
+	//sticky clips first, then clips before groups, then by order. Group orders are used when showing a group
+	void Sort(bool group);
+
+	int GetId(int row) const { return m_ids[row]; }
+
+	bool HasFlag(int row, BYTE flag) const { return (m_flags[row] & flag) != 0; }
+	void SetFlag(int row, BYTE flag, bool set);
+
+	double GetClipOrder(int row) const { return m_clipOrder[row]; }
+	double GetClipGroupOrder(int row) const { return m_clipGroupOrder[row]; }
+	double GetStickyClipOrder(int row) const { return m_stickyClipOrder[row]; }
+	double GetStickyClipGroupOrder(int row) const { return m_stickyClipGroupOrder[row]; }
+	void SetOrders(int row, double clipOrder, double clipGroupOrder);
+	void SetStickyOrders(int row, double stickyClipOrder, double stickyClipGroupOrder);
+
+	int GetDateCopied(int row) const { return m_dateCopied[row]; }
+	int GetDatePasted(int row) const { return m_datePasted[row]; }
+	void SetDatePasted(int row, int date) { m_datePasted[row] = date; }
+
+	//at most LIST_ROW_DESC_PREFIX characters
+	CString GetDescription(int row) const;
+
+	size_t GetBytes() const;
+
+protected:
+	void SetDescription(int row, const CString &desc);
+	void CompactDescriptions();
+
+	template <class T>
+	static void Reorder(std::vector<T> &column, const std::vector<int> &order)
+	{
+		std::vector<T> sorted(column.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			sorted[i] = column[order[i]];
+		}
+		column.swap(sorted);
+	}
+
+	std::vector<int> m_ids;
+	std::vector<BYTE> m_flags;
+	std::vector<double> m_clipOrder;
+	std::vector<double> m_clipGroupOrder;
+	std::vector<double> m_stickyClipOrder;
+	std::vector<double> m_stickyClipGroupOrder;
+	std::vector<int> m_dateCopied;
+	std::vector<int> m_datePasted;
+
+	std::vector<UINT> m_descStart;
+	std::vector<WORD> m_descLength;
+	std::vector<TCHAR> m_descText;
+	//characters in m_descText no row points to, left by rows that were replaced or erased
+	size_t m_descUnused;
+};
@@ -18,6 +18,7 @@
 #include "OptionsSheet.h"
 #include "DeleteClipData.h"
 #include "DatabaseUtilities.h"
+#include "HistorySync.h"
 
 #ifdef _DEBUG
     #define new DEBUG_NEW
@@ -175,6 +176,11 @@ int CMainFrame::OnCreate(LPCREATESTRUCT lpCreateStruct)
     SetTimer(REMOVE_OLD_ENTRIES_TIMER, ONE_MINUTE*15, 0);
 	SetTimer(CLOSE_NO_DB_WINDOW_TIMER, 10000, 0);
 
+	if(CGetSetOptions::GetNetworkSyncHosts() != _T(""))
+	{
+		SetTimer(SYNC_HISTORY_TIMER, max(1, CGetSetOptions::GetNetworkSyncIntervalMinutes()) * ONE_MINUTE, 0);
+	}
+
 	//found on some computers GetTickCount gettickcount returns a smaller value than other, can't explain
 	//check here to see if we need to make an adjustment
 	IdleSeconds();
@@ -838,6 +844,10 @@ void CMainFrame::OnTimer(UINT_PTR nIDEvent)
 			theApp.CloseNoDbWindow();
 			break;
 
+		case SYNC_HISTORY_TIMER:
+			CHistorySync::StartSyncThread();
+			break;
+
     }
 
     CFrameWnd::OnTimer(nIDEvent);
@@ -19,6 +19,8 @@
 
 #define REMOTE_CLIP_ADD_TO_CLIPBOARD 0x1
 #define REMOTE_CLIP_MANUAL_SEND 0x2
+//from a history sync, the clip keeps the date and crc it has on the other side
+#define REMOTE_CLIP_SYNC 0x4
 
 
 //Handle foreign keyboards pressing ALT_GR (right alt), this simulates a control press
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "NetworkCompress.h"
+#include "Options.h"
+#include "Misc.h"
+#include "zlib/zlib.h"
+
+//Formats that hold data that's already compressed, zlib would only spend time on them
+bool CNetworkCompress::IsCompressedFormat(const CString &formatName)
+{
+	static const TCHAR *compressedFormats[] = { _T("PNG"), _T("JFIF"), _T("JPEG"), _T("JPG"), _T("GIF"), _T("WEBP"), _T("ZIP"), _T("GZIP") };
+
+	CString name = formatName;
+	name.MakeUpper();
+
+	for(int i = 0; i < _countof(compressedFormats); i++)
+	{
+		if(name.Find(compressedFormats[i]) >= 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool CNetworkCompress::IsCompressedFile(const CString &fileName)
+{
+	static const TCHAR *compressedExtensions[] = { _T(".png"), _T(".jpg"), _T(".jpeg"), _T(".gif"), _T(".webp"), _T(".zip"), _T(".7z"), _T(".rar"), _T(".gz"), _T(".bz2"), _T(".xz"),
+		_T(".mp3"), _T(".mp4"), _T(".mkv"), _T(".avi"), _T(".mov"), _T(".docx"), _T(".xlsx"), _T(".pptx"), _T(".pdf"), _T(".msi"), _T(".cab") };
+
+	int dot = fileName.ReverseFind('.');
+	if(dot < 0)
+	{
+		return false;
+	}
+
+	CString extension = fileName.Mid(dot);
+
+	for(int i = 0; i < _countof(compressedExtensions); i++)
+	{
+		if(extension.CompareNoCase(compressedExtensions[i]) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//Returns false if zlib didn't save at least 1/8 of the size, the data is sent as is then
+bool CNetworkCompress::Compress(const BYTE *pData, int length, std::vector<BYTE> &compressed)
+{
+	uLongf compressedSize = compressBound((uLong)length);
+	compressed.resize(compressedSize);
+
+	int ret = compress2(compressed.data(), &compressedSize, pData, (uLong)length, CGetSetOptions::GetNetworkCompressionLevel());
+	if(ret != Z_OK)
+	{
+		LogSendRecieveInfo(StrF(_T("Error compressing network data, zlib: %d, size: %d"), ret, length));
+		return false;
+	}
+
+	if(compressedSize >= (uLongf)(length - length / 8))
+	{
+		return false;
+	}
+
+	compressed.resize(compressedSize);
+
+	return true;
+}
+
+//pDest has to be exactly the uncompressed size, anything else is treated as bad data
+bool CNetworkCompress::Uncompress(const BYTE *pData, int length, BYTE *pDest, int destLength)
+{
+	uLongf uncompressedSize = (uLongf)destLength;
+	int ret = uncompress(pDest, &uncompressedSize, pData, (uLong)length);
+	if(ret != Z_OK || uncompressedSize != (uLongf)destLength)
+	{
+		LogSendRecieveInfo(StrF(_T("Error uncompressing network data, zlib: %d, size: %d, expected: %d"), ret, (int)uncompressedSize, destLength));
+		return false;
+	}
+
+	return true;
+}
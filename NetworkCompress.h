@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+
+//zlib compression of clip data and files before they're encrypted and sent, only used with servers and clients
+//that said they support NETWORK_FEATURE_COMPRESSION
+class CNetworkCompress
+{
+public:
+	static bool IsCompressedFormat(const CString &formatName);
+	static bool IsCompressedFile(const CString &fileName);
+
+	static bool Compress(const BYTE *pData, int length, std::vector<BYTE> &compressed);
+	static bool Uncompress(const BYTE *pData, int length, BYTE *pDest, int destLength);
+};
@@ -0,0 +1,238 @@
+#include "NetworkFrame.h"
+#include <string.h>
+
+CNetworkFrameWriter::CNetworkFrameWriter()
+{
+	Clear();
+}
+
+void CNetworkFrameWriter::Clear()
+{
+	m_frame.clear();
+	m_message.clear();
+	m_messageType = 0;
+	m_messageCount = 0;
+
+	PutVarint(m_frame, NETWORK_FRAME_FORMAT);
+}
+
+void CNetworkFrameWriter::PutVarint(std::vector<unsigned char> &out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back((unsigned char)value);
+}
+
+void CNetworkFrameWriter::BeginMessage(unsigned int type)
+{
+	m_messageType = type;
+	m_message.clear();
+}
+
+void CNetworkFrameWriter::AddUInt(unsigned int tag, uint64_t value)
+{
+	std::vector<unsigned char> encoded;
+	PutVarint(encoded, value);
+
+	AddBytes(tag, &encoded[0], encoded.size());
+}
+
+void CNetworkFrameWriter::AddString(unsigned int tag, const std::string &value)
+{
+	AddBytes(tag, value.data(), value.size());
+}
+
+void CNetworkFrameWriter::AddBytes(unsigned int tag, const void *pData, size_t length)
+{
+	PutVarint(m_message, tag);
+	PutVarint(m_message, length);
+
+	if (length > 0)
+	{
+		const unsigned char *pBytes = (const unsigned char *)pData;
+		m_message.insert(m_message.end(), pBytes, pBytes + length);
+	}
+}
+
+void CNetworkFrameWriter::EndMessage()
+{
+	PutVarint(m_frame, m_messageType);
+	PutVarint(m_frame, m_message.size());
+	m_frame.insert(m_frame.end(), m_message.begin(), m_message.end());
+
+	m_message.clear();
+	m_messageCount++;
+}
+
+//Anything that doesn't fit in the bytes left or runs past 64 bits is a failure
+bool CNetworkFrameReader::GetVarint(const unsigned char *&pData, const unsigned char *pEnd, uint64_t &value)
+{
+	value = 0;
+
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (pData >= pEnd)
+		{
+			return false;
+		}
+
+		unsigned char byte = *pData++;
+
+		//the tenth byte only has room for the top bit
+		if (shift == 63 && byte > 1)
+		{
+			return false;
+		}
+
+		value |= (uint64_t)(byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+CNetworkFrameReader::CNetworkFrameReader(const unsigned char *pData, size_t length)
+{
+	m_pData = pData;
+	m_pEnd = pData + length;
+	m_failed = false;
+
+	uint64_t format = 0;
+	if (pData == NULL ||
+		GetVarint(m_pData, m_pEnd, format) == false ||
+		format != NETWORK_FRAME_FORMAT)
+	{
+		m_failed = true;
+	}
+}
+
+bool CNetworkFrameReader::Next(CNetworkFrameMessage &message)
+{
+	if (m_failed || m_pData >= m_pEnd)
+	{
+		return false;
+	}
+
+	uint64_t type = 0;
+	uint64_t length = 0;
+	if (GetVarint(m_pData, m_pEnd, type) == false ||
+		GetVarint(m_pData, m_pEnd, length) == false ||
+		type > 0xFFFFFFFF ||
+		length > (uint64_t)(m_pEnd - m_pData))
+	{
+		m_failed = true;
+		return false;
+	}
+
+	message.m_type = (unsigned int)type;
+	message.m_pPayload = m_pData;
+	message.m_payloadLength = (size_t)length;
+
+	if (message.IsValid() == false)
+	{
+		m_failed = true;
+		return false;
+	}
+
+	m_pData += length;
+
+	return true;
+}
+
+CNetworkFrameMessage::CNetworkFrameMessage()
+{
+	m_type = 0;
+	m_pPayload = NULL;
+	m_payloadLength = 0;
+}
+
+//Every field's length fits in the payload
+bool CNetworkFrameMessage::IsValid() const
+{
+	const unsigned char *pData = m_pPayload;
+	const unsigned char *pEnd = m_pPayload + m_payloadLength;
+
+	while (pData < pEnd)
+	{
+		uint64_t tag = 0;
+		uint64_t length = 0;
+		if (CNetworkFrameReader::GetVarint(pData, pEnd, tag) == false ||
+			CNetworkFrameReader::GetVarint(pData, pEnd, length) == false ||
+			length > (uint64_t)(pEnd - pData))
+		{
+			return false;
+		}
+
+		pData += length;
+	}
+
+	return true;
+}
+
+bool CNetworkFrameMessage::FindField(unsigned int tag, const unsigned char *&pValue, size_t &length) const
+{
+	const unsigned char *pData = m_pPayload;
+	const unsigned char *pEnd = m_pPayload + m_payloadLength;
+
+	while (pData < pEnd)
+	{
+		uint64_t fieldTag = 0;
+		uint64_t fieldLength = 0;
+		if (CNetworkFrameReader::GetVarint(pData, pEnd, fieldTag) == false ||
+			CNetworkFrameReader::GetVarint(pData, pEnd, fieldLength) == false ||
+			fieldLength > (uint64_t)(pEnd - pData))
+		{
+			return false;
+		}
+
+		if (fieldTag == tag)
+		{
+			pValue = pData;
+			length = (size_t)fieldLength;
+			return true;
+		}
+
+		pData += fieldLength;
+	}
+
+	return false;
+}
+
+bool CNetworkFrameMessage::GetUInt(unsigned int tag, uint64_t &value) const
+{
+	const unsigned char *pData = NULL;
+	size_t length = 0;
+	if (FindField(tag, pData, length) == false)
+	{
+		return false;
+	}
+
+	const unsigned char *pEnd = pData + length;
+	return CNetworkFrameReader::GetVarint(pData, pEnd, value) && pData == pEnd;
+}
+
+bool CNetworkFrameMessage::GetString(unsigned int tag, std::string &value) const
+{
+	const unsigned char *pData = NULL;
+	size_t length = 0;
+	if (FindField(tag, pData, length) == false)
+	{
+		return false;
+	}
+
+	value.assign((const char *)pData, length);
+	return true;
+}
+
+bool CNetworkFrameMessage::GetBytes(unsigned int tag, const unsigned char *&pData, size_t &length) const
+{
+	return FindField(tag, pData, length);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//Encoding for the framed network messages, kept free of windows and mfc so it can be built on its own.
+//
+//A frame is the frame format version as a varint followed by messages, each message is its type and payload length
+//as varints then the payload. A payload is a list of fields, each field is its tag and value length as varints then the value.
+//Numbers are stored as varints (7 bits a byte, low bits first). Readers skip message types and field tags they don't know
+//so newer senders can add to either without breaking older readers.
+
+#define NETWORK_FRAME_FORMAT 1
+
+class CNetworkFrameWriter
+{
+public:
+	CNetworkFrameWriter();
+
+	void BeginMessage(unsigned int type);
+	void AddUInt(unsigned int tag, uint64_t value);
+	void AddString(unsigned int tag, const std::string &value);
+	void AddBytes(unsigned int tag, const void *pData, size_t length);
+	void EndMessage();
+
+	const std::vector<unsigned char> &GetFrame() const	{ return m_frame; }
+	size_t GetSize() const								{ return m_frame.size(); }
+	bool HasMessages() const							{ return m_messageCount > 0; }
+	void Clear();
+
+	static void PutVarint(std::vector<unsigned char> &out, uint64_t value);
+
+protected:
+	std::vector<unsigned char> m_frame;
+	std::vector<unsigned char> m_message;
+	unsigned int m_messageType;
+	int m_messageCount;
+};
+
+class CNetworkFrameMessage
+{
+public:
+	CNetworkFrameMessage();
+
+	unsigned int GetType() const	{ return m_type; }
+
+	bool GetUInt(unsigned int tag, uint64_t &value) const;
+	bool GetString(unsigned int tag, std::string &value) const;
+	bool GetBytes(unsigned int tag, const unsigned char *&pData, size_t &length) const;
+
+	bool IsValid() const;
+
+protected:
+	bool FindField(unsigned int tag, const unsigned char *&pData, size_t &length) const;
+
+	unsigned int m_type;
+	const unsigned char *m_pPayload;
+	size_t m_payloadLength;
+
+	friend class CNetworkFrameReader;
+};
+
+//Reads messages out of a frame, the frame data has to stay around while the messages are used
+class CNetworkFrameReader
+{
+public:
+	CNetworkFrameReader(const unsigned char *pData, size_t length);
+
+	bool Next(CNetworkFrameMessage &message);
+	bool Failed() const		{ return m_failed; }
+
+	static bool GetVarint(const unsigned char *&pData, const unsigned char *pEnd, uint64_t &value);
+
+protected:
+	const unsigned char *m_pData;
+	const unsigned char *m_pEnd;
+	bool m_failed;
+};
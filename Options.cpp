@@ -8,6 +8,7 @@
 #include "CP_Main.h"
 #include "ActionEnums.h"
 #include "Shared/Tokenizer.h"
+#include "RecieveSocket.h"
 #include <set>
 #include <Wincrypt.h>
 
@@ -1600,6 +1601,27 @@ BOOL CGetSetOptions::GetFastThumbnailMode()
 	return GetProfileLong("FastThumbnailMode", TRUE);
 }
 
+//the row height the list last drew images at, new image clips get a thumbnail this high when they're saved, 0 for none
+int CGetSetOptions::GetThumbnailHeight()
+{
+	return GetProfileLong(_T("ThumbnailHeight"), 0);
+}
+
+void CGetSetOptions::SetThumbnailHeight(int height)
+{
+	SetProfileLong(_T("ThumbnailHeight"), height);
+}
+
+int CGetSetOptions::GetImagePreviewCacheBytes()
+{
+	return GetProfileLong(_T("ImagePreviewCacheBytes"), 32 * 1024 * 1024);
+}
+
+int CGetSetOptions::GetRtfPreviewCacheBytes()
+{
+	return GetProfileLong(_T("RtfPreviewCacheBytes"), 16 * 1024 * 1024);
+}
+
 void CGetSetOptions::SetExtraNetworkPassword(CString csPassword)
 {
 	SetProfileString("NetworkExtraPassword", csPassword);
@@ -1633,6 +1655,8 @@ CString CGetSetOptions::GetExtraNetworkPassword(bool bFillArray)
 		}
 
 		cs.ReleaseBuffer();
+
+		CRecieveSocket::LoadKeyIds();
 	}
 
 	return cs;
@@ -1642,6 +1666,8 @@ void CGetSetOptions::SetNetworkPassword(CString csPassword)
 {
 	m_csPassword = CTextConvert::UnicodeToUTF8(csPassword);
 	SetProfileString("NetworkStringPassword", csPassword);
+
+	CRecieveSocket::LoadKeyIds();
 }
 
 CStringA CGetSetOptions::GetNetworkPassword()
@@ -2434,6 +2460,89 @@ int CGetSetOptions::GetNetworkReadTimeoutMS()
 	return GetProfileLong(_T("NetworkReadTimeoutMS"), 30000);
 }
 
+//how long to wait for a server's VERSION reply before sending a large format the old way, only done once per connection
+int CGetSetOptions::GetNetworkVersionWaitMS()
+{
+	return GetProfileLong(_T("NetworkVersionWaitMS"), 500);
+}
+
+//auto send connections are kept open between batches and closed after being unused this long
+int CGetSetOptions::GetNetworkPeerIdleMS()
+{
+	return GetProfileLong(_T("NetworkPeerIdleMS"), 60000);
+}
+
+//after failing to connect to an auto send client the wait before trying again doubles up to this
+int CGetSetOptions::GetNetworkPeerMaxBackoffMS()
+{
+	return GetProfileLong(_T("NetworkPeerMaxBackoffMS"), 60000);
+}
+
+//how long the server waits on a kept open connection for the next batch
+int CGetSetOptions::GetNetworkServerIdleMS()
+{
+	return GetProfileLong(_T("NetworkServerIdleMS"), 600000);
+}
+
+//number of threads reading from connected clients, each reads one connection at a time. A thread stays with a connection
+//while it's sending a file, a request for files opens NetworkFileStreams connections at once, so the server always starts
+//at least one more thread than that, see MTServerThread
+int CGetSetOptions::GetNetworkServerThreads()
+{
+	return GetProfileLong(_T("NetworkServerThreads"), 6);
+}
+
+//how long a thread waits for a connection's next message before handing it back to the server thread to watch
+int CGetSetOptions::GetNetworkServerParkMS()
+{
+	return GetProfileLong(_T("NetworkServerParkMS"), 200);
+}
+
+//connections waiting for a thread, past this no more are accepted until the threads catch up
+int CGetSetOptions::GetNetworkServerMaxPending()
+{
+	return GetProfileLong(_T("NetworkServerMaxPending"), 32);
+}
+
+//zlib level for clip data and files sent over the network, 0 turns it off
+int CGetSetOptions::GetNetworkCompressionLevel()
+{
+	return GetProfileLong(_T("NetworkCompressionLevel"), 1);
+}
+
+//formats smaller than this are sent as is
+int CGetSetOptions::GetNetworkCompressMinSize()
+{
+	return GetProfileLong(_T("NetworkCompressMinSize"), 512);
+}
+
+int CGetSetOptions::GetNetworkFileStreams()
+{
+	return GetProfileLong(_T("NetworkFileStreams"), 3);
+}
+
+int CGetSetOptions::GetNetworkFileRetries()
+{
+	return GetProfileLong(_T("NetworkFileRetries"), 2);
+}
+
+//comma separated, the history is synced with these and they're the only ones allowed to sync with us, wild cards match ip addresses
+CString CGetSetOptions::GetNetworkSyncHosts()
+{
+	return GetProfileString(_T("NetworkSyncHosts"), _T(""));
+}
+
+int CGetSetOptions::GetNetworkSyncIntervalMinutes()
+{
+	return GetProfileLong(_T("NetworkSyncIntervalMinutes"), 60);
+}
+
+//most clips sent each way in one sync, the rest go in the next one
+int CGetSetOptions::GetNetworkSyncMaxClips()
+{
+	return GetProfileLong(_T("NetworkSyncMaxClips"), 100000);
+}
+
 void CGetSetOptions::SetRequestFilesUsingIP(int val)
 {
 	SetProfileLong(_T("RequestFilesUsingIP"), val);
@@ -3112,4 +3221,110 @@ BOOL CGetSetOptions::GetDrawCopiedColorCode()
 	BOOL drawCopiedColorCode = TRUE;
 
 	return GetProfileLong("DrawCopiedColorCode", drawCopiedColorCode);
-}
\ No newline at end of file
+}
+
+BOOL CGetSetOptions::GetUseFullTextSearchIndex()
+{
+	return GetProfileLong("UseFullTextSearchIndex", FALSE);
+}
+
+void CGetSetOptions::SetUseFullTextSearchIndex(BOOL val)
+{
+	SetProfileLong("UseFullTextSearchIndex", val);
+}
+
+//characters of a clip's text kept in DataSearchText, a search doesn't find text past this. 0, the default, keeps all of it,
+//a limit makes the db smaller for people who copy very large text
+int CGetSetOptions::GetMaxSearchTextLength()
+{
+	return GetProfileLong("MaxSearchTextLength", 0);
+}
+
+void CGetSetOptions::SetMaxSearchTextLength(int val)
+{
+	SetProfileLong("MaxSearchTextLength", val);
+}
+
+int CGetSetOptions::GetDataSearchTextMigrationBatch()
+{
+	return GetProfileLong("DataSearchTextMigrationBatch", 1000);
+}
+
+BOOL CGetSetOptions::GetDbWalMode()
+{
+	return GetProfileLong("DbWalMode", TRUE);
+}
+
+void CGetSetOptions::SetDbWalMode(BOOL val)
+{
+	SetProfileLong("DbWalMode", val);
+}
+
+//0 = OFF, 1 = NORMAL, 2 = FULL, NORMAL is safe in WAL mode and only syncs on checkpoints
+int CGetSetOptions::GetDbSynchronous()
+{
+	return GetProfileLong("DbSynchronous", 1);
+}
+
+void CGetSetOptions::SetDbSynchronous(int val)
+{
+	SetProfileLong("DbSynchronous", val);
+}
+
+int CGetSetOptions::GetDbReadConnections()
+{
+	return GetProfileLong("DbReadConnections", 2);
+}
+
+void CGetSetOptions::SetDbReadConnections(int val)
+{
+	SetProfileLong("DbReadConnections", val);
+}
+
+int CGetSetOptions::GetDbStatementCacheSize()
+{
+	return GetProfileLong("DbStatementCacheSize", 32);
+}
+
+void CGetSetOptions::SetDbStatementCacheSize(int val)
+{
+	SetProfileLong("DbStatementCacheSize", val);
+}
+
+//formats at least this many bytes are stored once in DataBlobs by their hash and shared by every clip that has the same data, 0 turns this off
+int CGetSetOptions::GetDataBlobMinSize()
+{
+	return GetProfileLong("DataBlobMinSize", 4096);
+}
+
+void CGetSetOptions::SetDataBlobMinSize(int val)
+{
+	SetProfileLong("DataBlobMinSize", val);
+}
+
+int CGetSetOptions::GetDataBlobMigrationBatch()
+{
+	return GetProfileLong("DataBlobMigrationBatch", 500);
+}
+
+//formats at least this many bytes are zlib compressed when saved, 0 turns this off
+int CGetSetOptions::GetDataCompressMinSize()
+{
+	return GetProfileLong("DataCompressMinSize", 4096);
+}
+
+void CGetSetOptions::SetDataCompressMinSize(int val)
+{
+	SetProfileLong("DataCompressMinSize", val);
+}
+
+//zlib level 1 (fastest) - 9 (smallest)
+int CGetSetOptions::GetDataCompressionLevel()
+{
+	return GetProfileLong("DataCompressionLevel", 1);
+}
+
+void CGetSetOptions::SetDataCompressionLevel(int val)
+{
+	SetProfileLong("DataCompressionLevel", val);
+}
@@ -276,6 +276,12 @@ public:
 	static void		SetFastThumbnailMode(BOOL bval);
 	static BOOL		GetFastThumbnailMode();
 
+	static int		GetThumbnailHeight();
+	static void		SetThumbnailHeight(int height);
+
+	static int		GetImagePreviewCacheBytes();
+	static int		GetRtfPreviewCacheBytes();
+
 	static CStringA	m_csPassword;
 	static void		SetNetworkPassword(CString csPassword);
 	static CStringA	GetNetworkPassword();
@@ -500,6 +506,23 @@ public:
 	static void SetNetworkReadTimeoutMS(int val);
 	static int GetNetworkReadTimeoutMS();
 
+	static int GetNetworkVersionWaitMS();
+
+	static int GetNetworkPeerIdleMS();
+	static int GetNetworkPeerMaxBackoffMS();
+	static int GetNetworkServerIdleMS();
+	static int GetNetworkServerThreads();
+	static int GetNetworkServerParkMS();
+	static int GetNetworkServerMaxPending();
+	static int GetNetworkCompressionLevel();
+	static int GetNetworkCompressMinSize();
+	static int GetNetworkFileStreams();
+	static int GetNetworkFileRetries();
+
+	static CString GetNetworkSyncHosts();
+	static int GetNetworkSyncIntervalMinutes();
+	static int GetNetworkSyncMaxClips();
+
 	static void SetRequestFilesUsingIP(int val);
 	static int GetRequestFilesUsingIP();
 
@@ -689,6 +712,37 @@ public:
 	static BOOL		m_bDrawCopiedColorCode;
 	static void		SetDrawCopiedColorCode(long bDraw);
 	static BOOL		GetDrawCopiedColorCode();
+
+	static BOOL GetUseFullTextSearchIndex();
+	static void SetUseFullTextSearchIndex(BOOL val);
+
+	static int GetMaxSearchTextLength();
+	static void SetMaxSearchTextLength(int val);
+
+	static int GetDataSearchTextMigrationBatch();
+
+	static BOOL GetDbWalMode();
+	static void SetDbWalMode(BOOL val);
+
+	static int GetDbSynchronous();
+	static void SetDbSynchronous(int val);
+
+	static int GetDbReadConnections();
+	static void SetDbReadConnections(int val);
+
+	static int GetDbStatementCacheSize();
+	static void SetDbStatementCacheSize(int val);
+
+	static int GetDataBlobMinSize();
+	static void SetDataBlobMinSize(int val);
+
+	static int GetDataBlobMigrationBatch();
+
+	static int GetDataCompressMinSize();
+	static void SetDataCompressMinSize(int val);
+
+	static int GetDataCompressionLevel();
+	static void SetDataCompressionLevel(int val);
 };
 
 // global for easy access and for initialization of fast access variables
@@ -0,0 +1,126 @@
+#include "stdafx.h"
+#include "PreviewCache.h"
+#include "Misc.h"
+
+CPreviewCache::CPreviewCache(CString name)
+{
+	m_name = name;
+	m_bytes = 0;
+	m_maxBytes = 0;
+	m_hits = 0;
+	m_misses = 0;
+	m_evictions = 0;
+}
+
+void CPreviewCache::SetMaxBytes(INT64 maxBytes)
+{
+	m_maxBytes = maxBytes;
+	Evict();
+}
+
+CClipFormatQListCtrl *CPreviewCache::Find(int clipId)
+{
+	std::unordered_map<int, CPreviewCacheList::iterator>::iterator iter = m_index.find(clipId);
+	if (iter == m_index.end())
+	{
+		m_misses++;
+		return NULL;
+	}
+
+	m_hits++;
+
+	//splice keeps the iterator in m_index valid
+	m_items.splice(m_items.begin(), m_items, iter->second);
+
+	return &(iter->second->m_format);
+}
+
+bool CPreviewCache::Contains(int clipId)
+{
+	return m_index.find(clipId) != m_index.end();
+}
+
+void CPreviewCache::Add(CClipFormatQListCtrl &format)
+{
+	INT64 bytes = sizeof(CPreviewCacheItem);
+	if (format.m_hgData != NULL)
+	{
+		bytes += GlobalSize(format.m_hgData);
+	}
+
+	Insert(format, bytes);
+	Evict();
+}
+
+void CPreviewCache::AddMissing(int clipId, CLIPFORMAT type)
+{
+	CClipFormatQListCtrl format;
+	format.m_cfType = type;
+	format.m_parentId = clipId;
+
+	Insert(format, sizeof(CPreviewCacheItem));
+	Evict();
+}
+
+void CPreviewCache::Remove(int clipId)
+{
+	std::unordered_map<int, CPreviewCacheList::iterator>::iterator iter = m_index.find(clipId);
+	if (iter != m_index.end())
+	{
+		m_bytes -= iter->second->m_bytes;
+		m_items.erase(iter->second);
+		m_index.erase(iter);
+	}
+}
+
+void CPreviewCache::Clear()
+{
+	m_index.clear();
+	m_items.clear();
+	m_bytes = 0;
+}
+
+void CPreviewCache::LogStats()
+{
+	Log(StrF(_T("%s cache, count: %d, bytes: %I64d of %I64d, hits: %I64d, misses: %I64d, evictions: %I64d"),
+		m_name, m_items.size(), m_bytes, m_maxBytes, m_hits, m_misses, m_evictions));
+}
+
+void CPreviewCache::Insert(CClipFormatQListCtrl &format, INT64 bytes)
+{
+	Remove(format.m_parentId);
+
+	m_items.emplace_front(format, bytes);
+
+	//the cache now owns the format data, set it to delete the data in the destructor
+	m_items.front().m_format.m_autoDeleteData = true;
+	format.m_autoDeleteData = false;
+
+	m_index[format.m_parentId] = m_items.begin();
+	m_bytes += bytes;
+}
+
+//the clip just added is never removed, even if it's over the budget on its own
+void CPreviewCache::Evict()
+{
+	int evicted = 0;
+
+	while (m_bytes > m_maxBytes &&
+		m_items.size() > 1)
+	{
+		CPreviewCacheItem &oldest = m_items.back();
+
+		m_bytes -= oldest.m_bytes;
+		m_index.erase(oldest.m_format.m_parentId);
+		m_items.pop_back();
+
+		evicted++;
+	}
+
+	if (evicted > 0)
+	{
+		m_evictions += evicted;
+
+		Log(StrF(_T("reduced size of %s cache, removed: %d, count: %d, bytes: %I64d"), m_name, evicted, m_items.size(), m_bytes));
+	}
+}
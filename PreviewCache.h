@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ClipFormatQListCtrl.h"
+#include <list>
+#include <unordered_map>
+
+//Images and rtf shown in the list, kept in least recently used order and limited by the size of their data.
+//Clips that were loaded and had nothing to show are kept as entries without data so they aren't loaded again.
+//Not locked, callers hold CQPasteWnd::m_CritSection
+class CPreviewCache
+{
+public:
+	CPreviewCache(CString name);
+
+	void SetMaxBytes(INT64 maxBytes);
+
+	//NULL if the clip needs to be loaded, moves the clip to the front and counts the hit or miss
+	CClipFormatQListCtrl *Find(int clipId);
+	//doesn't change the order or the counts
+	bool Contains(int clipId);
+
+	//the cache takes ownership of the format's data
+	void Add(CClipFormatQListCtrl &format);
+	void AddMissing(int clipId, CLIPFORMAT type);
+	void Remove(int clipId);
+	void Clear();
+
+	size_t GetCount() { return m_items.size(); }
+	INT64 GetBytes() { return m_bytes; }
+
+	void LogStats();
+
+protected:
+	class CPreviewCacheItem
+	{
+	public:
+		CPreviewCacheItem(const CClipFormatQListCtrl &format, INT64 bytes) : m_format(format), m_bytes(bytes) {}
+
+		CClipFormatQListCtrl m_format;
+		INT64 m_bytes;
+	};
+
+	typedef std::list<CPreviewCacheItem> CPreviewCacheList;
+
+	void Insert(CClipFormatQListCtrl &format, INT64 bytes);
+	void Evict();
+
+	CString m_name;
+	CPreviewCacheList m_items;
+	std::unordered_map<int, CPreviewCacheList::iterator> m_index;
+	INT64 m_bytes;
+	INT64 m_maxBytes;
+
+	INT64 m_hits;
+	INT64 m_misses;
+	INT64 m_evictions;
+};
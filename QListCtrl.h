@@ -31,6 +31,7 @@
 #define NM_FILL_REST_OF_LIST		WM_USER+0x115
 
 #define NM_SET_LIST_COUNT			WM_USER+0x116
+#define NM_REFINE_LIST_COUNT		WM_USER+0x117
 #define NM_ITEM_DELETED				WM_USER+0x118
 #define NM_ALL_SELECTED				WM_USER+0x119
 #define NM_REFRESH_ROW				WM_USER+0x120
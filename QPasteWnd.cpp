@@ -72,7 +72,7 @@ static char THIS_FILE[] = __FILE__;
 /////////////////////////////////////////////////////////////////////////////
 // CQPasteWnd
 
-CQPasteWnd::CQPasteWnd()
+CQPasteWnd::CQPasteWnd() : m_imageCache(_T("image")), m_rtfCache(_T("rtf"))
 {
 	m_Title = QPASTE_TITLE;
 	m_bHideWnd = true;
@@ -87,6 +87,9 @@ CQPasteWnd::CQPasteWnd()
 	m_lastDbWrite = 0;
 	m_pendingRefresh = false;
 	m_lastNonActiveMouseMove = 0;
+
+	m_imageCache.SetMaxBytes(CGetSetOptions::GetImagePreviewCacheBytes());
+	m_rtfCache.SetMaxBytes(CGetSetOptions::GetRtfPreviewCacheBytes());
 }
 
 CQPasteWnd::~CQPasteWnd()
@@ -210,6 +213,7 @@ BEGIN_MESSAGE_MAP(CQPasteWnd, CWndEx)
 	ON_MESSAGE(CB_UPDOWN, OnUpDown)
 	ON_MESSAGE(NM_INACTIVE_TOOLTIPWND, OnToolTipWndInactive)
 	ON_MESSAGE(NM_SET_LIST_COUNT, OnSetListCount)
+	ON_MESSAGE(NM_REFINE_LIST_COUNT, OnRefineListCount)
 	ON_MESSAGE(NM_REFRESH_ROW, OnRefeshRow)
 	ON_MESSAGE(NM_ITEM_DELETED, OnItemDeleted)
 	ON_WM_TIMER()
@@ -777,7 +781,7 @@ void CQPasteWnd::OnActivate(UINT nState, CWnd *pWndOther, BOOL bMinimized)
 			if (theApp.m_bShowingQuickPaste == false)
 			{
 				BOOL fillList = FALSE;
-				if (m_listItems.size() == 0)
+				if (m_listItems.GetCount() == 0)
 				{
 					fillList = TRUE;
 				}
@@ -878,7 +882,7 @@ BOOL CQPasteWnd::HideQPasteWindow(bool releaseFocus, BOOL clearSearchData)
 			{
 				ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
-				m_listItems.clear();
+				m_listItems.Clear();
 				m_lstHeader.SetItemCountEx(0);
 			}
 		}
@@ -900,7 +904,7 @@ BOOL CQPasteWnd::HideQPasteWindow(bool releaseFocus, BOOL clearSearchData)
 	if ((endTick - startTick) > 150)
 		Log(StrF(_T("Paste Timing HideQPasteWindow: %d"), endTick - startTick));
 
-	Log(StrF(_T("End of HideQPasteWindow, ItemCount: %d"), m_listItems.size()));
+	Log(StrF(_T("End of HideQPasteWindow, ItemCount: %d"), m_listItems.GetCount()));
 
 	return TRUE;
 }
@@ -921,7 +925,7 @@ BOOL CQPasteWnd::ShowQPasteWindow(BOOL bFillList)
 {
 	theApp.m_bShowingQuickPaste = true;
 
-	Log(StrF(_T("Start - ShowQPasteWindow - Fill List: %d, array count: %d"), bFillList, m_listItems.size()));
+	Log(StrF(_T("Start - ShowQPasteWindow - Fill List: %d, array count: %d"), bFillList, m_listItems.GetCount()));
 
 	//Ensure we have the latest theme file, this checks the last write time so it doesn't read the file each time
 	g_Opt.m_Theme.Load(g_Opt.GetTheme(), false, true);
@@ -957,7 +961,7 @@ BOOL CQPasteWnd::ShowQPasteWindow(BOOL bFillList)
 
 	//SetKeyModiferState(true);
 
-	Log(StrF(_T("END - ShowQPasteWindow - Fill List: %d, array count: %d"), bFillList, m_listItems.size()));
+	Log(StrF(_T("END - ShowQPasteWindow - Fill List: %d, array count: %d"), bFillList, m_listItems.GetCount()));
 
 	return TRUE;
 }
@@ -1204,41 +1208,26 @@ LRESULT CQPasteWnd::OnReloadClipAfterPaste(WPARAM wParam, LPARAM lParam)
 		double orderGroup = q.getFloatField(_T("clipGroupOrder"));
 		int lastPasted = q.getIntField(_T("lastPasteDate"));
 
-		std::vector<CMainTable>::iterator iter = m_listItems.begin();
-		while (iter != m_listItems.end())
+		int row = m_listItems.Find(clipId);
+		if (row >= 0)
 		{
-			if (iter->m_lID == clipId)
-			{
-				iter->m_datePasted = lastPasted;
+			m_listItems.SetDatePasted(row, lastPasted);
 
-				if (updateFlags & UPDATE_AFTER_PASTE_SELECT_CLIP)
+			if (updateFlags & UPDATE_AFTER_PASTE_SELECT_CLIP)
+			{
+				if (m_listItems.GetClipOrder(row) != order || m_listItems.GetClipGroupOrder(row) != orderGroup)
 				{
-					if (iter->m_clipOrder != order || iter->m_clipGroupOrder != orderGroup)
-					{
-						iter->m_clipOrder = order;
-						iter->m_clipGroupOrder = orderGroup;
-
-						if (theApp.m_GroupID > 0)
-						{
-							std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-						}
-						else
-						{
-							std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-						}
-					}
-
-					foundClip = TRUE;
+					m_listItems.SetOrders(row, order, orderGroup);
 
-					m_lstHeader.RefreshVisibleRows();
-					m_lstHeader.RedrawWindow();
-					SelectFocusID();
+					m_listItems.Sort(theApp.m_GroupID > 0);
 				}
 
-				break;
-			}
+				foundClip = TRUE;
 
-			iter++;
+				m_lstHeader.RefreshVisibleRows();
+				m_lstHeader.RedrawWindow();
+				SelectFocusID();
+			}
 		}
 	}
 
@@ -1287,7 +1276,7 @@ LRESULT CQPasteWnd::OnRefreshView(WPARAM wParam, LPARAM lParam)
 
 		{
 			ATL::CCritSecLock csLock(m_CritSection.m_sect);
-			m_listItems.clear();
+			m_listItems.Clear();
 		}
 
 		m_lstHeader.SetItemCountEx(0);
@@ -1296,7 +1285,7 @@ LRESULT CQPasteWnd::OnRefreshView(WPARAM wParam, LPARAM lParam)
 		action = _T("Cleared Items");
 	}
 
-	Log(StrF(_T("OnRefreshView - End - Count: %d, Action: %s"), m_listItems.size(), action));
+	Log(StrF(_T("OnRefreshView - End - Count: %d, Action: %s"), m_listItems.GetCount(), action));
 
 	return TRUE;
 }
@@ -1384,15 +1373,16 @@ BOOL CQPasteWnd::FillList(CString csSQLSearch)
 
 	CString strFilter;
 	CString strParentFilter;
-	CString csSort;
+	CString csStickyOrderColumn;
+	CString csOrderColumn;
 
 	// History Groupiter->m_stickyClipGroupOrder = clip.m_stickyClipGroupOrder;
 	if (theApp.m_GroupID < 0)
 	{
 		//do not change this this directly relates to the views in the Main table
-		csSort = "Main.stickyClipOrder DESC, "
-			"Main.bIsGroup ASC, "			
-			"Main.clipOrder DESC";
+		//sorted by stickyClipOrder DESC, bIsGroup ASC, clipOrder DESC, lID ASC (Main_TopLevel)
+		csStickyOrderColumn = _T("stickyClipOrder");
+		csOrderColumn = _T("clipOrder");
 
 		if (g_Opt.m_bShowAllClipsInMainList)
 		{
@@ -1415,9 +1405,9 @@ BOOL CQPasteWnd::FillList(CString csSQLSearch)
 		// it's some other group
 	{
 		//do not change this this directly relates to the views in the Main table
-		csSort = "Main.stickyClipGroupOrder DESC, "
-			"Main.bIsGroup ASC, "			
-			"Main.clipGroupOrder DESC";
+		//sorted by stickyClipGroupOrder DESC, bIsGroup ASC, clipGroupOrder DESC, lID ASC (Main_InGroup2)
+		csStickyOrderColumn = _T("stickyClipGroupOrder");
+		csOrderColumn = _T("clipGroupOrder");
 
 		//Main.stickyClipGroupOrder DESC, Main.clipGroupOrder DESC";//
 
@@ -1453,11 +1443,18 @@ BOOL CQPasteWnd::FillList(CString csSQLSearch)
 		CFormatSQL fullTextFormat;
 		CString fullTextSql;
 
+		//the MainFts index holds the description, quick paste and unicode text of each clip, search it instead of scanning Main and Data
+		bool useFullTextIndex = FullTextSearchIndexAvailable();
+
 		//If other are off then always search the description
 		if (CGetSetOptions::GetSearchDescription() ||
 			(CGetSetOptions::GetSearchFullText() == FALSE && CGetSetOptions::GetSearchQuickPaste() == FALSE))
 		{
 			descriptionFormat.SetVariable("Main.mText");
+			if (useFullTextIndex)
+			{
+				descriptionFormat.SetFullTextIndexColumn(_T("mText"));
+			}
 
 			descriptionFormat.Parse(csSQLSearch);
 			descriptionSql = descriptionFormat.GetSQLString();
@@ -1468,6 +1465,10 @@ BOOL CQPasteWnd::FillList(CString csSQLSearch)
 			CGetSetOptions::GetSearchQuickPaste())
 		{
 			quickPasteFormat.SetVariable("Main.QuickPasteText");
+			if (useFullTextIndex)
+			{
+				quickPasteFormat.SetFullTextIndexColumn(_T("QuickPasteText"));
+			}
 
 			if (csSQLSearch.Left(3) == _T("/q ") ||
 				csSQLSearch.Left(3) == _T("\\q "))
@@ -1483,29 +1484,68 @@ BOOL CQPasteWnd::FillList(CString csSQLSearch)
 			csSQLSearch.Left(3) == _T("\\f ") ||
 			CGetSetOptions::GetSearchFullText())
 		{
-			dataJoin = _T("INNER JOIN Data on Data.lParentID = Main.lID");
-
 			if (csSQLSearch.Left(3) == _T("/f ") ||
 				csSQLSearch.Left(3) == _T("\\f "))
 			{
 				csSQLSearch = csSQLSearch.Mid(3);
 			}
 
-			fullTextFormat.SetVariable("Data.ooData");
-			fullTextFormat.Parse(csSQLSearch);
-			fullTextSql = fullTextFormat.GetSQLString();
-
-			fullTextSql.Insert(1, _T("Data.strClipBoardFormat = 'CF_UNICODETEXT' AND "));
-
-			//If we are also search for other text make sure we only get one entry, including the data rows will cause multiple rows to be returned
-			if (descriptionSql != _T(""))
+			if (useFullTextIndex &&
+				CGetSetOptions::GetRegExTextSearch() == FALSE)
 			{
-				IsDistinct = _T("DISTINCT");
+				//the index is keyed by Main.lID so no join or distinct is needed
+				fullTextFormat.SetVariable("Data.ooData");
+				fullTextFormat.SetFullTextIndexColumn(_T("FullText"));
+				fullTextFormat.Parse(csSQLSearch);
+				fullTextSql = fullTextFormat.GetSQLString();
 			}
+			else if (CGetSetOptions::GetRegExTextSearch() == FALSE ||
+				CGetSetOptions::GetRegexCaseInsensitive())
+			{
+				//DataSearchText has one lower cased row per clip, so this never reads the data blobs and doesn't need distinct
+				dataJoin = _T("LEFT JOIN DataSearchText ON DataSearchText.lParentID = Main.lID");
+
+				//a regex is left as it is, lower casing it would change what escapes like \S and \W match.
+				//It's run case insensitive so it still matches the lower cased text
+				CString searchText(csSQLSearch);
+				if (CGetSetOptions::GetRegExTextSearch() == FALSE)
+				{
+					searchText.MakeLower();
+				}
 
-			if (quickPasteSql != _T(""))
+				//clips from before DataSearchText existed don't have a row until the migration thread gets to them, their text is read from Data
+				if (DataSearchTextMigrated())
+				{
+					fullTextFormat.SetVariable("DataSearchText.searchText");
+				}
+				else
+				{
+					fullTextFormat.SetVariable("IFNULL(DataSearchText.searchText, lower(unicodetext((SELECT DataContent.ooData FROM DataContent WHERE DataContent.lParentID = Main.lID AND DataContent.strClipBoardFormat = 'CF_UNICODETEXT' LIMIT 1))))");
+				}
+				fullTextFormat.Parse(searchText);
+				fullTextSql = fullTextFormat.GetSQLString();
+			}
+			else
 			{
-				IsDistinct = _T("DISTINCT");
+				//case sensitive regex can't be run against the lower cased search text
+				dataJoin = _T("INNER JOIN DataContent on DataContent.lParentID = Main.lID");
+
+				fullTextFormat.SetVariable("DataContent.ooData");
+				fullTextFormat.Parse(csSQLSearch);
+				fullTextSql = fullTextFormat.GetSQLString();
+
+				fullTextSql.Insert(1, _T("DataContent.strClipBoardFormat = 'CF_UNICODETEXT' AND "));
+
+				//If we are also search for other text make sure we only get one entry, including the data rows will cause multiple rows to be returned
+				if (descriptionSql != _T(""))
+				{
+					IsDistinct = _T("DISTINCT");
+				}
+
+				if (quickPasteSql != _T(""))
+				{
+					IsDistinct = _T("DISTINCT");
+				}
 			}
 		}
 
@@ -1551,19 +1591,30 @@ BOOL CQPasteWnd::FillList(CString csSQLSearch)
 
 	CString sql;
 	CString countSql;
+	bool countRows = false;
 
 	//Format the count and select sql queries for the thread
-	countSql.Format(_T("SELECT COUNT(%s Main.lID) FROM Main %s where %s"), IsDistinct, dataJoin, strFilter);
+	if (m_strSearch == _T(""))
+	{
+		//MainCounts has the bIsGroup and lParentID the filter reads, as Main it's summed with the same filter
+		countSql.Format(_T("SELECT IFNULL(SUM(Main.lCount), 0) FROM MainCounts Main where %s"), strFilter);
+	}
+	else
+	{
+		//the thread counts the ids as it reads them so the list can show the first rows without waiting for the count
+		countSql.Format(_T("SELECT %s Main.lID FROM Main %s where %s"), IsDistinct, dataJoin, strFilter);
+		countRows = true;
+	}
 
 	sql.Format(_T("SELECT %s Main.lID, Main.mText, Main.lParentID, Main.lDontAutoDelete, ")
 		_T("Main.lShortCut, Main.bIsGroup, Main.QuickPasteText, Main.clipOrder, Main.clipGroupOrder, ")
 		_T("Main.stickyClipOrder, Main.stickyClipGroupOrder, Main.lDate, Main.lastPasteDate FROM Main %s ")
-		_T("where %s order by %s"), IsDistinct, dataJoin, strFilter, csSort);
+		_T("where (%s)"), IsDistinct, dataJoin, strFilter);
 	
 
 	{
 		ATL::CCritSecLock csLock(m_CritSection.m_sect);
-		m_listItems.clear();
+		m_listItems.Clear();
 	}
 
 	m_noSearchResults = false;
@@ -1573,7 +1624,8 @@ BOOL CQPasteWnd::FillList(CString csSQLSearch)
 	CPoint loadItem(-1, m_lstHeader.GetCountPerPage() + 2);
 	m_loadItems.push_back(loadItem);
 	
-	m_thread.SetSearchSql(sql, countSql);
+	//the thread adds the order by and paging
+	m_thread.SetSearchSql(sql, countSql, countRows, csStickyOrderColumn, csOrderColumn);
 	m_thread.FireLoadItems(true);
 
 	MoveControls();
@@ -1988,10 +2040,8 @@ void CQPasteWnd::SetLinesPerRow(int lines, bool force, bool resetListCount)
 
 	ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
-	m_cf_dibCache.clear();
-	m_cf_NO_dibCache.clear();
-	m_cf_rtfCache.clear();
-	m_cf_NO_rtfCache.clear();
+	m_imageCache.Clear();
+	m_rtfCache.Clear();
 
 	if (resetListCount)
 	{
@@ -2200,9 +2250,9 @@ void CQPasteWnd::OnMenuQuickpropertiesSettoneverautodelete()
 		count = Indexs.GetSize();
 		for (int row = 0; row < count; row++)
 		{
-			if (Indexs[row] < (int)m_listItems.size())
+			if (Indexs[row] < m_listItems.GetCount())
 			{
-				m_listItems[Indexs[row]].m_bDontAutoDelete = true;
+				m_listItems.SetFlag(Indexs[row], LIST_ROW_DONT_AUTO_DELETE, true);
 			}
 		}
 	}
@@ -2234,9 +2284,9 @@ void CQPasteWnd::OnMenuQuickpropertiesAutodelete()
 		count = Indexs.GetSize();
 		for (int row = 0; row < count; row++)
 		{
-			if (Indexs[row] < (int)m_listItems.size())
+			if (Indexs[row] < m_listItems.GetCount())
 			{
-				m_listItems[Indexs[row]].m_bDontAutoDelete = false;
+				m_listItems.SetFlag(Indexs[row], LIST_ROW_DONT_AUTO_DELETE, false);
 			}
 		}
 	}
@@ -2272,9 +2322,9 @@ void CQPasteWnd::OnMenuQuickpropertiesRemovehotkey()
 		count = Indexs.GetSize();
 		for (int row = 0; row < count; row++)
 		{
-			if (Indexs[row] < (int)m_listItems.size())
+			if (Indexs[row] < m_listItems.GetCount())
 			{
-				m_listItems[Indexs[row]].m_bHasShortCut = false;
+				m_listItems.SetFlag(Indexs[row], LIST_ROW_HAS_SHORTCUT, false);
 			}
 		}
 	}
@@ -2307,9 +2357,9 @@ void CQPasteWnd::OnQuickpropertiesRemovequickpaste()
 		count = Indexs.GetSize();
 		for (int row = 0; row < count; row++)
 		{
-			if (Indexs[row] < (int)m_listItems.size())
+			if (Indexs[row] < m_listItems.GetCount())
 			{
-				m_listItems[Indexs[row]].m_QuickPaste.Empty();
+				m_listItems.SetFlag(Indexs[row], LIST_ROW_HAS_QUICK_PASTE, false);
 			}
 		}
 	}
@@ -2740,12 +2790,12 @@ bool CQPasteWnd::DeleteClips(CClipIDs &IDs, ARRAY &Indexs)
 
 		for (int i = 0; i < count; i++)
 		{
-			if (Indexs[i] < (int)m_listItems.size())
+			if (Indexs[i] < m_listItems.GetCount())
 			{
 				RemoveFromImageRtfCache(Indexs[i]);
 				g_HotKeys.Remove(m_lstHeader.GetItemData(Indexs[i]), CHotKey::PASTE_OPEN_CLIP);
 
-				m_listItems.erase(m_listItems.begin() + Indexs[i]);
+				m_listItems.Erase(Indexs[i]);
 				erasedCount++;
 			}
 		}
@@ -2778,29 +2828,8 @@ void CQPasteWnd::RemoveFromImageRtfCache(int id)
 {
 	ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
-	CF_DibTypeMap::iterator iterDib = m_cf_dibCache.find(m_lstHeader.GetItemData(id));
-	if (iterDib != m_cf_dibCache.end())
-	{
-		m_cf_dibCache.erase(iterDib);
-	}
-
-	CF_NoDibTypeMap::iterator iterNoDib = m_cf_NO_dibCache.find(m_lstHeader.GetItemData(id));
-	if (iterNoDib != m_cf_NO_dibCache.end())
-	{
-		m_cf_NO_dibCache.erase(iterNoDib);
-	}
-
-	CF_DibTypeMap::iterator iterRtf = m_cf_rtfCache.find(m_lstHeader.GetItemData(id));
-	if (iterRtf != m_cf_rtfCache.end())
-	{
-		m_cf_rtfCache.erase(iterRtf);
-	}
-
-	CF_NoDibTypeMap::iterator iterNoRtf = m_cf_NO_rtfCache.find(m_lstHeader.GetItemData(id));
-	if (iterNoRtf != m_cf_NO_rtfCache.end())
-	{
-		m_cf_NO_rtfCache.erase(iterNoRtf);
-	}
+	m_imageCache.Remove(m_lstHeader.GetItemData(id));
+	m_rtfCache.Remove(m_lstHeader.GetItemData(id));
 }
 
 CString CQPasteWnd::LoadDescription(int nItem)
@@ -3969,28 +3998,21 @@ bool CQPasteWnd::ShowProperties(int id, int row)
 
 			if (row < 0)
 			{
-				bool selectedItem = false;
-				int index = 0;
-				std::vector<CMainTable>::iterator iter = m_listItems.begin();
-				while (iter != m_listItems.end())
-				{
-					if (iter->m_lID == id)
-					{
-						row = index;
-						break;
-					}
-					iter++;
-					index++;
-				}
+				row = m_listItems.Find(id);
 			}
 
 			if (row >= 0 &&
-				row < (int)m_listItems.size())
+				row < m_listItems.GetCount())
 			{
-				CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT * FROM Main WHERE lID = %d"), id);
+				CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT * FROM Main WHERE lID = ?"));
+				stmt.bind(1, id);
+
+				CppSQLite3Query q = stmt.execQuery();
 				if (!q.eof())
 				{
-					FillMainTable(m_listItems[row], q);
+					CMainTable table;
+					FillMainTable(table, q);
+					m_listItems.Set(row, table);
 				}
 
 				RemoveFromImageRtfCache(row);
@@ -4383,14 +4405,7 @@ bool CQPasteWnd::DoMoveClipDown()
 
 		if (sort)
 		{
-			if (theApp.m_GroupID > 0)
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-			}
-			else
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-			}
+			m_listItems.Sort(theApp.m_GroupID > 0);
 
 			SelectIds(IDs);
 
@@ -4427,14 +4442,7 @@ bool CQPasteWnd::DoMoveClipUp()
 
 		if (sort)
 		{
-			if (theApp.m_GroupID > 0)
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-			}
-			else
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-			}
+			m_listItems.Sort(theApp.m_GroupID > 0);
 
 			SelectIds(IDs);
 
@@ -4471,7 +4479,7 @@ bool CQPasteWnd::DoMoveClipLast()
 				clip.ModifyMainTable();
 
 				//have we loaded all clips, if so then sort and select
-				if (m_listItems.size() == m_lstHeader.GetItemCount())
+				if (m_listItems.GetCount() == m_lstHeader.GetItemCount())
 				{
 					sort = SyncClipDataToArrayData(clip);
 				}
@@ -4479,30 +4487,14 @@ bool CQPasteWnd::DoMoveClipLast()
 				{
 					//haven't loaded all clips so this will be out of what we have loaded
 					//remove this from the list, will be shown as they scroll down the list
-					std::vector<CMainTable>::iterator iter = m_listItems.begin();
-					while (iter != m_listItems.end())
-					{
-						if (iter->m_lID == clip.ID())
-						{
-							m_listItems.erase(iter);
-							break;
-						}
-						iter++;
-					}
+					m_listItems.Erase(m_listItems.Find(clip.ID()));
 				}
 			}
 		}
 
 		if (sort)
 		{
-			if (theApp.m_GroupID > 0)
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-			}
-			else
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-			}
+			m_listItems.Sort(theApp.m_GroupID > 0);
 
 			SelectIds(IDs);
 		}
@@ -4544,14 +4536,7 @@ bool CQPasteWnd::DoMoveClipTOP()
 
 		if (sort)
 		{
-			if (theApp.m_GroupID > 0)
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-			}
-			else
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-			}
+			m_listItems.Sort(theApp.m_GroupID > 0);
 
 			SelectIds(IDs);
 
@@ -4574,20 +4559,25 @@ bool CQPasteWnd::DoFilterOnSelectedClip()
 	{
 		int id = IDs[0];
 
-		ATL::CCritSecLock csLock(m_CritSection.m_sect);
-		std::vector<CMainTable>::iterator iter = m_listItems.begin();
-		while (iter != m_listItems.end())
+		//the list only keeps the start of the description, search for all of it
+		CString desc;
+		try
 		{
-			if (iter->m_lID == id)
+			CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT mText FROM Main WHERE lID = %d"), id);
+			if (q.eof() == false)
 			{
-				m_bHandleSearchTextChange = false;
-				m_search.SetWindowText(iter->m_Desc);
-				m_bHandleSearchTextChange = true;
-				OnSearch(0, 0);
+				desc = q.getStringField(0);
 				ret = true;
-				break;
 			}
-			iter++;
+		}
+		CATCH_SQLITE_EXCEPTION
+
+		if (ret)
+		{
+			m_bHandleSearchTextChange = false;
+			m_search.SetWindowText(desc);
+			m_bHandleSearchTextChange = true;
+			OnSearch(0, 0);
 		}
 	}
 
@@ -4840,14 +4830,7 @@ bool CQPasteWnd::OnMakeTopSticky(bool forceSort)
 
 		if (sort)
 		{
-			if (theApp.m_GroupID > 0)
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-			}
-			else
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-			}
+			m_listItems.Sort(theApp.m_GroupID > 0);
 
 			SelectIds(IDs);
 
@@ -4882,14 +4865,7 @@ bool CQPasteWnd::OnMakeLastSticky()
 
 		if (sort)
 		{
-			if (theApp.m_GroupID > 0)
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-			}
-			else
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-			}
+			m_listItems.Sort(theApp.m_GroupID > 0);
 
 			SelectIds(IDs);
 
@@ -4918,14 +4894,7 @@ bool CQPasteWnd::OnRemoveStickySetting()
 
 		if (sort)
 		{
-			if (theApp.m_GroupID > 0)
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::GroupSortDesc);
-			}
-			else
-			{
-				std::sort(m_listItems.begin(), m_listItems.end(), CMainTable::SortDesc);
-			}
+			m_listItems.Sort(theApp.m_GroupID > 0);
 
 			//SelectFocusID();
 
@@ -4946,23 +4915,18 @@ void CQPasteWnd::RemoveStickyInternal(int id, bool &sort)
 		{
 			clip.ModifyMainTable();
 
-			std::vector<CMainTable>::iterator iter = m_listItems.begin();
-			while (iter != m_listItems.end())
+			int row = m_listItems.Find(id);
+			if (row >= 0)
 			{
-				if (iter->m_lID == id)
+				if (theApp.m_GroupID > 0)
 				{
-					if (theApp.m_GroupID > 0)
-					{
-						iter->m_stickyClipGroupOrder = clip.m_stickyClipGroupOrder;
-					}
-					else
-					{
-						iter->m_stickyClipOrder = clip.m_stickyClipOrder;
-					}
-					sort = true;
-					break;
+					m_listItems.SetStickyOrders(row, m_listItems.GetStickyClipOrder(row), clip.m_stickyClipGroupOrder);
+				}
+				else
+				{
+					m_listItems.SetStickyOrders(row, clip.m_stickyClipOrder, m_listItems.GetStickyClipGroupOrder(row));
 				}
-				iter++;
+				sort = true;
 			}
 		}
 	}
@@ -5040,12 +5004,17 @@ bool CQPasteWnd::DoActionSaveCF_HDROP_FileData()
 					if (clip.AddFileDataToData(localErrorMessage))
 					{
 						if (row >= 0 &&
-							row < (int)m_listItems.size())
+							row < m_listItems.GetCount())
 						{
-							CppSQLite3Query q = theApp.m_db.execQueryEx(_T("SELECT * FROM Main WHERE lID = %d"), id);
+							CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("SELECT * FROM Main WHERE lID = ?"));
+							stmt.bind(1, id);
+
+							CppSQLite3Query q = stmt.execQuery();
 							if (!q.eof())
 							{
-								FillMainTable(m_listItems[row], q);
+								CMainTable table;
+								FillMainTable(table, q);
+								m_listItems.Set(row, table);
 							}
 						}
 					}
@@ -5359,58 +5328,58 @@ void CQPasteWnd::GetDispInfo(NMHDR *pNMHDR, LRESULT *pResult)
 				ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
 				int c = m_lstHeader.GetItemCount();
-				if ((int)m_listItems.size() > pItem->iItem &&
-					m_listItems[pItem->iItem].m_lID > 0)
+				if (m_listItems.GetCount() > pItem->iItem &&
+					m_listItems.GetId(pItem->iItem) > 0)
 				{
 					CString cs;
-					if (m_listItems[pItem->iItem].m_bDontAutoDelete)
+					if (m_listItems.HasFlag(pItem->iItem, LIST_ROW_DONT_AUTO_DELETE))
 					{
 						cs += _T("<noautodelete>");
 					}
 
-					if (m_listItems[pItem->iItem].m_bHasShortCut)
+					if (m_listItems.HasFlag(pItem->iItem, LIST_ROW_HAS_SHORTCUT))
 					{
 						cs += _T("<shortcut>");
 					}
 
-					if (m_listItems[pItem->iItem].m_bIsGroup)
+					if (m_listItems.HasFlag(pItem->iItem, LIST_ROW_IS_GROUP))
 					{
 						cs += _T("<group>");
 					}
 
 					if (theApp.m_GroupID > 0)
 					{
-						if (m_listItems[pItem->iItem].m_stickyClipGroupOrder != INVALID_STICKY)
+						if (m_listItems.GetStickyClipGroupOrder(pItem->iItem) != INVALID_STICKY)
 						{
 							cs += _T("<sticky>");
 						}
 					}
 					else
 					{
-						if (m_listItems[pItem->iItem].m_stickyClipOrder != INVALID_STICKY)
+						if (m_listItems.GetStickyClipOrder(pItem->iItem) != INVALID_STICKY)
 						{
 							cs += _T("<sticky>");
 						}
 					}
 
 					// attached to a group
-					if (m_listItems[pItem->iItem].m_bHasParent)
+					if (m_listItems.HasFlag(pItem->iItem, LIST_ROW_HAS_PARENT))
 					{
 						cs += _T("<ingroup>");
 					}
 
-					if (m_listItems[pItem->iItem].m_QuickPaste.IsEmpty() == FALSE)
+					if (m_listItems.HasFlag(pItem->iItem, LIST_ROW_HAS_QUICK_PASTE))
 					{
 						cs += _T("<qpastetext>");
 					}
 
-					if (m_listItems[pItem->iItem].m_dateCopied != m_listItems[pItem->iItem].m_datePasted)
+					if (m_listItems.GetDateCopied(pItem->iItem) != m_listItems.GetDatePasted(pItem->iItem))
 					{
 						cs += "<pasted>";
 					}
 
 					// pipe is the "end of symbols" marker
-					cs += "|" + CMainTableFunctions::GetDisplayText(g_Opt.m_nLinesPerRow, m_listItems[pItem->iItem].m_Desc);
+					cs += "|" + CMainTableFunctions::GetDisplayText(g_Opt.m_nLinesPerRow, m_listItems.GetDescription(pItem->iItem));
 
 					lstrcpyn(pItem->pszText, cs, pItem->cchTextMax);
 					pItem->pszText[pItem->cchTextMax - 1] = '\0';
@@ -5456,9 +5425,9 @@ void CQPasteWnd::GetDispInfo(NMHDR *pNMHDR, LRESULT *pResult)
 		{
 			ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
-			if ((int)m_listItems.size() > pItem->iItem)
+			if (m_listItems.GetCount() > pItem->iItem)
 			{
-				pItem->lParam = m_listItems[pItem->iItem].m_lID;
+				pItem->lParam = m_listItems.GetId(pItem->iItem);
 			}
 		}
 
@@ -5470,45 +5439,38 @@ void CQPasteWnd::GetDispInfo(NMHDR *pNMHDR, LRESULT *pResult)
 	{
 		ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
-		if ((int)m_listItems.size() > pItem->iItem)
+		if (m_listItems.GetCount() > pItem->iItem)
 		{
-			CF_NoDibTypeMap::iterator iterNoDib = m_cf_NO_dibCache.find(m_listItems[pItem->iItem].m_lID);
-			if (iterNoDib == m_cf_NO_dibCache.end())
+			CClipFormatQListCtrl *pDib = m_imageCache.Find(m_listItems.GetId(pItem->iItem));
+			if (pDib == NULL)
 			{
-				CF_DibTypeMap::iterator iterDib = m_cf_dibCache.find(m_listItems[pItem->iItem].m_lID);
-				if (iterDib == m_cf_dibCache.end())
+				bool exists = false;
+				for (std::list<CClipFormatQListCtrl>::iterator it = m_ExtraDataLoadItems.begin(); it != m_ExtraDataLoadItems.end(); it++)
 				{
-					bool exists = false;
-					for (std::list<CClipFormatQListCtrl>::iterator it = m_ExtraDataLoadItems.begin(); it != m_ExtraDataLoadItems.end(); it++)
-					{
-						if (it->m_cfType == CF_DIB && it->m_parentId == m_listItems[pItem->iItem].m_lID)
-						{
-							exists = true;
-							break;
-						}
-					}
-
-					if (exists == false)
+					if (it->m_cfType == CF_DIB && it->m_parentId == m_listItems.GetId(pItem->iItem))
 					{
-						CClipFormatQListCtrl format;
-						format.m_cfType = CF_DIB;
-						format.m_parentId = m_listItems[pItem->iItem].m_lID;
-						format.m_clipRow = pItem->iItem;
-						format.m_autoDeleteData = true;
-						format.m_counter = m_extraDataCounter++;
-						m_ExtraDataLoadItems.push_back(format);
-
-						m_extraDataThread.FireLoadExtraData(m_lstHeader.GetRowHeight());
+						exists = true;
+						break;
 					}
 				}
-				else
+
+				if (exists == false)
 				{
-					if (iterDib->second.m_hgData != NULL)
-					{
-						pItem->lParam = (LPARAM) &(iterDib->second);
-					}
+					CClipFormatQListCtrl format;
+					format.m_cfType = CF_DIB;
+					format.m_parentId = m_listItems.GetId(pItem->iItem);
+					format.m_clipRow = pItem->iItem;
+					format.m_autoDeleteData = true;
+					format.m_counter = m_extraDataCounter++;
+					m_ExtraDataLoadItems.push_back(format);
+
+					m_extraDataThread.FireLoadExtraData(m_lstHeader.GetRowHeight());
 				}
 			}
+			else if (pDib->m_hgData != NULL)
+			{
+				pItem->lParam = (LPARAM) pDib;
+			}
 		}
 	}
 
@@ -5516,45 +5478,38 @@ void CQPasteWnd::GetDispInfo(NMHDR *pNMHDR, LRESULT *pResult)
 	{
 		ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
-		if ((int)m_listItems.size() > pItem->iItem)
+		if (m_listItems.GetCount() > pItem->iItem)
 		{
-			CF_NoDibTypeMap::iterator iterNoRtf = m_cf_NO_rtfCache.find(m_listItems[pItem->iItem].m_lID);
-			if (iterNoRtf == m_cf_NO_rtfCache.end())
+			CClipFormatQListCtrl *pRtf = m_rtfCache.Find(m_listItems.GetId(pItem->iItem));
+			if (pRtf == NULL)
 			{
-				CF_DibTypeMap::iterator iterRTF = m_cf_rtfCache.find(m_listItems[pItem->iItem].m_lID);
-				if (iterRTF == m_cf_rtfCache.end())
+				bool exists = false;
+				for (std::list<CClipFormatQListCtrl>::iterator it = m_ExtraDataLoadItems.begin(); it != m_ExtraDataLoadItems.end(); it++)
 				{
-					bool exists = false;
-					for (std::list<CClipFormatQListCtrl>::iterator it = m_ExtraDataLoadItems.begin(); it != m_ExtraDataLoadItems.end(); it++)
+					if (it->m_cfType == theApp.m_RTFFormat && it->m_parentId == m_listItems.GetId(pItem->iItem))
 					{
-						if (it->m_cfType == theApp.m_RTFFormat && it->m_parentId == m_listItems[pItem->iItem].m_lID)
-						{
-							exists = true;
-							break;
-						}
-					}
-
-					if (exists == false)
-					{
-						CClipFormatQListCtrl format;
-						format.m_cfType = theApp.m_RTFFormat;
-						format.m_parentId = m_listItems[pItem->iItem].m_lID;
-						format.m_clipRow = pItem->iItem;
-						format.m_autoDeleteData = true;
-						format.m_counter = m_extraDataCounter++;
-						m_ExtraDataLoadItems.push_back(format);
-
-						m_extraDataThread.FireLoadExtraData(m_lstHeader.GetRowHeight());
+						exists = true;
+						break;
 					}
 				}
-				else
+
+				if (exists == false)
 				{
-					if (iterRTF->second.m_hgData != NULL)
-					{
-						pItem->lParam = (LPARAM) &(iterRTF->second);
-					}
+					CClipFormatQListCtrl format;
+					format.m_cfType = theApp.m_RTFFormat;
+					format.m_parentId = m_listItems.GetId(pItem->iItem);
+					format.m_clipRow = pItem->iItem;
+					format.m_autoDeleteData = true;
+					format.m_counter = m_extraDataCounter++;
+					m_ExtraDataLoadItems.push_back(format);
+
+					m_extraDataThread.FireLoadExtraData(m_lstHeader.GetRowHeight());
 				}
 			}
+			else if (pRtf->m_hgData != NULL)
+			{
+				pItem->lParam = (LPARAM) pRtf;
+			}
 		}
 	}
 }
@@ -6098,6 +6053,24 @@ LRESULT CQPasteWnd::OnSetListCount(WPARAM wParam, LPARAM lParam)
 	return TRUE;
 }
 
+//The count of a search as the thread reads it, the scroll position and selection are kept
+LRESULT CQPasteWnd::OnRefineListCount(WPARAM wParam, LPARAM lParam)
+{
+	//posted before the search changed
+	if ((int)lParam != m_thread.GetSearchId())
+	{
+		return TRUE;
+	}
+
+	if ((int)wParam != m_lstHeader.GetItemCount())
+	{
+		m_lstHeader.SetItemCountEx((int)wParam, LVSICF_NOSCROLL | LVSICF_NOINVALIDATEALL);
+		UpdateStatus(false);
+	}
+
+	return TRUE;
+}
+
 LRESULT CQPasteWnd::OnItemDeleted(WPARAM wParam, LPARAM lParam)
 {
 	m_lstHeader.OnItemDeleted((int)wParam);
@@ -6134,18 +6107,11 @@ void CQPasteWnd::SelectFocusID()
 	ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
 	bool selectedItem = false;
-	int index = 0;
-	std::vector<CMainTable>::iterator iter = m_listItems.begin();
-	while (iter != m_listItems.end())
+	int index = m_listItems.Find(theApp.m_FocusID);
+	if (index >= 0)
 	{
-		if (iter->m_lID == theApp.m_FocusID)
-		{
-			m_lstHeader.SetListPos(index);
-			selectedItem = true;
-			break;
-		}
-		iter++;
-		index++;
+		m_lstHeader.SetListPos(index);
+		selectedItem = true;
 	}
 
 	if (selectedItem == false)
@@ -6282,7 +6248,7 @@ LRESULT CQPasteWnd::OnSelectAll(WPARAM wParam, LPARAM lParam)
 	BOOL ret = FALSE;
 	ATL::CCritSecLock csLock(m_CritSection.m_sect);
 
-	if ((int)m_listItems.size() < m_lstHeader.GetItemCount())
+	if (m_listItems.GetCount() < m_lstHeader.GetItemCount())
 	{
 		Log(_T("All items selected loading all items from the db"));
 
@@ -6474,20 +6440,12 @@ LRESULT CQPasteWnd::OnDeleteId(WPARAM wParam, LPARAM lParam)
 
 	IDs.Add((int)wParam);
 
-	bool selectedItem = false;
-	int index = 0;
 	{
 		ATL::CCritSecLock csLock(m_CritSection.m_sect);
-		std::vector<CMainTable>::iterator iter = m_listItems.begin();
-		while (iter != m_listItems.end())
+		int index = m_listItems.Find((int)wParam);
+		if (index >= 0)
 		{
-			if (iter->m_lID == wParam)
-			{
-				Indexs.Add(index);
-				break;
-			}
-			iter++;
-			index++;
+			Indexs.Add(index);
 		}
 	}
 
@@ -6566,24 +6524,14 @@ void CQPasteWnd::OnUpdateMenuSavecurrentclipboard(CCmdUI *pCmdUI)
 
 bool CQPasteWnd::SyncClipDataToArrayData(CClip &clip)
 {
-	int row = 0;
 	bool found = false;
-	std::vector<CMainTable>::iterator iter = m_listItems.begin();
-	while (iter != m_listItems.end())
+	int row = m_listItems.Find(clip.ID());
+	if (row >= 0)
 	{
-		if (iter->m_lID == clip.ID())
-		{
-			iter->m_clipOrder = clip.m_clipOrder;
-			iter->m_clipGroupOrder = clip.m_clipGroupOrder;
-
-			iter->m_stickyClipOrder = clip.m_stickyClipOrder;
-			iter->m_stickyClipGroupOrder = clip.m_stickyClipGroupOrder;
+		m_listItems.SetOrders(row, clip.m_clipOrder, clip.m_clipGroupOrder);
+		m_listItems.SetStickyOrders(row, clip.m_stickyClipOrder, clip.m_stickyClipGroupOrder);
 
-			found = true;
-			break;
-		}
-		iter++;
-		row++;
+		found = true;
 	}
 
 	return found;
@@ -6591,16 +6539,15 @@ bool CQPasteWnd::SyncClipDataToArrayData(CClip &clip)
 
 bool CQPasteWnd::SelectIds(ARRAY &ids)
 {
-	int row = 0;
 	bool found = false;
-	std::vector<CMainTable>::iterator iter = m_listItems.begin();
 
 	//sort so .Find works
 	ids.SortAscending();
 
-	while (iter != m_listItems.end())
+	int count = m_listItems.GetCount();
+	for (int row = 0; row < count; row++)
 	{
-		if (ids.Find(iter->m_lID))
+		if (ids.Find(m_listItems.GetId(row)))
 		{
 			if (found == false)
 			{
@@ -6613,8 +6560,6 @@ bool CQPasteWnd::SelectIds(ARRAY &ids)
 
 			found = true;
 		}
-		iter++;
-		row++;
 	}
 
 	return found;
@@ -7732,10 +7677,8 @@ bool CQPasteWnd::DoDeleteAllNonUsedClips()
 	DeleteNonUsedClips(true);
 	FillList();
 
-	m_cf_dibCache.clear();
-	m_cf_NO_dibCache.clear();
-	m_cf_rtfCache.clear();
-	m_cf_NO_rtfCache.clear();
+	m_imageCache.Clear();
+	m_rtfCache.Clear();
 
 	return true;
 }
@@ -12,6 +12,8 @@
 #include <map>
 #include <afxmt.h>
 #include "ClipFormatQListCtrl.h"
+#include "PreviewCache.h"
+#include "ListRows.h"
 #include "QPasteWndThread.h"
 #include "editwithbutton.h"
 #include "GdipButton.h"
@@ -21,76 +23,6 @@
 #include "Popup.h"
 #include "CustomFriendsHelper.h"
 
-class CMainTable
-{
-public:
-    CMainTable(): 
-		m_lID( - 1), 
-		m_bDontAutoDelete(false), 
-		m_bIsGroup(false), 
-		m_bHasShortCut(false), 
-		m_bHasParent(false),
-		m_dateCopied(0),
-		m_datePasted(0)
-	{
-
-	}
-
-    ~CMainTable()
-	{
-
-    }
-
-    long m_lID;
-    CString m_Desc;
-    bool m_bDontAutoDelete;
-    bool m_bIsGroup;
-    bool m_bHasShortCut;
-    bool m_bHasParent;
-    CString m_QuickPaste;
-	double m_clipOrder;
-	double m_clipGroupOrder;
-	double m_stickyClipOrder;
-	double m_stickyClipGroupOrder;
-	int m_dateCopied;
-	int m_datePasted;
-
-	static bool SortDesc(const CMainTable& d1, const CMainTable& d2)
-	{
-		double d1StickyOrder = d1.m_stickyClipOrder;
-		double d2StickyOrder = d2.m_stickyClipOrder;		
-
-		if (d1StickyOrder != d2StickyOrder)
-			return d1StickyOrder > d2StickyOrder;
-
-		if (d1.m_bIsGroup != d2.m_bIsGroup)
-			return d1.m_bIsGroup < d2.m_bIsGroup;
-
-		return d1.m_clipOrder > d2.m_clipOrder;
-	}
-
-	static bool GroupSortDesc(const CMainTable& d1, const CMainTable& d2)
-	{
-		double d1StickyOrder = d1.m_stickyClipGroupOrder;
-
-		double d2StickyOrder = d2.m_stickyClipGroupOrder;
-
-		if (d1StickyOrder != d2StickyOrder)
-			return d1StickyOrder > d2StickyOrder;
-
-		if (d1.m_bIsGroup != d2.m_bIsGroup)
-			return d1.m_bIsGroup < d2.m_bIsGroup;
-
-		return d1.m_clipGroupOrder > d2.m_clipGroupOrder;
-	}
-};
-
-
-typedef std::map < int, CMainTable > MainTypeMap;
-typedef std::map < int, CClipFormatQListCtrl > CF_DibTypeMap;
-typedef std::map < int, char > CF_NoDibTypeMap;
-
-
 
 /////////////////////////////////////////////////////////////////////////////
 // CQPasteWnd window
@@ -152,14 +84,12 @@ public:
 
     CQPasteWndThread m_thread;
 	CQPasteWndThread m_extraDataThread;
-	std::vector<CMainTable> m_listItems;
+	CListRows m_listItems;
 
 	std::list<CPoint> m_loadItems;
     std::list<CClipFormatQListCtrl> m_ExtraDataLoadItems;
-    CF_DibTypeMap m_cf_dibCache;
-	CF_NoDibTypeMap m_cf_NO_dibCache;
-    CF_DibTypeMap m_cf_rtfCache;
-	CF_NoDibTypeMap m_cf_NO_rtfCache;
+    CPreviewCache m_imageCache;
+    CPreviewCache m_rtfCache;
     CCriticalSection m_CritSection;
     CAccels m_actions;
 	CAccels m_toolTipActions;
@@ -433,6 +363,7 @@ protected:
     afx_msg LRESULT OnFillRestOfList(WPARAM wParam, LPARAM lParam);
     afx_msg LRESULT OnRefeshRow(WPARAM wParam, LPARAM lParam);
 	afx_msg LRESULT OnSetListCount(WPARAM wParam, LPARAM lParam);
+	afx_msg LRESULT OnRefineListCount(WPARAM wParam, LPARAM lParam);
     afx_msg HBRUSH CtlColor(CDC *pDC, UINT nCtlColor);
     afx_msg void OnNcLButtonDblClk(UINT nHitTest, CPoint point);
     afx_msg void OnViewcaptionbaronRight();
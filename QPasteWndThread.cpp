@@ -4,12 +4,15 @@
 #include "Options.h"
 #include "QPasteWnd.h"
 #include "cp_main.h"
+#include "Thumbnails.h"
 #include <vector>
 #include <algorithm>
 
 CQPasteWndThread::CQPasteWndThread(void)
 {
 	m_rowHeight = 0;
+	m_countRows = false;
+	m_searchId = 0;
 	m_threadName = "CQPasteWndThread";
     m_waitTimeout = ONE_HOUR * 12;
 
@@ -38,7 +41,7 @@ void CQPasteWndThread::OnEvent(int eventId, void *param)
     switch((eCQPasteWndThreadEvents)eventId)
     {
         case DO_SET_LIST_COUNT:
-            OnSetListCount(param);
+            OnSetListCount(param, -1);
             break;
         case LOAD_ACCELERATORS:
             OnLoadAccelerators(param);
@@ -58,7 +61,28 @@ void CQPasteWndThread::OnEvent(int eventId, void *param)
 	Log(StrF(_T("End of OnEvent, eventId: %s, Time: %d(ms)"), EnumName((eCQPasteWndThreadEvents)eventId), length));
 }
 
-void CQPasteWndThread::OnSetListCount(void *param)
+void CQPasteWndThread::SetSearchSql(CString sql, CString countSql, bool countRows, CString stickyOrderColumn, CString orderColumn)
+{
+	ATL::CCritSecLock csLock(m_sqlCritSection.m_sect);
+
+	m_sql = sql;
+	m_countSql = countSql;
+	m_countRows = countRows;
+	m_stickyOrderColumn = stickyOrderColumn;
+	m_orderColumn = orderColumn;
+	m_pageBoundaries.clear();
+	m_searchId++;
+}
+
+int CQPasteWndThread::GetSearchId()
+{
+	ATL::CCritSecLock csLock(m_sqlCritSection.m_sect);
+
+	return m_searchId;
+}
+
+//loadedRows are the rows of the first page, when counting a search they're shown as the count until the real count is read
+void CQPasteWndThread::OnSetListCount(void *param, int loadedRows)
 {
     CQPasteWnd *pasteWnd = (CQPasteWnd*)param;
 
@@ -69,14 +93,36 @@ void CQPasteWndThread::OnSetListCount(void *param)
     ResetEvent(m_SearchingEvent);
     long lTick = GetTickCount();
 
-	CString countSQL = m_countSql;
+	CString countSQL;
+	bool countRows = false;
+	int searchId = 0;
+	{
+		ATL::CCritSecLock csLock(m_sqlCritSection.m_sect);
+		countSQL = m_countSql;
+		countRows = m_countRows;
+		searchId = m_searchId;
+	}
 
     long lRecordCount = 0;
 
     try
     {
-        lRecordCount = theApp.m_db.execScalar(countSQL);
-        ::PostMessage(pasteWnd->m_hWnd, NM_SET_LIST_COUNT, lRecordCount, 0);
+        CDbReadConnection reader;
+		if (countRows)
+		{
+			if (loadedRows >= 0)
+			{
+				::PostMessage(pasteWnd->m_hWnd, NM_SET_LIST_COUNT, loadedRows, 0);
+			}
+
+			lRecordCount = CountRows(pasteWnd, reader.Db(), countSQL, searchId, loadedRows >= 0);
+		}
+		else
+		{
+			//MainCounts, this doesn't read Main
+	        lRecordCount = reader.Db().execScalar(countSQL);
+	        ::PostMessage(pasteWnd->m_hWnd, NM_SET_LIST_COUNT, lRecordCount, 0);
+		}
     }
     CATCH_SQLITE_EXCEPTION 
 
@@ -85,6 +131,50 @@ void CQPasteWndThread::OnSetListCount(void *param)
     Log(StrF(_T("Set list count = %d, time = %d"), lRecordCount, GetTickCount() - lTick));
 }
 
+//Steps through the ids a search matches. When refine is set the list was given the first page as its count, it's sent the count
+//as it grows so it can be scrolled while this runs, otherwise only the end count is sent. Returns -1 if the search changed first
+long CQPasteWndThread::CountRows(CQPasteWnd *pasteWnd, CppSQLite3DB &db, CString countSQL, int searchId, bool refine)
+{
+	long count = 0;
+	DWORD postTick = GetTickCount();
+
+	CppSQLite3Query q = db.execQuery(countSQL);
+	while (q.eof() == false)
+	{
+		count++;
+
+		if ((count % 1000) == 0)
+		{
+			if (pasteWnd->m_bStopQuery ||
+				GetSearchId() != searchId)
+			{
+				Log(StrF(_T("Search changed, stopped counting rows at %d"), count));
+				return -1;
+			}
+
+			if (refine &&
+				GetTickCount() - postTick > 250)
+			{
+				::PostMessage(pasteWnd->m_hWnd, NM_REFINE_LIST_COUNT, count, searchId);
+				postTick = GetTickCount();
+			}
+		}
+
+		q.nextRow();
+	}
+
+	if (refine)
+	{
+		::PostMessage(pasteWnd->m_hWnd, NM_REFINE_LIST_COUNT, count, searchId);
+	}
+	else
+	{
+		::PostMessage(pasteWnd->m_hWnd, NM_SET_LIST_COUNT, count, 0);
+	}
+
+	return count;
+}
+
 void CQPasteWndThread::OnLoadItems(void *param)
 {
     CQPasteWnd *pasteWnd = (CQPasteWnd*)param;
@@ -97,7 +187,9 @@ void CQPasteWndThread::OnLoadItems(void *param)
 	    int loadItemsIndex = 0;
 	    int loadItemsCount = 0;
 	    int loadCount = 0;
-		CString localSql = m_sql;
+		CString localSql;
+		CString stickyOrderColumn;
+		CString orderColumn;
 	    bool clearFirstLoadItem = false;
 		bool firstLoad = false;
 		int listSize = 0;
@@ -111,7 +203,7 @@ void CQPasteWndThread::OnLoadItems(void *param)
 		        loadItemsIndex = max(pasteWnd->m_loadItems.begin()->x, 0);
 		        loadItemsCount = pasteWnd->m_loadItems.begin()->y - pasteWnd->m_loadItems.begin()->x;
 		        pasteWnd->m_bStopQuery = false;
-				listSize = pasteWnd->m_listItems.size();
+				listSize = pasteWnd->m_listItems.GetCount();
 		        clearFirstLoadItem = true;
 		    }
 		}
@@ -122,54 +214,45 @@ void CQPasteWndThread::OnLoadItems(void *param)
 			{
 				Log(StrF(_T("Load Items start = %d, count = %d, list size: %d"), loadItemsIndex, loadItemsCount, listSize));
 
+				{
+					ATL::CCritSecLock csLock(m_sqlCritSection.m_sect);
+					localSql = m_sql;
+					stickyOrderColumn = m_stickyOrderColumn;
+					orderColumn = m_orderColumn;
+				}
+
 				int pos = loadItemsIndex;
-				CString limit;
-				limit.Format(_T(" LIMIT %d OFFSET %d"), loadItemsCount, loadItemsIndex);
-				localSql += limit;
+				CString pageSql = GetPageSql(localSql, stickyOrderColumn, orderColumn, loadItemsIndex, loadItemsCount, pasteWnd);
 
 				CMainTable table;
+				CListPageBoundary boundary;
+				int boundaryPos = -1;
 
-				CppSQLite3Query q = theApp.m_db.execQuery(localSql);
+				CDbReadConnection reader;
+				CppSQLite3Query q = reader.Db().execQuery(pageSql);
 				while(!q.eof())
 				{
 					CQPasteWnd::FillMainTable(table, q);
 
+					//remember the sort key of the last row so the next page can seek past it
+					boundary.m_id = table.m_lID;
+					boundary.m_stickyOrderNull = q.fieldIsNull(stickyOrderColumn);
+					boundary.m_stickyOrder = boundary.m_stickyOrderNull ? 0 : q.getFloatField(stickyOrderColumn);
+					boundary.m_isGroupNull = q.fieldIsNull(_T("bIsGroup"));
+					boundary.m_isGroup = boundary.m_isGroupNull ? 0 : q.getIntField(_T("bIsGroup"));
+					boundary.m_orderNull = q.fieldIsNull(orderColumn);
+					boundary.m_order = boundary.m_orderNull ? 0 : q.getFloatField(orderColumn);
+					boundaryPos = pos;
+
 					int updateIndex = -1;
 
 					{
 						ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
 
-						if (pos < pasteWnd->m_listItems.size())
-						{
-							pasteWnd->m_listItems[pos] = table;
-
-							updateIndex = pos;
-
-							//Log(StrF(_T("updating list pos = %d, id: %d, size: %d"), pos, table.m_lID, pasteWnd->m_listItems.size() - 1));
-						}
-						else if (pos == pasteWnd->m_listItems.size())
-						{
-							pasteWnd->m_listItems.push_back(table);
-							updateIndex = (int)pasteWnd->m_listItems.size() - 1;
-							//Log(StrF(_T("adding (same size) list pos = %d, id: %d, size: %d"), pasteWnd->m_listItems.size()-1, table.m_lID, pasteWnd->m_listItems.size() - 1));
-						}
-						else if (pos > pasteWnd->m_listItems.size())
-						{
-							for (int toAdd = (int)pasteWnd->m_listItems.size()-1; toAdd < pos - 1; toAdd++)
-							{
-								CMainTable empty;
-								empty.m_lID = -1;
-								pasteWnd->m_listItems.push_back(empty);
-
-								//Log(StrF(_T("adding dummy row size: %d"), pasteWnd->m_listItems.size()-1));
-							}
-
-							pasteWnd->m_listItems.push_back(table);
-
-							updateIndex = (int)pasteWnd->m_listItems.size() - 1;
+						//past the end adds the row, and empty rows with an id of -1 for any gap before it
+						pasteWnd->m_listItems.Set(pos, table);
 
-							//Log(StrF(_T("adding list pos = %d, id: %d, size: %d"), pasteWnd->m_listItems.size()-1, table.m_lID, pasteWnd->m_listItems.size() - 1));
-						}
+						updateIndex = pos;
 					}
 
 					if(pasteWnd->m_bStopQuery)
@@ -195,6 +278,20 @@ void CQPasteWndThread::OnLoadItems(void *param)
 					pos++;
 				}
 
+				//fewer rows than were asked for and not stopped, the first page is all there is
+				bool allRowsLoaded = (q.eof() && loadCount < loadItemsCount);
+
+				if (boundaryPos >= 0)
+				{
+					ATL::CCritSecLock csLock(m_sqlCritSection.m_sect);
+
+					//only keep it if the search didn't change while we were loading
+					if (m_sql == localSql)
+					{
+						m_pageBoundaries[boundaryPos] = boundary;
+					}
+				}
+
 				DWORD loadCount = GetTickCount() - startTick;
 				DWORD countCountStart = GetTickCount();
 				DWORD countCount = 0;
@@ -205,7 +302,23 @@ void CQPasteWndThread::OnLoadItems(void *param)
 					::PostMessage(pasteWnd->m_hWnd, NM_REFRESH_ROW, -2, 0);
 					//allow the next thread message to process, this should be the message to set the list count
 
-					OnSetListCount(param);
+					bool countRows = false;
+					{
+						ATL::CCritSecLock csLock(m_sqlCritSection.m_sect);
+						countRows = m_countRows;
+					}
+
+					if (countRows &&
+						allRowsLoaded)
+					{
+						//a search that fit in the first page doesn't need to be counted again
+						::PostMessage(pasteWnd->m_hWnd, NM_SET_LIST_COUNT, pos, 0);
+						Log(StrF(_T("Set list count from the loaded rows = %d"), pos));
+					}
+					else
+					{
+						OnSetListCount(param, pos);
+					}
 					
 					countCount = GetTickCount() - countCountStart;
 					DWORD acceleratorCountStart = GetTickCount();
@@ -226,7 +339,13 @@ void CQPasteWndThread::OnLoadItems(void *param)
 					pasteWnd->m_loadItems.erase(pasteWnd->m_loadItems.begin());
 				}
 
-				Log(StrF(_T("Load items End count = %d, Total Time = %d, LoadItems: %d, Count: %d, Accel: %d"), loadCount, GetTickCount() - startTick, loadCount, countCount, acceleratorCount));
+				size_t listBytes = 0;
+				{
+					ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
+					listBytes = pasteWnd->m_listItems.GetBytes();
+				}
+
+				Log(StrF(_T("Load items End count = %d, Total Time = %d, LoadItems: %d, Count: %d, Accel: %d, List bytes: %Iu"), loadCount, GetTickCount() - startTick, loadCount, countCount, acceleratorCount, listBytes));
 			}
 			catch (CppSQLite3Exception& e)	\
 			{								\
@@ -244,41 +363,110 @@ void CQPasteWndThread::OnLoadItems(void *param)
     SetEvent(m_SearchingEvent);
 }
 
-void ReduceMapItems(CF_DibTypeMap &mapItem, CCriticalSection &critSection, CString mapName)
+CString CQPasteWndThread::GetOrderBy(CString tablePrefix, CString stickyOrderColumn, CString orderColumn)
 {
-	ATL::CCritSecLock csLock(critSection.m_sect);
+	//lID is last so rows with the same order have a unique key to seek past, it's the rowid so the index still covers the sort
+	return StrF(_T(" order by %s%s DESC, %sbIsGroup ASC, %s%s DESC, %slID ASC"), tablePrefix, stickyOrderColumn, tablePrefix, tablePrefix, orderColumn, tablePrefix);
+}
 
-	int maxSize = 50;
-	int reduceToSize = 30;
+CString CQPasteWndThread::GetPageSql(CString sql, CString stickyOrderColumn, CString orderColumn, int start, int count, CQPasteWnd *pasteWnd)
+{
+	int boundaryPos = -1;
+	CListPageBoundary boundary;
 
-	if (mapItem.size() > maxSize)
+	if (start <= 0 ||
+		FindPageBoundary(sql, start, pasteWnd, boundaryPos, boundary) == false)
 	{
-		//create a vector so we can sort and keep the last x number of events
-		vector<INT64> counterArray;
-		for (CF_DibTypeMap::iterator iterDib = mapItem.begin(); iterDib != mapItem.end(); iterDib++)
+		return sql + GetOrderBy(_T("Main."), stickyOrderColumn, orderColumn) + StrF(_T(" LIMIT %d OFFSET %d"), count, max(start, 0));
+	}
+
+	//a jump past the rows we have loaded still has to skip the rows between the closest boundary and the start
+	int skip = start - boundaryPos - 1;
+
+	CString stickyColumn = _T("Main.") + stickyOrderColumn;
+	CString sortColumn = _T("Main.") + orderColumn;
+
+	CString stickyEqual = boundary.m_stickyOrderNull ? StrF(_T("%s IS NULL"), stickyColumn) : StrF(_T("%s = %.17g"), stickyColumn, boundary.m_stickyOrder);
+	CString groupEqual = boundary.m_isGroupNull ? CString(_T("Main.bIsGroup IS NULL")) : StrF(_T("Main.bIsGroup = %d"), boundary.m_isGroup);
+	CString orderEqual = boundary.m_orderNull ? StrF(_T("%s IS NULL"), sortColumn) : StrF(_T("%s = %.17g"), sortColumn, boundary.m_order);
+
+	//rows after the boundary split into ranges that can each seek into Main_TopLevel/Main_InGroup2
+	//a single where clause OR'ing these together can only seek on the first column and ends up scanning.
+	//Nulls sort last in the DESC columns and first in bIsGroup ASC, so a null boundary has nothing after it in a DESC column
+	//and everything that isn't null after it in bIsGroup
+	std::vector<CString> afterBoundary;
+	afterBoundary.push_back(StrF(_T("%s AND %s AND %s AND Main.lID > %d"), stickyEqual, groupEqual, orderEqual, boundary.m_id));
+	if (boundary.m_orderNull == false)
+	{
+		afterBoundary.push_back(StrF(_T("%s AND %s AND %s < %.17g"), stickyEqual, groupEqual, sortColumn, boundary.m_order));
+		afterBoundary.push_back(StrF(_T("%s AND %s AND %s IS NULL"), stickyEqual, groupEqual, sortColumn));
+	}
+	if (boundary.m_isGroupNull)
+	{
+		afterBoundary.push_back(StrF(_T("%s AND Main.bIsGroup IS NOT NULL"), stickyEqual));
+	}
+	else
+	{
+		afterBoundary.push_back(StrF(_T("%s AND Main.bIsGroup > %d"), stickyEqual, boundary.m_isGroup));
+	}
+	if (boundary.m_stickyOrderNull == false)
+	{
+		afterBoundary.push_back(StrF(_T("%s < %.17g"), stickyColumn, boundary.m_stickyOrder));
+		afterBoundary.push_back(StrF(_T("%s IS NULL"), stickyColumn));
+	}
+
+	CString innerOrderBy = GetOrderBy(_T("Main."), stickyOrderColumn, orderColumn);
+	CString pageSql;
+
+	for (size_t i = 0; i < afterBoundary.size(); i++)
+	{
+		if (i > 0)
 		{
-			counterArray.push_back(iterDib->second.m_counter);
+			pageSql += _T(" UNION ALL ");
 		}
-		std::sort(counterArray.begin(), counterArray.end());
-		counterArray.erase(counterArray.begin(), counterArray.end() - reduceToSize);
 
-		//remove the oldest x number if bitmaps
-		for (CF_DibTypeMap::iterator iterDib = mapItem.begin(); iterDib != mapItem.end();)
-		{
-			if (std::binary_search(counterArray.begin(), counterArray.end(), iterDib->second.m_counter) == false)
-			{
-				Log(StrF(_T("reduced size of %s cache, Id: %d, Row: %d"), mapName, iterDib->second.m_parentId, iterDib->second.m_clipRow));
+		//sql ends with its where clause in brackets, the range is too so neither can change what the other's ORs apply to
+		pageSql += StrF(_T("SELECT * FROM (%s AND (%s)%s LIMIT %d)"), sql, afterBoundary[i], innerOrderBy, count + skip);
+	}
 
-				mapItem.erase(iterDib++);
-			}
-			else
-			{
-				++iterDib;
-			}
+	pageSql += GetOrderBy(_T(""), stickyOrderColumn, orderColumn);
+	pageSql += StrF(_T(" LIMIT %d OFFSET %d"), count, skip);
+
+	Log(StrF(_T("Loading items from page boundary, position: %d, id: %d, skip: %d"), boundaryPos, boundary.m_id, skip));
+
+	return pageSql;
+}
+
+bool CQPasteWndThread::FindPageBoundary(CString sql, int start, CQPasteWnd *pasteWnd, int &boundaryPos, CListPageBoundary &boundary)
+{
+	//the list lock is taken first, FillList can hold it while setting the search sql
+	ATL::CCritSecLock listLock(pasteWnd->m_CritSection.m_sect);
+	ATL::CCritSecLock csLock(m_sqlCritSection.m_sect);
+
+	if (m_sql != sql)
+	{
+		return false;
+	}
+
+	//closest boundary at or before the row before start
+	std::map<int, CListPageBoundary>::iterator it = m_pageBoundaries.upper_bound(start - 1);
+	while (it != m_pageBoundaries.begin())
+	{
+		it--;
+
+		//clips deleted or moved in the list shift positions, only use a boundary if its clip is still at that position
+		if (it->first < pasteWnd->m_listItems.GetCount() &&
+			pasteWnd->m_listItems.GetId(it->first) == it->second.m_id)
+		{
+			boundaryPos = it->first;
+			boundary = it->second;
+			return true;
 		}
 
-		Log(StrF(_T("reduced size of %s cache, count: %d"), mapName, mapItem.size()));
+		it = m_pageBoundaries.erase(it);
 	}
+
+	return false;
 }
 
 void CQPasteWndThread::OnLoadExtraData(void *param)
@@ -289,6 +477,13 @@ void CQPasteWndThread::OnLoadExtraData(void *param)
 
     Log(_T("Start of load extra data, Bitmaps/rtf"));
 
+	//image clips saved from now on get a thumbnail at this height
+	if (m_rowHeight > 0 &&
+		CThumbnails::HeightBucket(m_rowHeight) != CGetSetOptions::GetThumbnailHeight())
+	{
+		CGetSetOptions::SetThumbnailHeight(CThumbnails::HeightBucket(m_rowHeight));
+	}
+
     std::list<CClipFormatQListCtrl> localFormats;
 	{
 		ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
@@ -308,51 +503,50 @@ void CQPasteWndThread::OnLoadExtraData(void *param)
 		{
 			ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
 
-			CF_DibTypeMap::iterator iterDib = pasteWnd->m_cf_dibCache.find(it->m_parentId);
-			if (iterDib != pasteWnd->m_cf_dibCache.end())
+			if (pasteWnd->m_imageCache.Contains(it->m_parentId))
 			{
 				loadClip = false;
 			}
-			else
-			{
-				CF_NoDibTypeMap::iterator iterNoDib = pasteWnd->m_cf_NO_dibCache.find(it->m_parentId);
-				if (iterNoDib != pasteWnd->m_cf_NO_dibCache.end())
-				{
-					loadClip = false;
-				}
-			}
 		}
 		else if (it->m_cfType == theApp.m_RTFFormat)
 		{
 			ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
 
-			CF_DibTypeMap::iterator iterDib = pasteWnd->m_cf_rtfCache.find(it->m_parentId);
-			if (iterDib != pasteWnd->m_cf_rtfCache.end())
+			if (pasteWnd->m_rtfCache.Contains(it->m_parentId))
 			{
 				loadClip = false;
 			}
-			else
-			{
-				CF_NoDibTypeMap::iterator iterNoRtf = pasteWnd->m_cf_NO_rtfCache.find(it->m_parentId);
-				if (iterNoRtf != pasteWnd->m_cf_NO_rtfCache.end())
-				{
-					loadClip = false;
-				}
-			}
 		}
 
 		if (loadClip)
 		{
 			DWORD startLoadClipData = GetTickCount();
 
-			BOOL foundClipData = theApp.GetClipData(it->m_parentId, *it);
-			if (foundClipData == false &&
-				it->m_cfType == CF_DIB)
+			BOOL foundClipData = FALSE;
+			bool foundThumbnail = false;
 			{
-				it->Free();
-				it->m_cfType = theApp.m_PNG_Format;
+				CDbReadConnection reader;
+
+				//the thumbnail is a few kb, the image can be many mb
+				if (it->m_cfType == CF_DIB)
+				{
+					foundThumbnail = CThumbnails::Load(reader.Db(), it->m_parentId, m_rowHeight, *it);
+					foundClipData = foundThumbnail;
+				}
 
-				foundClipData = theApp.GetClipData(it->m_parentId, *it);
+				if (foundClipData == false)
+				{
+					foundClipData = theApp.GetClipData(it->m_parentId, *it, reader.Db());
+				}
+
+				if (foundClipData == false &&
+					it->m_cfType == CF_DIB)
+				{
+					it->Free();
+					it->m_cfType = theApp.m_PNG_Format;
+
+					foundClipData = theApp.GetClipData(it->m_parentId, *it, reader.Db());
+				}
 			}
 
 			if (foundClipData)
@@ -370,7 +564,8 @@ void CQPasteWndThread::OnLoadExtraData(void *param)
 
 					HDC dc = GetDC(NULL);
 
-					it->GetDibFittingToHeight(CDC::FromHandle(dc), m_rowHeight);
+					//the thumbnail height so a thumbnail made from it matches one made when the clip was saved
+					it->GetDibFittingToHeight(CDC::FromHandle(dc), CThumbnails::HeightBucket(m_rowHeight));
 
 					ReleaseDC(NULL, dc);
 
@@ -380,26 +575,29 @@ void CQPasteWndThread::OnLoadExtraData(void *param)
 						Log(StrF(_T("GetDibFittingToHeight for clip %d, took: %d"), it->m_parentId, GetTickCount() - startConvertImage));
 					}
 
+					//clips saved before thumbnails, or at another row height, have theirs saved the first time they're shown
+					if (foundThumbnail == false &&
+						it->m_hgData != NULL &&
+						m_rowHeight > 0)
+					{
+						CThumbnails::Save(it->m_parentId, m_rowHeight, it->m_hgData);
+					}
+
 					{
 						ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
 
-						pasteWnd->m_cf_dibCache[it->m_parentId] = *it;
-						//the cache now owns the format data, set it to delete the data in the destructor
-						pasteWnd->m_cf_dibCache[it->m_parentId].m_autoDeleteData = true;
+						pasteWnd->m_imageCache.Add(*it);
 
-						Log(StrF(_T("Loaded, extra data for clipId: %d, Row: %d image cache count: %d"), it->m_parentId, it->m_clipRow, pasteWnd->m_cf_dibCache.size()));
+						Log(StrF(_T("Loaded, extra data for clipId: %d, Row: %d image cache count: %d"), it->m_parentId, it->m_clipRow, pasteWnd->m_imageCache.GetCount()));
 					}
 				}
 				else if (it->m_cfType == theApp.m_RTFFormat)
 				{
 					ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
 
-					pasteWnd->m_cf_rtfCache[it->m_parentId] = *it;
-					it->m_autoDeleteData = false;
-					//the cache now owns the format data, set it to delete the data in the destructor
-					pasteWnd->m_cf_rtfCache[it->m_parentId].m_autoDeleteData = true;
+					pasteWnd->m_rtfCache.Add(*it);
 
-					Log(StrF(_T("Loaded, extra data for clip %d, rtf cache count: %d"), it->m_parentId, pasteWnd->m_cf_rtfCache.size()));
+					Log(StrF(_T("Loaded, extra data for clip %d, rtf cache count: %d"), it->m_parentId, pasteWnd->m_rtfCache.GetCount()));
 				}
 
 				::PostMessage(pasteWnd->m_hWnd, NM_REFRESH_ROW, it->m_parentId, it->m_clipRow);
@@ -411,25 +609,23 @@ void CQPasteWndThread::OnLoadExtraData(void *param)
 				if (it->m_cfType == CF_DIB ||
 					it->m_cfType == theApp.m_PNG_Format)
 				{
-					pasteWnd->m_cf_NO_dibCache[it->m_parentId] = true;
+					pasteWnd->m_imageCache.AddMissing(it->m_parentId, CF_DIB);
 				}
 				else if (it->m_cfType == theApp.m_RTFFormat)
 				{
-					pasteWnd->m_cf_NO_rtfCache[it->m_parentId] = true;
+					pasteWnd->m_rtfCache.AddMissing(it->m_parentId, theApp.m_RTFFormat);
 				}
 			}
 		}
-
-		if (it->m_cfType == CF_DIB)
-		{
-			ReduceMapItems(pasteWnd->m_cf_dibCache, pasteWnd->m_CritSection, _T("image"));
-		}
-		else if (it->m_cfType == theApp.m_RTFFormat)
-		{
-			ReduceMapItems(pasteWnd->m_cf_rtfCache, pasteWnd->m_CritSection, _T("rtf"));
-		}
     }
 
+	{
+		ATL::CCritSecLock csLock(pasteWnd->m_CritSection.m_sect);
+
+		pasteWnd->m_imageCache.LogStats();
+		pasteWnd->m_rtfCache.LogStats();
+	}
+
     SetEvent(m_SearchingEvent);
     Log(_T("End of load extra data, Bitmaps/rtf"));
 }
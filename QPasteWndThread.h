@@ -1,6 +1,23 @@
 #pragma once
 #include "EventThread.h"
 #include "sqlite/CppSQLite3.h"
+#include <map>
+
+class CQPasteWnd;
+
+//sort key of the last row of a loaded page, the next page is loaded by seeking past this key instead of using OFFSET
+class CListPageBoundary
+{
+public:
+	int m_id;
+	double m_stickyOrder;
+	int m_isGroup;
+	double m_order;
+	//most clips have no sticky order, a null key is sorted like sqlite compares it, smaller than any value
+	bool m_stickyOrderNull;
+	bool m_isGroupNull;
+	bool m_orderNull;
+};
 
 class CQPasteWndThread: public CEventThread
 {
@@ -45,23 +62,36 @@ public:
     HANDLE m_SearchingEvent;
 
 	void SetRowHeight(int height) { m_rowHeight = height; }
-    void SetSearchSql(CString sql, CString countSql) { m_sql = sql; m_countSql = countSql; }
+    void SetSearchSql(CString sql, CString countSql, bool countRows, CString stickyOrderColumn, CString orderColumn);
+	int GetSearchId();
 
 protected:
     virtual void OnEvent(int eventId, void *param);
     virtual void OnTimeOut(void *param);
 
-    void OnSetListCount(void *param);
+    void OnSetListCount(void *param, int loadedRows);
+	long CountRows(CQPasteWnd *pasteWnd, CppSQLite3DB &db, CString countSQL, int searchId, bool refine);
     void OnLoadItems(void *param);
     void OnLoadExtraData(void *param);
-	//void ReduceMapItems(CF_DibTypeMap mapItem, CCriticalSection &critSection, CString mapName);
     void OnLoadAccelerators(void *param);
     void OnUnloadAccelerators(void *param);
 
 	CString EnumName(eCQPasteWndThreadEvents e);
 
+	CString GetOrderBy(CString tablePrefix, CString stickyOrderColumn, CString orderColumn);
+	CString GetPageSql(CString sql, CString stickyOrderColumn, CString orderColumn, int start, int count, CQPasteWnd *pasteWnd);
+	bool FindPageBoundary(CString sql, int start, CQPasteWnd *pasteWnd, int &boundaryPos, CListPageBoundary &boundary);
+
 	int m_rowHeight;
 
     CString m_sql;
     CString m_countSql;
+	//m_countSql selects the ids of a search instead of counting them, they're counted as they're read
+	bool m_countRows;
+	//changes each time the sql is set, counts posted for an older search are ignored
+	int m_searchId;
+	CString m_stickyOrderColumn;
+	CString m_orderColumn;
+	std::map<int, CListPageBoundary> m_pageBoundaries;
+	CCriticalSection m_sqlCritSection;
 };
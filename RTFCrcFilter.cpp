@@ -0,0 +1,260 @@
+#include "stdafx.h"
+#include "RTFCrcFilter.h"
+#include "Crc32Dynamic.h"
+
+namespace
+{
+	class CRTFCrcSink
+	{
+	public:
+		virtual ~CRTFCrcSink() {}
+
+		virtual void Put(char c) = 0;
+		virtual void Finish() = 0;
+	};
+
+	//buffers the filtered rtf so the crc still runs over blocks
+	class CRTFCrcAccumulator : public CRTFCrcSink
+	{
+	public:
+		CRTFCrcAccumulator(DWORD dwCrc32) : m_crc(dwCrc32), m_used(0) {}
+
+		virtual void Put(char c)
+		{
+			m_buffer[m_used++] = (BYTE)c;
+			if (m_used == sizeof(m_buffer))
+			{
+				Flush();
+			}
+		}
+
+		virtual void Finish()
+		{
+			Flush();
+		}
+
+		DWORD Crc() { return m_crc; }
+
+	protected:
+		void Flush()
+		{
+			m_crc = CCrc32Dynamic::UpdateCrc32(m_crc, m_buffer, m_used);
+			m_used = 0;
+		}
+
+		DWORD m_crc;
+		BYTE m_buffer[4096];
+		size_t m_used;
+	};
+
+	//streaming version of DeleteParamFromRTF, only the chars that could still be part of a match are held back
+	class CRTFParamFilter : public CRTFCrcSink
+	{
+	public:
+		CRTFParamFilter(const char *param, bool searchForTrailingDigits, CRTFCrcSink &next) :
+			m_param(param),
+			m_paramLength((int)strlen(param)),
+			m_searchForTrailingDigits(searchForTrailingDigits),
+			m_next(next),
+			m_last(0)
+		{
+		}
+
+		virtual void Put(char c)
+		{
+			int pendingLength = m_pending.GetLength();
+
+			if (pendingLength == 0)
+			{
+				if (c == m_param[0])
+				{
+					m_pending.AppendChar(c);
+				}
+				else
+				{
+					Emit(c);
+				}
+				return;
+			}
+
+			if (pendingLength < m_paramLength)
+			{
+				if (c != m_param[pendingLength])
+				{
+					Reject(&c);
+					return;
+				}
+
+				m_pending.AppendChar(c);
+
+				if (pendingLength + 1 == m_paramLength &&
+					m_searchForTrailingDigits == false)
+				{
+					//leave it if the preceding character is \\, same as DeleteParamFromRTF
+					if (m_last == '\\')
+					{
+						Reject(NULL);
+					}
+					else
+					{
+						m_pending.Empty();
+					}
+				}
+				return;
+			}
+
+			//have the whole param, collecting its digits
+			if (c >= '0' && c <= '9')
+			{
+				m_pending.AppendChar(c);
+				return;
+			}
+
+			if (pendingLength > m_paramLength &&
+				m_last != '\\')
+			{
+				m_pending.Empty();
+				Put(c);
+			}
+			else
+			{
+				Reject(&c);
+			}
+		}
+
+		virtual void Finish()
+		{
+			while (m_pending.GetLength() > 0)
+			{
+				//the digits ran to the end of the rtf, DeleteParamFromRTF stops and leaves these
+				if (m_searchForTrailingDigits &&
+					m_pending.GetLength() >= m_paramLength &&
+					m_last != '\\')
+				{
+					CStringA pending = m_pending;
+					m_pending.Empty();
+
+					for (int i = 0; i < pending.GetLength(); i++)
+					{
+						Emit(pending[i]);
+					}
+					break;
+				}
+
+				Reject(NULL);
+			}
+
+			m_next.Finish();
+		}
+
+	protected:
+		void Emit(char c)
+		{
+			m_last = c;
+			m_next.Put(c);
+		}
+
+		//not a match, the first held back char goes out and the rest are checked again starting at the next char
+		void Reject(const char *next)
+		{
+			CStringA recheck = m_pending.Mid(1);
+			if (next != NULL)
+			{
+				recheck.AppendChar(*next);
+			}
+
+			Emit(m_pending[0]);
+			m_pending.Empty();
+
+			for (int i = 0; i < recheck.GetLength(); i++)
+			{
+				Put(recheck[i]);
+			}
+		}
+
+		const char *m_param;
+		int m_paramLength;
+		bool m_searchForTrailingDigits;
+		CRTFCrcSink &m_next;
+		CStringA m_pending;
+		char m_last;
+	};
+}
+
+DWORD CRTFCrcFilter::UpdateCrc32(DWORD dwCrc32, const char *rtf, size_t length)
+{
+	CRTFCrcAccumulator crc(dwCrc32);
+
+	//applied in the same order GenerateCRC always has
+	CRTFParamFilter mdispDef("\\mdispDef1", false, crc);
+	CRTFParamFilter insrsid("\\insrsid", true, mdispDef);
+	CRTFParamFilter rsid("\\rsid", true, insrsid);
+
+	//In word and outlook I was finding that data in the \\datastore section was always changing, skip this for the crc check
+	size_t sectionStart = length;
+	size_t sectionEnd = length;
+	if (FindSection(rtf, length, "{\\*\\datastore", sectionStart, sectionEnd) == false)
+	{
+		sectionStart = length;
+		sectionEnd = length;
+	}
+
+	for (size_t i = 0; i < sectionStart; i++)
+	{
+		rsid.Put(rtf[i]);
+	}
+
+	for (size_t i = sectionEnd; i < length; i++)
+	{
+		rsid.Put(rtf[i]);
+	}
+
+	rsid.Finish();
+
+	return crc.Crc();
+}
+
+//same as RemoveRTFSection, the first section and only if its closing brace is found, sectionEnd is one past the brace
+bool CRTFCrcFilter::FindSection(const char *rtf, size_t length, const char *section, size_t &sectionStart, size_t &sectionEnd)
+{
+	size_t sectionLength = strlen(section);
+	if (length < sectionLength)
+	{
+		return false;
+	}
+
+	for (size_t start = 0; start <= length - sectionLength; start++)
+	{
+		if (memcmp(rtf + start, section, sectionLength) != 0)
+		{
+			continue;
+		}
+
+		int in = 0;
+		for (size_t pos = start + 1; pos < length; pos++)
+		{
+			if (rtf[pos] == '{')
+			{
+				in++;
+			}
+
+			if (rtf[pos] == '}')
+			{
+				if (in > 0)
+				{
+					in--;
+				}
+				else
+				{
+					sectionStart = start;
+					sectionEnd = pos + 1;
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	return false;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+//Adds rtf to a running crc while leaving out the parts word and outlook change on every copy ({\*\datastore, \rsid, \insrsid, \mdispDef1)
+//Gives the same crc as running RemoveRTFSection and DeleteParamFromRTF on a copy of the rtf, in one pass without making the copy
+class CRTFCrcFilter
+{
+public:
+	static DWORD UpdateCrc32(DWORD dwCrc32, const char *rtf, size_t length);
+
+protected:
+	static bool FindSection(const char *rtf, size_t length, const char *section, size_t &sectionStart, size_t &sectionEnd);
+};
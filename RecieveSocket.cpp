@@ -4,6 +4,11 @@
 #include "Misc.h"
 #include "CP_Main.h"
 #include "shared/TextConvert.h"
+#include "NetworkCompress.h"
+
+CCriticalSection CRecieveSocket::m_keyIdsLock;
+std::map<ULONGLONG, CRecieveSocket::CKeyIdPassword> CRecieveSocket::m_keyIds;
+bool CRecieveSocket::m_keyIdsLoaded = false;
 
 CRecieveSocket::CRecieveSocket(SOCKET sock)
 {
@@ -48,6 +53,12 @@ LPVOID CRecieveSocket::ReceiveEncryptedData(long lInSize, long &lOutSize)
 	if(m_pDataReturnedFromDecrypt)
 		FreeDecryptedData();
 
+	if(lInSize < (long)sizeof(TD_TLHEADER))
+	{
+		LogSendRecieveInfo(StrF(_T("ReceiveEncryptedData:: size %d is smaller than the header"), lInSize));
+		return NULL;
+	}
+
 	char *pInput = new char[lInSize];
 
 	UCHAR* pOutput = NULL;
@@ -56,14 +67,53 @@ LPVOID CRecieveSocket::ReceiveEncryptedData(long lInSize, long &lOutSize)
 	{
 		int nOut = 0;
 
-		if(RecieveExactSize(pInput, lInSize))
+		//read the header first, it says what password was used so the body is only read if we have it
+		BYTE keyId[TD_KEYID_SIZE];
+		bool hasKeyId = false;
+		CStringA csKeyIdPassword;
+		INT_PTR nKeyIdIndex = -2;
+		BOOL bReadBody = FALSE;
+
+		if(RecieveExactSize(pInput, sizeof(TD_TLHEADER)) == FALSE)
 		{
+			LogSendRecieveInfo(StrF(_T("ReceiveEncryptedData:: FAILED reading header"), lInSize));
+		}
+		else if(CEncryption::GetHeaderKeyId((UCHAR*)pInput, sizeof(TD_TLHEADER), keyId, hasKeyId) == false)
+		{
+			LogSendRecieveInfo(_T("ReceiveEncryptedData:: invalid header, not reading the data"));
+		}
+		else if(hasKeyId && FindKeyIdPassword(keyId, csKeyIdPassword, nKeyIdIndex) == FALSE)
+		{
+			LogSendRecieveInfo(_T("ReceiveEncryptedData:: data was encrypted with a password we don't have, not reading the data"));
+		}
+		else if(RecieveExactSize(pInput + sizeof(TD_TLHEADER), lInSize - sizeof(TD_TLHEADER)) == FALSE)
+		{
+			LogSendRecieveInfo(StrF(_T("ReceiveEncryptedData:: FAILED"), lInSize));
+		}
+		else
+		{
+			bReadBody = TRUE;
+		}
+
+		if(bReadBody && hasKeyId)
+		{
+			if(m_pEncryptor->Decrypt((UCHAR*)pInput, lInSize, csKeyIdPassword, pOutput, nOut) == FALSE)
+			{
+				LogSendRecieveInfo(_T("ReceiveEncryptedData:: Failed to Decrypt data with the password matching the key id"));
+			}
+			else
+			{
+				theApp.m_lLastGoodIndexForNextworkPassword = (long)nKeyIdIndex;
+			}
+		}
+		else if(bReadBody)
+		{
+			//sent by a version without key ids, try each password
 			CStringA csPassword;
 			INT_PTR count = g_Opt.m_csNetworkPasswordArray.GetSize();
 			INT_PTR nIndex;
 			for(int i = -2; i < count; i++)
 			{
-				csPassword.Empty();
 				nIndex = i;
 
 				//First time through try the last index that was valid
@@ -74,20 +124,9 @@ LPVOID CRecieveSocket::ReceiveEncryptedData(long lInSize, long &lOutSize)
 						continue;
 				}
 
-				if(nIndex == -1)
-				{
-					csPassword = g_Opt.m_csPassword;
-				}
-				else
+				if(GetNetworkPassword(nIndex, csPassword) == FALSE)
 				{
-					if(nIndex >= 0 && nIndex < count)
-					{
-						csPassword = CTextConvert::UnicodeToUTF8(g_Opt.m_csNetworkPasswordArray[nIndex]);
-					}
-					else
-					{
-						continue;
-					}
+					continue;
 				}
 
 				if(m_pEncryptor->Decrypt((UCHAR*)pInput, lInSize, csPassword, pOutput, nOut) == FALSE)
@@ -101,10 +140,6 @@ LPVOID CRecieveSocket::ReceiveEncryptedData(long lInSize, long &lOutSize)
 				}
 			}
 		}
-		else
-		{
-			LogSendRecieveInfo(StrF(_T("ReceiveEncryptedData:: FAILED"), lInSize));
-		}
 
 		lOutSize = nOut;
 
@@ -122,6 +157,227 @@ LPVOID CRecieveSocket::ReceiveEncryptedData(long lInSize, long &lOutSize)
 	return pOutput;
 }
 
+//-1 is our password, 0 and up are the network passwords
+BOOL CRecieveSocket::GetNetworkPassword(INT_PTR nIndex, CStringA &csPassword)
+{
+	csPassword.Empty();
+
+	if(nIndex == -1)
+	{
+		csPassword = g_Opt.m_csPassword;
+		return TRUE;
+	}
+
+	if(nIndex >= 0 && nIndex < g_Opt.m_csNetworkPasswordArray.GetSize())
+	{
+		csPassword = CTextConvert::UnicodeToUTF8(g_Opt.m_csNetworkPasswordArray[nIndex]);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+//Works out the key id of each password, called when the passwords are loaded or changed so finding
+//the password for a message is a lookup, the passwords are stretched here and not for each sender
+void CRecieveSocket::LoadKeyIds()
+{
+	std::map<ULONGLONG, CKeyIdPassword> keyIds;
+	CEncryption encryption;
+	CStringA csPassword;
+	BYTE keyId[TD_KEYID_SIZE];
+
+	INT_PTR count = g_Opt.m_csNetworkPasswordArray.GetSize();
+	for(INT_PTR i = -1; i < count; i++)
+	{
+		if(GetNetworkPassword(i, csPassword) == FALSE ||
+			csPassword.IsEmpty())
+		{
+			continue;
+		}
+
+		if(encryption.GetKeyId(csPassword, keyId) == false)
+		{
+			Log(StrF(_T("LoadKeyIds - failed to get the key id of password %d"), (int)i));
+			continue;
+		}
+
+		ULONGLONG id;
+		memcpy(&id, keyId, sizeof(id));
+
+		//the same password can be in the list more than once, keep the first like trying them in order did
+		if(keyIds.find(id) == keyIds.end())
+		{
+			CKeyIdPassword &keyIdPassword = keyIds[id];
+			keyIdPassword.m_csPassword = csPassword;
+			keyIdPassword.m_nIndex = i;
+		}
+	}
+
+	ATL::CCritSecLock lock(m_keyIdsLock.m_sect);
+
+	m_keyIds.swap(keyIds);
+	m_keyIdsLoaded = true;
+}
+
+BOOL CRecieveSocket::FindKeyIdPassword(const BYTE *pKeyId, CStringA &csPassword, INT_PTR &nIndex)
+{
+	bool loaded;
+	{
+		ATL::CCritSecLock lock(m_keyIdsLock.m_sect);
+		loaded = m_keyIdsLoaded;
+	}
+
+	if(loaded == false)
+	{
+		LoadKeyIds();
+	}
+
+	ULONGLONG id;
+	memcpy(&id, pKeyId, sizeof(id));
+
+	ATL::CCritSecLock lock(m_keyIdsLock.m_sect);
+
+	std::map<ULONGLONG, CKeyIdPassword>::iterator found = m_keyIds.find(id);
+	if(found == m_keyIds.end())
+	{
+		csPassword.Empty();
+		return FALSE;
+	}
+
+	csPassword = found->second.m_csPassword;
+	nIndex = found->second.m_nIndex;
+
+	return TRUE;
+}
+
+//Reads the records sent by CSendSocket::SendEncryptedChunks straight into the returned global,
+//only one record is held decrypted at a time
+HGLOBAL CRecieveSocket::ReceiveEncryptedChunks(INT_PTR totalSize, bool bCompressed)
+{
+	if(totalSize <= 0)
+	{
+		LogSendRecieveInfo(StrF(_T("ReceiveEncryptedChunks:: invalid size %d"), (int)totalSize));
+		return NULL;
+	}
+
+	HGLOBAL hData = NewGlobal(totalSize);
+	if(hData == NULL)
+	{
+		LogSendRecieveInfo(StrF(_T("ReceiveEncryptedChunks:: Failed to create new global size = %d"), (int)totalSize));
+		return NULL;
+	}
+
+	BYTE *pDest = (BYTE*)GlobalLock(hData);
+	INT_PTR offset = 0;
+
+	while(offset < totalSize)
+	{
+		int chunkLength = (int)min((INT_PTR)ENCRYPTED_CHUNK_SIZE, totalSize - offset);
+
+		long recordLength = 0;
+		if(RecieveExactSize((char*)&recordLength, sizeof(recordLength)) == FALSE)
+		{
+			break;
+		}
+
+		//header, offset, compressed flag, data and at most one block of padding
+		long maxRecordLength = (long)(sizeof(TD_TLHEADER) + sizeof(__int64) + 1 + chunkLength + 16);
+		if(recordLength <= 0 || recordLength > maxRecordLength)
+		{
+			LogSendRecieveInfo(StrF(_T("ReceiveEncryptedChunks:: invalid record size %d at %d"), recordLength, (int)offset));
+			break;
+		}
+
+		long lOutSize = 0;
+		BYTE *pRecord = (BYTE*)ReceiveEncryptedData(recordLength, lOutSize);
+		if(pRecord == NULL)
+		{
+			break;
+		}
+
+		__int64 recordOffset = -1;
+		long dataStart = sizeof(recordOffset) + (bCompressed ? 1 : 0);
+		bool bRecordCompressed = false;
+
+		if(bCompressed && lOutSize > dataStart)
+		{
+			memcpy(&recordOffset, pRecord, sizeof(recordOffset));
+			bRecordCompressed = (pRecord[sizeof(recordOffset)] == 1);
+
+			if(bRecordCompressed == false && lOutSize != dataStart + chunkLength)
+			{
+				recordOffset = -1;
+			}
+		}
+		else if(lOutSize == dataStart + chunkLength)
+		{
+			memcpy(&recordOffset, pRecord, sizeof(recordOffset));
+		}
+
+		if(recordOffset != offset)
+		{
+			LogSendRecieveInfo(StrF(_T("ReceiveEncryptedChunks:: record at %d has the wrong size or offset"), (int)offset));
+			FreeDecryptedData();
+			break;
+		}
+
+		if(bRecordCompressed)
+		{
+			if(CNetworkCompress::Uncompress(pRecord + dataStart, lOutSize - dataStart, pDest + offset, chunkLength) == false)
+			{
+				FreeDecryptedData();
+				break;
+			}
+		}
+		else
+		{
+			memcpy(pDest + offset, pRecord + dataStart, chunkLength);
+		}
+		FreeDecryptedData();
+
+		offset += chunkLength;
+	}
+
+	GlobalUnlock(hData);
+
+	if(offset < totalSize)
+	{
+		GlobalFree(hData);
+		hData = NULL;
+	}
+
+	return hData;
+}
+
+//Reads one frame sent by CSendSocket::SendFrame and decrypts it into frame
+BOOL CRecieveSocket::ReceiveFrame(std::vector<unsigned char> &frame)
+{
+	long frameLength = 0;
+	if(RecieveExactSize((char*)&frameLength, sizeof(frameLength)) == FALSE)
+		return FALSE;
+
+	//header and at most one block of padding
+	long maxFrameLength = (long)(sizeof(TD_TLHEADER) + NETWORK_MAX_FRAME_SIZE + 16);
+	if(frameLength <= (long)sizeof(TD_TLHEADER) || frameLength > maxFrameLength)
+	{
+		LogSendRecieveInfo(StrF(_T("ReceiveFrame:: invalid frame size %d"), frameLength));
+		return FALSE;
+	}
+
+	long lOutSize = 0;
+	BYTE *pFrame = (BYTE*)ReceiveEncryptedData(frameLength, lOutSize);
+	if(pFrame == NULL || lOutSize <= 0)
+	{
+		FreeDecryptedData();
+		return FALSE;
+	}
+
+	frame.assign(pFrame, pFrame + lOutSize);
+	FreeDecryptedData();
+
+	return TRUE;
+}
+
 int recv_to(int fd, char *buffer, int len, int flags, int to) 
 {
 	fd_set readset;
@@ -239,6 +495,41 @@ BOOL CRecieveSocket::RecieveExactSize(char *pData, long lSize)
 	return TRUE;
 }
 
+BOOL CRecieveSocket::WaitForData(int timeoutMs)
+{
+	fd_set readset;
+	FD_ZERO(&readset);
+	FD_SET(m_Sock, &readset);
+
+	struct timeval tv;
+	tv.tv_sec = timeoutMs / 1000;
+	tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+	return select((int)m_Sock+1, &readset, NULL, NULL, &tv) > 0;
+}
+
+//Reads and drops anything still sent until the other side closes, so closing our side doesn't reset the connection
+//while the other side still has data of ours to read
+void CRecieveSocket::WaitForClose(int timeoutMs)
+{
+	char buffer[512];
+	DWORD startTick = GetTickCount();
+
+	while((int)(GetTickCount() - startTick) < timeoutMs)
+	{
+		if(WaitForData(100) == FALSE)
+		{
+			continue;
+		}
+
+		int received = recv(m_Sock, buffer, sizeof(buffer), 0);
+		if(received <= 0)
+		{
+			break;
+		}
+	}
+}
+
 #define ENCRYPTED_SIZE_CSENDINFO 508
 
 BOOL CRecieveSocket::RecieveCSendInfo(CSendInfo *pInfo)
@@ -4,6 +4,9 @@
 #include "EncryptDecrypt\Encryption.h"
 #include "ServerDefines.h"
 #include "FileTransferProgressDlg.h"
+#include <afxmt.h>
+#include <vector>
+#include <map>
 
 class CRecieveSocket
 {
@@ -13,9 +16,14 @@ public:
 	~CRecieveSocket();
 	
 	LPVOID ReceiveEncryptedData(long lInSize, long &lOutSize);
+	HGLOBAL ReceiveEncryptedChunks(INT_PTR totalSize, bool bCompressed = false);
+	BOOL ReceiveFrame(std::vector<unsigned char> &frame);
 	BOOL RecieveExactSize(char *pData, long lSize);
 	BOOL RecieveCSendInfo(CSendInfo *pInfo);
 
+	BOOL WaitForData(int timeoutMs);
+	void WaitForClose(int timeoutMs);
+
 	void FreeDecryptedData();
 
 	SOCKET	GetSocket()				{ return m_Sock;	}
@@ -23,6 +31,24 @@ public:
 
 	void SetProgressBar(CFileTransferProgressDlg *pDlg) { m_pProgress = pDlg; }
 
+	//call after the network passwords change
+	static void LoadKeyIds();
+
+protected:
+	static BOOL GetNetworkPassword(INT_PTR nIndex, CStringA &csPassword);
+	static BOOL FindKeyIdPassword(const BYTE *pKeyId, CStringA &csPassword, INT_PTR &nIndex);
+
+	class CKeyIdPassword
+	{
+	public:
+		CStringA m_csPassword;
+		INT_PTR m_nIndex;
+	};
+
+	static CCriticalSection m_keyIdsLock;
+	static std::map<ULONGLONG, CKeyIdPassword> m_keyIds;
+	static bool m_keyIdsLoaded;
+
 protected:
 	CEncryption *m_pEncryptor;
 	SOCKET m_Sock;
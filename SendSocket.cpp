@@ -6,6 +6,10 @@
 #include "cp_main.h"
 #include "SendSocket.h"
 #include "shared/TextConvert.h"
+#include "NetworkCompress.h"
+
+#include <mswsock.h>
+#pragma comment(lib, "mswsock.lib")
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -83,4 +87,132 @@ BOOL CSendSocket::SendExactSize(char *pData, long lLength, bool bEncrypt)
 //	LogSendRecieveInfo(StrF(_T("END SendExactSize Total %d"), lBytesRead));
 
 	return bRet;
-}
\ No newline at end of file
+}
+
+//Each ENCRYPTED_CHUNK_SIZE piece is encrypted on its own with its offset in front, then sent as the record size followed by the record,
+//so only one piece is ever encrypted in memory. The offset stops records from being dropped or reordered.
+//With bCompress a flag byte follows the offset and pieces that zlib shrinks are sent compressed
+BOOL CSendSocket::SendEncryptedChunks(const BYTE *pData, INT_PTR length, bool bCompress)
+{
+	if(!m_pEncryptor)
+	{
+		ASSERT(!"Encryption not initialized");
+		LogSendRecieveInfo("SendEncryptedChunks::Encryption not initialized");
+		return FALSE;
+	}
+
+	BYTE *pRecord = new BYTE[sizeof(__int64) + 1 + ENCRYPTED_CHUNK_SIZE];
+	if(pRecord == NULL)
+	{
+		LogSendRecieveInfo("SendEncryptedChunks::Error creating record buffer");
+		return FALSE;
+	}
+
+	BOOL bRet = TRUE;
+	std::vector<BYTE> compressed;
+	int chunksNotCompressed = 0;
+
+	for(INT_PTR offset = 0; offset < length; offset += ENCRYPTED_CHUNK_SIZE)
+	{
+		int chunkLength = (int)min((INT_PTR)ENCRYPTED_CHUNK_SIZE, length - offset);
+
+		__int64 recordOffset = offset;
+		memcpy(pRecord, &recordOffset, sizeof(recordOffset));
+		int recordLength = sizeof(recordOffset);
+
+		if(bCompress)
+		{
+			//stop trying once a few pieces in a row didn't compress, the rest likely won't either
+			if(chunksNotCompressed < 4 &&
+				CNetworkCompress::Compress(pData + offset, chunkLength, compressed))
+			{
+				pRecord[recordLength++] = 1;
+				memcpy(pRecord + recordLength, compressed.data(), compressed.size());
+				recordLength += (int)compressed.size();
+				chunksNotCompressed = 0;
+			}
+			else
+			{
+				pRecord[recordLength++] = 0;
+				memcpy(pRecord + recordLength, pData + offset, chunkLength);
+				recordLength += chunkLength;
+				chunksNotCompressed++;
+			}
+		}
+		else
+		{
+			memcpy(pRecord + recordLength, pData + offset, chunkLength);
+			recordLength += chunkLength;
+		}
+
+		UCHAR* pOutput = NULL;
+		int nLenOutput = 0;
+		if(m_pEncryptor->Encrypt(pRecord, recordLength, g_Opt.m_csPassword, pOutput, nLenOutput) == false)
+		{
+			LogSendRecieveInfo(StrF(_T("SendEncryptedChunks::Failed to encrypt record at %d"), (int)offset));
+			bRet = FALSE;
+			break;
+		}
+
+		long recordLength = nLenOutput;
+		if(SendExactSize((char*)&recordLength, sizeof(recordLength), false) == FALSE ||
+			SendExactSize((char*)pOutput, recordLength, false) == FALSE)
+		{
+			m_pEncryptor->FreeBuffer(pOutput);
+			bRet = FALSE;
+			break;
+		}
+
+		m_pEncryptor->FreeBuffer(pOutput);
+	}
+
+	delete [] pRecord;
+	pRecord = NULL;
+
+	return bRet;
+}
+
+//The whole frame is encrypted as one piece and sent as its size followed by the encrypted frame
+BOOL CSendSocket::SendFrame(const CNetworkFrameWriter &frame)
+{
+	if(!m_pEncryptor)
+	{
+		ASSERT(!"Encryption not initialized");
+		LogSendRecieveInfo("SendFrame::Encryption not initialized");
+		return FALSE;
+	}
+
+	const std::vector<unsigned char> &data = frame.GetFrame();
+
+	UCHAR* pOutput = NULL;
+	int nLenOutput = 0;
+	if(m_pEncryptor->Encrypt((UCHAR*)&data[0], (int)data.size(), g_Opt.m_csPassword, pOutput, nLenOutput) == false)
+	{
+		LogSendRecieveInfo(StrF(_T("SendFrame::Failed to encrypt frame size %d"), (int)data.size()));
+		return FALSE;
+	}
+
+	LogSendRecieveInfo(StrF(_T("SendFrame size %d encrypted %d"), (int)data.size(), nLenOutput));
+
+	long frameLength = nLenOutput;
+	BOOL bRet = SendExactSize((char*)&frameLength, sizeof(frameLength), false) &&
+				SendExactSize((char*)pOutput, frameLength, false);
+
+	m_pEncryptor->FreeBuffer(pOutput);
+
+	return bRet;
+}
+//Sends the next length bytes of the file from where its file pointer is, as is, without copying them through a buffer
+BOOL CSendSocket::TransmitFileData(HANDLE hFile, DWORD length)
+{
+	if(length == 0)
+		return TRUE;
+
+	if(TransmitFile(m_Connection, hFile, length, 0, NULL, NULL, 0) == FALSE)
+	{
+		LogSendRecieveInfo(StrF(_T("TransmitFileData::TransmitFile failed, %d"), WSAGetLastError()));
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -12,6 +12,7 @@
 #include "EncryptDecrypt\Encryption.h"
 #include "ServerDefines.h"
 #include "FileTransferProgressDlg.h"
+#include "NetworkFrame.h"
 
 
 class CSendSocket  
@@ -27,6 +28,9 @@ public:
 
 	BOOL SendCSendData(CSendInfo &data, MyEnums::eSendType type);
 	BOOL SendExactSize(char *pData, long lLength, bool bEncrypt);
+	BOOL SendEncryptedChunks(const BYTE *pData, INT_PTR length, bool bCompress = false);
+	BOOL SendFrame(const CNetworkFrameWriter &frame);
+	BOOL TransmitFileData(HANDLE hFile, DWORD length);
 
 protected:
 	SOCKET m_Connection;
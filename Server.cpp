@@ -7,6 +7,9 @@
 #include "Server.h"
 #include "Shared\Tokenizer.h"
 #include "WildCardMatch.h"
+#include "NetworkCompress.h"
+#include "HistorySync.h"
+#include <algorithm>
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -59,36 +62,103 @@ UINT  MTServerThread(LPVOID pParam)
 		LogSendRecieveInfo("ERROR - if(bind(theApp.m_sSocket,(sockaddr*)&local,sizeof(local))!=0)");
 		return 0;
 	}
-	if(listen(theApp.m_sSocket,10)!=0)
+	//connections wait in the backlog while the workers are busy
+	if(listen(theApp.m_sSocket,SOMAXCONN)!=0)
 	{
-		LogSendRecieveInfo("ERROR - if(listen(theApp.m_sSocket,10)!=0)");
+		LogSendRecieveInfo("ERROR - if(listen(theApp.m_sSocket,SOMAXCONN)!=0)");
 		return 0;
 	}
 		
-	sockaddr_in from;
-	int fromlen = sizeof(from);
+	//the connections of one request for files are each sent on their own thread until the file is done,
+	//keep a thread past those for clips and other computers
+	int workerCount = max(CGetSetOptions::GetNetworkServerThreads(), CGetSetOptions::GetNetworkFileStreams() + 1);
+
+	CServerWorkers *pWorkers = new CServerWorkers();
+	pWorkers->Start(workerCount);
+
+	int maxPending = CGetSetOptions::GetNetworkServerMaxPending();
+	DWORD idleMs = (DWORD)CGetSetOptions::GetNetworkServerIdleMS();
+	DWORD readTimeoutMs = (DWORD)CGetSetOptions::GetNetworkReadTimeoutMS();
+
+	std::vector<CServer*> idle;
 
 	while(true)
 	{
 		if(theApp.m_bAppExiting || theApp.m_bExitServerThread)
 			break;
 
-		SOCKET socket = accept(theApp.m_sSocket, (struct sockaddr*)&from, &fromlen);
+		pWorkers->CloseIdle(idleMs, readTimeoutMs);
 
-		SocketParams *pParams = new SocketParams();
-		pParams->m_ip = inet_ntoa(from.sin_addr);
-		pParams->m_socket = socket;
+		//backpressure, leave new connections in the listen backlog and idle connections unread until a worker catches up
+		if(pWorkers->PendingCount() >= maxPending)
+		{
+			Sleep(50);
+			continue;
+		}
 
-		if (socket != INVALID_SOCKET)
+		fd_set readset;
+		FD_ZERO(&readset);
+		FD_SET(theApp.m_sSocket, &readset);
+
+		pWorkers->GetIdle(idle);
+		for(size_t i = 0; i < idle.size(); i++)
 		{
-			AfxBeginThread(ClientThread, (LPVOID)pParams);
+			FD_SET(idle[i]->GetSocket(), &readset);
 		}
-		else
+
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+
+		int result = select(0, &readset, NULL, NULL, &tv);
+		if(result == SOCKET_ERROR)
+		{
+			//the listen socket was closed to stop the server
+			if(theApp.m_bAppExiting || theApp.m_bExitServerThread)
+				break;
+
+			LogSendRecieveInfo(StrF(_T("ERROR - select in server thread %d"), WSAGetLastError()));
+			Sleep(100);
+			continue;
+		}
+
+		if(result == 0)
+			continue;
+
+		for(size_t i = 0; i < idle.size(); i++)
+		{
+			if(FD_ISSET(idle[i]->GetSocket(), &readset))
+			{
+				pWorkers->Resume(idle[i]);
+			}
+		}
+
+		if(FD_ISSET(theApp.m_sSocket, &readset))
 		{
-			delete pParams;
+			sockaddr_in from;
+			int fromlen = sizeof(from);
+
+			SOCKET socket = accept(theApp.m_sSocket, (struct sockaddr*)&from, &fromlen);
+			if (socket != INVALID_SOCKET)
+			{
+				CServer *pServer = new CServer();
+				pServer->SetSocket(socket, CString(inet_ntoa(from.sin_addr)));
+
+				pWorkers->Queue(pServer);
+			}
 		}
 	}	
 
+	//workers still in the middle of a read hold on to the pool, it's left for them rather than freed under them
+	if(pWorkers->Stop(5000))
+	{
+		delete pWorkers;
+	}
+	else
+	{
+		LogSendRecieveInfo("ERROR - server worker threads didn't exit");
+	}
+
 	LogSendRecieveInfo("End of Server Thread");
 
 	bRunning = false;
@@ -97,19 +167,205 @@ UINT  MTServerThread(LPVOID pParam)
 	return 0;
 }
 
-UINT  ClientThread(LPVOID pParam)
-{	
-	LogSendRecieveInfo("*********************Start of ClientThread*********************");
-	
-	SocketParams *pParams = (SocketParams*)pParam;
+CServerWorkers::CServerWorkers()
+{
+	m_hSemaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+	m_bStop = false;
+}
+
+CServerWorkers::~CServerWorkers()
+{
+	for(size_t i = 0; i < m_threads.size(); i++)
+	{
+		CloseHandle(m_threads[i]);
+	}
 
-	CServer Server;
-	Server.RunThread(pParams);
+	CloseHandle(m_hSemaphore);
+}
 
-	delete pParams;
+void CServerWorkers::Start(int workers)
+{
+	//WaitForMultipleObjects in Stop is limited to 64 handles
+	workers = max(1, min(workers, MAXIMUM_WAIT_OBJECTS));
+
+	for(int i = 0; i < workers; i++)
+	{
+		HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, WorkerThread, this, 0, NULL);
+		if(thread != NULL)
+		{
+			m_threads.push_back(thread);
+		}
+	}
+
+	LogSendRecieveInfo(StrF(_T("Started %d server worker threads"), (int)m_threads.size()));
+}
+
+bool CServerWorkers::Stop(int waitTime)
+{
+	{
+		ATL::CCritSecLock csLock(m_cs.m_sect);
+		m_bStop = true;
+	}
+
+	ReleaseSemaphore(m_hSemaphore, (LONG)m_threads.size(), NULL);
+
+	if(m_threads.size() > 0 &&
+		WaitForMultipleObjects((DWORD)m_threads.size(), &m_threads[0], TRUE, waitTime) == WAIT_TIMEOUT)
+	{
+		return false;
+	}
+
+	ATL::CCritSecLock csLock(m_cs.m_sect);
+
+	for(std::deque<CServer*>::iterator it = m_pending.begin(); it != m_pending.end(); it++)
+	{
+		delete *it;
+	}
+	m_pending.clear();
+
+	for(std::vector<CServer*>::iterator it = m_idle.begin(); it != m_idle.end(); it++)
+	{
+		delete *it;
+	}
+	m_idle.clear();
+
+	return true;
+}
+
+void CServerWorkers::Queue(CServer *pServer)
+{
+	{
+		ATL::CCritSecLock csLock(m_cs.m_sect);
+		m_pending.push_back(pServer);
+	}
+
+	ReleaseSemaphore(m_hSemaphore, 1, NULL);
+}
+
+int CServerWorkers::PendingCount()
+{
+	ATL::CCritSecLock csLock(m_cs.m_sect);
+	return (int)m_pending.size();
+}
+
+//Connection sent FLUSH and is waiting for its next batch, or its next message is slow to come, it doesn't need a worker
+//until there is something to read
+void CServerWorkers::Park(CServer *pServer)
+{
+	{
+		ATL::CCritSecLock csLock(m_cs.m_sect);
+
+		if(m_bStop)
+		{
+			delete pServer;
+			return;
+		}
+
+		//the listen socket is in the same fd_set
+		if((int)m_idle.size() < FD_SETSIZE - 1)
+		{
+			pServer->SetIdleStart(GetTickCount());
+			m_idle.push_back(pServer);
+			return;
+		}
+
+		if(pServer->IsWaitingForBatch())
+		{
+			LogSendRecieveInfo("::Too many idle connections, closing");
+			delete pServer;
+			return;
+		}
+	}
+
+	//in the middle of talking to us, a worker reads it without parking instead
+	Queue(pServer);
+}
+
+bool CServerWorkers::CanPark()
+{
+	ATL::CCritSecLock csLock(m_cs.m_sect);
+	return m_bStop == false && (int)m_idle.size() < FD_SETSIZE - 1;
+}
+
+void CServerWorkers::GetIdle(std::vector<CServer*> &idle)
+{
+	ATL::CCritSecLock csLock(m_cs.m_sect);
+	idle = m_idle;
+}
+
+void CServerWorkers::Resume(CServer *pServer)
+{
+	{
+		ATL::CCritSecLock csLock(m_cs.m_sect);
+
+		std::vector<CServer*>::iterator it = std::find(m_idle.begin(), m_idle.end(), pServer);
+		if(it == m_idle.end())
+			return;
+
+		m_idle.erase(it);
+	}
+
+	Queue(pServer);
+}
+
+//connections between batches are kept for idleMs, ones that stopped in the middle of a batch get the same time a read would
+void CServerWorkers::CloseIdle(DWORD idleMs, DWORD readTimeoutMs)
+{
+	ATL::CCritSecLock csLock(m_cs.m_sect);
+
+	DWORD now = GetTickCount();
+
+	for(std::vector<CServer*>::iterator it = m_idle.begin(); it != m_idle.end();)
+	{
+		DWORD timeout = (*it)->IsWaitingForBatch() ? idleMs : readTimeoutMs;
+		if(now - (*it)->GetIdleStart() > timeout)
+		{
+			LogSendRecieveInfo("::Kept open connection was idle too long, closing");
+			delete *it;
+			it = m_idle.erase(it);
+		}
+		else
+		{
+			it++;
+		}
+	}
+}
+
+CServer *CServerWorkers::Next()
+{
+	WaitForSingleObject(m_hSemaphore, INFINITE);
+
+	ATL::CCritSecLock csLock(m_cs.m_sect);
+
+	if(m_bStop || m_pending.empty())
+		return NULL;
+
+	CServer *pServer = m_pending.front();
+	m_pending.pop_front();
+
+	return pServer;
+}
+
+unsigned int __stdcall CServerWorkers::WorkerThread(void *pParam)
+{
+	CServerWorkers *pWorkers = (CServerWorkers*)pParam;
+
+	while(true)
+	{
+		CServer *pServer = pWorkers->Next();
+		if(pServer == NULL)
+			break;
+
+		if(pServer->Process(pWorkers->CanPark()))
+		{
+			pWorkers->Park(pServer);
+		}
+		else
+		{
+			delete pServer;
+		}
+	}
 
-	LogSendRecieveInfo("*********************End of ClientThread*********************");
-	
 	return 0;
 }
 
@@ -120,22 +376,77 @@ CServer::CServer()
 	m_bSetToClipBoard = FALSE;
 	m_manualSend = false;
 	m_respondPort = 0;
+	m_bSentVersion = false;
+	m_bWaitingForBatch = false;
+	m_idleStartTick = 0;
+	m_parkMs = CGetSetOptions::GetNetworkServerParkMS();
+	m_bFramed = false;
+	m_bSync = false;
+	m_pSync = NULL;
 }
 
 CServer::~CServer()
 {
 	closesocket(m_Sock.GetSocket());
+
+	if(m_pClipList)
+	{
+		delete m_pClipList;
+		m_pClipList = NULL;
+	}
+
+	if(m_pClip)
+	{
+		delete m_pClip;
+		m_pClip = NULL;
+	}
+
+	if(m_pSync)
+	{
+		delete m_pSync;
+		m_pSync = NULL;
+	}
+}
+
+void CServer::SetSocket(SOCKET socket, CString ip)
+{
+	LogSendRecieveInfo(StrF(_T("*********************New connection from %s*********************"), ip));
+
+	m_Sock.SetSocket(socket);	
+	m_Send.SetSocket(socket);
+	m_recieveIP = ip;
 }
 
-void CServer::RunThread(SocketParams *pParams)
+//Reads messages until the client is done with the connection (returns false), or it sent FLUSH and will send
+//more later, or bCanPark is set and the next message doesn't come within m_parkMs (returns true).
+//The caller then watches the socket and calls this again when there is more to read
+bool CServer::Process(bool bCanPark)
 {
-	m_Sock.SetSocket(pParams->m_socket);	
-	m_recieveIP = pParams->m_ip;
 	CSendInfo info;
 	bool bBreak = false;
 		
+	m_bWaitingForBatch = false;
+
 	while(true)
 	{
+		if(m_bFramed)
+		{
+			if(ReadFrame(bBreak) == FALSE)
+				break;
+
+			if(bBreak || theApp.m_bAppExiting)
+				break;
+
+			if(m_bWaitingForBatch)
+				return true;
+
+			if(bCanPark &&
+				m_Sock.WaitForData(m_parkMs) == FALSE)
+				return true;
+
+			continue;
+		}
+
 		if(m_Sock.RecieveCSendInfo(&info) == FALSE)
 			break;
 		
@@ -154,11 +465,11 @@ void CServer::RunThread(SocketParams *pParams)
 			break;
 
 		case MyEnums::END:
-			OnEnd(info);
+			OnEnd();
 			break;
 
 		case MyEnums::EXIT:
-			OnExit(info);
+			OnExit();
 			bBreak = true;
 			break;
 
@@ -166,6 +477,19 @@ void CServer::RunThread(SocketParams *pParams)
 			OnRequestFiles(info);
 			break;
 
+		case MyEnums::FLUSH:
+			OnFlush();
+			break;
+
+		case MyEnums::FRAMES:
+			OnFrames(info);
+			break;
+
+		case MyEnums::SYNC:
+			if(OnSync(info) == false)
+				bBreak = true;
+			break;
+
 		default:
 			LogSendRecieveInfo("::ERROR unknown action type exiting");
 			bBreak = true;
@@ -173,6 +497,14 @@ void CServer::RunThread(SocketParams *pParams)
 
 		if(bBreak || theApp.m_bAppExiting)
 			break;
+
+		if(m_bWaitingForBatch)
+			return true;
+
+		//nothing is read between messages, so the server thread can watch the socket until the next one starts
+		if(bCanPark &&
+			m_Sock.WaitForData(m_parkMs) == FALSE)
+			return true;
 	}		
 
 	if(m_pClipList)
@@ -190,6 +522,8 @@ void CServer::RunThread(SocketParams *pParams)
 		delete m_pClip;
 		m_pClip = NULL;
 	}
+
+	return false;
 }
 
 void CServer::OnStart(CSendInfo &info)
@@ -204,11 +538,31 @@ void CServer::OnStart(CSendInfo &info)
 	{
 		m_csIP = CTextConvert::Utf8ToUnicode(info.m_cIP);
 	}
-	m_csComputerName = CTextConvert::Utf8ToUnicode(info.m_cComputerName);
-	m_csDesc = CTextConvert::Utf8ToUnicode(info.m_cDesc);
 
-	m_manualSend = info.m_manualSend;
-	m_respondPort = info.m_respondPort;
+	//older clients send version 1 and don't read anything back, clients from the chunked version on read the reply
+	if(info.m_nVersion >= NETWORK_CHUNKED_VERSION &&
+		m_bSentVersion == false)
+	{
+		CSendInfo reply;
+		reply.m_nVersion = NETWORK_PROTOCOL_VERSION;
+		reply.m_lParameter1 = NETWORK_FEATURES;
+		if(m_Send.SendCSendData(reply, MyEnums::VERSION))
+		{
+			m_bSentVersion = true;
+		}
+	}
+
+	StartClip(CTextConvert::Utf8ToUnicode(info.m_cComputerName), CTextConvert::Utf8ToUnicode(info.m_cDesc), info.m_manualSend != 0, info.m_respondPort);
+}
+
+void CServer::StartClip(CString csComputerName, CString csDesc, bool manualSend, short respondPort)
+{
+	m_csComputerName = csComputerName;
+	m_csDesc = csDesc;
+
+	m_manualSend = manualSend;
+	m_respondPort = respondPort;
+	m_bWaitingForBatch = false;
 
 	if(m_pClip != NULL)
 	{
@@ -252,9 +606,8 @@ void CServer::OnStart(CSendInfo &info)
 			}
 		}
 	}
-	
-	info.m_cDesc[20] = 0;
-	LogSendRecieveInfo(StrF(_T("::START %s %s %s"), m_csDesc, m_csComputerName, m_csIP));
+
+	LogSendRecieveInfo(StrF(_T("::START %s %s %s"), m_csDesc.Left(20), m_csComputerName, m_csIP));
 }
 
 void CServer::OnDataStart(CSendInfo &info)
@@ -265,6 +618,23 @@ void CServer::OnDataStart(CSendInfo &info)
 	m_cf.m_cfType = GetFormatID(csFormat);
 	m_cf.m_hgData = 0;
 	
+	if(info.m_nVersion >= NETWORK_CHUNKED_VERSION)
+	{
+		//decrypted a record at a time straight into the format's global
+		m_cf.m_hgData = m_Sock.ReceiveEncryptedChunks(info.m_lParameter1);
+		if(m_cf.m_hgData == NULL)
+		{
+			LogSendRecieveInfo("::DATA_START -- failed to receive encrypted chunks");
+		}
+		else if(m_pClip)
+		{
+			m_pClip->m_lTotalCopySize += info.m_lParameter1;
+		}
+
+		LogSendRecieveInfo("::DATA_START -- END");
+		return;
+	}
+
 	long lInSize = info.m_lParameter1;
 	long lOutSize = 0;
 
@@ -308,6 +678,11 @@ void CServer::OnDataEnd(CSendInfo &info)
 {
 	LogSendRecieveInfo("::DATA_END");
 				
+	AddReceivedFormat();
+}
+
+void CServer::AddReceivedFormat()
+{
 	if(m_pClip && m_cf.m_hgData)
 	{
 		if(m_cf.m_cfType == CF_HDROP)
@@ -322,7 +697,7 @@ void CServer::OnDataEnd(CSendInfo &info)
 	}
 }
 
-void CServer::OnEnd(CSendInfo &info)
+void CServer::OnEnd()
 {				
 	LogSendRecieveInfo("::END");
 
@@ -338,10 +713,25 @@ void CServer::OnEnd(CSendInfo &info)
 		LogSendRecieveInfo("::ERROR pClipList was NULL");
 }
 
-void CServer::OnExit(CSendInfo &info)
+void CServer::OnExit()
 {
 	LogSendRecieveInfo("::EXIT");
 
+	PostClipList();
+}
+
+void CServer::OnFlush()
+{
+	LogSendRecieveInfo("::FLUSH");
+
+	PostClipList();
+
+	//the client keeps this connection open for its next batch, Process returns so the worker can be used by others
+	m_bWaitingForBatch = true;
+}
+
+void CServer::PostClipList()
+{
 	if(m_pClipList && m_pClipList->GetCount() > 0)
 	{
 		theApp.m_lClipsRecieved += (long)m_pClipList->GetCount();
@@ -364,10 +754,296 @@ void CServer::OnExit(CSendInfo &info)
 		LogSendRecieveInfo("::ERROR pClipList was NULL or Count was 0");
 }
 
+//Everything after this message comes in frames
+void CServer::OnFrames(CSendInfo &info)
+{
+	LogSendRecieveInfo(StrF(_T("::FRAMES features %d"), info.m_lParameter1));
+
+	m_bFramed = true;
+}
+
+//A history sync, only from computers in NetworkSyncHosts. Returns false if the connection should be closed
+bool CServer::OnSync(CSendInfo &info)
+{
+	//the address the connection came from, not the one the client says it has
+	m_csIP = m_recieveIP;
+	m_csComputerName = CTextConvert::Utf8ToUnicode(info.m_cComputerName);
+	m_respondPort = info.m_respondPort;
+
+	bool bAllowed = m_csIP != _T("") && CHistorySync::IsSyncHost(m_csIP);
+
+	CSendInfo reply;
+	reply.m_nVersion = NETWORK_PROTOCOL_VERSION;
+	reply.m_lParameter1 = NETWORK_FEATURES;
+	if(bAllowed)
+	{
+		reply.m_lParameter1 |= NETWORK_FEATURE_SYNC;
+	}
+
+	if(m_Send.SendCSendData(reply, MyEnums::VERSION) == FALSE)
+		return false;
+
+	m_bSentVersion = true;
+
+	if(bAllowed == false)
+	{
+		LogSendRecieveInfo(StrF(_T("::SYNC from %s %s refused, not in NetworkSyncHosts"), m_csComputerName, m_csIP));
+		return false;
+	}
+
+	LogSendRecieveInfo(StrF(_T("::SYNC mode %d from %s %s"), info.m_lParameter1, m_csComputerName, m_csIP));
+
+	m_bFramed = true;
+	m_bSync = true;
+
+	if(info.m_lParameter1 == NETWORK_SYNC_MODE_SUMMARY &&
+		m_pSync == NULL)
+	{
+		m_pSync = new CHistorySyncReply;
+	}
+
+	return true;
+}
+
+//Reads one frame and handles its messages, bExit is set by an exit message. Returns FALSE if the frame
+//couldn't be read or isn't valid, the connection is closed then
+BOOL CServer::ReadFrame(bool &bExit)
+{
+	std::vector<unsigned char> frame;
+	if(m_Sock.ReceiveFrame(frame) == FALSE)
+		return FALSE;
+
+	CNetworkFrameReader reader(&frame[0], frame.size());
+	CNetworkFrameMessage message;
+
+	while(reader.Next(message))
+	{
+		switch(message.GetType())
+		{
+		case NETWORK_MESSAGE_START:
+			{
+				std::string ip;
+				std::string computerName;
+				std::string desc;
+				uint64_t manualSend = 0;
+				uint64_t respondPort = 0;
+				message.GetString(NETWORK_FIELD_IP, ip);
+				message.GetString(NETWORK_FIELD_COMPUTER_NAME, computerName);
+				message.GetString(NETWORK_FIELD_DESC, desc);
+				message.GetUInt(NETWORK_FIELD_MANUAL_SEND, manualSend);
+				message.GetUInt(NETWORK_FIELD_RESPOND_PORT, respondPort);
+
+				if (m_recieveIP != _T("") &&
+					g_Opt.GetUseIPFromAccept())
+				{
+					m_csIP = m_recieveIP;
+				}
+				else
+				{
+					m_csIP = CTextConvert::Utf8ToUnicode(ip.c_str());
+				}
+
+				StartClip(CTextConvert::Utf8ToUnicode(computerName.c_str()), CTextConvert::Utf8ToUnicode(desc.c_str()), manualSend != 0, (short)respondPort);
+
+				uint64_t date = 0;
+				uint64_t crc = 0;
+				if(m_bSync &&
+					m_pClip &&
+					message.GetUInt(NETWORK_FIELD_DATE, date) &&
+					message.GetUInt(NETWORK_FIELD_CRC, crc))
+				{
+					//kept as they are on the other computer so both sides have the same key for the clip, synced clips don't go on the clipboard
+					m_pClip->m_Desc = CTextConvert::Utf8ToUnicode(desc.c_str());
+					m_pClip->m_Time = (time_t)(DWORD)date;
+					m_pClip->m_CRC = (DWORD)crc;
+					m_pClip->m_param1 |= REMOTE_CLIP_SYNC;
+					m_bSetToClipBoard = FALSE;
+					m_manualSend = false;
+				}
+			}
+			break;
+
+		case NETWORK_MESSAGE_FORMAT:
+			{
+				std::string name;
+				const unsigned char *pData = NULL;
+				size_t length = 0;
+				message.GetString(NETWORK_FIELD_FORMAT_NAME, name);
+
+				m_cf.m_cfType = GetFormatID(CTextConvert::Utf8ToUnicode(name.c_str()));
+				m_cf.m_hgData = 0;
+
+				if(message.GetBytes(NETWORK_FIELD_DATA, pData, length) && length > 0)
+				{
+					uint64_t originalSize = 0;
+					if(message.GetUInt(NETWORK_FIELD_ORIGINAL_SIZE, originalSize))
+					{
+						//formats sent in a frame are never more than a chunk
+						if(originalSize == 0 || originalSize > ENCRYPTED_CHUNK_SIZE)
+						{
+							LogSendRecieveInfo(StrF(_T("::FORMAT invalid original size %I64u"), originalSize));
+							return FALSE;
+						}
+
+						m_cf.m_hgData = NewGlobal((SIZE_T)originalSize);
+						if(m_cf.m_hgData)
+						{
+							BYTE *pDest = (BYTE*)GlobalLock(m_cf.m_hgData);
+							bool bUncompressed = CNetworkCompress::Uncompress(pData, (int)length, pDest, (int)originalSize);
+							GlobalUnlock(m_cf.m_hgData);
+
+							if(bUncompressed == false)
+							{
+								GlobalFree(m_cf.m_hgData);
+								m_cf.m_hgData = 0;
+								return FALSE;
+							}
+						}
+
+						length = (size_t)originalSize;
+					}
+					else
+					{
+						m_cf.m_hgData = NewGlobalP((LPVOID)pData, length);
+					}
+
+					if(m_cf.m_hgData && m_pClip)
+					{
+						m_pClip->m_lTotalCopySize += (ULONG)length;
+					}
+				}
+
+				AddReceivedFormat();
+			}
+			break;
+
+		case NETWORK_MESSAGE_FORMAT_CHUNKED:
+			{
+				std::string name;
+				uint64_t size = 0;
+				uint64_t compressed = 0;
+				message.GetString(NETWORK_FIELD_FORMAT_NAME, name);
+				message.GetUInt(NETWORK_FIELD_SIZE, size);
+				message.GetUInt(NETWORK_FIELD_COMPRESSED, compressed);
+
+				if(size == 0 || size > (uint64_t)MAXINT_PTR)
+				{
+					LogSendRecieveInfo(StrF(_T("::FORMAT_CHUNKED invalid size %I64u"), size));
+					return FALSE;
+				}
+
+				m_cf.m_cfType = GetFormatID(CTextConvert::Utf8ToUnicode(name.c_str()));
+				m_cf.m_hgData = m_Sock.ReceiveEncryptedChunks((INT_PTR)size, compressed != 0);
+				if(m_cf.m_hgData == NULL)
+				{
+					LogSendRecieveInfo("::FORMAT_CHUNKED -- failed to receive encrypted chunks");
+					return FALSE;
+				}
+
+				if(m_pClip)
+				{
+					m_pClip->m_lTotalCopySize += (ULONG)size;
+				}
+
+				AddReceivedFormat();
+			}
+			break;
+
+		case NETWORK_MESSAGE_END:
+			OnEnd();
+			break;
+
+		case NETWORK_MESSAGE_FLUSH:
+			OnFlush();
+			break;
+
+		case NETWORK_MESSAGE_EXIT:
+			OnExit();
+			bExit = true;
+			break;
+
+		case NETWORK_MESSAGE_SYNC_SUMMARY:
+			if(m_pSync == NULL ||
+				m_pSync->AddSummary(message) == false)
+			{
+				LogSendRecieveInfo("::ERROR invalid SYNC_SUMMARY");
+				return FALSE;
+			}
+			break;
+
+		case NETWORK_MESSAGE_SYNC_SUMMARY_END:
+			if(m_pSync == NULL ||
+				m_pSync->SendDifferences(m_Send) == FALSE)
+			{
+				return FALSE;
+			}
+			break;
+
+		case NETWORK_MESSAGE_SYNC_REQUEST:
+			if(m_pSync == NULL ||
+				m_pSync->AddRequest(message) == false)
+			{
+				LogSendRecieveInfo("::ERROR invalid SYNC_REQUEST");
+				return FALSE;
+			}
+			break;
+
+		case NETWORK_MESSAGE_SYNC_REQUEST_END:
+			if(m_pSync)
+			{
+				//sent over a new connection to the other side's server
+				CString server = m_csIP;
+				if(m_respondPort != 0)
+				{
+					server.Format(_T("%s:%d"), m_csIP, (unsigned short)m_respondPort);
+				}
+
+				m_pSync->SendRequested(server);
+			}
+			break;
+
+		default:
+			//from a newer client, skipped
+			LogSendRecieveInfo(StrF(_T("::Skipping unknown frame message %d"), message.GetType()));
+			break;
+		}
+	}
+
+	if(reader.Failed())
+	{
+		LogSendRecieveInfo("::ERROR invalid frame");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 void CServer::OnRequestFiles(CSendInfo &info)
 {
+	//m_lParameter1 is -1 from clients before the compressed version
+	DWORD features = 0;
+	if(info.m_nVersion >= NETWORK_COMPRESSED_VERSION)
+	{
+		features = info.m_lParameter1 & NETWORK_FEATURE_COMPRESSION;
+	}
+
+	int streamIndex = 0;
+	int streamCount = 1;
+	if(info.m_nVersion >= NETWORK_RESUME_VERSION)
+	{
+		features = info.m_lParameter1 & (NETWORK_FEATURE_COMPRESSION | NETWORK_FEATURE_RESUME | NETWORK_FEATURE_FAST_HASH);
+
+		streamIndex = LOWORD(info.m_lParameter2);
+		streamCount = HIWORD(info.m_lParameter2);
+		if(streamCount < 1 || streamIndex >= streamCount)
+		{
+			streamIndex = 0;
+			streamCount = 1;
+		}
+	}
+
 	CFileSend Send;
-	Send.SendClientFiles(m_Sock.GetSocket(), m_pClipList);
+	Send.SendClientFiles(m_Sock.GetSocket(), m_pClipList, features, streamIndex, streamCount);
 
 	delete m_pClipList;
 	m_pClipList = NULL;
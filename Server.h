@@ -5,15 +5,13 @@
 #include "shared/TextConvert.h"
 #include "RecieveSocket.h"
 #include "FileSend.h"
+#include "SendSocket.h"
 #include "ServerDefines.h"
+#include <afxmt.h>
+#include <deque>
+#include <vector>
 
-
-class SocketParams
-{
-public:
-	SOCKET m_socket;
-	CString m_ip;
-};
+class CHistorySyncReply;
 
 class CServer
 {
@@ -21,7 +19,13 @@ public:
 	CServer();
 	~CServer();
 
-	void RunThread(SocketParams *pParams);
+	void SetSocket(SOCKET socket, CString ip);
+	bool Process(bool bCanPark);
+
+	SOCKET GetSocket()					{ return m_Sock.GetSocket(); }
+	DWORD GetIdleStart()				{ return m_idleStartTick; }
+	void SetIdleStart(DWORD tick)		{ m_idleStartTick = tick; }
+	bool IsWaitingForBatch()			{ return m_bWaitingForBatch; }
 
 protected:
 	void AddRemoteCF_HDROPFormat();
@@ -29,9 +33,17 @@ protected:
 	void OnStart(CSendInfo &Info);
 	void OnDataEnd(CSendInfo &info);
 	void OnDataStart(CSendInfo &info);
-	void OnEnd(CSendInfo &info);
-	void OnExit(CSendInfo &info);
+	void OnEnd();
+	void OnExit();
 	void OnRequestFiles(CSendInfo &info);
+	void OnFlush();
+	void OnFrames(CSendInfo &info);
+	bool OnSync(CSendInfo &info);
+	void PostClipList();
+
+	void StartClip(CString csComputerName, CString csDesc, bool manualSend, short respondPort);
+	void AddReceivedFormat();
+	BOOL ReadFrame(bool &bExit);
 
 protected:
 	CClipList *m_pClipList;
@@ -44,9 +56,50 @@ protected:
 	CString m_csComputerName;
 	CString m_csDesc;
 	CRecieveSocket m_Sock;
+	CSendSocket m_Send;
+	bool m_bSentVersion;
+	bool m_bWaitingForBatch;
+	DWORD m_idleStartTick;
+	int m_parkMs;
+	bool m_bFramed;
 	CClipFormat m_cf;
 	CString m_recieveIP;
+	//the connection was started with SYNC, m_pSync is only set for NETWORK_SYNC_MODE_SUMMARY
+	bool m_bSync;
+	CHistorySyncReply *m_pSync;
+};
+
+//Runs accepted connections on a fixed number of threads instead of a thread per connection. Connections waiting
+//for their next batch or their next message don't hold a thread, the server thread selects on them with the listen socket
+class CServerWorkers
+{
+public:
+	CServerWorkers();
+	~CServerWorkers();
+
+	void Start(int workers);
+	bool Stop(int waitTime);
+
+	void Queue(CServer *pServer);
+	int PendingCount();
+
+	void GetIdle(std::vector<CServer*> &idle);
+	void Resume(CServer *pServer);
+	void CloseIdle(DWORD idleMs, DWORD readTimeoutMs);
+	bool CanPark();
+
+protected:
+	static unsigned int __stdcall WorkerThread(void *pParam);
+
+	CServer *Next();
+	void Park(CServer *pServer);
+
+	CCriticalSection m_cs;
+	HANDLE m_hSemaphore;
+	std::vector<HANDLE> m_threads;
+	std::deque<CServer*> m_pending;
+	std::vector<CServer*> m_idle;
+	bool m_bStop;
 };
 
 UINT  MTServerThread(LPVOID pParam);
-UINT  ClientThread(LPVOID pParam);
@@ -3,10 +3,106 @@
 
 #define CHUNK_WRITE_SIZE 65536
 
+//Sent in CSendInfo::m_nVersion of START, a server that understands it answers with a VERSION message that has its own version.
+//Older servers ignore the version and never answer so nothing new is sent to them
+#define NETWORK_PROTOCOL_VERSION 8
+
+//From this version DATA_START can be followed by encrypted records of ENCRYPTED_CHUNK_SIZE instead of one encrypted block,
+//DATA_START has m_nVersion set to this and m_lParameter1 is the unencrypted size
+#define NETWORK_CHUNKED_VERSION 2
+#define ENCRYPTED_CHUNK_SIZE 65536
+
+//From this version the client can send FLUSH after a batch of clips instead of EXIT, the server adds the clips
+//it has so far and keeps reading the connection so the next batch doesn't need a new connection
+#define NETWORK_PERSISTENT_VERSION 3
+
+//From this version the VERSION reply has the server's NETWORK_FEATURE_ flags in m_lParameter1. If it has NETWORK_FEATURE_FRAMES
+//the client can send a FRAMES message, everything it sends after that is an encrypted NetworkFrame (long size then the frame)
+//holding NETWORK_MESSAGE_ messages, instead of a CSendInfo per message
+#define NETWORK_FRAMED_VERSION 4
+#define NETWORK_FEATURE_FRAMES 0x01
+//zlib before encryption, NETWORK_FIELD_ORIGINAL_SIZE on a FORMAT, NETWORK_FIELD_COMPRESSED on a FORMAT_CHUNKED
+#define NETWORK_FEATURE_COMPRESSION 0x02
+//DATA_START is answered with RESUME before the file data, see NETWORK_RESUME_VERSION
+#define NETWORK_FEATURE_RESUME 0x04
+//DATA_END has a CChunkedHash of the file instead of its md5, see NETWORK_FAST_HASH_VERSION
+#define NETWORK_FEATURE_FAST_HASH 0x08
+#define NETWORK_FEATURES (NETWORK_FEATURE_FRAMES | NETWORK_FEATURE_COMPRESSION | NETWORK_FEATURE_RESUME | NETWORK_FEATURE_FAST_HASH)
+//the server will sync its history with the client, only sent to clients in NetworkSyncHosts, see NETWORK_SYNC_VERSION
+#define NETWORK_FEATURE_SYNC 0x10
+
+//From this version REQUEST_FILES has the client's NETWORK_FEATURE_ flags in m_lParameter1, if it has NETWORK_FEATURE_COMPRESSION
+//each file's DATA_START has m_nVersion set to this and the file is sent as blocks, a long size then the block. A positive size
+//is zlib data that uncompresses to CHUNK_WRITE_SIZE (or what's left of the file), a negative size is that many bytes as is
+#define NETWORK_COMPRESSED_VERSION 5
+
+//From this version REQUEST_FILES has MAKELONG(stream index, stream count) in m_lParameter2, the server only sends the files
+//where file index % count == stream index so a client can request the files over more than one connection.
+//If the request has NETWORK_FEATURE_RESUME, DATA_START has m_nVersion set to this and the low dword of the file's last write time
+//in m_lParameter2, the client answers with RESUME with the offset to start at in m_lParameter1, a multiple of CHUNK_WRITE_SIZE
+#define NETWORK_RESUME_VERSION 6
+
+//From this version DATA_START has m_nVersion set to the server's version whenever REQUEST_FILES asked for any feature.
+//If the request has NETWORK_FEATURE_FAST_HASH, DATA_END's m_md5 is the file's CChunkedHash (CHUNK_WRITE_SIZE chunks) as 16 hex digits,
+//or empty if the server doesn't check transfers
+#define NETWORK_FAST_HASH_VERSION 7
+
+//From this version a client can start with SYNC instead of START, it has the mode in m_lParameter1 and is answered with VERSION,
+//both sides then use frames. NETWORK_SYNC_MODE_SUMMARY: the client sends SYNC_SUMMARY messages, the server answers with SYNC_KEYS for
+//every bucket that's different, the client sends SYNC_REQUEST for the keys it doesn't have followed by the clips the server doesn't
+//have as START messages with NETWORK_FIELD_DATE and CRC. The server then connects back with NETWORK_SYNC_MODE_CLIPS and sends the
+//requested clips the same way.
+//A clip's key is its lDate and CRC, a bucket is the clips with lDate in the same NETWORK_SYNC_BUCKET_SECONDS
+#define NETWORK_SYNC_VERSION 8
+#define NETWORK_SYNC_MODE_SUMMARY 1
+#define NETWORK_SYNC_MODE_CLIPS 2
+#define NETWORK_SYNC_BUCKET_SECONDS 86400
+
+//largest decrypted frame a reader accepts, writers send a frame once it passes ENCRYPTED_CHUNK_SIZE
+#define NETWORK_MAX_FRAME_SIZE (ENCRYPTED_CHUNK_SIZE * 4)
+//longest clip description sent in a frame
+#define NETWORK_MAX_DESC_SIZE 32768
+
+enum eNetworkMessage
+{
+	NETWORK_MESSAGE_START = 1,			//NETWORK_FIELD_IP, COMPUTER_NAME, DESC, MANUAL_SEND, RESPOND_PORT
+	NETWORK_MESSAGE_FORMAT = 2,			//NETWORK_FIELD_FORMAT_NAME, DATA
+	NETWORK_MESSAGE_FORMAT_CHUNKED = 3,	//NETWORK_FIELD_FORMAT_NAME, SIZE, the data follows the frame as encrypted records, always last in its frame
+	NETWORK_MESSAGE_END = 4,
+	NETWORK_MESSAGE_FLUSH = 5,
+	NETWORK_MESSAGE_EXIT = 6,
+	NETWORK_MESSAGE_SYNC_SUMMARY = 7,	//NETWORK_FIELD_SYNC_BUCKETS
+	NETWORK_MESSAGE_SYNC_SUMMARY_END = 8,
+	NETWORK_MESSAGE_SYNC_KEYS = 9,		//NETWORK_FIELD_SYNC_BUCKET, SYNC_KEYS, SYNC_MORE if the bucket's keys go on in the next message
+	NETWORK_MESSAGE_SYNC_KEYS_END = 10,
+	NETWORK_MESSAGE_SYNC_REQUEST = 11,	//NETWORK_FIELD_SYNC_KEYS
+	NETWORK_MESSAGE_SYNC_REQUEST_END = 12,
+};
+
+enum eNetworkField
+{
+	NETWORK_FIELD_IP = 1,
+	NETWORK_FIELD_COMPUTER_NAME = 2,
+	NETWORK_FIELD_DESC = 3,
+	NETWORK_FIELD_MANUAL_SEND = 4,
+	NETWORK_FIELD_RESPOND_PORT = 5,
+	NETWORK_FIELD_FORMAT_NAME = 6,
+	NETWORK_FIELD_DATA = 7,
+	NETWORK_FIELD_SIZE = 8,
+	NETWORK_FIELD_ORIGINAL_SIZE = 9,		//NETWORK_FIELD_DATA is zlib data that uncompresses to this
+	NETWORK_FIELD_COMPRESSED = 10,		//the FORMAT_CHUNKED records have a flag byte after the offset, 1 if the rest is zlib data
+	NETWORK_FIELD_DATE = 11,			//a synced clip's lDate, kept as is by the receiver
+	NETWORK_FIELD_CRC = 12,				//a synced clip's CRC
+	NETWORK_FIELD_SYNC_BUCKETS = 13,	//for each bucket: bucket number minus the last one, clip count (varints), 8 byte little endian hash
+	NETWORK_FIELD_SYNC_BUCKET = 14,
+	NETWORK_FIELD_SYNC_KEYS = 15,		//for each key: lDate minus the last one (varint), 4 byte little endian CRC, sorted by lDate then CRC
+	NETWORK_FIELD_SYNC_MORE = 16,
+};
+
 class MyEnums
 {
 public:
-	enum eSendType{START, DATA, DATA_START, DATA_END, END, EXIT, REQUEST_FILES};
+	enum eSendType{START, DATA, DATA_START, DATA_END, END, EXIT, REQUEST_FILES, VERSION, FLUSH, FRAMES, RESUME, SYNC};
 };
 
 class CSendInfo
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+//sqlite helpers for the database benchmarks. The tables and indexes are the ones CreateDB and ValidDB make, Ditto links
+//sqlite3mc which has the same api, these link the system sqlite3
+
+namespace BenchDb
+{
+	inline void Check(int result, sqlite3 *pDb, const char *pWhat)
+	{
+		if (result != SQLITE_OK && result != SQLITE_DONE && result != SQLITE_ROW)
+		{
+			printf("%s failed: %s\n", pWhat, pDb != NULL ? sqlite3_errmsg(pDb) : sqlite3_errstr(result));
+			exit(1);
+		}
+	}
+
+	inline sqlite3 *Open(const std::string &path, bool readOnly = false)
+	{
+		sqlite3 *pDb = NULL;
+		int flags = readOnly ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+		Check(sqlite3_open_v2(path.c_str(), &pDb, flags | SQLITE_OPEN_NOMUTEX, NULL), pDb, "open");
+		return pDb;
+	}
+
+	inline void Exec(sqlite3 *pDb, const std::string &sql)
+	{
+		Check(sqlite3_exec(pDb, sql.c_str(), NULL, NULL, NULL), pDb, sql.c_str());
+	}
+
+	inline sqlite3_stmt *Prepare(sqlite3 *pDb, const std::string &sql)
+	{
+		sqlite3_stmt *pStmt = NULL;
+		Check(sqlite3_prepare_v2(pDb, sql.c_str(), -1, &pStmt, NULL), pDb, sql.c_str());
+		return pStmt;
+	}
+
+	inline std::string TempPath(const char *pName)
+	{
+		const char *pDir = getenv("TMPDIR");
+		std::string path = (pDir != NULL && pDir[0] != 0) ? pDir : "/tmp";
+		path += "/";
+		path += pName;
+		return path;
+	}
+
+	inline void Delete(const std::string &path)
+	{
+		remove(path.c_str());
+		remove((path + "-wal").c_str());
+		remove((path + "-shm").c_str());
+		remove((path + "-journal").c_str());
+	}
+
+	inline void CreateTables(sqlite3 *pDb)
+	{
+		Exec(pDb, "CREATE TABLE Main("
+			"lID INTEGER PRIMARY KEY AUTOINCREMENT, "
+			"lDate INTEGER, "
+			"mText TEXT, "
+			"lShortCut INTEGER, "
+			"lDontAutoDelete INTEGER, "
+			"CRC INTEGER, "
+			"bIsGroup INTEGER, "
+			"lParentID INTEGER, "
+			"QuickPasteText TEXT, "
+			"clipOrder REAL, "
+			"clipGroupOrder REAL, "
+			"globalShortCut INTEGER, "
+			"lastPasteDate INTEGER, "
+			"stickyClipOrder REAL, "
+			"stickyClipGroupOrder REAL, "
+			"MoveToGroupShortCut INTEGER, "
+			"GlobalMoveToGroupShortCut INTEGER);");
+
+		Exec(pDb, "CREATE TABLE Data("
+			"lID INTEGER PRIMARY KEY AUTOINCREMENT, "
+			"lParentID INTEGER, "
+			"strClipBoardFormat TEXT, "
+			"ooData BLOB, "
+			"blobID INTEGER, "
+			"lOriginalSize INTEGER);");
+
+		Exec(pDb, "CREATE INDEX Main_TopLevel ON Main(stickyClipOrder DESC, bIsGroup ASC, clipOrder DESC);");
+		Exec(pDb, "CREATE INDEX Main_InGroup2 ON Main(lParentId ASC, stickyClipGroupOrder DESC, bIsGroup ASC, clipGroupOrder DESC);");
+		Exec(pDb, "CREATE INDEX Main_CRC on Main(CRC ASC)");
+		Exec(pDb, "CREATE INDEX Main_DateCRC on Main(lDate ASC, CRC ASC, bIsGroup ASC)");
+		Exec(pDb, "CREATE INDEX Data_ParentId_Format ON Data(lParentID COLLATE BINARY ASC, strClipBoardFormat COLLATE NOCASE ASC);");
+	}
+
+	//DataBlobs and the DataContent view from CreateDataBlobsTable, the clip data queries read through the view
+	inline void CreateDataBlobs(sqlite3 *pDb)
+	{
+		Exec(pDb, "CREATE TABLE IF NOT EXISTS DataBlobs("
+			"lID INTEGER PRIMARY KEY AUTOINCREMENT, "
+			"hash BLOB UNIQUE, "
+			"refCount INTEGER, "
+			"ooData BLOB, "
+			"lOriginalSize INTEGER)");
+
+		Exec(pDb, "CREATE TRIGGER IF NOT EXISTS DataBlobs_insert_trigger AFTER INSERT ON Data FOR EACH ROW WHEN new.blobID IS NOT NULL\n"
+			"BEGIN\n"
+				"UPDATE DataBlobs SET refCount = refCount + 1 WHERE lID = new.blobID;\n"
+			"END\n");
+
+		Exec(pDb, "CREATE VIEW IF NOT EXISTS DataContent AS "
+			"SELECT Data.lID AS lID, Data.lParentID AS lParentID, Data.strClipBoardFormat AS strClipBoardFormat, IFNULL(Data.ooData, DataBlobs.ooData) AS ooData, "
+			"CASE WHEN Data.ooData IS NULL THEN DataBlobs.lOriginalSize ELSE Data.lOriginalSize END AS lOriginalSize "
+			"FROM Data LEFT JOIN DataBlobs ON DataBlobs.lID = Data.blobID");
+	}
+
+	inline uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	//a text clip, the same columns AddToDB writes. Every 50th has a sticky order, most clips don't
+	inline void InsertClip(sqlite3_stmt *pMain, sqlite3_stmt *pData, uint64_t &random, int64_t id, int dataBytes)
+	{
+		char text[96];
+		snprintf(text, sizeof(text), "clip %lld %llx", (long long)id, (unsigned long long)NextRandom(random));
+
+		sqlite3_bind_int64(pMain, 1, id);
+		sqlite3_bind_int64(pMain, 2, 1600000000 + id * 30);
+		sqlite3_bind_text(pMain, 3, text, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64(pMain, 4, (int64_t)(NextRandom(random) & 0xFFFFFFFF));
+		sqlite3_bind_double(pMain, 5, (double)id);
+		if (id % 50 == 0)
+		{
+			sqlite3_bind_double(pMain, 6, (double)id);
+		}
+		else
+		{
+			sqlite3_bind_null(pMain, 6);
+		}
+
+		sqlite3_step(pMain);
+		sqlite3_reset(pMain);
+
+		if (pData == NULL)
+		{
+			return;
+		}
+
+		std::vector<unsigned char> data((size_t)dataBytes);
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = (unsigned char)('a' + NextRandom(random) % 26);
+		}
+
+		sqlite3_bind_int64(pData, 1, id);
+		sqlite3_bind_blob(pData, 2, data.empty() ? NULL : &data[0], (int)data.size(), SQLITE_TRANSIENT);
+		sqlite3_bind_int(pData, 3, dataBytes);
+		sqlite3_step(pData);
+		sqlite3_reset(pData);
+	}
+
+	inline const char *InsertMainSql()
+	{
+		return "INSERT INTO Main (lID, lDate, mText, CRC, bIsGroup, lParentID, clipOrder, clipGroupOrder, stickyClipOrder, lDontAutoDelete, lShortCut, lastPasteDate) "
+			"VALUES(?1, ?2, ?3, ?4, 0, -1, ?5, 0, ?6, 0, 0, ?2)";
+	}
+
+	inline const char *InsertDataSql()
+	{
+		return "INSERT INTO Data (lParentID, strClipBoardFormat, ooData, lOriginalSize) VALUES(?1, 'CF_UNICODETEXT', ?2, ?3)";
+	}
+
+	//clips 1 to count, in transactions of 10000. No Data rows are added if dataBytes is negative
+	inline void Fill(sqlite3 *pDb, int count, int dataBytes, uint64_t seed)
+	{
+		sqlite3_stmt *pMain = Prepare(pDb, InsertMainSql());
+		sqlite3_stmt *pData = dataBytes >= 0 ? Prepare(pDb, InsertDataSql()) : NULL;
+
+		uint64_t random = seed | 1;
+		for (int id = 1; id <= count; id++)
+		{
+			if ((id - 1) % 10000 == 0)
+			{
+				Exec(pDb, "BEGIN");
+			}
+
+			InsertClip(pMain, pData, random, id, dataBytes);
+
+			if (id % 10000 == 0 || id == count)
+			{
+				Exec(pDb, "COMMIT");
+			}
+		}
+
+		sqlite3_finalize(pMain);
+		sqlite3_finalize(pData);
+	}
+
+	inline double NowMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//percent of 0 to 100, sorts times
+	inline double Percentile(std::vector<double> &times, double percent)
+	{
+		if (times.empty())
+		{
+			return 0.0;
+		}
+
+		std::sort(times.begin(), times.end());
+		size_t index = (size_t)((times.size() - 1) * percent / 100.0 + 0.5);
+		return times[std::min(index, times.size() - 1)];
+	}
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "Crc32Dynamic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+//Clip crc throughput for the old byte at a time loop, slicing-by-8 and pclmul
+//
+//Crc32DynamicBench [-megabytes n]
+
+namespace
+{
+	class CCrc32Paths : public CCrc32Dynamic
+	{
+	public:
+		using CCrc32Dynamic::UpdateSlicingBy8;
+		using CCrc32Dynamic::UpdateClmul;
+		using CCrc32Dynamic::HasClmul;
+	};
+
+	//the loop GenerateCrc32 had, with the table it built each time
+	DWORD ByteAtATime(DWORD crc, const BYTE *pData, size_t size)
+	{
+		DWORD table[256];
+		for (DWORD i = 0; i < 256; i++)
+		{
+			DWORD value = i;
+			for (int j = 8; j > 0; j--)
+			{
+				value = (value & 1) ? ((value >> 1) ^ 0xEDB88320) : (value >> 1);
+			}
+			table[i] = value;
+		}
+
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = (crc >> 8) ^ table[pData[i] ^ (crc & 0xFF)];
+		}
+
+		return crc;
+	}
+
+	//runs for half a second, every run has to give the same crc
+	template <class Work>
+	void Report(const char *pName, const std::vector<BYTE> &buffer, Work work)
+	{
+		DWORD crc = work(0xFFFFFFFF, &buffer[0], buffer.size());
+		bool same = true;
+		int runs = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		double seconds = 0;
+		while (seconds < 0.5)
+		{
+			same = same && work(0xFFFFFFFF, &buffer[0], buffer.size()) == crc;
+			runs++;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		printf("%-14s %10.2f GB/s  crc %08x%s\n", pName, (double)buffer.size() * runs / seconds / 1e9, (unsigned int)crc, same ? "" : " (changed between runs)");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int megabytes = 5;
+	if (argc > 2 && strcmp(argv[1], "-megabytes") == 0)
+	{
+		megabytes = atoi(argv[2]) > 0 ? atoi(argv[2]) : 5;
+	}
+
+	std::vector<BYTE> buffer((size_t)megabytes * 1024 * 1024);
+	for (size_t i = 0; i < buffer.size(); i++)
+	{
+		buffer[i] = (BYTE)(i * 2654435761u >> 13);
+	}
+
+	printf("%d MB buffer\n", megabytes);
+
+	Report("byte at a time", buffer, ByteAtATime);
+	Report("slicing-by-8", buffer, CCrc32Paths::UpdateSlicingBy8);
+
+	if (CCrc32Paths::HasClmul())
+	{
+		Report("pclmul", buffer, [](DWORD crc, const BYTE *pData, size_t size) { return CCrc32Paths::UpdateClmul(crc, pData, size & ~((size_t)15)); });
+	}
+	else
+	{
+		printf("%-14s isn't available on this cpu\n", "pclmul");
+	}
+
+	return 0;
+}
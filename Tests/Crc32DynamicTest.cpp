@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "Crc32Dynamic.h"
+#include "TestCheck.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	//the two paths UpdateCrc32 picks between
+	class CCrc32Paths : public CCrc32Dynamic
+	{
+	public:
+		using CCrc32Dynamic::UpdateSlicingBy8;
+		using CCrc32Dynamic::UpdateClmul;
+		using CCrc32Dynamic::HasClmul;
+	};
+
+	//one bit at a time from the polynomial, what the table used to be built from
+	DWORD ReferenceCrc32(DWORD crc, const BYTE *pData, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			crc ^= pData[i];
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320) : (crc >> 1);
+			}
+		}
+
+		return crc;
+	}
+
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	void TestKnownValue()
+	{
+		const char *pCheck = "123456789";
+
+		//the usual check value 0xCBF43926 is after a final xor, which Main.CRC never had
+		DWORD crc = CCrc32Dynamic::UpdateCrc32(0xFFFFFFFF, (const BYTE *)pCheck, strlen(pCheck));
+		CHECK(crc == (DWORD)~0xCBF43926u);
+
+		CCrc32Dynamic generate;
+		DWORD generated = 0xFFFFFFFF;
+		CHECK(generate.GenerateCrc32((LPBYTE)pCheck, (DWORD)strlen(pCheck), generated) == NO_ERROR);
+		CHECK(generated == crc);
+
+		DWORD unchanged = 0x12345678;
+		CHECK(generate.GenerateCrc32(NULL, 10, unchanged) == ERROR_CRC);
+		CHECK(generate.GenerateCrc32(NULL, 0, unchanged) == NO_ERROR && unchanged == 0x12345678);
+	}
+
+	//random lengths around the 64 and 16 byte blocks at every alignment
+	void TestMatchesReference()
+	{
+		std::vector<BYTE> buffer(70000);
+		uint64_t random = 42;
+		for (size_t i = 0; i < buffer.size(); i++)
+		{
+			buffer[i] = (BYTE)NextRandom(random);
+		}
+
+		for (int i = 0; i < 3000; i++)
+		{
+			size_t offset = (size_t)(NextRandom(random) % 16);
+			size_t size;
+			switch (i % 3)
+			{
+			case 0:
+				size = (size_t)(NextRandom(random) % 200);
+				break;
+			case 1:
+				size = 64 + (size_t)(NextRandom(random) % 1024);
+				break;
+			default:
+				size = (size_t)(NextRandom(random) % (buffer.size() - 16));
+				break;
+			}
+
+			DWORD start = (DWORD)NextRandom(random);
+			DWORD expected = ReferenceCrc32(start, &buffer[offset], size);
+
+			CHECK(CCrc32Dynamic::UpdateCrc32(start, &buffer[offset], size) == expected);
+			CHECK(CCrc32Paths::UpdateSlicingBy8(start, &buffer[offset], size) == expected);
+
+			//the pclmul path takes multiples of 16 from 64 up
+			if (CCrc32Paths::HasClmul() && size >= 64)
+			{
+				size_t clmulSize = size & ~((size_t)15);
+				CHECK(CCrc32Paths::UpdateClmul(start, &buffer[offset], clmulSize) == ReferenceCrc32(start, &buffer[offset], clmulSize));
+			}
+		}
+	}
+
+	//a crc made a piece at a time is the same as one made all at once
+	void TestPieces()
+	{
+		std::vector<BYTE> buffer(10000);
+		uint64_t random = 7;
+		for (size_t i = 0; i < buffer.size(); i++)
+		{
+			buffer[i] = (BYTE)NextRandom(random);
+		}
+
+		DWORD whole = CCrc32Dynamic::UpdateCrc32(0xFFFFFFFF, &buffer[0], buffer.size());
+
+		for (int i = 0; i < 100; i++)
+		{
+			DWORD crc = 0xFFFFFFFF;
+			size_t done = 0;
+			while (done < buffer.size())
+			{
+				size_t piece = std::min(buffer.size() - done, (size_t)(NextRandom(random) % 300));
+				crc = CCrc32Dynamic::UpdateCrc32(crc, &buffer[done], piece);
+				done += piece;
+			}
+
+			CHECK(crc == whole);
+		}
+	}
+}
+
+int main()
+{
+	printf("pclmul %s\n", CCrc32Paths::HasClmul() ? "is used" : "isn't available, only the tables are tested");
+
+	TestKnownValue();
+	TestMatchesReference();
+	TestPieces();
+
+	return TestCheck::Result("Crc32DynamicTest");
+}
@@ -0,0 +1,210 @@
+#include "BenchDb.h"
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+//How long list reads wait while clips are being saved, the reason for WAL and the read connections (DbConnectionPool).
+//
+//shared: one connection in DELETE journal mode for everything, as theApp.m_db was. A save holds the connection for its
+//        whole transaction (CppSQLite3DB's write lock) so a read waits for the save to finish
+//wal:    WAL with synchronous NORMAL, the writer has its own connection and each reader a read only one, the defaults of
+//        DbWalMode, DbSynchronous and DbReadConnections
+//
+//Each reader loads a page of the list or one clip's data in a loop while the writer keeps saving clips.
+//
+//DbWalBench [-seconds n] [-readers n] [-clips n] [-clipBytes n]
+
+namespace
+{
+	class CBenchSettings
+	{
+	public:
+		double m_seconds;
+		int m_readers;
+		int m_clips;
+		int m_clipBytes;
+	};
+
+	class CBenchResult
+	{
+	public:
+		std::vector<double> m_readTimes;
+		int m_writes;
+	};
+
+	const char *PageSql()
+	{
+		return "SELECT Main.lID, Main.mText, Main.lParentID, Main.lDontAutoDelete, Main.lShortCut, Main.bIsGroup, Main.QuickPasteText, "
+			"Main.clipOrder, Main.clipGroupOrder, Main.stickyClipOrder, Main.stickyClipGroupOrder, Main.lDate, Main.lastPasteDate FROM Main "
+			"where (((Main.bIsGroup = 1 AND Main.lParentID = -1) OR Main.bIsGroup = 0)) "
+			"order by Main.stickyClipOrder DESC, Main.bIsGroup ASC, Main.clipOrder DESC, Main.lID ASC LIMIT 50 OFFSET ?1";
+	}
+
+	const char *ClipDataSql()
+	{
+		return "SELECT ooData FROM Data WHERE lParentID = ?1 AND strClipBoardFormat = 'CF_UNICODETEXT'";
+	}
+
+	//one list page or one clip's data, returns the ms it took including any wait for the lock
+	double Read(sqlite3_stmt *pPage, sqlite3_stmt *pClipData, uint64_t &random, int clips, std::mutex *pShared)
+	{
+		double start = BenchDb::NowMs();
+
+		std::unique_lock<std::mutex> lock;
+		if (pShared != NULL)
+		{
+			lock = std::unique_lock<std::mutex>(*pShared);
+		}
+
+		sqlite3_stmt *pStmt = pPage;
+		if (BenchDb::NextRandom(random) % 2 == 0)
+		{
+			sqlite3_bind_int(pPage, 1, (int)(BenchDb::NextRandom(random) % 2000));
+		}
+		else
+		{
+			pStmt = pClipData;
+			sqlite3_bind_int(pClipData, 1, 1 + (int)(BenchDb::NextRandom(random) % clips));
+		}
+
+		int result;
+		while ((result = sqlite3_step(pStmt)) == SQLITE_ROW)
+		{
+		}
+		sqlite3_reset(pStmt);
+
+		BenchDb::Check(result, sqlite3_db_handle(pStmt), "read");
+
+		return BenchDb::NowMs() - start;
+	}
+
+	void Run(const CBenchSettings &settings, bool wal, CBenchResult &result)
+	{
+		std::string path = BenchDb::TempPath(wal ? "DittoWalBench.db" : "DittoSharedBench.db");
+		BenchDb::Delete(path);
+
+		sqlite3 *pWriter = BenchDb::Open(path);
+		sqlite3_busy_timeout(pWriter, 5000);
+		BenchDb::Exec(pWriter, wal ? "PRAGMA journal_mode = WAL" : "PRAGMA journal_mode = DELETE");
+		BenchDb::Exec(pWriter, wal ? "PRAGMA synchronous = 1" : "PRAGMA synchronous = 2");
+		BenchDb::CreateTables(pWriter);
+		BenchDb::Fill(pWriter, settings.m_clips, 200, 1);
+
+		std::mutex shared;
+		std::mutex *pShared = wal ? NULL : &shared;
+
+		std::atomic<bool> stop(false);
+		std::atomic<int> writes(0);
+		std::vector<std::vector<double> > readTimes(settings.m_readers);
+
+		std::vector<std::thread> readers;
+		for (int i = 0; i < settings.m_readers; i++)
+		{
+			readers.push_back(std::thread([&, i]()
+			{
+				sqlite3 *pDb = wal ? BenchDb::Open(path, true) : pWriter;
+				sqlite3_busy_timeout(pDb, 5000);
+
+				sqlite3_stmt *pPage = BenchDb::Prepare(pDb, PageSql());
+				sqlite3_stmt *pClipData = BenchDb::Prepare(pDb, ClipDataSql());
+
+				uint64_t random = 0x9E3779B97F4A7C15ULL + i;
+				while (stop == false)
+				{
+					readTimes[i].push_back(Read(pPage, pClipData, random, settings.m_clips, pShared));
+
+					//the list reads when it's scrolled, not continuously
+					std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				}
+
+				sqlite3_finalize(pPage);
+				sqlite3_finalize(pClipData);
+				if (pDb != pWriter)
+				{
+					sqlite3_close(pDb);
+				}
+			}));
+		}
+
+		std::thread writer([&]()
+		{
+			sqlite3_stmt *pMain = BenchDb::Prepare(pWriter, BenchDb::InsertMainSql());
+			sqlite3_stmt *pData = BenchDb::Prepare(pWriter, BenchDb::InsertDataSql());
+
+			uint64_t random = 12345;
+			int64_t id = settings.m_clips + 1;
+			while (stop == false)
+			{
+				std::unique_lock<std::mutex> lock;
+				if (pShared != NULL)
+				{
+					lock = std::unique_lock<std::mutex>(*pShared);
+				}
+
+				BenchDb::Exec(pWriter, "BEGIN");
+				BenchDb::InsertClip(pMain, pData, random, id++, settings.m_clipBytes);
+				BenchDb::Exec(pWriter, "COMMIT");
+				writes++;
+			}
+
+			sqlite3_finalize(pMain);
+			sqlite3_finalize(pData);
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds((int)(settings.m_seconds * 1000)));
+		stop = true;
+
+		writer.join();
+		for (size_t i = 0; i < readers.size(); i++)
+		{
+			readers[i].join();
+		}
+
+		sqlite3_close(pWriter);
+		BenchDb::Delete(path);
+
+		result.m_readTimes.clear();
+		for (size_t i = 0; i < readTimes.size(); i++)
+		{
+			result.m_readTimes.insert(result.m_readTimes.end(), readTimes[i].begin(), readTimes[i].end());
+		}
+		result.m_writes = writes;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	CBenchSettings settings;
+	settings.m_seconds = 5;
+	settings.m_readers = 2;
+	settings.m_clips = 20000;
+	settings.m_clipBytes = 1024 * 1024;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-seconds") == 0)
+			settings.m_seconds = atof(argv[i + 1]);
+		else if (strcmp(argv[i], "-readers") == 0)
+			settings.m_readers = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-clips") == 0)
+			settings.m_clips = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-clipBytes") == 0)
+			settings.m_clipBytes = std::max(0, atoi(argv[i + 1]));
+	}
+
+	printf("%d readers, %d clips, saving %d byte clips for %.1f seconds\n", settings.m_readers, settings.m_clips, settings.m_clipBytes, settings.m_seconds);
+	printf("%-8s %8s %8s %10s %10s %10s %10s\n", "mode", "saves", "reads", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+	for (int wal = 0; wal < 2; wal++)
+	{
+		CBenchResult result;
+		Run(settings, wal == 1, result);
+
+		std::vector<double> &times = result.m_readTimes;
+		printf("%-8s %8d %8d %10.2f %10.2f %10.2f %10.2f\n", wal ? "wal" : "shared", result.m_writes, (int)times.size(),
+			BenchDb::Percentile(times, 50), BenchDb::Percentile(times, 90), BenchDb::Percentile(times, 99), BenchDb::Percentile(times, 100));
+	}
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include "FastHash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+//Throughput of the XXH64 hash that file transfers are checked with, all at once and as a CChunkedHash
+//with the 64K chunks FileSend uses, fed in the given buffer size
+//
+//FastHashBench [-megabytes n]
+
+namespace
+{
+	//runs for half a second, every run has to give the same hash
+	template <class Work>
+	void Report(const char *pName, const std::vector<unsigned char> &buffer, Work work)
+	{
+		uint64_t hash = work(buffer);
+		bool same = true;
+		int runs = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		double seconds = 0;
+		while (seconds < 0.5)
+		{
+			same = same && work(buffer) == hash;
+			runs++;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		printf("%-24s %10.2f GB/s  hash %016llx%s\n", pName, (double)buffer.size() * runs / seconds / 1e9, (unsigned long long)hash, same ? "" : " (changed between runs)");
+	}
+
+	template <size_t PieceSize>
+	uint64_t Chunked(const std::vector<unsigned char> &buffer)
+	{
+		CChunkedHash hash(65536);
+		for (size_t offset = 0; offset < buffer.size(); offset += PieceSize)
+		{
+			hash.Update(&buffer[offset], std::min(PieceSize, buffer.size() - offset));
+		}
+
+		return hash.Final();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int megabytes = 1;
+	if (argc > 2 && strcmp(argv[1], "-megabytes") == 0)
+	{
+		megabytes = atoi(argv[2]) > 0 ? atoi(argv[2]) : 1;
+	}
+
+	std::vector<unsigned char> buffer((size_t)megabytes * 1024 * 1024);
+	for (size_t i = 0; i < buffer.size(); i++)
+	{
+		buffer[i] = (unsigned char)(i * 2654435761u >> 13);
+	}
+
+	printf("%d MB buffer\n", megabytes);
+
+	Report("XXH64", buffer, [](const std::vector<unsigned char> &data) { return CFastHash::Hash(&data[0], data.size()); });
+	Report("chunked, 64K writes", buffer, Chunked<65536>);
+	Report("chunked, 1500 byte reads", buffer, Chunked<1500>);
+
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include "FastHash.h"
+#include "TestCheck.h"
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	//(i * 7 + 3) & 255, so the values below can be checked with any other xxhash
+	std::vector<unsigned char> Pattern(size_t size)
+	{
+		std::vector<unsigned char> data(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			data[i] = (unsigned char)(i * 7 + 3);
+		}
+
+		return data;
+	}
+
+	void TestKnownValues()
+	{
+		//from the xxHash project
+		CHECK(CFastHash::Hash("", 0) == 0xEF46DB3751D8E999ULL);
+		CHECK(CFastHash::Hash("a", 1) == 0xD24EC4F1A98C6E5BULL);
+		CHECK(CFastHash::Hash("abc", 3) == 0x44BC2CF5AD770999ULL);
+		CHECK(CFastHash::Hash("The quick brown fox jumps over the lazy dog", 43) == 0x0B242D361FDA71BCULL);
+
+		//either side of the 32 byte stripes, with and without a seed
+		std::vector<unsigned char> data = Pattern(1000);
+		CHECK(CFastHash::Hash(&data[0], 31) == 0xA2AA5F33CC4A6119ULL);
+		CHECK(CFastHash::Hash(&data[0], 32) == 0x23C3C17EF790FD97ULL);
+		CHECK(CFastHash::Hash(&data[0], 33) == 0x50A7CFC7BA588784ULL);
+		CHECK(CFastHash::Hash(&data[0], 100) == 0xA61F8D4C170FE531ULL);
+		CHECK(CFastHash::Hash(&data[0], 1000) == 0x5F235FA033F1A3FBULL);
+		CHECK(CFastHash::Hash(&data[0], 31, 12345) == 0x8086BF60119A7308ULL);
+		CHECK(CFastHash::Hash(&data[0], 1000, 12345) == 0x365C39A0C5A4C88EULL);
+		CHECK(CFastHash::Hash("", 0, 1) == 0xD5AFBA1336A3BE4BULL);
+	}
+
+	//a hash fed a piece at a time is the same as Hash, and Reset starts it over
+	void TestPieces()
+	{
+		std::vector<unsigned char> data(5000);
+		uint64_t random = 11;
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = (unsigned char)NextRandom(random);
+		}
+
+		CFastHash hash(99);
+		for (int i = 0; i < 200; i++)
+		{
+			size_t size = (size_t)(NextRandom(random) % data.size());
+			uint64_t seed = (i % 2) ? NextRandom(random) : 0;
+
+			hash.Reset(seed);
+			size_t done = 0;
+			while (done < size)
+			{
+				size_t piece = std::min(size - done, (size_t)(NextRandom(random) % 70));
+				hash.Update(&data[done], piece);
+				done += piece;
+			}
+
+			CHECK(hash.Digest() == CFastHash::Hash(&data[0], size, seed));
+		}
+
+		//Digest doesn't change the state
+		hash.Reset();
+		hash.Update(&data[0], 50);
+		uint64_t first = hash.Digest();
+		CHECK(hash.Digest() == first);
+		hash.Update(&data[50], 50);
+		CHECK(hash.Digest() == CFastHash::Hash(&data[0], 100));
+	}
+
+	//the hash of each chunk's hash then the length
+	uint64_t ChunkedReference(const std::vector<unsigned char> &data, size_t chunkSize)
+	{
+		CFastHash chunks;
+		for (size_t offset = 0; offset < data.size(); offset += chunkSize)
+		{
+			uint64_t chunkHash = CFastHash::Hash(&data[offset], std::min(chunkSize, data.size() - offset));
+			chunks.Update(&chunkHash, sizeof(chunkHash));
+		}
+
+		uint64_t length = data.size();
+		chunks.Update(&length, sizeof(length));
+
+		return chunks.Digest();
+	}
+
+	void TestChunked()
+	{
+		std::vector<unsigned char> data = Pattern(1000);
+
+		CChunkedHash known(64);
+		known.Update(&data[0], data.size());
+		CHECK(known.Final() == 0x0DCCB36B306A2DB7ULL);
+
+		CChunkedHash empty(64);
+		CHECK(empty.Final() == 0x34C96ACDCADB1BBBULL);
+
+		//the sizes of the pieces don't matter, only the chunk size does
+		data.resize(300000);
+		uint64_t random = 3;
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = (unsigned char)NextRandom(random);
+		}
+
+		const size_t chunkSizes[] = { 1, 64, 65536 };
+		for (size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++)
+		{
+			uint64_t expected = ChunkedReference(data, chunkSizes[c]);
+
+			for (int i = 0; i < 5; i++)
+			{
+				CChunkedHash hash(chunkSizes[c]);
+				size_t done = 0;
+				while (done < data.size())
+				{
+					size_t piece = std::min(data.size() - done, (size_t)(NextRandom(random) % 100000));
+					hash.Update(&data[done], piece);
+					done += piece;
+				}
+
+				CHECK(hash.Final() == expected);
+			}
+		}
+
+		//a file that ends on a chunk boundary doesn't get an empty chunk, the length still tells it apart
+		std::vector<unsigned char> exact(data.begin(), data.begin() + 131072);
+		CChunkedHash whole(65536);
+		whole.Update(&exact[0], exact.size());
+		CHECK(whole.Final() == ChunkedReference(exact, 65536));
+
+		//a changed byte changes the hash wherever it is
+		CChunkedHash before(65536);
+		before.Update(&data[0], data.size());
+		uint64_t original = before.Final();
+
+		const size_t changed[] = { 0, 65535, 65536, data.size() - 1 };
+		for (size_t i = 0; i < sizeof(changed) / sizeof(changed[0]); i++)
+		{
+			data[changed[i]] ^= 1;
+
+			CChunkedHash after(65536);
+			after.Update(&data[0], data.size());
+			CHECK(after.Final() != original);
+
+			data[changed[i]] ^= 1;
+		}
+	}
+}
+
+int main()
+{
+	TestKnownValues();
+	TestPieces();
+	TestChunked();
+
+	return TestCheck::Result("FastHashTest");
+}
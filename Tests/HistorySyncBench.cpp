@@ -0,0 +1,427 @@
+#include "BenchDb.h"
+#include "NetworkFrame.h"
+#include <string.h>
+
+//Two databases synced the way CHistorySync does it, until they have the same clips. Each round both sides make
+//the per day summary, the keys of the days that are different are compared and the missing clips, up to
+//NetworkSyncMaxClips each way, are copied. HistorySync.cpp needs mfc and sockets so its queries, hash and encoding
+//are repeated here, the varints are NetworkFrame's. Returns non zero if the two sides don't end up the same.
+//
+//HistorySyncBench [-clips n] [-unique n] [-days n] [-maxclips n]
+
+//-days is how many of the last days of the history the clips only one side has are spread over, 0 for all of it
+
+#define BENCH_SYNC_BUCKET_SECONDS 86400
+
+namespace
+{
+	class CSyncKey
+	{
+	public:
+		CSyncKey(uint32_t date, uint32_t crc, int64_t id)
+		{
+			m_date = date;
+			m_crc = crc;
+			m_id = id;
+		}
+
+		bool operator<(const CSyncKey &other) const
+		{
+			return m_date < other.m_date || (m_date == other.m_date && m_crc < other.m_crc);
+		}
+		bool operator==(const CSyncKey &other) const
+		{
+			return m_date == other.m_date && m_crc == other.m_crc;
+		}
+
+		uint32_t m_date;
+		uint32_t m_crc;
+		int64_t m_id;
+	};
+
+	class CSyncBucket
+	{
+	public:
+		uint32_t m_bucket;
+		uint64_t m_count;
+		uint64_t m_hash;
+	};
+
+	class CSyncTotals
+	{
+	public:
+		CSyncTotals()
+		{
+			m_summaryBytes = 0;
+			m_keyBytes = 0;
+			m_clipsCopied = 0;
+			m_summaryMs = 0;
+			m_summaries = 0;
+		}
+
+		size_t m_summaryBytes;
+		size_t m_keyBytes;
+		size_t m_clipsCopied;
+		double m_summaryMs;
+		int m_summaries;
+	};
+
+	uint64_t HashKey(uint32_t date, uint32_t crc)
+	{
+		uint64_t x = ((uint64_t)date << 32) | crc;
+
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+		return x ^ (x >> 31);
+	}
+
+	void BuildSummary(sqlite3 *pDb, std::vector<CSyncBucket> &buckets, CSyncTotals &totals)
+	{
+		double start = BenchDb::NowMs();
+		buckets.clear();
+
+		sqlite3_stmt *pStmt = BenchDb::Prepare(pDb, "SELECT lDate, CRC FROM Main WHERE bIsGroup = 0 ORDER BY lDate, CRC");
+
+		uint32_t lastDate = 0;
+		uint32_t lastCrc = 0;
+
+		while (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			uint32_t date = (uint32_t)sqlite3_column_int64(pStmt, 0);
+			uint32_t crc = (uint32_t)sqlite3_column_int64(pStmt, 1);
+
+			if (buckets.empty() == false && date == lastDate && crc == lastCrc)
+			{
+				continue;
+			}
+
+			lastDate = date;
+			lastCrc = crc;
+
+			uint32_t bucket = date / BENCH_SYNC_BUCKET_SECONDS;
+			if (buckets.empty() || buckets.back().m_bucket != bucket)
+			{
+				CSyncBucket newBucket;
+				newBucket.m_bucket = bucket;
+				newBucket.m_count = 0;
+				newBucket.m_hash = 0;
+				buckets.push_back(newBucket);
+			}
+
+			buckets.back().m_count++;
+			buckets.back().m_hash += HashKey(date, crc);
+		}
+
+		sqlite3_finalize(pStmt);
+
+		totals.m_summaryMs += BenchDb::NowMs() - start;
+		totals.m_summaries++;
+	}
+
+	void LoadKeys(sqlite3 *pDb, uint32_t bucket, std::vector<CSyncKey> &keys)
+	{
+		keys.clear();
+
+		sqlite3_stmt *pStmt = BenchDb::Prepare(pDb, "SELECT lID, lDate, CRC FROM Main WHERE lDate >= ?1 AND lDate < ?2 AND bIsGroup = 0");
+		sqlite3_bind_int64(pStmt, 1, (int64_t)bucket * BENCH_SYNC_BUCKET_SECONDS);
+		sqlite3_bind_int64(pStmt, 2, ((int64_t)bucket + 1) * BENCH_SYNC_BUCKET_SECONDS);
+
+		while (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			keys.push_back(CSyncKey((uint32_t)sqlite3_column_int64(pStmt, 1), (uint32_t)sqlite3_column_int64(pStmt, 2), sqlite3_column_int64(pStmt, 0)));
+		}
+
+		sqlite3_finalize(pStmt);
+
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	}
+
+	size_t BucketBytes(const std::vector<CSyncBucket> &buckets)
+	{
+		std::vector<unsigned char> out;
+		uint32_t last = 0;
+
+		for (size_t i = 0; i < buckets.size(); i++)
+		{
+			CNetworkFrameWriter::PutVarint(out, buckets[i].m_bucket - last);
+			CNetworkFrameWriter::PutVarint(out, buckets[i].m_count);
+			out.resize(out.size() + 8);
+			last = buckets[i].m_bucket;
+		}
+
+		return out.size();
+	}
+
+	size_t KeyBytes(const std::vector<CSyncKey> &keys)
+	{
+		std::vector<unsigned char> out;
+		uint32_t last = 0;
+
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			CNetworkFrameWriter::PutVarint(out, keys[i].m_date - last);
+			out.resize(out.size() + 4);
+			last = keys[i].m_date;
+		}
+
+		return out.size();
+	}
+
+	//the days where the two summaries differ, including days only one side has
+	void DifferentBuckets(const std::vector<CSyncBucket> &local, const std::vector<CSyncBucket> &remote, std::vector<uint32_t> &different)
+	{
+		size_t l = 0;
+		size_t r = 0;
+
+		while (l < local.size() || r < remote.size())
+		{
+			if (r == remote.size() || (l < local.size() && local[l].m_bucket < remote[r].m_bucket))
+			{
+				different.push_back(local[l++].m_bucket);
+			}
+			else if (l == local.size() || remote[r].m_bucket < local[l].m_bucket)
+			{
+				different.push_back(remote[r++].m_bucket);
+			}
+			else
+			{
+				if (local[l].m_count != remote[r].m_count || local[l].m_hash != remote[r].m_hash)
+				{
+					different.push_back(local[l].m_bucket);
+				}
+				l++;
+				r++;
+			}
+		}
+	}
+
+	void CompareBucket(const std::vector<CSyncKey> &localKeys, const std::vector<CSyncKey> &remoteKeys, std::vector<CSyncKey> &send, std::vector<CSyncKey> &wanted, size_t maxClips)
+	{
+		size_t local = 0;
+		size_t remote = 0;
+
+		while (local < localKeys.size() || remote < remoteKeys.size())
+		{
+			if (remote == remoteKeys.size() || (local < localKeys.size() && localKeys[local] < remoteKeys[remote]))
+			{
+				if (send.size() < maxClips)
+				{
+					send.push_back(localKeys[local]);
+				}
+				local++;
+			}
+			else if (local == localKeys.size() || remoteKeys[remote] < localKeys[local])
+			{
+				if (wanted.size() < maxClips)
+				{
+					wanted.push_back(remoteKeys[remote]);
+				}
+				remote++;
+			}
+			else
+			{
+				local++;
+				remote++;
+			}
+		}
+	}
+
+	//a synced clip keeps its date and crc and gets a new id on the side it's added to
+	void CopyClips(sqlite3 *pFrom, sqlite3 *pTo, const std::vector<CSyncKey> &keys)
+	{
+		sqlite3_stmt *pRead = BenchDb::Prepare(pFrom, "SELECT mText FROM Main WHERE lID = ?1");
+		sqlite3_stmt *pWrite = BenchDb::Prepare(pTo, "INSERT INTO Main (lDate, mText, CRC, bIsGroup, lParentID, clipOrder, clipGroupOrder, lDontAutoDelete, lShortCut, lastPasteDate) "
+			"VALUES(?1, ?2, ?3, 0, -1, ?1, 0, 0, 0, ?1)");
+
+		BenchDb::Exec(pTo, "BEGIN");
+
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			sqlite3_bind_int64(pRead, 1, keys[i].m_id);
+			if (sqlite3_step(pRead) == SQLITE_ROW)
+			{
+				sqlite3_bind_int64(pWrite, 1, keys[i].m_date);
+				sqlite3_bind_text(pWrite, 2, (const char *)sqlite3_column_text(pRead, 0), -1, SQLITE_TRANSIENT);
+				sqlite3_bind_int64(pWrite, 3, keys[i].m_crc);
+				sqlite3_step(pWrite);
+				sqlite3_reset(pWrite);
+			}
+			sqlite3_reset(pRead);
+		}
+
+		BenchDb::Exec(pTo, "COMMIT");
+
+		sqlite3_finalize(pRead);
+		sqlite3_finalize(pWrite);
+	}
+
+	//one SyncWith from pLocal to pRemote, returns the number of days that were different
+	size_t Sync(sqlite3 *pLocal, sqlite3 *pRemote, size_t maxClips, CSyncTotals &totals)
+	{
+		std::vector<CSyncBucket> localBuckets;
+		std::vector<CSyncBucket> remoteBuckets;
+		BuildSummary(pLocal, localBuckets, totals);
+		BuildSummary(pRemote, remoteBuckets, totals);
+		totals.m_summaryBytes += BucketBytes(localBuckets);
+
+		std::vector<uint32_t> different;
+		DifferentBuckets(localBuckets, remoteBuckets, different);
+
+		std::vector<CSyncKey> send;
+		std::vector<CSyncKey> wanted;
+		std::vector<CSyncKey> localKeys;
+		std::vector<CSyncKey> remoteKeys;
+
+		for (size_t i = 0; i < different.size(); i++)
+		{
+			LoadKeys(pRemote, different[i], remoteKeys);
+			LoadKeys(pLocal, different[i], localKeys);
+			totals.m_keyBytes += KeyBytes(remoteKeys);
+
+			CompareBucket(localKeys, remoteKeys, send, wanted, maxClips);
+		}
+
+		totals.m_keyBytes += KeyBytes(wanted);
+
+		CopyClips(pRemote, pLocal, wanted);
+		CopyClips(pLocal, pRemote, send);
+		totals.m_clipsCopied += wanted.size() + send.size();
+
+		return different.size();
+	}
+
+	//clips only this side has, at random times in the last days of the shared history
+	void AddUnique(sqlite3 *pDb, int count, int clips, int days, uint64_t seed)
+	{
+		int64_t end = 1600000000 + (int64_t)clips * 30;
+		int64_t span = days > 0 ? std::min((int64_t)days * BENCH_SYNC_BUCKET_SECONDS, (int64_t)clips * 30) : (int64_t)clips * 30;
+
+		sqlite3_stmt *pStmt = BenchDb::Prepare(pDb, "INSERT INTO Main (lDate, mText, CRC, bIsGroup, lParentID, clipOrder, clipGroupOrder, lDontAutoDelete, lShortCut, lastPasteDate) "
+			"VALUES(?1, ?2, ?3, 0, -1, ?1, 0, 0, 0, ?1)");
+
+		uint64_t random = seed | 1;
+		BenchDb::Exec(pDb, "BEGIN");
+
+		for (int i = 0; i < count; i++)
+		{
+			int64_t date = end - 1 - (int64_t)(BenchDb::NextRandom(random) % (uint64_t)span);
+			char text[64];
+			snprintf(text, sizeof(text), "unique %d %llx", i, (unsigned long long)seed);
+
+			sqlite3_bind_int64(pStmt, 1, date);
+			sqlite3_bind_text(pStmt, 2, text, -1, SQLITE_TRANSIENT);
+			sqlite3_bind_int64(pStmt, 3, (int64_t)(BenchDb::NextRandom(random) & 0xFFFFFFFF));
+			sqlite3_step(pStmt);
+			sqlite3_reset(pStmt);
+		}
+
+		BenchDb::Exec(pDb, "COMMIT");
+		sqlite3_finalize(pStmt);
+	}
+
+	void AllKeys(sqlite3 *pDb, std::vector<CSyncKey> &keys)
+	{
+		keys.clear();
+
+		sqlite3_stmt *pStmt = BenchDb::Prepare(pDb, "SELECT DISTINCT lDate, CRC FROM Main WHERE bIsGroup = 0 ORDER BY lDate, CRC");
+		while (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			keys.push_back(CSyncKey((uint32_t)sqlite3_column_int64(pStmt, 0), (uint32_t)sqlite3_column_int64(pStmt, 1), -1));
+		}
+
+		sqlite3_finalize(pStmt);
+	}
+
+	void PrintPlan(sqlite3 *pDb, const char *pSql)
+	{
+		sqlite3_stmt *pStmt = BenchDb::Prepare(pDb, std::string("EXPLAIN QUERY PLAN ") + pSql);
+		while (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			printf("  %s\n", (const char *)sqlite3_column_text(pStmt, 3));
+		}
+
+		sqlite3_finalize(pStmt);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int clips = 200000;
+	int unique = 2000;
+	int days = 3;
+	int maxClips = 100000;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-clips") == 0)
+			clips = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-unique") == 0)
+			unique = std::max(0, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-days") == 0)
+			days = std::max(0, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-maxclips") == 0)
+			maxClips = std::max(1, atoi(argv[i + 1]));
+	}
+
+	std::string pathA = BenchDb::TempPath("DittoHistorySyncA.db");
+	std::string pathB = BenchDb::TempPath("DittoHistorySyncB.db");
+	BenchDb::Delete(pathA);
+	BenchDb::Delete(pathB);
+
+	sqlite3 *pA = BenchDb::Open(pathA);
+	sqlite3 *pB = BenchDb::Open(pathB);
+
+	//the same history on both, then clips each side copied while they weren't syncing
+	sqlite3 *sides[] = { pA, pB };
+	for (int i = 0; i < 2; i++)
+	{
+		BenchDb::Exec(sides[i], "PRAGMA journal_mode = WAL");
+		BenchDb::CreateTables(sides[i]);
+		BenchDb::Fill(sides[i], clips, -1, 1);
+		AddUnique(sides[i], unique, clips, days, 100 + 100 * i);
+	}
+
+	printf("%d shared clips over %d days, %d only on each side in the last %d days (0 is all), at most %d clips each way per sync\n",
+		clips, (int)((int64_t)clips * 30 / BENCH_SYNC_BUCKET_SECONDS + 1), unique, days, maxClips);
+
+	printf("summary query plan:\n");
+	PrintPlan(pA, "SELECT lDate, CRC FROM Main WHERE bIsGroup = 0 ORDER BY lDate, CRC");
+
+	std::vector<CSyncKey> before;
+	AllKeys(pA, before);
+	size_t everyKeyBytes = KeyBytes(before);
+
+	CSyncTotals totals;
+	int syncs = 0;
+	size_t different = 0;
+	do
+	{
+		different = Sync(pA, pB, (size_t)maxClips, totals);
+		syncs++;
+		printf("sync %d: %zu days different\n", syncs, different);
+	}
+	while (different > 0 && syncs < 100);
+
+	std::vector<CSyncKey> keysA;
+	std::vector<CSyncKey> keysB;
+	AllKeys(pA, keysA);
+	AllKeys(pB, keysB);
+
+	bool same = keysA.size() == keysB.size() && std::equal(keysA.begin(), keysA.end(), keysB.begin());
+	bool complete = keysA.size() == (size_t)clips + 2 * (size_t)unique;
+
+	printf("summary %.1f ms each, %zu bytes sent in summaries, %zu in keys, sending every key once would be %zu\n",
+		totals.m_summaryMs / std::max(1, totals.m_summaries), totals.m_summaryBytes, totals.m_keyBytes, everyKeyBytes);
+	printf("%zu clips copied, both sides have %zu and %zu clips, %s\n", totals.m_clipsCopied, keysA.size(), keysB.size(),
+		(same && complete) ? "the same" : "NOT the same");
+
+	sqlite3_close(pA);
+	sqlite3_close(pB);
+	BenchDb::Delete(pathA);
+	BenchDb::Delete(pathB);
+
+	return (same && complete) ? 0 : 1;
+}
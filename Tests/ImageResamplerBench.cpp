@@ -0,0 +1,152 @@
+#include "ImageResampler.h"
+#include "ReferenceResampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+//Times scaling screenshots to list thumbnail size. With no arguments it makes a few screenshot sized images, otherwise
+//each argument is a .bmp file to use, for timing a real corpus.
+//
+//ImageResamplerBench [-iterations n] [file.bmp ...]
+
+namespace
+{
+	class CBenchImage
+	{
+	public:
+		std::string m_name;
+		std::vector<uint8_t> m_pixels;
+		int m_width;
+		int m_height;
+	};
+
+	bool LoadBmp(const char *pFile, CBenchImage &image)
+	{
+		FILE *pStream = fopen(pFile, "rb");
+		if (pStream == NULL)
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> file;
+		uint8_t buffer[65536];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), pStream)) > 0)
+		{
+			file.insert(file.end(), buffer, buffer + read);
+		}
+		fclose(pStream);
+
+		//the 14 byte file header is followed by the same packed dib that's on the clipboard
+		if (file.size() < 14 || file[0] != 'B' || file[1] != 'M')
+		{
+			return false;
+		}
+
+		image.m_name = pFile;
+		return CImageResampler::DecodeDib(&file[14], file.size() - 14, image.m_pixels, image.m_width, image.m_height);
+	}
+
+	void MakeImage(int width, int height, CBenchImage &image)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "screenshot %dx%d", width, height);
+
+		image.m_name = name;
+		image.m_width = width;
+		image.m_height = height;
+		ReferenceResampler::MakeScreenshot(image.m_pixels, width, height, (unsigned int)width);
+	}
+
+	//same fit as the list thumbnails, the longest side becomes size
+	void ThumbnailSize(int width, int height, int size, int &thumbnailWidth, int &thumbnailHeight)
+	{
+		if (width >= height)
+		{
+			thumbnailWidth = size;
+			thumbnailHeight = std::max(1, (int)((double)height * size / width + 0.5));
+		}
+		else
+		{
+			thumbnailHeight = size;
+			thumbnailWidth = std::max(1, (int)((double)width * size / height + 0.5));
+		}
+	}
+
+	template <class Work>
+	double TimeMs(int iterations, Work work)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			work();
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = 10;
+	std::vector<CBenchImage> images;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+		{
+			iterations = std::max(1, atoi(argv[++i]));
+			continue;
+		}
+
+		CBenchImage image;
+		if (LoadBmp(argv[i], image) == false)
+		{
+			printf("can't read %s\n", argv[i]);
+			return 1;
+		}
+
+		images.push_back(image);
+	}
+
+	if (images.empty())
+	{
+		const int sizes[][2] = { { 1366, 768 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		{
+			CBenchImage image;
+			MakeImage(sizes[i][0], sizes[i][1], image);
+			images.push_back(image);
+		}
+	}
+
+	printf("%-32s %12s %12s %12s %14s\n", "image", "thumbnail", "box ms", "lanczos3 ms", "reference ms");
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const CBenchImage &image = images[i];
+
+		int width;
+		int height;
+		ThumbnailSize(image.m_width, image.m_height, 256, width, height);
+
+		std::vector<uint8_t> scaled((size_t)width * height * 4);
+
+		double box = TimeMs(iterations, [&]() { CImageResampler::Resize(&image.m_pixels[0], image.m_width, image.m_height, &scaled[0], width, height, RESAMPLE_BOX); });
+		double lanczos = TimeMs(iterations, [&]() { CImageResampler::Resize(&image.m_pixels[0], image.m_width, image.m_height, &scaled[0], width, height, RESAMPLE_LANCZOS3); });
+
+		//the reference weighs every source pixel, once is enough to see the difference
+		std::vector<double> reference;
+		double referenceMs = TimeMs(1, [&]() { ReferenceResampler::Resize(&image.m_pixels[0], image.m_width, image.m_height, reference, width, height, RESAMPLE_LANCZOS3); });
+
+		char thumbnail[32];
+		snprintf(thumbnail, sizeof(thumbnail), "%dx%d", width, height);
+
+		printf("%-32s %12s %12.2f %12.2f %14.2f\n", image.m_name.c_str(), thumbnail, box, lanczos, referenceMs);
+	}
+
+	return 0;
+}
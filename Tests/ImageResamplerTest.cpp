@@ -0,0 +1,303 @@
+#include "ImageResampler.h"
+#include "ReferenceResampler.h"
+#include "TestCheck.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	//largest difference of any channel between CImageResampler and the reference
+	int MaxDifference(const std::vector<uint8_t> &pixels, int srcWidth, int srcHeight, int dstWidth, int dstHeight, eResampleFilter filter)
+	{
+		std::vector<uint8_t> scaled((size_t)dstWidth * dstHeight * 4);
+		if (CImageResampler::Resize(&pixels[0], srcWidth, srcHeight, &scaled[0], dstWidth, dstHeight, filter) == false)
+		{
+			return 256;
+		}
+
+		std::vector<double> reference;
+		ReferenceResampler::Resize(&pixels[0], srcWidth, srcHeight, reference, dstWidth, dstHeight, filter);
+
+		int largest = 0;
+		for (size_t i = 0; i < scaled.size(); i++)
+		{
+			int difference = abs((int)scaled[i] - (int)floor(reference[i] + 0.5));
+			largest = std::max(largest, difference);
+		}
+
+		return largest;
+	}
+
+	void TestMatchesReference()
+	{
+		struct Size
+		{
+			int srcWidth;
+			int srcHeight;
+			int dstWidth;
+			int dstHeight;
+		};
+
+		//odd widths leave some pixels after the last full simd block, the small ones have fewer pixels than taps
+		const Size sizes[] =
+		{
+			{ 640, 480, 160, 120 },
+			{ 643, 359, 97, 53 },
+			{ 300, 200, 299, 199 },
+			{ 57, 31, 200, 100 },
+			{ 3, 2, 40, 30 },
+			{ 1, 1, 5, 7 },
+			{ 25, 9, 1, 1 },
+			{ 1500, 1, 7, 1 },
+		};
+
+		const eResampleFilter filters[] = { RESAMPLE_BOX, RESAMPLE_LANCZOS3 };
+
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+		{
+			const Size &size = sizes[s];
+
+			std::vector<uint8_t> noise;
+			ReferenceResampler::MakeNoise(noise, size.srcWidth, size.srcHeight, (unsigned int)s + 1);
+
+			std::vector<uint8_t> screenshot;
+			ReferenceResampler::MakeScreenshot(screenshot, size.srcWidth, size.srcHeight, (unsigned int)s + 1);
+
+			for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++)
+			{
+				//the weights are rounded to 14 bits and the first pass is rounded to bytes
+				int allowed = (filters[f] == RESAMPLE_BOX) ? 1 : 2;
+
+				int difference = MaxDifference(noise, size.srcWidth, size.srcHeight, size.dstWidth, size.dstHeight, filters[f]);
+				if (CHECK(difference <= allowed) == false)
+				{
+					printf("  noise %dx%d to %dx%d filter %d, off by %d\n", size.srcWidth, size.srcHeight, size.dstWidth, size.dstHeight, (int)filters[f], difference);
+				}
+
+				difference = MaxDifference(screenshot, size.srcWidth, size.srcHeight, size.dstWidth, size.dstHeight, filters[f]);
+				if (CHECK(difference <= allowed) == false)
+				{
+					printf("  screenshot %dx%d to %dx%d filter %d, off by %d\n", size.srcWidth, size.srcHeight, size.dstWidth, size.dstHeight, (int)filters[f], difference);
+				}
+			}
+		}
+	}
+
+	//large enough to be split over threads
+	void TestLargeImage()
+	{
+		const int srcWidth = 1920;
+		const int srcHeight = 1080;
+
+		std::vector<uint8_t> screenshot;
+		ReferenceResampler::MakeScreenshot(screenshot, srcWidth, srcHeight, 7);
+
+		CHECK(MaxDifference(screenshot, srcWidth, srcHeight, 240, 135, RESAMPLE_BOX) <= 1);
+		CHECK(MaxDifference(screenshot, srcWidth, srcHeight, 240, 135, RESAMPLE_LANCZOS3) <= 2);
+	}
+
+	void TestFlatColorStaysFlat()
+	{
+		const int srcWidth = 333;
+		const int srcHeight = 187;
+
+		std::vector<uint8_t> pixels((size_t)srcWidth * srcHeight * 4);
+		for (size_t i = 0; i < pixels.size(); i += 4)
+		{
+			pixels[i] = 12;
+			pixels[i + 1] = 200;
+			pixels[i + 2] = 255;
+			pixels[i + 3] = 255;
+		}
+
+		const int dstSizes[][2] = { { 50, 29 }, { 332, 186 }, { 700, 400 }, { 1, 1 } };
+		const eResampleFilter filters[] = { RESAMPLE_BOX, RESAMPLE_LANCZOS3 };
+
+		for (size_t s = 0; s < sizeof(dstSizes) / sizeof(dstSizes[0]); s++)
+		{
+			for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++)
+			{
+				int dstWidth = dstSizes[s][0];
+				int dstHeight = dstSizes[s][1];
+
+				std::vector<uint8_t> scaled((size_t)dstWidth * dstHeight * 4);
+				CHECK(CImageResampler::Resize(&pixels[0], srcWidth, srcHeight, &scaled[0], dstWidth, dstHeight, filters[f]));
+
+				bool flat = true;
+				for (size_t i = 0; i < scaled.size(); i += 4)
+				{
+					if (scaled[i] != 12 || scaled[i + 1] != 200 || scaled[i + 2] != 255 || scaled[i + 3] != 255)
+					{
+						flat = false;
+					}
+				}
+
+				CHECK(flat);
+			}
+		}
+	}
+
+	//halving with the box filter is the average of each 2x2 block
+	void TestBoxHalves()
+	{
+		const int srcWidth = 64;
+		const int srcHeight = 48;
+
+		std::vector<uint8_t> pixels;
+		ReferenceResampler::MakeNoise(pixels, srcWidth, srcHeight, 3);
+
+		std::vector<uint8_t> scaled((size_t)(srcWidth / 2) * (srcHeight / 2) * 4);
+		CHECK(CImageResampler::Resize(&pixels[0], srcWidth, srcHeight, &scaled[0], srcWidth / 2, srcHeight / 2, RESAMPLE_BOX));
+
+		int largest = 0;
+		for (int y = 0; y < srcHeight / 2; y++)
+		{
+			for (int x = 0; x < srcWidth / 2; x++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = pixels[((size_t)(y * 2) * srcWidth + x * 2) * 4 + c] +
+						pixels[((size_t)(y * 2) * srcWidth + x * 2 + 1) * 4 + c] +
+						pixels[((size_t)(y * 2 + 1) * srcWidth + x * 2) * 4 + c] +
+						pixels[((size_t)(y * 2 + 1) * srcWidth + x * 2 + 1) * 4 + c];
+
+					int difference = abs(scaled[((size_t)y * (srcWidth / 2) + x) * 4 + c] * 4 - sum);
+					largest = std::max(largest, difference);
+				}
+			}
+		}
+
+		//the row pass rounds to a byte before the column pass, so 1 either way after both
+		CHECK(largest <= 4);
+	}
+
+	void TestSameSizeCopies()
+	{
+		std::vector<uint8_t> pixels;
+		ReferenceResampler::MakeNoise(pixels, 31, 17, 5);
+
+		std::vector<uint8_t> scaled(pixels.size());
+		CHECK(CImageResampler::Resize(&pixels[0], 31, 17, &scaled[0], 31, 17, RESAMPLE_LANCZOS3));
+		CHECK(scaled == pixels);
+	}
+
+	void TestBadSizes()
+	{
+		uint8_t pixel[4] = { 1, 2, 3, 4 };
+		uint8_t scaled[4];
+
+		CHECK(CImageResampler::Resize(NULL, 1, 1, scaled, 1, 1, RESAMPLE_BOX) == false);
+		CHECK(CImageResampler::Resize(pixel, 1, 1, NULL, 1, 1, RESAMPLE_BOX) == false);
+		CHECK(CImageResampler::Resize(pixel, 0, 1, scaled, 1, 1, RESAMPLE_BOX) == false);
+		CHECK(CImageResampler::Resize(pixel, 1, 1, scaled, 1, -1, RESAMPLE_BOX) == false);
+	}
+
+	void Put32(std::vector<uint8_t> &dib, size_t offset, uint32_t value)
+	{
+		dib[offset] = (uint8_t)value;
+		dib[offset + 1] = (uint8_t)(value >> 8);
+		dib[offset + 2] = (uint8_t)(value >> 16);
+		dib[offset + 3] = (uint8_t)(value >> 24);
+	}
+
+	std::vector<uint8_t> MakeHeader(int width, int height, int bitCount, uint32_t compression, uint32_t colorsUsed)
+	{
+		std::vector<uint8_t> dib(40, 0);
+		Put32(dib, 0, 40);
+		Put32(dib, 4, (uint32_t)width);
+		Put32(dib, 8, (uint32_t)height);
+		dib[12] = 1;
+		dib[14] = (uint8_t)bitCount;
+		Put32(dib, 16, compression);
+		Put32(dib, 32, colorsUsed);
+		return dib;
+	}
+
+	void TestDibRoundTrip()
+	{
+		std::vector<uint8_t> pixels;
+		ReferenceResampler::MakeNoise(pixels, 13, 7, 9);
+		for (size_t i = 3; i < pixels.size(); i += 4)
+		{
+			pixels[i] = 255;
+		}
+
+		std::vector<uint8_t> dib(CImageResampler::DibSize(13, 7));
+		CImageResampler::WriteDib(&pixels[0], 13, 7, &dib[0]);
+
+		std::vector<uint8_t> decoded;
+		int width = 0;
+		int height = 0;
+		CHECK(CImageResampler::DecodeDib(&dib[0], dib.size(), decoded, width, height));
+		CHECK(width == 13 && height == 7);
+		CHECK(decoded == pixels);
+
+		//every length short of the whole dib is rejected
+		for (size_t length = 0; length < dib.size(); length++)
+		{
+			CHECK(CImageResampler::DecodeDib(&dib[0], length, decoded, width, height) == false);
+		}
+	}
+
+	void TestDibFormats()
+	{
+		std::vector<uint8_t> decoded;
+		int width = 0;
+		int height = 0;
+
+		//24 bit, top down, rows padded to 4 bytes
+		std::vector<uint8_t> dib = MakeHeader(2, -2, 24, 0, 0);
+		const uint8_t bits24[] = { 1, 2, 3, 4, 5, 6, 0, 0, 7, 8, 9, 10, 11, 12, 0, 0 };
+		dib.insert(dib.end(), bits24, bits24 + sizeof(bits24));
+
+		CHECK(CImageResampler::DecodeDib(&dib[0], dib.size(), decoded, width, height));
+		const uint8_t expected24[] = { 1, 2, 3, 255, 4, 5, 6, 255, 7, 8, 9, 255, 10, 11, 12, 255 };
+		CHECK(width == 2 && height == 2 && decoded.size() == 16 && memcmp(&decoded[0], expected24, 16) == 0);
+
+		//8 bit with a 2 color table, bottom up
+		dib = MakeHeader(3, 2, 8, 0, 2);
+		const uint8_t colors[] = { 10, 20, 30, 0, 40, 50, 60, 0 };
+		const uint8_t bits8[] = { 1, 1, 1, 0, 0, 1, 0, 0 };
+		dib.insert(dib.end(), colors, colors + sizeof(colors));
+		dib.insert(dib.end(), bits8, bits8 + sizeof(bits8));
+
+		CHECK(CImageResampler::DecodeDib(&dib[0], dib.size(), decoded, width, height));
+		const uint8_t expected8[] = { 10, 20, 30, 255, 40, 50, 60, 255, 10, 20, 30, 255, 40, 50, 60, 255, 40, 50, 60, 255, 40, 50, 60, 255 };
+		CHECK(width == 3 && height == 2 && decoded.size() == 24 && memcmp(&decoded[0], expected8, 24) == 0);
+
+		//16 bit 565 bit fields, white and pure red
+		dib = MakeHeader(2, 1, 16, 3, 0);
+		const uint8_t masks[] = { 0x00, 0xF8, 0, 0, 0xE0, 0x07, 0, 0, 0x1F, 0, 0, 0 };
+		const uint8_t bits16[] = { 0xFF, 0xFF, 0x00, 0xF8 };
+		dib.insert(dib.end(), masks, masks + sizeof(masks));
+		dib.insert(dib.end(), bits16, bits16 + sizeof(bits16));
+
+		CHECK(CImageResampler::DecodeDib(&dib[0], dib.size(), decoded, width, height));
+		const uint8_t expected16[] = { 255, 255, 255, 255, 0, 0, 255, 255 };
+		CHECK(width == 2 && height == 1 && decoded.size() == 8 && memcmp(&decoded[0], expected16, 8) == 0);
+
+		//rle isn't decoded
+		dib = MakeHeader(2, 2, 8, 1, 0);
+		dib.resize(dib.size() + 1024 + 64);
+		CHECK(CImageResampler::DecodeDib(&dib[0], dib.size(), decoded, width, height) == false);
+
+		//a height of INT_MIN is still negative after flipping it
+		dib = MakeHeader(1, (int)0x80000000, 32, 0, 0);
+		dib.resize(dib.size() + 64);
+		CHECK(CImageResampler::DecodeDib(&dib[0], dib.size(), decoded, width, height) == false);
+	}
+}
+
+int main()
+{
+	TestMatchesReference();
+	TestLargeImage();
+	TestFlatColorStaysFlat();
+	TestBoxHalves();
+	TestSameSizeCopies();
+	TestBadSizes();
+	TestDibRoundTrip();
+	TestDibFormats();
+
+	return TestCheck::Result("ImageResamplerTest");
+}
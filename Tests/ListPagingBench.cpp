@@ -0,0 +1,256 @@
+#include "BenchDb.h"
+#include <stdarg.h>
+#include <string.h>
+#include <map>
+
+//Time to load a page of the clip list at different depths, with LIMIT/OFFSET and with the page boundaries
+//CQPasteWndThread::GetPageSql seeks past. The seek sql is built here the same way GetPageSql builds it, GetPageSql
+//itself needs mfc. Every seek page is also checked against the OFFSET page.
+//
+//ListPagingBench [-clips n] [-pageSize n] [-db path]
+//With -db an existing database is used as it is, otherwise one is made with clips rows and deleted at the end
+
+namespace
+{
+	//the list's sql for the top level without a search, from CQPasteWnd::FillList
+	const char *ListSql()
+	{
+		return "SELECT Main.lID, Main.mText, Main.lParentID, Main.lDontAutoDelete, Main.lShortCut, Main.bIsGroup, Main.QuickPasteText, "
+			"Main.clipOrder, Main.clipGroupOrder, Main.stickyClipOrder, Main.stickyClipGroupOrder, Main.lDate, Main.lastPasteDate FROM Main "
+			"where (((Main.bIsGroup = 1 AND Main.lParentID = -1) OR Main.bIsGroup = 0))";
+	}
+
+	class CPageBoundary
+	{
+	public:
+		int m_id;
+		double m_stickyOrder;
+		int m_isGroup;
+		double m_order;
+		bool m_stickyOrderNull;
+		bool m_isGroupNull;
+		bool m_orderNull;
+	};
+
+	std::string Format(const char *pFormat, ...)
+	{
+		char buffer[1024];
+		va_list args;
+		va_start(args, pFormat);
+		vsnprintf(buffer, sizeof(buffer), pFormat, args);
+		va_end(args);
+		return buffer;
+	}
+
+	std::string OrderBy(const char *pPrefix)
+	{
+		return Format(" order by %sstickyClipOrder DESC, %sbIsGroup ASC, %sclipOrder DESC, %slID ASC", pPrefix, pPrefix, pPrefix, pPrefix);
+	}
+
+	std::string OffsetSql(int start, int count)
+	{
+		return ListSql() + OrderBy("Main.") + Format(" LIMIT %d OFFSET %d", count, start);
+	}
+
+	//as GetPageSql, start is the row after boundaryPos plus skip
+	std::string SeekSql(const CPageBoundary &boundary, int skip, int count)
+	{
+		std::string stickyEqual = boundary.m_stickyOrderNull ? "Main.stickyClipOrder IS NULL" : Format("Main.stickyClipOrder = %.17g", boundary.m_stickyOrder);
+		std::string groupEqual = boundary.m_isGroupNull ? "Main.bIsGroup IS NULL" : Format("Main.bIsGroup = %d", boundary.m_isGroup);
+		std::string orderEqual = boundary.m_orderNull ? "Main.clipOrder IS NULL" : Format("Main.clipOrder = %.17g", boundary.m_order);
+
+		std::vector<std::string> afterBoundary;
+		afterBoundary.push_back(stickyEqual + " AND " + groupEqual + " AND " + orderEqual + Format(" AND Main.lID > %d", boundary.m_id));
+		if (boundary.m_orderNull == false)
+		{
+			afterBoundary.push_back(stickyEqual + " AND " + groupEqual + Format(" AND Main.clipOrder < %.17g", boundary.m_order));
+			afterBoundary.push_back(stickyEqual + " AND " + groupEqual + " AND Main.clipOrder IS NULL");
+		}
+		if (boundary.m_isGroupNull)
+		{
+			afterBoundary.push_back(stickyEqual + " AND Main.bIsGroup IS NOT NULL");
+		}
+		else
+		{
+			afterBoundary.push_back(stickyEqual + Format(" AND Main.bIsGroup > %d", boundary.m_isGroup));
+		}
+		if (boundary.m_stickyOrderNull == false)
+		{
+			afterBoundary.push_back(Format("Main.stickyClipOrder < %.17g", boundary.m_stickyOrder));
+			afterBoundary.push_back("Main.stickyClipOrder IS NULL");
+		}
+
+		std::string sql;
+		for (size_t i = 0; i < afterBoundary.size(); i++)
+		{
+			if (i > 0)
+			{
+				sql += " UNION ALL ";
+			}
+
+			sql += std::string("SELECT * FROM (") + ListSql() + " AND (" + afterBoundary[i] + ")" + OrderBy("Main.") + Format(" LIMIT %d)", count + skip);
+		}
+
+		sql += OrderBy("");
+		sql += Format(" LIMIT %d OFFSET %d", count, skip);
+
+		return sql;
+	}
+
+	//the ids of the page, and the boundary of its last row
+	double LoadPage(sqlite3 *pDb, const std::string &sql, std::vector<int> &ids, CPageBoundary &boundary)
+	{
+		double start = BenchDb::NowMs();
+
+		ids.clear();
+
+		sqlite3_stmt *pStmt = BenchDb::Prepare(pDb, sql);
+		while (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			ids.push_back(sqlite3_column_int(pStmt, 0));
+
+			boundary.m_id = sqlite3_column_int(pStmt, 0);
+			boundary.m_stickyOrderNull = sqlite3_column_type(pStmt, 9) == SQLITE_NULL;
+			boundary.m_stickyOrder = sqlite3_column_double(pStmt, 9);
+			boundary.m_isGroupNull = sqlite3_column_type(pStmt, 5) == SQLITE_NULL;
+			boundary.m_isGroup = sqlite3_column_int(pStmt, 5);
+			boundary.m_orderNull = sqlite3_column_type(pStmt, 7) == SQLITE_NULL;
+			boundary.m_order = sqlite3_column_double(pStmt, 7);
+		}
+		sqlite3_finalize(pStmt);
+
+		return BenchDb::NowMs() - start;
+	}
+
+	void Report(const char *pWhat, std::vector<double> &times)
+	{
+		printf("%-34s %8d %10.3f %10.3f %10.3f %10.3f\n", pWhat, (int)times.size(),
+			BenchDb::Percentile(times, 50), BenchDb::Percentile(times, 90), BenchDb::Percentile(times, 99), BenchDb::Percentile(times, 100));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int clips = 1000000;
+	int pageSize = 100;
+	std::string path;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-clips") == 0)
+			clips = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-pageSize") == 0)
+			pageSize = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-db") == 0)
+			path = argv[i + 1];
+	}
+
+	bool made = path.empty();
+	if (made)
+	{
+		path = BenchDb::TempPath("DittoListPagingBench.db");
+		BenchDb::Delete(path);
+
+		sqlite3 *pDb = BenchDb::Open(path);
+		BenchDb::Exec(pDb, "PRAGMA journal_mode = WAL");
+		BenchDb::Exec(pDb, "PRAGMA synchronous = 1");
+		BenchDb::CreateTables(pDb);
+
+		double start = BenchDb::NowMs();
+		BenchDb::Fill(pDb, clips, -1, 1);
+		BenchDb::Exec(pDb, "ANALYZE");
+		printf("made %d clips in %.1f s\n", clips, (BenchDb::NowMs() - start) / 1000);
+
+		sqlite3_close(pDb);
+	}
+
+	sqlite3 *pDb = BenchDb::Open(path, true);
+
+	int rows = 0;
+	{
+		sqlite3_stmt *pCount = BenchDb::Prepare(pDb, std::string("SELECT COUNT(*) FROM (") + ListSql() + ")");
+		sqlite3_step(pCount);
+		rows = sqlite3_column_int(pCount, 0);
+		sqlite3_finalize(pCount);
+	}
+
+	printf("%d rows in the list, %d row pages\n", rows, pageSize);
+	printf("%-34s %8s %10s %10s %10s %10s\n", "", "pages", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+	std::vector<int> offsetIds;
+	std::vector<int> seekIds;
+	CPageBoundary boundary = CPageBoundary();
+	CPageBoundary offsetBoundary = CPageBoundary();
+	int mismatches = 0;
+
+	//scrolling from the top to the bottom, each page seeks past the last one
+	std::map<int, CPageBoundary> boundaries;
+	std::vector<double> seekTimes;
+	for (int start = 0; start < rows; start += pageSize)
+	{
+		std::string sql = (start == 0) ? OffsetSql(0, pageSize) : SeekSql(boundary, 0, pageSize);
+		seekTimes.push_back(LoadPage(pDb, sql, seekIds, boundary));
+		boundaries[start + (int)seekIds.size() - 1] = boundary;
+	}
+	Report("scroll, seek", seekTimes);
+
+	//the same scroll with OFFSET takes too long on a large list, every 100th page is timed and compared
+	std::vector<double> offsetTimes;
+	std::vector<double> sampledSeekTimes;
+	int step = std::max(1, (rows / pageSize) / 100) * pageSize;
+	for (int start = 0; start < rows; start += step)
+	{
+		offsetTimes.push_back(LoadPage(pDb, OffsetSql(start, pageSize), offsetIds, offsetBoundary));
+
+		if (start > 0)
+		{
+			std::map<int, CPageBoundary>::iterator it = boundaries.find(start - 1);
+			if (it != boundaries.end())
+			{
+				sampledSeekTimes.push_back(LoadPage(pDb, SeekSql(it->second, 0, pageSize), seekIds, boundary));
+				if (seekIds != offsetIds)
+				{
+					mismatches++;
+				}
+			}
+		}
+	}
+	Report("scroll, offset (every 100th page)", offsetTimes);
+	Report("scroll, seek (the same pages)", sampledSeekTimes);
+
+	//jumping to a random row, from the closest boundary before it
+	uint64_t random = 77;
+	std::vector<double> jumpOffsetTimes;
+	std::vector<double> jumpSeekTimes;
+	for (int i = 0; i < 100; i++)
+	{
+		int start = 1 + (int)(BenchDb::NextRandom(random) % (uint64_t)std::max(1, rows - 1));
+
+		jumpOffsetTimes.push_back(LoadPage(pDb, OffsetSql(start, pageSize), offsetIds, offsetBoundary));
+
+		std::map<int, CPageBoundary>::iterator it = boundaries.upper_bound(start - 1);
+		it--;
+		jumpSeekTimes.push_back(LoadPage(pDb, SeekSql(it->second, start - it->first - 1, pageSize), seekIds, boundary));
+
+		if (seekIds != offsetIds)
+		{
+			mismatches++;
+		}
+	}
+	Report("jump, offset", jumpOffsetTimes);
+	Report("jump, seek from a loaded page", jumpSeekTimes);
+
+	sqlite3_close(pDb);
+	if (made)
+	{
+		BenchDb::Delete(path);
+	}
+
+	if (mismatches > 0)
+	{
+		printf("%d seek page(s) didn't match the OFFSET page\n", mismatches);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "ListRows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+//Memory and time for a list of a million clips, in the std::vector<CMainTable> the list used to keep and in CListRows.
+//Memory is the growth of the resident size. CString here is Shim's, on a std::wstring, not atl's. Atl allocates every
+//non empty string with a header in front, so the vector's numbers are a guide, not what Ditto used
+//
+//ListRowsBench [-rows n]
+
+namespace
+{
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	double Now()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	size_t ResidentBytes()
+	{
+		long pages = 0;
+		long resident = 0;
+		FILE *pStream = fopen("/proc/self/statm", "r");
+		if (pStream != NULL)
+		{
+			if (fscanf(pStream, "%ld %ld", &pages, &resident) != 2)
+			{
+				resident = 0;
+			}
+			fclose(pStream);
+		}
+
+		return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+	}
+
+	void ReleaseFreed()
+	{
+#ifdef __GLIBC__
+		malloc_trim(0);
+#endif
+	}
+
+	//the row FillMainTable reads for clip id, most descriptions are a line, a few are long
+	void MakeRow(int id, CMainTable &table)
+	{
+		uint64_t random = (uint64_t)id * 2654435761u + 1;
+		NextRandom(random);
+
+		size_t length = (id % 100 == 0) ? 4000 : 10 + (size_t)(NextRandom(random) % 120);
+		std::wstring text = L"clip ";
+		text += std::to_wstring(id);
+		text.resize(length, (wchar_t)(L'a' + id % 26));
+
+		table.m_lID = id;
+		table.m_Desc = CString(text);
+		table.m_bIsGroup = (id % 500) == 0;
+		table.m_bHasParent = (id % 3) == 0;
+		table.m_QuickPaste = (id % 20) == 0 ? CString(L"qp") : CString();
+		table.m_clipOrder = (double)(NextRandom(random) % 10000000);
+		table.m_clipGroupOrder = (double)id;
+		table.m_stickyClipOrder = (id % 1000) == 0 ? 1.0 : 0.0;
+		table.m_dateCopied = 1600000000 + id;
+		table.m_datePasted = 1600000000 + id;
+	}
+
+	bool SortDesc(const CMainTable &d1, const CMainTable &d2)
+	{
+		if (d1.m_stickyClipOrder != d2.m_stickyClipOrder)
+			return d1.m_stickyClipOrder > d2.m_stickyClipOrder;
+
+		if (d1.m_bIsGroup != d2.m_bIsGroup)
+			return d1.m_bIsGroup < d2.m_bIsGroup;
+
+		return d1.m_clipOrder > d2.m_clipOrder;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int rows = 1000000;
+	if (argc > 2 && strcmp(argv[1], "-rows") == 0)
+	{
+		rows = atoi(argv[2]) > 0 ? atoi(argv[2]) : rows;
+	}
+
+	const int lookups = 1000;
+	std::vector<int> lookupIds(lookups);
+	for (int i = 0; i < lookups; i++)
+	{
+		lookupIds[i] = 1 + (int)(((uint64_t)i * 7919) % rows);
+	}
+
+	printf("%d rows, sizeof(CMainTable) %zu\n", rows, sizeof(CMainTable));
+	printf("%-24s %10s %10s %10s %14s %14s\n", "", "memory", "fill", "sort", "1000 finds", "descriptions");
+
+	//the old list
+	{
+		ReleaseFreed();
+		size_t before = ResidentBytes();
+
+		double start = Now();
+		std::vector<CMainTable> list;
+		for (int id = 1; id <= rows; id++)
+		{
+			CMainTable table;
+			MakeRow(id, table);
+			list.push_back(table);
+		}
+		double fill = Now() - start;
+		size_t memory = ResidentBytes() - before;
+
+		start = Now();
+		std::sort(list.begin(), list.end(), SortDesc);
+		double sort = Now() - start;
+
+		start = Now();
+		size_t found = 0;
+		for (int i = 0; i < lookups; i++)
+		{
+			int id = lookupIds[i];
+			std::vector<CMainTable>::iterator iter = std::find_if(list.begin(), list.end(), [id](const CMainTable &table) { return table.m_lID == id; });
+			found += iter != list.end() ? 1 : 0;
+		}
+		double find = Now() - start;
+
+		start = Now();
+		size_t characters = 0;
+		for (size_t i = 0; i < list.size(); i += 100)
+		{
+			characters += (size_t)list[i].m_Desc.GetLength();
+		}
+		double descriptions = Now() - start;
+
+		printf("%-24s %8.1fMB %8.0fms %8.0fms %12.1fms %12.2fms  (%zu found, %zu characters)\n", "std::vector<CMainTable>", memory / 1e6, fill, sort, find, descriptions, found, characters);
+	}
+
+	{
+		ReleaseFreed();
+		size_t before = ResidentBytes();
+
+		double start = Now();
+		CListRows list;
+		for (int id = 1; id <= rows; id++)
+		{
+			CMainTable table;
+			MakeRow(id, table);
+			list.Set(id - 1, table);
+		}
+		double fill = Now() - start;
+		size_t memory = ResidentBytes() - before;
+
+		start = Now();
+		list.Sort(false);
+		double sort = Now() - start;
+
+		start = Now();
+		size_t found = 0;
+		for (int i = 0; i < lookups; i++)
+		{
+			found += list.Find(lookupIds[i]) >= 0 ? 1 : 0;
+		}
+		double find = Now() - start;
+
+		start = Now();
+		size_t characters = 0;
+		for (int i = 0; i < list.GetCount(); i += 100)
+		{
+			characters += (size_t)list.GetDescription(i).GetLength();
+		}
+		double descriptions = Now() - start;
+
+		printf("%-24s %8.1fMB %8.0fms %8.0fms %12.1fms %12.2fms  (%zu found, %zu characters)\n", "CListRows", memory / 1e6, fill, sort, find, descriptions, found, characters);
+		printf("CListRows::GetBytes %.1fMB\n", list.GetBytes() / 1e6);
+	}
+
+	return 0;
+}
@@ -0,0 +1,273 @@
+#include "stdafx.h"
+#include "ListRows.h"
+#include "TestCheck.h"
+#include <stdio.h>
+#include <vector>
+
+namespace
+{
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	CString MakeText(const wchar_t *pPrefix, int number, int length)
+	{
+		std::wstring text = pPrefix;
+		text += std::to_wstring(number);
+		text.resize((size_t)std::max(length, (int)text.size()), L'x');
+		return CString(text);
+	}
+
+	CMainTable MakeRow(long id, uint64_t &random)
+	{
+		CMainTable table;
+		table.m_lID = id;
+		table.m_Desc = MakeText(L"clip ", (int)id, 5 + (int)(NextRandom(random) % 60));
+		table.m_bDontAutoDelete = (NextRandom(random) % 5) == 0;
+		table.m_bIsGroup = (NextRandom(random) % 7) == 0;
+		table.m_bHasShortCut = (NextRandom(random) % 11) == 0;
+		table.m_bHasParent = (NextRandom(random) % 3) == 0;
+		if ((NextRandom(random) % 4) == 0)
+		{
+			table.m_QuickPaste = _T("qp");
+		}
+		table.m_clipOrder = (double)(NextRandom(random) % 1000);
+		table.m_clipGroupOrder = (double)(NextRandom(random) % 1000);
+		table.m_stickyClipOrder = (NextRandom(random) % 10) == 0 ? (double)(NextRandom(random) % 5) : 0;
+		table.m_stickyClipGroupOrder = (NextRandom(random) % 10) == 0 ? (double)(NextRandom(random) % 5) : 0;
+		table.m_dateCopied = (int)(NextRandom(random) % 100000);
+		table.m_datePasted = (int)(NextRandom(random) % 100000);
+		return table;
+	}
+
+	bool SameRow(const CListRows &rows, int row, const CMainTable &table)
+	{
+		return rows.GetId(row) == table.m_lID &&
+			rows.HasFlag(row, LIST_ROW_DONT_AUTO_DELETE) == table.m_bDontAutoDelete &&
+			rows.HasFlag(row, LIST_ROW_IS_GROUP) == table.m_bIsGroup &&
+			rows.HasFlag(row, LIST_ROW_HAS_SHORTCUT) == table.m_bHasShortCut &&
+			rows.HasFlag(row, LIST_ROW_HAS_PARENT) == table.m_bHasParent &&
+			rows.HasFlag(row, LIST_ROW_HAS_QUICK_PASTE) == (table.m_QuickPaste.IsEmpty() == FALSE) &&
+			rows.GetClipOrder(row) == table.m_clipOrder &&
+			rows.GetClipGroupOrder(row) == table.m_clipGroupOrder &&
+			rows.GetStickyClipOrder(row) == table.m_stickyClipOrder &&
+			rows.GetStickyClipGroupOrder(row) == table.m_stickyClipGroupOrder &&
+			rows.GetDateCopied(row) == table.m_dateCopied &&
+			rows.GetDatePasted(row) == table.m_datePasted &&
+			rows.GetDescription(row) == table.m_Desc;
+	}
+
+	//the comparisons the list sorted its std::vector<CMainTable> with
+	bool SortDesc(const CMainTable &d1, const CMainTable &d2)
+	{
+		if (d1.m_stickyClipOrder != d2.m_stickyClipOrder)
+			return d1.m_stickyClipOrder > d2.m_stickyClipOrder;
+
+		if (d1.m_bIsGroup != d2.m_bIsGroup)
+			return d1.m_bIsGroup < d2.m_bIsGroup;
+
+		return d1.m_clipOrder > d2.m_clipOrder;
+	}
+
+	bool GroupSortDesc(const CMainTable &d1, const CMainTable &d2)
+	{
+		if (d1.m_stickyClipGroupOrder != d2.m_stickyClipGroupOrder)
+			return d1.m_stickyClipGroupOrder > d2.m_stickyClipGroupOrder;
+
+		if (d1.m_bIsGroup != d2.m_bIsGroup)
+			return d1.m_bIsGroup < d2.m_bIsGroup;
+
+		return d1.m_clipGroupOrder > d2.m_clipGroupOrder;
+	}
+
+	void TestSet()
+	{
+		uint64_t random = 5;
+		std::vector<CMainTable> tables;
+		CListRows rows;
+
+		for (int i = 0; i < 500; i++)
+		{
+			tables.push_back(MakeRow(1000 + i, random));
+			rows.Set(i, tables.back());
+		}
+
+		CHECK(rows.GetCount() == 500);
+		for (int i = 0; i < 500; i++)
+		{
+			CHECK(SameRow(rows, i, tables[i]));
+		}
+
+		//replacing a row keeps the others
+		CMainTable replaced = MakeRow(77, random);
+		rows.Set(10, replaced);
+		CHECK(SameRow(rows, 10, replaced));
+		CHECK(SameRow(rows, 9, tables[9]));
+		CHECK(SameRow(rows, 11, tables[11]));
+
+		rows.SetFlag(3, LIST_ROW_HAS_SHORTCUT, true);
+		CHECK(rows.HasFlag(3, LIST_ROW_HAS_SHORTCUT));
+		rows.SetFlag(3, LIST_ROW_HAS_SHORTCUT, false);
+		CHECK(rows.HasFlag(3, LIST_ROW_HAS_SHORTCUT) == false);
+
+		rows.SetOrders(4, 1.5, 2.5);
+		rows.SetStickyOrders(4, 3.5, 4.5);
+		rows.SetDatePasted(4, 99);
+		CHECK(rows.GetClipOrder(4) == 1.5 && rows.GetClipGroupOrder(4) == 2.5);
+		CHECK(rows.GetStickyClipOrder(4) == 3.5 && rows.GetStickyClipGroupOrder(4) == 4.5);
+		CHECK(rows.GetDatePasted(4) == 99);
+
+		//a row past the end adds empty rows before it
+		CListRows gap;
+		gap.Set(-1, tables[0]);
+		CHECK(gap.GetCount() == 0);
+		gap.Set(3, tables[0]);
+		CHECK(gap.GetCount() == 4);
+		for (int i = 0; i < 3; i++)
+		{
+			CHECK(gap.GetId(i) == -1);
+			CHECK(gap.GetDescription(i).IsEmpty());
+		}
+		CHECK(SameRow(gap, 3, tables[0]));
+
+		gap.Clear();
+		CHECK(gap.GetCount() == 0);
+	}
+
+	void TestEraseAndFind()
+	{
+		uint64_t random = 9;
+		std::vector<CMainTable> tables;
+		CListRows rows;
+
+		for (int i = 0; i < 100; i++)
+		{
+			tables.push_back(MakeRow(i * 3, random));
+			rows.Set(i, tables.back());
+		}
+
+		CHECK(rows.Find(30) == 10);
+		CHECK(rows.Find(31) == -1);
+
+		rows.Erase(10);
+		tables.erase(tables.begin() + 10);
+		rows.Erase(0);
+		tables.erase(tables.begin());
+		rows.Erase(rows.GetCount() - 1);
+		tables.pop_back();
+		rows.Erase(-1);
+		rows.Erase(rows.GetCount());
+
+		CHECK(rows.GetCount() == (int)tables.size());
+		CHECK(rows.Find(30) == -1);
+		CHECK(rows.Find(33) == 9);
+
+		for (int i = 0; i < rows.GetCount(); i++)
+		{
+			CHECK(SameRow(rows, i, tables[i]));
+		}
+	}
+
+	void TestDescriptionPrefix()
+	{
+		CMainTable table;
+		table.m_lID = 1;
+		table.m_Desc = MakeText(L"long ", 1, LIST_ROW_DESC_PREFIX + 500);
+
+		CListRows rows;
+		rows.Set(0, table);
+
+		CHECK(rows.GetDescription(0).GetLength() == LIST_ROW_DESC_PREFIX);
+		CHECK(rows.GetDescription(0) == table.m_Desc.Mid(0, LIST_ROW_DESC_PREFIX));
+	}
+
+	//the same order the vector of CMainTable was sorted in, stable so equal rows keep their order
+	void TestSort()
+	{
+		uint64_t random = 21;
+
+		for (int group = 0; group < 2; group++)
+		{
+			std::vector<CMainTable> tables;
+			CListRows rows;
+
+			for (int i = 0; i < 3000; i++)
+			{
+				tables.push_back(MakeRow(i, random));
+				rows.Set(i, tables.back());
+			}
+
+			rows.Sort(group == 1);
+			std::stable_sort(tables.begin(), tables.end(), group == 1 ? GroupSortDesc : SortDesc);
+
+			bool same = true;
+			for (int i = 0; i < rows.GetCount(); i++)
+			{
+				same = same && SameRow(rows, i, tables[i]);
+			}
+			CHECK(same);
+		}
+	}
+
+	//replaced and erased descriptions don't make the buffer grow without end
+	void TestCompaction()
+	{
+		uint64_t random = 33;
+		std::vector<CMainTable> tables;
+		CListRows rows;
+
+		for (int i = 0; i < 100; i++)
+		{
+			tables.push_back(MakeRow(i, random));
+			rows.Set(i, tables.back());
+		}
+
+		size_t maxBytes = 0;
+		for (int pass = 0; pass < 1000; pass++)
+		{
+			int row = (int)(NextRandom(random) % tables.size());
+			tables[row].m_Desc = MakeText(L"pass ", pass, 100 + (int)(NextRandom(random) % 100));
+			rows.Set(row, tables[row]);
+
+			maxBytes = std::max(maxBytes, rows.GetBytes());
+		}
+
+		bool same = true;
+		for (int i = 0; i < rows.GetCount(); i++)
+		{
+			same = same && SameRow(rows, i, tables[i]);
+		}
+		CHECK(same);
+
+		//100 rows of at most 200 characters, without compaction the buffer holds all 1000 descriptions
+		printf("largest size while replacing descriptions: %zu bytes\n", maxBytes);
+		CHECK(maxBytes < 100 * 200 * sizeof(TCHAR) * 4);
+
+		for (int i = 0; i < 90; i++)
+		{
+			rows.Erase(0);
+			tables.erase(tables.begin());
+			rows.Set(rows.GetCount() - 1, tables.back());
+		}
+
+		for (int i = 0; i < rows.GetCount(); i++)
+		{
+			CHECK(SameRow(rows, i, tables[i]));
+		}
+	}
+}
+
+int main()
+{
+	TestSet();
+	TestEraseAndFind();
+	TestDescriptionPrefix();
+	TestSort();
+	TestCompaction();
+
+	return TestCheck::Result("ListRowsTest");
+}
@@ -0,0 +1,274 @@
+#include "ImageResampler.h"
+#include "ReferenceResampler.h"
+#include <zlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <chrono>
+#include <string>
+
+//Bytes on the wire and transfer time for clip data and files with and without the zlib compression in NetworkCompress.
+//Data is compressed in CHUNK_WRITE_SIZE records with CNetworkCompress::Compress's rule: a record is only sent
+//compressed if that saves 1/8 of it. Formats named as already compressed (PNG here) aren't tried. NetworkCompress.cpp
+//needs mfc so the zlib calls are made here.
+//
+//The link isn't a real socket, the time at a link speed is the time to compress and uncompress plus the bytes over
+//the speed, with nothing overlapped, which is the worst case for compression.
+//
+//NetworkCompressBench [-level n] [file ...]
+
+#define BENCH_CHUNK_SIZE 65536
+
+namespace
+{
+	class CCorpusItem
+	{
+	public:
+		std::string m_name;
+		std::vector<unsigned char> m_data;
+		bool m_skip;
+	};
+
+	class CCompressResult
+	{
+	public:
+		size_t m_wireBytes;
+		double m_compressSeconds;
+		double m_uncompressSeconds;
+	};
+
+	double Now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Add(std::vector<CCorpusItem> &corpus, const char *pName, const std::string &text, bool skip)
+	{
+		CCorpusItem item;
+		item.m_name = pName;
+		item.m_data.assign(text.begin(), text.end());
+		item.m_skip = skip;
+		corpus.push_back(item);
+	}
+
+	void MakeCorpus(std::vector<CCorpusItem> &corpus)
+	{
+		char line[512];
+
+		std::string rtf = "{\\rtf1\\ansi\\ansicpg1252\\deff0{\\fonttbl{\\f0\\fswiss Calibri;}}";
+		for (int i = 0; rtf.size() < 2 * 1024 * 1024; i++)
+		{
+			snprintf(line, sizeof(line), "\\pard\\sa200\\sl276\\slmult1\\rsid%d\\f0\\fs22 Meeting notes item %d, follow up with the team about the %s.\\par\r\n",
+				1000000 + i * 7, i, (i % 3) ? "release schedule" : "budget");
+			rtf += line;
+		}
+		rtf += "}";
+		Add(corpus, "rtf", rtf, false);
+
+		std::string html = "Version:0.9\r\nStartHTML:0000000105\r\n<html><body><table>";
+		for (int i = 0; html.size() < 1024 * 1024; i++)
+		{
+			snprintf(line, sizeof(line), "<tr><td class=\"cell\">%d</td><td class=\"cell\">Row %d</td><td style=\"color:#333\">%0.2f</td></tr>\r\n", i, i * 31, i * 1.25);
+			html += line;
+		}
+		html += "</table></body></html>";
+		Add(corpus, "html", html, false);
+
+		std::string text;
+		for (int i = 0; text.size() < 512 * 1024; i++)
+		{
+			snprintf(line, sizeof(line), "2024-05-%02d 10:%02d:%02d INFO request %d served in %d ms from cache %s\r\n", 1 + i % 28, i % 60, (i * 7) % 60, i, (i * 13) % 200, (i % 5) ? "hit" : "miss");
+			text += line;
+		}
+		Add(corpus, "text", text, false);
+
+		//a screenshot as the CF_DIB the clipboard has
+		std::vector<uint8_t> pixels;
+		ReferenceResampler::MakeScreenshot(pixels, 1920, 1080, 3);
+		std::vector<uint8_t> dib(CImageResampler::DibSize(1920, 1080));
+		CImageResampler::WriteDib(&pixels[0], 1920, 1080, &dib[0]);
+		CCorpusItem dibItem;
+		dibItem.m_name = "CF_DIB 1920x1080";
+		dibItem.m_data = dib;
+		dibItem.m_skip = false;
+		corpus.push_back(dibItem);
+
+		//random bytes stand in for a png, it isn't tried
+		std::vector<uint8_t> noise;
+		ReferenceResampler::MakeNoise(noise, 512, 512, 5);
+		CCorpusItem png;
+		png.m_name = "PNG";
+		png.m_data = noise;
+		png.m_skip = true;
+		corpus.push_back(png);
+	}
+
+	bool LoadFile(const char *pFile, CCorpusItem &item)
+	{
+		FILE *pStream = fopen(pFile, "rb");
+		if (pStream == NULL)
+		{
+			return false;
+		}
+
+		unsigned char buffer[65536];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), pStream)) > 0)
+		{
+			item.m_data.insert(item.m_data.end(), buffer, buffer + read);
+		}
+		fclose(pStream);
+
+		item.m_name = pFile;
+
+		//IsCompressedFile's list, the common ones
+		static const char *compressed[] = { ".png", ".jpg", ".jpeg", ".gif", ".zip", ".7z", ".gz", ".mp4", ".docx", ".pdf" };
+		item.m_skip = false;
+		const char *pDot = strrchr(pFile, '.');
+		for (size_t i = 0; pDot != NULL && i < sizeof(compressed) / sizeof(compressed[0]); i++)
+		{
+			if (strcasecmp(pDot, compressed[i]) == 0)
+			{
+				item.m_skip = true;
+			}
+		}
+
+		return true;
+	}
+
+	bool Compress(const CCorpusItem &item, int level, CCompressResult &result)
+	{
+		result.m_wireBytes = 0;
+		result.m_compressSeconds = 0;
+		result.m_uncompressSeconds = 0;
+
+		std::vector<unsigned char> compressed(compressBound(BENCH_CHUNK_SIZE));
+		std::vector<unsigned char> uncompressed(BENCH_CHUNK_SIZE);
+
+		int failedInARow = 0;
+		for (size_t offset = 0; offset < item.m_data.size(); offset += BENCH_CHUNK_SIZE)
+		{
+			size_t length = std::min((size_t)BENCH_CHUNK_SIZE, item.m_data.size() - offset);
+			const unsigned char *pChunk = &item.m_data[offset];
+
+			//the flag byte in front of each record
+			result.m_wireBytes += 1;
+
+			//the sender stops trying after four records in a row didn't compress
+			if (item.m_skip || failedInARow >= 4)
+			{
+				result.m_wireBytes += length;
+				continue;
+			}
+
+			double start = Now();
+			uLongf compressedSize = (uLongf)compressed.size();
+			int ret = compress2(&compressed[0], &compressedSize, pChunk, (uLong)length, level);
+			result.m_compressSeconds += Now() - start;
+
+			if (ret != Z_OK || compressedSize >= (uLongf)(length - length / 8))
+			{
+				failedInARow++;
+				result.m_wireBytes += length;
+				continue;
+			}
+
+			failedInARow = 0;
+			result.m_wireBytes += compressedSize;
+
+			start = Now();
+			uLongf uncompressedSize = (uLongf)length;
+			ret = uncompress(&uncompressed[0], &uncompressedSize, &compressed[0], compressedSize);
+			result.m_uncompressSeconds += Now() - start;
+
+			if (ret != Z_OK || uncompressedSize != length || memcmp(&uncompressed[0], pChunk, length) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int level = 1;
+	std::vector<CCorpusItem> corpus;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-level") == 0 && i + 1 < argc)
+		{
+			level = atoi(argv[++i]);
+			continue;
+		}
+
+		CCorpusItem item;
+		if (LoadFile(argv[i], item) == false)
+		{
+			printf("can't read %s\n", argv[i]);
+			return 1;
+		}
+		corpus.push_back(item);
+	}
+
+	if (corpus.empty())
+	{
+		MakeCorpus(corpus);
+	}
+
+	const double linkMbits[] = { 10, 100 };
+
+	printf("zlib level %d, %d byte records\n", level, BENCH_CHUNK_SIZE);
+	printf("%-20s %10s %10s %7s %12s %12s %11s %11s %11s %11s\n", "data", "bytes", "on wire", "ratio", "compress", "uncompress",
+		"10Mb raw", "10Mb zlib", "100Mb raw", "100Mb zlib");
+
+	size_t totalBytes = 0;
+	size_t totalWire = 0;
+	double totalRaw[2] = { 0, 0 };
+	double totalCompressed[2] = { 0, 0 };
+
+	for (size_t i = 0; i < corpus.size(); i++)
+	{
+		const CCorpusItem &item = corpus[i];
+
+		CCompressResult result;
+		if (Compress(item, level, result) == false)
+		{
+			printf("%s didn't uncompress to the same data\n", item.m_name.c_str());
+			return 1;
+		}
+
+		double megabytes = item.m_data.size() / 1e6;
+		double seconds[2][2];
+		for (int link = 0; link < 2; link++)
+		{
+			double bytesPerSecond = linkMbits[link] * 1e6 / 8;
+			seconds[link][0] = item.m_data.size() / bytesPerSecond;
+			seconds[link][1] = result.m_compressSeconds + result.m_uncompressSeconds + result.m_wireBytes / bytesPerSecond;
+
+			totalRaw[link] += seconds[link][0];
+			totalCompressed[link] += seconds[link][1];
+		}
+
+		char compressRate[32] = "-";
+		char uncompressRate[32] = "-";
+		if (result.m_compressSeconds > 0)
+			snprintf(compressRate, sizeof(compressRate), "%.0f MB/s", megabytes / result.m_compressSeconds);
+		if (result.m_uncompressSeconds > 0)
+			snprintf(uncompressRate, sizeof(uncompressRate), "%.0f MB/s", megabytes / result.m_uncompressSeconds);
+
+		printf("%-20s %10zu %10zu %6.1fx %12s %12s %10.2fs %10.2fs %10.2fs %10.2fs\n", item.m_name.c_str(), item.m_data.size(), result.m_wireBytes,
+			(double)item.m_data.size() / result.m_wireBytes, compressRate, uncompressRate, seconds[0][0], seconds[0][1], seconds[1][0], seconds[1][1]);
+
+		totalBytes += item.m_data.size();
+		totalWire += result.m_wireBytes;
+	}
+
+	printf("%-20s %10zu %10zu %6.1fx %12s %12s %10.2fs %10.2fs %10.2fs %10.2fs\n", "all", totalBytes, totalWire, (double)totalBytes / totalWire, "", "",
+		totalRaw[0], totalCompressed[0], totalRaw[1], totalCompressed[1]);
+
+	return 0;
+}
@@ -0,0 +1,376 @@
+#include "NetworkFrame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Fuzz entry for CNetworkFrameReader. The input is also split into messages and fields here, on its own, and the two
+//have to agree. Every message read is then written again with CNetworkFrameWriter and has to read back the same.
+//
+//Built with -DDITTO_LIBFUZZER=ON and clang it's a libFuzzer target. Otherwise main() runs the entry on random frames,
+//random bytes and cut or changed frames from a fixed seed, or on the files passed to it.
+
+namespace
+{
+	class CFuzzField
+	{
+	public:
+		uint64_t m_tag;
+		std::string m_value;
+	};
+
+	class CFuzzMessage
+	{
+	public:
+		uint64_t m_type;
+		std::vector<CFuzzField> m_fields;
+	};
+
+	void Fail(const char *pReason)
+	{
+		printf("NetworkFrameFuzz: %s\n", pReason);
+		fflush(stdout);
+		abort();
+	}
+
+	//the frame as the format describes it, false where the reader has to stop
+	bool Split(const uint8_t *pData, const uint8_t *pEnd, std::vector<CFuzzMessage> &messages)
+	{
+		uint64_t format = 0;
+		if (CNetworkFrameReader::GetVarint(pData, pEnd, format) == false ||
+			format != NETWORK_FRAME_FORMAT)
+		{
+			return false;
+		}
+
+		while (pData < pEnd)
+		{
+			CFuzzMessage message;
+			uint64_t length = 0;
+			if (CNetworkFrameReader::GetVarint(pData, pEnd, message.m_type) == false ||
+				CNetworkFrameReader::GetVarint(pData, pEnd, length) == false ||
+				message.m_type > 0xFFFFFFFF ||
+				length > (uint64_t)(pEnd - pData))
+			{
+				return false;
+			}
+
+			const uint8_t *pPayloadEnd = pData + length;
+			while (pData < pPayloadEnd)
+			{
+				CFuzzField field;
+				uint64_t fieldLength = 0;
+				if (CNetworkFrameReader::GetVarint(pData, pPayloadEnd, field.m_tag) == false ||
+					CNetworkFrameReader::GetVarint(pData, pPayloadEnd, fieldLength) == false ||
+					fieldLength > (uint64_t)(pPayloadEnd - pData))
+				{
+					return false;
+				}
+
+				field.m_value.assign((const char *)pData, (size_t)fieldLength);
+				message.m_fields.push_back(field);
+
+				pData += fieldLength;
+			}
+
+			messages.push_back(message);
+		}
+
+		return true;
+	}
+
+	//what the message returns for a tag is the first field with it
+	void CheckMessage(const CNetworkFrameMessage &message, const CFuzzMessage &expected)
+	{
+		if (message.GetType() != expected.m_type)
+		{
+			Fail("the message type doesn't match");
+		}
+
+		for (size_t i = 0; i < expected.m_fields.size(); i++)
+		{
+			const CFuzzField &field = expected.m_fields[i];
+			if (field.m_tag > 0xFFFFFFFF)
+			{
+				continue;
+			}
+
+			bool first = true;
+			for (size_t j = 0; j < i; j++)
+			{
+				if (expected.m_fields[j].m_tag == field.m_tag)
+				{
+					first = false;
+				}
+			}
+
+			if (first == false)
+			{
+				continue;
+			}
+
+			std::string value;
+			if (message.GetString((unsigned int)field.m_tag, value) == false ||
+				value != field.m_value)
+			{
+				Fail("GetString doesn't match the field");
+			}
+
+			//a uint is one varint that fills the field
+			const uint8_t *pValue = (const uint8_t *)field.m_value.data();
+			const uint8_t *pValueEnd = pValue + field.m_value.size();
+			uint64_t expectedNumber = 0;
+			bool isNumber = CNetworkFrameReader::GetVarint(pValue, pValueEnd, expectedNumber) && pValue == pValueEnd;
+
+			uint64_t number = 0;
+			if (message.GetUInt((unsigned int)field.m_tag, number) != isNumber ||
+				(isNumber && number != expectedNumber))
+			{
+				Fail("GetUInt doesn't match the field");
+			}
+		}
+	}
+
+	void CheckRewrite(const std::vector<CFuzzMessage> &messages)
+	{
+		CNetworkFrameWriter writer;
+		for (size_t i = 0; i < messages.size(); i++)
+		{
+			writer.BeginMessage((unsigned int)messages[i].m_type);
+
+			for (size_t f = 0; f < messages[i].m_fields.size(); f++)
+			{
+				const CFuzzField &field = messages[i].m_fields[f];
+				if (field.m_tag <= 0xFFFFFFFF)
+				{
+					writer.AddBytes((unsigned int)field.m_tag, field.m_value.data(), field.m_value.size());
+				}
+			}
+
+			writer.EndMessage();
+		}
+
+		const std::vector<unsigned char> &frame = writer.GetFrame();
+		CNetworkFrameReader reader(&frame[0], frame.size());
+
+		size_t count = 0;
+		CNetworkFrameMessage message;
+		while (reader.Next(message))
+		{
+			if (count >= messages.size())
+			{
+				Fail("the rewritten frame has extra messages");
+			}
+
+			CFuzzMessage expected = messages[count];
+			for (size_t f = expected.m_fields.size(); f-- > 0; )
+			{
+				if (expected.m_fields[f].m_tag > 0xFFFFFFFF)
+				{
+					expected.m_fields.erase(expected.m_fields.begin() + f);
+				}
+			}
+
+			CheckMessage(message, expected);
+			count++;
+		}
+
+		if (reader.Failed() || count != messages.size())
+		{
+			Fail("the rewritten frame doesn't read back");
+		}
+	}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t length)
+{
+	std::vector<CFuzzMessage> messages;
+	bool valid = Split(pData, pData + length, messages);
+
+	CNetworkFrameReader reader(pData, length);
+
+	size_t count = 0;
+	CNetworkFrameMessage message;
+	while (reader.Next(message))
+	{
+		if (count >= messages.size())
+		{
+			Fail("the reader returned a message that isn't complete");
+		}
+
+		CheckMessage(message, messages[count]);
+		count++;
+	}
+
+	if (reader.Failed() == valid)
+	{
+		Fail("the reader and the format disagree on whether the frame is good");
+	}
+
+	if (count < messages.size())
+	{
+		Fail("the reader stopped before the last good message");
+	}
+
+	CheckRewrite(messages);
+
+	return 0;
+}
+
+#ifndef DITTO_LIBFUZZER
+
+namespace
+{
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	void MakeFrame(uint64_t &state, std::vector<unsigned char> &frame)
+	{
+		CNetworkFrameWriter writer;
+
+		int messages = (int)(NextRandom(state) % 5);
+		for (int i = 0; i < messages; i++)
+		{
+			writer.BeginMessage((unsigned int)(NextRandom(state) % 300));
+
+			int fields = (int)(NextRandom(state) % 5);
+			for (int f = 0; f < fields; f++)
+			{
+				unsigned int tag = (unsigned int)(NextRandom(state) % 8);
+				if (NextRandom(state) % 2)
+				{
+					writer.AddUInt(tag, NextRandom(state) >> (NextRandom(state) % 64));
+				}
+				else
+				{
+					std::string value((size_t)(NextRandom(state) % 40), (char)NextRandom(state));
+					writer.AddString(tag, value);
+				}
+			}
+
+			writer.EndMessage();
+		}
+
+		frame = writer.GetFrame();
+	}
+
+	void Mutate(uint64_t &state, std::vector<unsigned char> &frame)
+	{
+		int changes = 1 + (int)(NextRandom(state) % 4);
+		for (int i = 0; i < changes; i++)
+		{
+			switch (NextRandom(state) % 4)
+			{
+			case 0:
+				if (frame.empty() == false)
+				{
+					frame[NextRandom(state) % frame.size()] = (unsigned char)NextRandom(state);
+				}
+				break;
+			case 1:
+				if (frame.empty() == false)
+				{
+					frame[NextRandom(state) % frame.size()] ^= (unsigned char)(1 << (NextRandom(state) % 8));
+				}
+				break;
+			case 2:
+				frame.resize((size_t)(NextRandom(state) % (frame.size() + 1)));
+				break;
+			case 3:
+				frame.insert(frame.begin() + (size_t)(NextRandom(state) % (frame.size() + 1)), (unsigned char)NextRandom(state));
+				break;
+			}
+		}
+	}
+
+	bool RunFile(const char *pFile)
+	{
+		FILE *pStream = fopen(pFile, "rb");
+		if (pStream == NULL)
+		{
+			printf("can't read %s\n", pFile);
+			return false;
+		}
+
+		std::vector<unsigned char> data;
+		unsigned char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), pStream)) > 0)
+		{
+			data.insert(data.end(), buffer, buffer + read);
+		}
+		fclose(pStream);
+
+		LLVMFuzzerTestOneInput(data.empty() ? NULL : &data[0], data.size());
+		return true;
+	}
+}
+
+//NetworkFrameFuzz [-runs n] [file ...]
+int main(int argc, char *argv[])
+{
+	int runs = 200000;
+	int files = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc)
+		{
+			runs = atoi(argv[++i]);
+			continue;
+		}
+
+		if (RunFile(argv[i]) == false)
+		{
+			return 1;
+		}
+		files++;
+	}
+
+	if (files > 0)
+	{
+		printf("NetworkFrameFuzz: %d file(s) passed\n", files);
+		return 0;
+	}
+
+	uint64_t state = 0x2545F4914F6CDD1DULL;
+	std::vector<unsigned char> data;
+
+	for (int i = 0; i < runs; i++)
+	{
+		switch (i % 3)
+		{
+		case 0:
+			MakeFrame(state, data);
+			break;
+		case 1:
+			MakeFrame(state, data);
+			Mutate(state, data);
+			break;
+		case 2:
+			data.resize((size_t)(NextRandom(state) % 64));
+			for (size_t b = 0; b < data.size(); b++)
+			{
+				data[b] = (unsigned char)NextRandom(state);
+			}
+
+			//mostly a good format so the bytes after it get read
+			if (data.empty() == false && NextRandom(state) % 4 != 0)
+			{
+				data[0] = NETWORK_FRAME_FORMAT;
+			}
+			break;
+		}
+
+		LLVMFuzzerTestOneInput(data.empty() ? NULL : &data[0], data.size());
+	}
+
+	printf("NetworkFrameFuzz: %d run(s) passed\n", runs);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include "NetworkFrame.h"
+#include "TestCheck.h"
+#include <string.h>
+
+namespace
+{
+	class CTestField
+	{
+	public:
+		unsigned int m_tag;
+		bool m_isUInt;
+		uint64_t m_value;
+		std::string m_bytes;
+	};
+
+	class CTestMessage
+	{
+	public:
+		unsigned int m_type;
+		std::vector<CTestField> m_fields;
+	};
+
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	//values near every varint byte boundary
+	uint64_t RandomValue(uint64_t &state)
+	{
+		int bits = (int)(NextRandom(state) % 65);
+		if (bits == 0)
+		{
+			return 0;
+		}
+
+		uint64_t value = NextRandom(state);
+		if (bits < 64)
+		{
+			value &= (1ULL << bits) - 1;
+		}
+
+		return value;
+	}
+
+	void MakeMessages(uint64_t seed, std::vector<CTestMessage> &messages)
+	{
+		uint64_t state = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+		messages.resize(NextRandom(state) % 8);
+		for (size_t i = 0; i < messages.size(); i++)
+		{
+			CTestMessage &message = messages[i];
+			message.m_type = (unsigned int)RandomValue(state);
+
+			//tags are unique in a message, the reader returns the first one
+			message.m_fields.resize(NextRandom(state) % 6);
+			for (size_t f = 0; f < message.m_fields.size(); f++)
+			{
+				CTestField &field = message.m_fields[f];
+				field.m_tag = (unsigned int)(f * 1000 + NextRandom(state) % 1000);
+				field.m_isUInt = (NextRandom(state) % 2) == 0;
+				field.m_value = RandomValue(state);
+
+				size_t length = (size_t)(NextRandom(state) % 300);
+				for (size_t b = 0; b < length; b++)
+				{
+					field.m_bytes += (char)NextRandom(state);
+				}
+			}
+		}
+	}
+
+	void Write(const std::vector<CTestMessage> &messages, CNetworkFrameWriter &writer)
+	{
+		writer.Clear();
+
+		for (size_t i = 0; i < messages.size(); i++)
+		{
+			writer.BeginMessage(messages[i].m_type);
+
+			for (size_t f = 0; f < messages[i].m_fields.size(); f++)
+			{
+				const CTestField &field = messages[i].m_fields[f];
+				if (field.m_isUInt)
+				{
+					writer.AddUInt(field.m_tag, field.m_value);
+				}
+				else
+				{
+					writer.AddString(field.m_tag, field.m_bytes);
+				}
+			}
+
+			writer.EndMessage();
+		}
+	}
+
+	void TestRoundTrip()
+	{
+		for (uint64_t seed = 0; seed < 2000; seed++)
+		{
+			std::vector<CTestMessage> messages;
+			MakeMessages(seed, messages);
+
+			CNetworkFrameWriter writer;
+			Write(messages, writer);
+
+			CHECK(writer.HasMessages() == (messages.empty() == false));
+
+			const std::vector<unsigned char> &frame = writer.GetFrame();
+			CNetworkFrameReader reader(&frame[0], frame.size());
+
+			size_t count = 0;
+			CNetworkFrameMessage message;
+			while (reader.Next(message))
+			{
+				if (CHECK(count < messages.size()) == false)
+				{
+					break;
+				}
+
+				const CTestMessage &expected = messages[count];
+				CHECK(message.GetType() == expected.m_type);
+
+				for (size_t f = 0; f < expected.m_fields.size(); f++)
+				{
+					const CTestField &field = expected.m_fields[f];
+					if (field.m_isUInt)
+					{
+						uint64_t value = 0;
+						CHECK(message.GetUInt(field.m_tag, value) && value == field.m_value);
+					}
+					else
+					{
+						std::string value;
+						CHECK(message.GetString(field.m_tag, value) && value == field.m_bytes);
+
+						const unsigned char *pData = NULL;
+						size_t length = 0;
+						CHECK(message.GetBytes(field.m_tag, pData, length) && length == field.m_bytes.size());
+					}
+				}
+
+				//a tag that was never written
+				uint64_t value = 0;
+				CHECK(message.GetUInt(999999, value) == false);
+
+				count++;
+			}
+
+			CHECK(reader.Failed() == false);
+			CHECK(count == messages.size());
+		}
+	}
+
+	void TestVarints()
+	{
+		const uint64_t values[] = { 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0xFFFFFFFFULL, 0x100000000ULL, 0x7FFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL };
+		const size_t sizes[] = { 1, 1, 1, 2, 2, 3, 5, 5, 9, 10 };
+
+		for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+		{
+			std::vector<unsigned char> encoded;
+			CNetworkFrameWriter::PutVarint(encoded, values[i]);
+			CHECK(encoded.size() == sizes[i]);
+
+			const unsigned char *pData = &encoded[0];
+			uint64_t value = 0;
+			CHECK(CNetworkFrameReader::GetVarint(pData, pData + encoded.size(), value) && value == values[i]);
+			CHECK(pData == &encoded[0] + encoded.size());
+
+			//every shorter piece runs out of bytes
+			for (size_t length = 0; length < encoded.size(); length++)
+			{
+				pData = &encoded[0];
+				CHECK(CNetworkFrameReader::GetVarint(pData, pData + length, value) == false);
+			}
+		}
+
+		//past 64 bits, either in the tenth byte or by an eleventh one
+		const unsigned char tooBig[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02 };
+		const unsigned char tooLong[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x81, 0x00 };
+
+		const unsigned char *pData = tooBig;
+		uint64_t value = 0;
+		CHECK(CNetworkFrameReader::GetVarint(pData, tooBig + sizeof(tooBig), value) == false);
+
+		pData = tooLong;
+		CHECK(CNetworkFrameReader::GetVarint(pData, tooLong + sizeof(tooLong), value) == false);
+	}
+
+	void TestBadFrames()
+	{
+		CNetworkFrameMessage message;
+
+		CNetworkFrameReader empty(NULL, 0);
+		CHECK(empty.Failed());
+		CHECK(empty.Next(message) == false);
+
+		const unsigned char otherFormat[] = { NETWORK_FRAME_FORMAT + 1, 1, 0 };
+		CNetworkFrameReader other(otherFormat, sizeof(otherFormat));
+		CHECK(other.Failed());
+
+		//a frame with no messages is fine
+		const unsigned char noMessages[] = { NETWORK_FRAME_FORMAT };
+		CNetworkFrameReader none(noMessages, sizeof(noMessages));
+		CHECK(none.Next(message) == false);
+		CHECK(none.Failed() == false);
+
+		//the message says it has 5 bytes but there are 4
+		const unsigned char shortMessage[] = { NETWORK_FRAME_FORMAT, 3, 5, 1, 1, 7, 0 };
+		CNetworkFrameReader shortReader(shortMessage, sizeof(shortMessage));
+		CHECK(shortReader.Next(message) == false);
+		CHECK(shortReader.Failed());
+
+		//the field says it has 3 bytes but the message has 1 left
+		const unsigned char shortField[] = { NETWORK_FRAME_FORMAT, 3, 3, 1, 3, 7 };
+		CNetworkFrameReader fieldReader(shortField, sizeof(shortField));
+		CHECK(fieldReader.Next(message) == false);
+		CHECK(fieldReader.Failed());
+
+		//a uint field with a byte after its varint
+		const unsigned char extraByte[] = { NETWORK_FRAME_FORMAT, 3, 4, 1, 2, 7, 0 };
+		CNetworkFrameReader extraReader(extraByte, sizeof(extraByte));
+		CHECK(extraReader.Next(message));
+		uint64_t value = 0;
+		CHECK(message.GetUInt(1, value) == false);
+		std::string bytes;
+		CHECK(message.GetString(1, bytes) && bytes.size() == 2);
+	}
+
+	//a frame cut short gives the messages before the cut then fails, it never returns a partial message
+	void TestTruncated()
+	{
+		std::vector<CTestMessage> messages;
+		for (uint64_t seed = 1; messages.size() < 3; seed++)
+		{
+			MakeMessages(seed, messages);
+		}
+
+		//where each message ends is the size of the frame with only the messages up to it
+		std::vector<size_t> ends;
+		CNetworkFrameWriter writer;
+		for (size_t i = 1; i <= messages.size(); i++)
+		{
+			std::vector<CTestMessage> first(messages.begin(), messages.begin() + i);
+			Write(first, writer);
+			ends.push_back(writer.GetSize());
+		}
+
+		const std::vector<unsigned char> &frame = writer.GetFrame();
+		CNetworkFrameMessage message;
+
+		for (size_t length = 1; length < frame.size(); length++)
+		{
+			std::vector<unsigned char> cut(frame.begin(), frame.begin() + length);
+			CNetworkFrameReader reader(&cut[0], cut.size());
+
+			size_t count = 0;
+			while (reader.Next(message))
+			{
+				count++;
+			}
+
+			size_t complete = 0;
+			while (complete < ends.size() && ends[complete] <= length)
+			{
+				complete++;
+			}
+
+			CHECK(count == complete);
+
+			//it only ends cleanly right after a message
+			bool atEnd = (length == 1) || (complete > 0 && ends[complete - 1] == length);
+			CHECK(reader.Failed() == (atEnd == false));
+		}
+	}
+
+	//an older reader skips what it doesn't know
+	void TestUnknownSkipped()
+	{
+		CNetworkFrameWriter writer;
+		writer.BeginMessage(12345);
+		writer.AddString(77, "new");
+		writer.EndMessage();
+		writer.BeginMessage(1);
+		writer.AddBytes(500, "skip me", 7);
+		writer.AddUInt(2, 42);
+		writer.EndMessage();
+
+		const std::vector<unsigned char> &frame = writer.GetFrame();
+		CNetworkFrameReader reader(&frame[0], frame.size());
+
+		CNetworkFrameMessage message;
+		CHECK(reader.Next(message) && message.GetType() == 12345);
+		CHECK(reader.Next(message) && message.GetType() == 1);
+
+		uint64_t value = 0;
+		CHECK(message.GetUInt(2, value) && value == 42);
+		CHECK(reader.Next(message) == false);
+		CHECK(reader.Failed() == false);
+	}
+}
+
+int main()
+{
+	TestVarints();
+	TestRoundTrip();
+	TestBadFrames();
+	TestTruncated();
+	TestUnknownSkipped();
+
+	return TestCheck::Result("NetworkFrameTest");
+}
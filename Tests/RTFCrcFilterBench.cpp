@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "RTFCrcFilter.h"
+#include "RTFCrcReference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+//Time to crc a word style rtf document, the old copy and delete against CRTFCrcFilter. The old way is quadratic in the
+//number of rsid values so the default size is small
+//
+//RTFCrcFilterBench [-megabytes n]
+
+namespace
+{
+	//paragraphs with rsid tags the way word writes them, and a datastore section at the end
+	std::string MakeDocument(size_t bytes)
+	{
+		std::string rtf = "{\\rtf1\\adeflang1025\\ansi\\ansicpg1252\\uc1\\adeff31507\\deff0{\\*\\rsidtbl \\rsid1402\\rsid592154}";
+
+		char paragraph[256];
+		int number = 0;
+		while (rtf.size() < bytes)
+		{
+			snprintf(paragraph, sizeof(paragraph), "\\pard\\plain \\ltrpar\\ql \\rsid%d\\insrsid%d Paragraph %d of the document with some text.\\par\r\n",
+				1000000 + number * 7, 2000000 + number * 13, number);
+			rtf += paragraph;
+			number++;
+		}
+
+		rtf += "{\\*\\datastore 0105000002000000180000004d73786d6c322e534158584d4c5265616465722e362e30}\\mdispDef1}";
+		return rtf;
+	}
+
+	template <class Work>
+	double TimeSeconds(Work work)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		work();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	double megabytes = 2;
+	if (argc > 2 && strcmp(argv[1], "-megabytes") == 0)
+	{
+		megabytes = atof(argv[2]);
+	}
+
+	std::string rtf = MakeDocument((size_t)(megabytes * 1024 * 1024));
+
+	DWORD oldCrc = 0;
+	DWORD newCrc = 0;
+	double oldSeconds = TimeSeconds([&]() { oldCrc = RTFCrcReference::Crc32(rtf); });
+	double newSeconds = TimeSeconds([&]() { newCrc = CRTFCrcFilter::UpdateCrc32(0xFFFFFFFF, rtf.data(), rtf.size()); });
+
+	printf("%.1f MB rtf\n", rtf.size() / (1024.0 * 1024.0));
+	printf("copy and delete  %10.3f s  crc %08x\n", oldSeconds, (unsigned int)oldCrc);
+	printf("CRTFCrcFilter    %10.3f s  crc %08x\n", newSeconds, (unsigned int)newCrc);
+
+	if (oldCrc != newCrc)
+	{
+		printf("the crcs don't match\n");
+		return 1;
+	}
+
+	return 0;
+}
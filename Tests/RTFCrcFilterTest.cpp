@@ -0,0 +1,98 @@
+#include "stdafx.h"
+#include "RTFCrcFilter.h"
+#include "Crc32Dynamic.h"
+#include "RTFCrcReference.h"
+#include "TestCheck.h"
+#include <stdlib.h>
+#include <string.h>
+
+//CRTFCrcFilter has to give the same crc as the copy and delete GenerateCRC used to do, on random rtf built from pieces
+//that hit the edge cases: escaped backslashes, partial control words, digits at the end and unclosed braces
+//
+//RTFCrcFilterTest [-runs n]
+
+namespace
+{
+	const char *s_pieces[] =
+	{
+		"\\rsid", "\\rsid1234", "\\rsid0", "\\insrsid", "\\insrsid98", "\\mdispDef1", "\\mdispDef", "\\mdispDef10",
+		"\\rs", "\\ins", "\\insr", "\\\\", "\\", "{", "}", "{\\*\\datastore ", "{\\*\\datastore", "{\\*\\data",
+		"0", "7", "12", "a", "d", "D", " ", "\\par ", "\\b ", "rsid", "insrsid", "\r\n",
+	};
+
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	bool Matches(const std::string &rtf)
+	{
+		DWORD expected = RTFCrcReference::Crc32(rtf);
+		DWORD filtered = CRTFCrcFilter::UpdateCrc32(0xFFFFFFFF, rtf.data(), rtf.size());
+
+		if (expected != filtered)
+		{
+			printf("  crc %08x, expected %08x for: %s\n", (unsigned int)filtered, (unsigned int)expected, rtf.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	void TestKnown()
+	{
+		CHECK(Matches(""));
+		CHECK(Matches("{\\rtf1 plain}"));
+		CHECK(Matches("{\\rtf1\\rsid123 text\\insrsid4\\mdispDef1 more}"));
+		CHECK(Matches("{\\rtf1 {\\*\\datastore 0105 {nested}} after}"));
+		CHECK(Matches("{\\rtf1 {\\*\\datastore unclosed"));
+		CHECK(Matches("\\\\rsid12 escaped"));
+		CHECK(Matches("\\rsid"));
+		CHECK(Matches("ends with digits \\rsid123"));
+		CHECK(Matches("\\rsid\\rsid1\\rsid"));
+
+		//the rsid values that change on every copy are left out
+		const char *pFirst = "{\\rtf1\\rsid111 hello}";
+		const char *pSecond = "{\\rtf1\\rsid222 hello}";
+		CHECK(CRTFCrcFilter::UpdateCrc32(0xFFFFFFFF, pFirst, strlen(pFirst)) == CRTFCrcFilter::UpdateCrc32(0xFFFFFFFF, pSecond, strlen(pSecond)));
+	}
+
+	void TestRandom(int runs)
+	{
+		uint64_t random = 0x1234567;
+		const size_t pieceCount = sizeof(s_pieces) / sizeof(s_pieces[0]);
+
+		int failures = 0;
+		for (int i = 0; i < runs && failures < 10; i++)
+		{
+			std::string rtf;
+			int pieces = (int)(NextRandom(random) % 30);
+			for (int p = 0; p < pieces; p++)
+			{
+				rtf += s_pieces[NextRandom(random) % pieceCount];
+			}
+
+			if (CHECK(Matches(rtf)) == false)
+			{
+				failures++;
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int runs = 200000;
+	if (argc > 2 && strcmp(argv[1], "-runs") == 0)
+	{
+		runs = atoi(argv[2]);
+	}
+
+	TestKnown();
+	TestRandom(runs);
+
+	return TestCheck::Result("RTFCrcFilterTest");
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Crc32Dynamic.h"
+#include <string>
+
+//What GenerateCRC did with rtf before CRTFCrcFilter: copy it, take out the datastore section and the rsid values,
+//then crc the copy. DeleteParamFromRTF and RemoveRTFSection are as they are in Misc.cpp, which needs mfc
+
+namespace RTFCrcReference
+{
+	inline void DeleteParamFromRTF(CStringA &test, CStringA find, bool searchForTrailingDigits)
+	{
+		int start = 0;
+
+		while (start >= 0)
+		{
+			start = test.Find(find, start);
+			if (start >= 0)
+			{
+				if (start > 0)
+				{
+					//leave it if the preceding character is \\, i was seeing the double slash if the actual text contained slash
+					if (test[start - 1] == '\\')
+					{
+						start++;
+						continue;
+					}
+				}
+
+				int end = -1;
+				int innerStart = start + find.GetLength();
+
+				if (searchForTrailingDigits)
+				{
+					for (int i = innerStart; i < test.GetLength(); i++)
+					{
+						if (isdigit(test[i]) == false)
+						{
+							end = i;
+							break;
+						}
+					}
+				}
+				else
+				{
+					end = innerStart;
+				}
+
+				if (end > 0)
+				{
+					if (searchForTrailingDigits == false ||
+						end != innerStart)
+					{
+						test.Delete(start, (end - start));
+					}
+					else
+					{
+						start++;
+					}
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	inline bool RemoveRTFSection(CStringA &str, CStringA section)
+	{
+		bool removedSection = false;
+
+		int start2 = str.Find(section, 0);
+		int end2 = 0;
+		if (start2 >= 0)
+		{
+			int in = 0;
+			for (int pos = start2+1; pos < str.GetLength(); pos++)
+			{
+				if (str[pos] == '{')
+				{
+					in++;
+				}
+
+				if (str[pos] == '}')
+				{
+					if (in > 0)
+					{
+						in--;
+					}
+					else
+					{
+						end2 = pos;
+						break;
+					}
+				}
+			}
+
+			if (end2 > start2)
+			{
+				str.Delete(start2, (end2 - start2) + 1);
+				removedSection = true;
+			}
+		}
+
+		return removedSection;
+	}
+
+	inline DWORD Crc32(const std::string &rtf)
+	{
+		CStringA CStringData(rtf.c_str());
+
+		RemoveRTFSection(CStringData, "{\\*\\datastore");
+
+		DeleteParamFromRTF(CStringData, "\\rsid", true);
+		DeleteParamFromRTF(CStringData, "\\insrsid", true);
+		DeleteParamFromRTF(CStringData, "\\mdispDef1", false);
+
+		return CCrc32Dynamic::UpdateCrc32(0xFFFFFFFF, (const BYTE *)CStringData.GetString(), (size_t)CStringData.GetLength());
+	}
+}
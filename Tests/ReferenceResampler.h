@@ -0,0 +1,155 @@
+#pragma once
+
+#include "ImageResampler.h"
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+//A plain double precision scaler to check CImageResampler against. Every output pixel is weighted over the whole
+//source row or column instead of a fixed number of taps, so a mistake in where the taps start or in the fixed point
+//and simd math shows up as a difference.
+
+namespace ReferenceResampler
+{
+	inline double Kernel(eResampleFilter filter, double x)
+	{
+		if (filter == RESAMPLE_BOX)
+		{
+			return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+		}
+
+		if (x <= -3.0 || x >= 3.0)
+		{
+			return 0.0;
+		}
+
+		if (x == 0.0)
+		{
+			return 1.0;
+		}
+
+		const double pi = 3.14159265358979323846;
+		return (sin(pi * x) / (pi * x)) * (sin(pi * x / 3.0) / (pi * x / 3.0));
+	}
+
+	//one direction, count lines of srcSize values each step apart in the source and the output
+	inline void Resize1D(const std::vector<double> &src, int srcSize, std::vector<double> &dst, int dstSize, int lines, int srcLineStep, int srcStep, int dstLineStep, int dstStep, eResampleFilter filter)
+	{
+		double scale = (double)dstSize / srcSize;
+		double filterScale = std::min(scale, 1.0);
+
+		std::vector<double> weights(srcSize);
+
+		for (int i = 0; i < dstSize; i++)
+		{
+			double center = (i + 0.5) / scale;
+
+			double total = 0.0;
+			int first = srcSize;
+			int last = -1;
+			for (int j = 0; j < srcSize; j++)
+			{
+				weights[j] = Kernel(filter, (j + 0.5 - center) * filterScale);
+				total += weights[j];
+
+				if (weights[j] != 0.0)
+				{
+					first = std::min(first, j);
+					last = j;
+				}
+			}
+
+			if (total <= 0.0)
+			{
+				int nearest = std::max(0, std::min((int)center, srcSize - 1));
+				for (int j = 0; j < srcSize; j++)
+				{
+					weights[j] = (j == nearest) ? 1.0 : 0.0;
+				}
+				total = 1.0;
+				first = nearest;
+				last = nearest;
+			}
+
+			for (int line = 0; line < lines; line++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					double sum = 0.0;
+					for (int j = first; j <= last; j++)
+					{
+						sum += src[(size_t)line * srcLineStep + (size_t)j * srcStep + c] * weights[j];
+					}
+
+					//CImageResampler keeps bytes between the two passes
+					dst[(size_t)line * dstLineStep + (size_t)i * dstStep + c] = std::max(0.0, std::min(255.0, sum / total));
+				}
+			}
+		}
+	}
+
+	inline void Resize(const uint8_t *pSrc, int srcWidth, int srcHeight, std::vector<double> &dst, int dstWidth, int dstHeight, eResampleFilter filter)
+	{
+		std::vector<double> src(pSrc, pSrc + (size_t)srcWidth * srcHeight * 4);
+		std::vector<double> narrow((size_t)dstWidth * srcHeight * 4);
+		dst.resize((size_t)dstWidth * dstHeight * 4);
+
+		Resize1D(src, srcWidth, narrow, dstWidth, srcHeight, srcWidth * 4, 4, dstWidth * 4, 4, filter);
+		Resize1D(narrow, srcHeight, dst, dstHeight, dstWidth, 4, dstWidth * 4, 4, dstWidth * 4, filter);
+	}
+
+	//flat areas, sharp edges and text sized detail, roughly what a screenshot has in it
+	inline void MakeScreenshot(std::vector<uint8_t> &pixels, int width, int height, unsigned int seed)
+	{
+		pixels.resize((size_t)width * height * 4);
+
+		unsigned int random = seed;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				uint8_t *pPixel = &pixels[((size_t)y * width + x) * 4];
+
+				random = random * 1103515245 + 12345;
+
+				if (y < height / 16)
+				{
+					//title bar
+					pPixel[0] = 120; pPixel[1] = 80; pPixel[2] = 40;
+				}
+				else if ((x / 7 + y / 11) % 5 == 0 && (random >> 16) % 3 == 0)
+				{
+					//text
+					pPixel[0] = pPixel[1] = pPixel[2] = (uint8_t)((random >> 8) & 0x3F);
+				}
+				else if (x % 200 < 2 || y % 150 < 2)
+				{
+					//borders
+					pPixel[0] = 200; pPixel[1] = 200; pPixel[2] = 200;
+				}
+				else
+				{
+					//gradient background
+					pPixel[0] = (uint8_t)(255 - (x * 64 / width));
+					pPixel[1] = (uint8_t)(240 - (y * 64 / height));
+					pPixel[2] = 250;
+				}
+
+				pPixel[3] = 255;
+			}
+		}
+	}
+
+	inline void MakeNoise(std::vector<uint8_t> &pixels, int width, int height, unsigned int seed)
+	{
+		pixels.resize((size_t)width * height * 4);
+
+		unsigned int random = seed;
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			random = random * 1103515245 + 12345;
+			pixels[i] = (uint8_t)(random >> 16);
+		}
+	}
+}
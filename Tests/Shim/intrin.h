@@ -0,0 +1,21 @@
+#pragma once
+
+//msvc's __cpuid for gcc and clang, for the pclmul path in Crc32Dynamic.cpp
+
+#include <cpuid.h>
+
+#undef __cpuid
+
+inline void __cpuid(int cpuInfo[4], int function)
+{
+	unsigned int eax = 0;
+	unsigned int ebx = 0;
+	unsigned int ecx = 0;
+	unsigned int edx = 0;
+	__cpuid_count((unsigned int)function, 0, eax, ebx, ecx, edx);
+
+	cpuInfo[0] = (int)eax;
+	cpuInfo[1] = (int)ebx;
+	cpuInfo[2] = (int)ecx;
+	cpuInfo[3] = (int)edx;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+//The windows and atl types that Crc32Dynamic, RTFCrcFilter and ListRows use, so the tests can build them without windows. Only
+//the test programs have this on their include path, the app uses the real StdAfx.h. On a file system that ignores
+//case the real StdAfx.h next to the sources would be found first, the tests are built on linux
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef uint8_t BYTE;
+typedef BYTE *LPBYTE;
+typedef int BOOL;
+typedef unsigned int UINT;
+
+//Ditto is built with unicode
+typedef wchar_t TCHAR;
+typedef const TCHAR *LPCTSTR;
+#define _T(x) L##x
+
+#define TRUE 1
+#define FALSE 0
+
+#define NO_ERROR 0
+#define ERROR_CRC 23
+
+#ifndef _MSC_VER
+#define __int64 long long
+#define __declspec(x) __declspec_##x
+#define __declspec_align(n) __attribute__((aligned(n)))
+#endif
+
+using std::min;
+using std::max;
+
+//The part of ATL's CStringT these files use, on a std::basic_string
+template <class Ch>
+class CStringT
+{
+public:
+	CStringT() {}
+	CStringT(const Ch *pText) : m_text(pText != NULL ? pText : std::basic_string<Ch>()) {}
+	CStringT(const Ch *pText, int length) : m_text(pText, (size_t)length) {}
+	CStringT(const std::basic_string<Ch> &text) : m_text(text) {}
+
+	int GetLength() const			{ return (int)m_text.size(); }
+	BOOL IsEmpty() const			{ return m_text.empty() ? TRUE : FALSE; }
+	void Empty()					{ m_text.clear(); }
+	void AppendChar(Ch c)			{ m_text += c; }
+	const Ch *GetString() const		{ return m_text.c_str(); }
+	operator const Ch *() const		{ return m_text.c_str(); }
+	Ch operator[](int index) const	{ return m_text[(size_t)index]; }
+
+	CStringT Mid(int first) const
+	{
+		return Mid(first, GetLength() - first);
+	}
+
+	CStringT Mid(int first, int count) const
+	{
+		first = max(0, min(first, GetLength()));
+		count = max(0, min(count, GetLength() - first));
+		return CStringT(m_text.substr((size_t)first, (size_t)count));
+	}
+
+	int Find(const Ch *pSub, int start = 0) const
+	{
+		if (start < 0 || start > GetLength())
+		{
+			return -1;
+		}
+
+		size_t found = m_text.find(pSub, (size_t)start);
+		return found == std::basic_string<Ch>::npos ? -1 : (int)found;
+	}
+
+	int Delete(int index, int count = 1)
+	{
+		if (index >= 0 && index < GetLength() && count > 0)
+		{
+			m_text.erase((size_t)index, (size_t)count);
+		}
+		return GetLength();
+	}
+
+	CStringT &operator+=(const CStringT &text)	{ m_text += text.m_text; return *this; }
+	bool operator==(const CStringT &text) const	{ return m_text == text.m_text; }
+	bool operator!=(const CStringT &text) const	{ return m_text != text.m_text; }
+
+protected:
+	std::basic_string<Ch> m_text;
+};
+
+typedef CStringT<wchar_t> CString;
+typedef CStringT<char> CStringA;
@@ -0,0 +1,138 @@
+#include "BenchDb.h"
+#include <string.h>
+
+//Cost of the per clip queries when the values are formatted into the sql and it's compiled on every call, as
+//execQueryEx did, against one compiled statement with bound values that's reset after each call, as
+//CppSQLite3DB::cachedStatement does. CppSQLite3 needs mfc so the sqlite calls each way are made here directly.
+//
+//StatementCacheBench [-calls n] [-clips n]
+
+namespace
+{
+	class CQuery
+	{
+	public:
+		const char *m_name;
+		//printf format of the old sql, takes the clip id (a crc for FindDuplicate)
+		const char *m_formatted;
+		//the cached sql, ?1 is the same value
+		const char *m_bound;
+	};
+
+	const CQuery s_queries[] =
+	{
+		{
+			"GetClipData",
+			"SELECT ooData, lOriginalSize FROM DataContent WHERE lParentID = %d AND strClipboardFormat = 'CF_UNICODETEXT'",
+			"SELECT ooData, lOriginalSize FROM DataContent WHERE lParentID = ?1 AND strClipboardFormat = 'CF_UNICODETEXT'"
+		},
+		{
+			"AggregateData",
+			"SELECT DataContent.strClipBoardFormat, DataContent.ooData, DataContent.lOriginalSize FROM DataContent "
+				"INNER JOIN Main ON Main.lID = DataContent.lParentID "
+				"WHERE (DataContent.strClipBoardFormat = 'CF_UNICODETEXT' OR DataContent.strClipBoardFormat = 'CF_TEXT') AND Main.lID = %d",
+			"SELECT DataContent.strClipBoardFormat, DataContent.ooData, DataContent.lOriginalSize FROM DataContent "
+				"INNER JOIN Main ON Main.lID = DataContent.lParentID "
+				"WHERE (DataContent.strClipBoardFormat = 'CF_UNICODETEXT' OR DataContent.strClipBoardFormat = 'CF_TEXT') AND Main.lID = ?1"
+		},
+		{
+			"FindDuplicate",
+			"SELECT lID FROM Main WHERE CRC = %d",
+			"SELECT lID FROM Main WHERE CRC = ?1"
+		},
+	};
+
+	//reads every column of every row so both ways do the same work after the statement is ready
+	size_t Step(sqlite3_stmt *pStmt)
+	{
+		size_t bytes = 0;
+		while (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			for (int i = 0; i < sqlite3_column_count(pStmt); i++)
+			{
+				sqlite3_column_blob(pStmt, i);
+				bytes += (size_t)sqlite3_column_bytes(pStmt, i);
+			}
+		}
+
+		return bytes;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int calls = 200000;
+	int clips = 20000;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-calls") == 0)
+			calls = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-clips") == 0)
+			clips = std::max(1, atoi(argv[i + 1]));
+	}
+
+	std::string path = BenchDb::TempPath("DittoStatementCacheBench.db");
+	BenchDb::Delete(path);
+
+	sqlite3 *pDb = BenchDb::Open(path);
+	BenchDb::Exec(pDb, "PRAGMA journal_mode = WAL");
+	BenchDb::CreateTables(pDb);
+	BenchDb::CreateDataBlobs(pDb);
+	BenchDb::Fill(pDb, clips, 200, 1);
+
+	printf("%d calls each, %d clips\n", calls, clips);
+	printf("%-16s %16s %16s %10s\n", "query", "compiled us/call", "cached us/call", "speedup");
+
+	for (size_t q = 0; q < sizeof(s_queries) / sizeof(s_queries[0]); q++)
+	{
+		const CQuery &query = s_queries[q];
+		uint64_t random = 99;
+		size_t compiledBytes = 0;
+		size_t cachedBytes = 0;
+
+		double start = BenchDb::NowMs();
+		for (int i = 0; i < calls; i++)
+		{
+			int id = 1 + (int)(BenchDb::NextRandom(random) % clips);
+
+			char sql[512];
+			snprintf(sql, sizeof(sql), query.m_formatted, id);
+
+			sqlite3_stmt *pStmt = BenchDb::Prepare(pDb, sql);
+			compiledBytes += Step(pStmt);
+			sqlite3_finalize(pStmt);
+		}
+		double compiled = BenchDb::NowMs() - start;
+
+		random = 99;
+		sqlite3_stmt *pCached = BenchDb::Prepare(pDb, query.m_bound);
+
+		start = BenchDb::NowMs();
+		for (int i = 0; i < calls; i++)
+		{
+			int id = 1 + (int)(BenchDb::NextRandom(random) % clips);
+
+			sqlite3_bind_int(pCached, 1, id);
+			cachedBytes += Step(pCached);
+			sqlite3_reset(pCached);
+			sqlite3_clear_bindings(pCached);
+		}
+		double cached = BenchDb::NowMs() - start;
+
+		sqlite3_finalize(pCached);
+
+		if (compiledBytes != cachedBytes)
+		{
+			printf("%s read %zu bytes compiled and %zu cached\n", query.m_name, compiledBytes, cachedBytes);
+			return 1;
+		}
+
+		printf("%-16s %16.2f %16.2f %9.1fx\n", query.m_name, compiled * 1000 / calls, cached * 1000 / calls, compiled / cached);
+	}
+
+	sqlite3_close(pDb);
+	BenchDb::Delete(path);
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdio.h>
+
+//Counts failed checks so a test program can run all of its checks and still return non zero
+
+namespace TestCheck
+{
+	inline int &Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline bool Check(bool passed, const char *expression, const char *file, int line)
+	{
+		if (passed == false)
+		{
+			printf("%s(%d): check failed: %s\n", file, line, expression);
+			Failures()++;
+		}
+
+		return passed;
+	}
+
+	inline int Result(const char *name)
+	{
+		if (Failures() > 0)
+		{
+			printf("%s: %d check(s) failed\n", name, Failures());
+			return 1;
+		}
+
+		printf("%s: passed\n", name);
+		return 0;
+	}
+}
+
+#define CHECK(expression) TestCheck::Check((expression) ? true : false, #expression, __FILE__, __LINE__)
@@ -0,0 +1,234 @@
+#include "BenchDb.h"
+#include "ImageResampler.h"
+#include "ReferenceResampler.h"
+#include <zlib.h>
+#include <string.h>
+
+//Time to get an image row ready for the list: the old way reads the full CF_DIB from Data, uncompresses it and scales
+//it to the row height, the new way reads the thumbnail CThumbnails saved at that height from Thumbnails and uncompresses
+//it. Data and thumbnails are zlib compressed at level 1 as CClip::CompressData does. The scaling is CImageResampler's
+//with the box filter of FastThumbnailMode, the default, and Lanczos3. Thumbnails.cpp and CClip need mfc so the sqlite
+//and zlib calls are made here.
+//
+//ThumbnailBench [-clips n] [-rowheight n]
+
+namespace
+{
+	//screenshots at the sizes that are copied most
+	const int s_sizes[][2] = { { 1920, 1080 }, { 2560, 1440 }, { 1280, 720 }, { 800, 600 } };
+
+	void Compress(const std::vector<uint8_t> &data, std::vector<uint8_t> &compressed)
+	{
+		uLongf compressedSize = compressBound((uLong)data.size());
+		compressed.resize(compressedSize);
+		compress2(&compressed[0], &compressedSize, &data[0], (uLong)data.size(), 1);
+		compressed.resize(compressedSize);
+	}
+
+	bool Uncompress(const void *pData, int length, int originalSize, std::vector<uint8_t> &out)
+	{
+		out.resize((size_t)originalSize);
+		uLongf uncompressedSize = (uLongf)originalSize;
+		return uncompress(&out[0], &uncompressedSize, (const Bytef *)pData, (uLong)length) == Z_OK && uncompressedSize == (uLongf)originalSize;
+	}
+
+	//GetScaledDib for a CF_DIB
+	bool ScaleDib(const std::vector<uint8_t> &dib, int maxHeight, eResampleFilter filter, std::vector<uint8_t> &scaledDib)
+	{
+		std::vector<uint8_t> pixels;
+		int width = 0;
+		int height = 0;
+		if (CImageResampler::DecodeDib(&dib[0], dib.size(), pixels, width, height) == false)
+		{
+			return false;
+		}
+
+		int newHeight = std::min(maxHeight, height);
+		int newWidth = std::max(1, (int)(((int64_t)newHeight * width) / height));
+
+		std::vector<uint8_t> scaled((size_t)newWidth * newHeight * 4);
+		if (CImageResampler::Resize(&pixels[0], width, height, &scaled[0], newWidth, newHeight, filter) == false)
+		{
+			return false;
+		}
+
+		scaledDib.resize(CImageResampler::DibSize(newWidth, newHeight));
+		CImageResampler::WriteDib(&scaled[0], newWidth, newHeight, &scaledDib[0]);
+
+		return true;
+	}
+
+	//one row the old way, returns the size of the dib it ends with
+	size_t LoadFull(sqlite3_stmt *pStmt, int id, int rowHeight, eResampleFilter filter)
+	{
+		size_t size = 0;
+
+		sqlite3_bind_int(pStmt, 1, id);
+		if (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			std::vector<uint8_t> dib;
+			std::vector<uint8_t> scaled;
+			if (Uncompress(sqlite3_column_blob(pStmt, 0), sqlite3_column_bytes(pStmt, 0), sqlite3_column_int(pStmt, 1), dib) &&
+				ScaleDib(dib, rowHeight, filter, scaled))
+			{
+				size = scaled.size();
+			}
+		}
+		sqlite3_reset(pStmt);
+
+		return size;
+	}
+
+	size_t LoadThumbnail(sqlite3_stmt *pStmt, int id, int rowHeight)
+	{
+		size_t size = 0;
+
+		sqlite3_bind_int(pStmt, 1, id);
+		sqlite3_bind_int(pStmt, 2, rowHeight);
+		if (sqlite3_step(pStmt) == SQLITE_ROW)
+		{
+			std::vector<uint8_t> dib;
+			if (Uncompress(sqlite3_column_blob(pStmt, 0), sqlite3_column_bytes(pStmt, 0), sqlite3_column_int(pStmt, 1), dib))
+			{
+				size = dib.size();
+			}
+		}
+		sqlite3_reset(pStmt);
+
+		return size;
+	}
+
+	void Report(const char *pName, std::vector<double> &times)
+	{
+		double total = 0;
+		for (size_t i = 0; i < times.size(); i++)
+		{
+			total += times[i];
+		}
+
+		printf("%-28s p50 %8.3f ms  p95 %8.3f ms  all %8.1f ms\n", pName, BenchDb::Percentile(times, 50), BenchDb::Percentile(times, 95), total);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int clips = 40;
+	int rowHeight = 40;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-clips") == 0)
+			clips = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-rowheight") == 0)
+			rowHeight = std::max(8, atoi(argv[i + 1]));
+	}
+
+	//CThumbnails::HeightBucket
+	rowHeight = (rowHeight / 8) * 8;
+
+	std::string path = BenchDb::TempPath("DittoThumbnailBench.db");
+	BenchDb::Delete(path);
+
+	sqlite3 *pDb = BenchDb::Open(path);
+	BenchDb::Exec(pDb, "PRAGMA journal_mode = WAL");
+	BenchDb::CreateTables(pDb);
+	BenchDb::CreateDataBlobs(pDb);
+	BenchDb::Exec(pDb, "CREATE TABLE Thumbnails(lParentID INTEGER, lHeight INTEGER, ooData BLOB, lOriginalSize INTEGER, PRIMARY KEY(lParentID, lHeight))");
+
+	sqlite3_stmt *pMain = BenchDb::Prepare(pDb, BenchDb::InsertMainSql());
+	sqlite3_stmt *pData = BenchDb::Prepare(pDb, "INSERT INTO Data (lParentID, strClipBoardFormat, ooData, lOriginalSize) VALUES(?1, 'CF_DIB', ?2, ?3)");
+	sqlite3_stmt *pThumbnail = BenchDb::Prepare(pDb, "INSERT OR REPLACE INTO Thumbnails (lParentID, lHeight, ooData, lOriginalSize) VALUES(?1, ?2, ?3, ?4)");
+
+	std::vector<double> createTimes;
+	size_t dataBytes = 0;
+	size_t thumbnailBytes = 0;
+	uint64_t random = 1;
+
+	for (int id = 1; id <= clips; id++)
+	{
+		const int *pSize = s_sizes[(id - 1) % (sizeof(s_sizes) / sizeof(s_sizes[0]))];
+
+		std::vector<uint8_t> pixels;
+		ReferenceResampler::MakeScreenshot(pixels, pSize[0], pSize[1], (unsigned int)id);
+		std::vector<uint8_t> dib(CImageResampler::DibSize(pSize[0], pSize[1]));
+		CImageResampler::WriteDib(&pixels[0], pSize[0], pSize[1], &dib[0]);
+
+		std::vector<uint8_t> compressed;
+		Compress(dib, compressed);
+
+		//what CThumbnails::Create and Save add to a save
+		double start = BenchDb::NowMs();
+		std::vector<uint8_t> thumbnail;
+		std::vector<uint8_t> compressedThumbnail;
+		ScaleDib(dib, rowHeight, RESAMPLE_BOX, thumbnail);
+		Compress(thumbnail, compressedThumbnail);
+		createTimes.push_back(BenchDb::NowMs() - start);
+
+		BenchDb::InsertClip(pMain, NULL, random, id, 0);
+
+		sqlite3_bind_int(pData, 1, id);
+		sqlite3_bind_blob(pData, 2, &compressed[0], (int)compressed.size(), SQLITE_TRANSIENT);
+		sqlite3_bind_int(pData, 3, (int)dib.size());
+		sqlite3_step(pData);
+		sqlite3_reset(pData);
+
+		sqlite3_bind_int(pThumbnail, 1, id);
+		sqlite3_bind_int(pThumbnail, 2, rowHeight);
+		sqlite3_bind_blob(pThumbnail, 3, &compressedThumbnail[0], (int)compressedThumbnail.size(), SQLITE_TRANSIENT);
+		sqlite3_bind_int(pThumbnail, 4, (int)thumbnail.size());
+		sqlite3_step(pThumbnail);
+		sqlite3_reset(pThumbnail);
+
+		dataBytes += compressed.size();
+		thumbnailBytes += compressedThumbnail.size();
+	}
+
+	sqlite3_finalize(pMain);
+	sqlite3_finalize(pData);
+	sqlite3_finalize(pThumbnail);
+
+	printf("%d screenshots, %.1f MB in Data, %.1f KB in Thumbnails at row height %d\n", clips, dataBytes / 1e6, thumbnailBytes / 1e3, rowHeight);
+
+	sqlite3_stmt *pFull = BenchDb::Prepare(pDb, "SELECT ooData, lOriginalSize FROM DataContent WHERE lParentID = ?1 AND strClipboardFormat = 'CF_DIB'");
+	sqlite3_stmt *pSmall = BenchDb::Prepare(pDb, "SELECT ooData, lOriginalSize FROM Thumbnails WHERE lParentID = ?1 AND lHeight = ?2");
+
+	std::vector<double> boxTimes;
+	std::vector<double> lanczosTimes;
+	std::vector<double> thumbnailTimes;
+	bool allLoaded = true;
+
+	for (int id = 1; id <= clips; id++)
+	{
+		double start = BenchDb::NowMs();
+		allLoaded = LoadFull(pFull, id, rowHeight, RESAMPLE_BOX) > 0 && allLoaded;
+		boxTimes.push_back(BenchDb::NowMs() - start);
+
+		start = BenchDb::NowMs();
+		allLoaded = LoadFull(pFull, id, rowHeight, RESAMPLE_LANCZOS3) > 0 && allLoaded;
+		lanczosTimes.push_back(BenchDb::NowMs() - start);
+
+		start = BenchDb::NowMs();
+		allLoaded = LoadThumbnail(pSmall, id, rowHeight) > 0 && allLoaded;
+		thumbnailTimes.push_back(BenchDb::NowMs() - start);
+	}
+
+	sqlite3_finalize(pFull);
+	sqlite3_finalize(pSmall);
+
+	printf("time to get each row ready:\n");
+	Report("full image, box", boxTimes);
+	Report("full image, lanczos3", lanczosTimes);
+	Report("thumbnail", thumbnailTimes);
+	Report("making the thumbnail at save", createTimes);
+
+	sqlite3_close(pDb);
+	BenchDb::Delete(path);
+
+	if (allLoaded == false)
+	{
+		printf("an image didn't load\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "CP_Main.h"
+#include "Thumbnails.h"
+#include "BitmapHelper.h"
+
+//the image is fit to this, never more than the row
+int CThumbnails::HeightBucket(int rowHeight)
+{
+	return max(THUMBNAIL_HEIGHT_STEP, (rowHeight / THUMBNAIL_HEIGHT_STEP) * THUMBNAIL_HEIGHT_STEP);
+}
+
+bool CThumbnails::Load(CppSQLite3DB &db, int clipId, int rowHeight, CClipFormatQListCtrl &format)
+{
+	try
+	{
+		CppSQLite3Statement stmt = db.cachedStatement(_T("SELECT ooData, lOriginalSize FROM Thumbnails WHERE lParentID = ? AND lHeight = ?"));
+		stmt.bind(1, clipId);
+		stmt.bind(2, HeightBucket(rowHeight));
+
+		CppSQLite3Query q = stmt.execQuery();
+		if(q.eof() == false)
+		{
+			int dataLength = 0;
+			const unsigned char *data = q.getBlobField(0, dataLength);
+			if(data != NULL)
+			{
+				HGLOBAL hGlobal = CClip::NewGlobalFromData(data, dataLength, q.getIntField(1));
+				if(hGlobal != NULL)
+				{
+					format.m_cfType = CF_DIB;
+					format.m_hgData = hGlobal;
+					format.m_convertedToSmallImage = true;
+					return true;
+				}
+			}
+		}
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	return false;
+}
+
+//Only saved while the clip still has its data, the trigger on Data removes thumbnails when the image is deleted
+bool CThumbnails::Save(int clipId, int rowHeight, HGLOBAL hDib)
+{
+	const unsigned char *data = (const unsigned char *)GlobalLock(hDib);
+	if(data == NULL)
+	{
+		return false;
+	}
+
+	int dataLength = (int)GlobalSize(hDib);
+	bool bRet = false;
+
+	try
+	{
+		CppSQLite3Statement stmt = theApp.m_db.cachedStatement(_T("INSERT OR REPLACE INTO Thumbnails (lParentID, lHeight, ooData, lOriginalSize) ")
+								_T("SELECT ?1, ?2, ?3, ?4 WHERE EXISTS (SELECT 1 FROM Data WHERE lParentID = ?1);"));
+		stmt.bind(1, clipId);
+		stmt.bind(2, HeightBucket(rowHeight));
+
+		std::vector<BYTE> compressed;
+		if(CClip::CompressData(data, dataLength, compressed))
+		{
+			stmt.bind(3, compressed.data(), (int)compressed.size());
+			stmt.bind(4, dataLength);
+		}
+		else
+		{
+			stmt.bind(3, data, dataLength);
+			stmt.bindNull(4);
+		}
+
+		bRet = stmt.execDML() > 0;
+	}
+	CATCH_SQLITE_EXCEPTION
+
+	GlobalUnlock(hDib);
+
+	return bRet;
+}
+
+HGLOBAL CThumbnails::Create(CClipFormats &formats, int rowHeight)
+{
+	CClipFormat *pImage = NULL;
+
+	INT_PTR count = formats.GetSize();
+	for(INT_PTR i = 0; i < count; i++)
+	{
+		CClipFormat *pCF = &formats.ElementAt(i);
+		if(pCF->m_cfType == CF_DIB)
+		{
+			pImage = pCF;
+			break;
+		}
+
+		if(pCF->m_cfType == theApp.m_PNG_Format &&
+			pImage == NULL)
+		{
+			pImage = pCF;
+		}
+	}
+
+	if(pImage == NULL ||
+		pImage->m_hgData == NULL)
+	{
+		return NULL;
+	}
+
+	HGLOBAL hDib = CBitmapHelper::GetScaledDib(pImage, HeightBucket(rowHeight));
+	if(hDib != NULL)
+	{
+		return hDib;
+	}
+
+	HDC dc = GetDC(NULL);
+
+	CBitmap bitmap;
+	if(CBitmapHelper::GetCBitmap(pImage, CDC::FromHandle(dc), &bitmap, HeightBucket(rowHeight)))
+	{
+		HPALETTE hPal = NULL;
+		hDib = (HGLOBAL)CBitmapHelper::hBitmapToDIB((HBITMAP)bitmap, BI_RGB, hPal);
+	}
+
+	bitmap.DeleteObject();
+
+	ReleaseDC(NULL, dc);
+
+	return hDib;
+}
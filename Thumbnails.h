@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Clip.h"
+#include "ClipFormatQListCtrl.h"
+#include "sqlite/CppSQLite3.h"
+
+//rows with heights in the same step share a thumbnail
+#define THUMBNAIL_HEIGHT_STEP 8
+
+//Small copies of image clips at the list's row height, stored as a zlib compressed dib in the Thumbnails table.
+//Made when the clip is saved or the first time the list loads the full image, the list reads these instead of the image
+class CThumbnails
+{
+public:
+	static int HeightBucket(int rowHeight);
+
+	//sets format to the thumbnail's dib, already fitting the row
+	static bool Load(CppSQLite3DB &db, int clipId, int rowHeight, CClipFormatQListCtrl &format);
+	static bool Save(int clipId, int rowHeight, HGLOBAL hDib);
+
+	//a dib of the clip's image scaled to the row height, NULL if it doesn't have one
+	static HGLOBAL Create(CClipFormats &formats, int rowHeight);
+};
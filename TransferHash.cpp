@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include "TransferHash.h"
+#include "ServerDefines.h"
+#include "Misc.h"
+
+CTransferHash::CTransferHash(bool bFast) :
+	m_chunked(CHUNK_WRITE_SIZE)
+{
+	m_bFast = bFast;
+	m_md5.MD5Init();
+}
+
+void CTransferHash::Update(const void *pData, size_t length)
+{
+	if(m_bFast)
+	{
+		m_chunked.Update(pData, length);
+	}
+	else
+	{
+		m_md5.MD5Update((unsigned char *)pData, (unsigned)length);
+	}
+}
+
+void CTransferHash::Reset()
+{
+	m_chunked = CChunkedHash(CHUNK_WRITE_SIZE);
+	m_md5.MD5Init();
+}
+
+CStringA CTransferHash::FinalToString()
+{
+	if(m_bFast)
+	{
+		return ToString(m_chunked.Final());
+	}
+
+	return m_md5.MD5FinalToString();
+}
+
+CStringA CTransferHash::ToString(uint64_t hash)
+{
+	CStringA csHash;
+	csHash.Format("%016I64x", hash);
+	return csHash;
+}
+
+CFileHasher::CFileHasher()
+{
+	m_hThread = NULL;
+	m_bStop = false;
+}
+
+CFileHasher::~CFileHasher()
+{
+	m_bStop = true;
+	Wait();
+}
+
+bool CFileHasher::Start(CString csFile)
+{
+	m_csFile = csFile;
+	m_hash.Empty();
+	m_bStop = false;
+
+	m_hThread = (HANDLE)_beginthreadex(NULL, 0, HashThread, this, 0, NULL);
+
+	return m_hThread != NULL;
+}
+
+//Empty if the file couldn't be read
+CStringA CFileHasher::Wait()
+{
+	if(m_hThread != NULL)
+	{
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+
+	return m_hash;
+}
+
+unsigned int __stdcall CFileHasher::HashThread(void *pParam)
+{
+	CFileHasher *pHasher = (CFileHasher*)pParam;
+
+	CFile file;
+	if(file.Open(pHasher->m_csFile, CFile::modeRead|CFile::typeBinary|CFile::shareDenyNone) == FALSE)
+	{
+		LogSendRecieveInfo(StrF(_T("Error opening %s to hash it"), pHasher->m_csFile));
+		return 0;
+	}
+
+	std::vector<BYTE> buffer(CHUNK_WRITE_SIZE);
+	CChunkedHash hash(CHUNK_WRITE_SIZE);
+
+	try
+	{
+		UINT read = 0;
+		do
+		{
+			if(pHasher->m_bStop)
+				return 0;
+
+			read = file.Read(buffer.data(), CHUNK_WRITE_SIZE);
+			hash.Update(buffer.data(), read);
+
+		}while(read == CHUNK_WRITE_SIZE);
+	}
+	catch(CFileException *e)
+	{
+		e->Delete();
+		LogSendRecieveInfo(StrF(_T("Error reading %s to hash it"), pHasher->m_csFile));
+		return 0;
+	}
+
+	pHasher->m_hash = CTransferHash::ToString(hash.Final());
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Md5.h"
+#include "FastHash.h"
+
+//Hash sent in DATA_END to check a file transfer, md5 for peers before NETWORK_FAST_HASH_VERSION, a CChunkedHash after
+class CTransferHash
+{
+public:
+	CTransferHash(bool bFast);
+
+	void Update(const void *pData, size_t length);
+	CStringA FinalToString();
+
+	//back to nothing hashed
+	void Reset();
+
+	static CStringA ToString(uint64_t hash);
+
+protected:
+	bool m_bFast;
+	CMd5 m_md5;
+	CChunkedHash m_chunked;
+};
+
+//Hashes a file on its own thread while it's being sent, the send doesn't wait on the hash until DATA_END
+class CFileHasher
+{
+public:
+	CFileHasher();
+	~CFileHasher();
+
+	bool Start(CString csFile);
+	CStringA Wait();
+
+protected:
+	static unsigned int __stdcall HashThread(void *pParam);
+
+	CString m_csFile;
+	HANDLE m_hThread;
+	CStringA m_hash;
+	volatile bool m_bStop;
+};
@@ -497,6 +497,8 @@ CppSQLite3Statement::CppSQLite3Statement()
 {
 	mpDB = 0;
 	mpVM = 0;
+	mpCacheDB = 0;
+	mpWriteDB = 0;
 }
 
 
@@ -504,6 +506,9 @@ CppSQLite3Statement::CppSQLite3Statement(const CppSQLite3Statement& rStatement)
 {
 	mpDB = rStatement.mpDB;
 	mpVM = rStatement.mpVM;
+	mpCacheDB = rStatement.mpCacheDB;
+	msCacheSQL = rStatement.msCacheSQL;
+	mpWriteDB = rStatement.mpWriteDB;
 	// Only one object can own VM
 	const_cast<CppSQLite3Statement&>(rStatement).mpVM = 0;
 }
@@ -513,6 +518,18 @@ CppSQLite3Statement::CppSQLite3Statement(sqlite3* pDB, sqlite3_stmt* pVM)
 {
 	mpDB = pDB;
 	mpVM = pVM;
+	mpCacheDB = 0;
+	mpWriteDB = 0;
+}
+
+
+CppSQLite3Statement::CppSQLite3Statement(sqlite3* pDB, sqlite3_stmt* pVM, CppSQLite3DB* pCacheDB, const TCHAR* szCacheSQL)
+{
+	mpDB = pDB;
+	mpVM = pVM;
+	mpCacheDB = pCacheDB;
+	msCacheSQL = szCacheSQL;
+	mpWriteDB = pCacheDB;
 }
 
 
@@ -530,8 +547,23 @@ CppSQLite3Statement::~CppSQLite3Statement()
 
 CppSQLite3Statement& CppSQLite3Statement::operator=(const CppSQLite3Statement& rStatement)
 {
+	if (this == &rStatement)
+	{
+		return *this;
+	}
+
+	try
+	{
+		finalize();
+	}
+	catch (...)
+	{
+	}
 	mpDB = rStatement.mpDB;
 	mpVM = rStatement.mpVM;
+	mpCacheDB = rStatement.mpCacheDB;
+	msCacheSQL = rStatement.msCacheSQL;
+	mpWriteDB = rStatement.mpWriteDB;
 	// Only one object can own VM
 	const_cast<CppSQLite3Statement&>(rStatement).mpVM = 0;
 	return *this;
@@ -543,6 +575,8 @@ int CppSQLite3Statement::execDML()
 	checkDB();
 	checkVM();
 
+	CppSQLite3DB::WriteLock writeLock(mpWriteDB);
+
 	int nRet = sqlite3_step(mpVM);
 
 	if (nRet == SQLITE_DONE)
@@ -686,7 +720,13 @@ void CppSQLite3Statement::reset()
 
 void CppSQLite3Statement::finalize()
 {
-	if (mpVM)
+	if (mpVM && mpCacheDB)
+	{
+		sqlite3_stmt* pVM = mpVM;
+		mpVM = 0;
+		mpCacheDB->releaseCachedStatement(msCacheSQL, pVM);
+	}
+	else if (mpVM)
 	{
 		int nRet = sqlite3_finalize(mpVM);
 		mpVM = 0;
@@ -728,6 +768,11 @@ CppSQLite3DB::CppSQLite3DB()
 {
 	mpDB = 0;
 	mnBusyTimeoutMs = 60000; // 60 seconds
+	mnStatementCacheSize = 32;
+	mnStatementCacheHits = 0;
+	mnStatementCacheMisses = 0;
+	mpWriteLock = NULL;
+	mbTransactionWriteLock = false;
 }
 
 
@@ -735,6 +780,11 @@ CppSQLite3DB::CppSQLite3DB(const CppSQLite3DB& db)
 {
 	mpDB = db.mpDB;
 	mnBusyTimeoutMs = 60000; // 60 seconds
+	mnStatementCacheSize = 32;
+	mnStatementCacheHits = 0;
+	mnStatementCacheMisses = 0;
+	mpWriteLock = NULL;
+	mbTransactionWriteLock = false;
 }
 
 
@@ -782,6 +832,28 @@ void sqlite_regexp(sqlite3_context* context, int argc, sqlite3_value** values)
 	}
 }
 
+//returns the text of a CF_UNICODETEXT blob, used by the full text search triggers to index the clip data
+void sqlite_unicodetext(sqlite3_context* context, int argc, sqlite3_value** values)
+{
+	if (argc != 1 || sqlite3_value_type(values[0]) != SQLITE_BLOB)
+	{
+		sqlite3_result_null(context);
+		return;
+	}
+
+	const wchar_t* text = (const wchar_t*)sqlite3_value_blob(values[0]);
+	int chars = sqlite3_value_bytes(values[0]) / sizeof(wchar_t);
+
+	//stop at the null terminator, the blob is the size of the global and can have trailing data
+	int length = 0;
+	while (length < chars && text[length] != 0)
+	{
+		length++;
+	}
+
+	sqlite3_result_text16le(context, text, length * sizeof(wchar_t), SQLITE_TRANSIENT);
+}
+
 bool CppSQLite3DB::DBEncrypted()
 {
 	bool encrypted = false;
@@ -807,13 +879,27 @@ bool CppSQLite3DB::DBEncrypted()
 	return encrypted;
 }
 
-void CppSQLite3DB::open(const TCHAR* szFile)
+void CppSQLite3DB::open(const TCHAR* szFile, bool readOnly)
 {
+	int nRet = SQLITE_OK;
+	if (readOnly)
+	{
+		//sqlite3_open16 has no flags, open_v2 takes a utf8 path
+#ifdef _UNICODE
+		CStringA utf8File(CW2A(szFile, CP_UTF8));
+#else
+		CStringA utf8File(szFile);
+#endif
+		nRet = sqlite3_open_v2(utf8File, &mpDB, SQLITE_OPEN_READONLY, NULL);
+	}
+	else
+	{
 #ifdef _UNICODE
-	int nRet = sqlite3_open16(szFile, &mpDB);
+		nRet = sqlite3_open16(szFile, &mpDB);
 #else
-	int nRet = sqlite3_open(szFile, &mpDB);
+		nRet = sqlite3_open(szFile, &mpDB);
 #endif
+	}
 
 	//sqlite3_exec(mpDB, "PRAGMA rekey=123456", 0, 0, 0);
 	//sqlite3_exec(mpDB, "PRAGMA key=123456", 0, 0, 0);
@@ -834,6 +920,7 @@ void CppSQLite3DB::open(const TCHAR* szFile)
 	}
 
 	int ret = sqlite3_create_function(mpDB, "regexp", 2, SQLITE_ANY, 0, &sqlite_regexp, 0, 0);
+	ret = sqlite3_create_function(mpDB, "unicodetext", 1, SQLITE_ANY | SQLITE_DETERMINISTIC, 0, &sqlite_unicodetext, 0, 0);
 
 	setBusyTimeout(mnBusyTimeoutMs);
 
@@ -871,6 +958,9 @@ bool CppSQLite3DB::close()
 	bool bRet = true;
 	if (mpDB)
 	{
+		// cached statements have to be finalized before the db can be closed
+		clearStatementCache();
+
 		//sqlite3_shutdown();
 		int nClose = sqlite3_close(mpDB);
 		
@@ -891,7 +981,93 @@ CppSQLite3Statement CppSQLite3DB::compileStatement(const TCHAR* szSQL)
 	checkDB();
 
 	sqlite3_stmt* pVM = compile(szSQL);
-	return CppSQLite3Statement(mpDB, pVM);
+	CppSQLite3Statement stmt(mpDB, pVM);
+	stmt.mpWriteDB = this;
+	return stmt;
+}
+
+
+CppSQLite3Statement CppSQLite3DB::cachedStatement(const TCHAR* szSQL)
+{
+	checkDB();
+
+	{
+		ATL::CCritSecLock csLock(mStatementCacheLock.m_sect);
+
+		std::map<CString, StatementCacheList::iterator>::iterator it = mStatementCacheIndex.find(szSQL);
+		if (it != mStatementCacheIndex.end())
+		{
+			// taken out of the cache while in use so two threads never step the same VM,
+			// the same sql used again before this is released compiles a second copy
+			sqlite3_stmt* pVM = it->second->second;
+			mStatementCache.erase(it->second);
+			mStatementCacheIndex.erase(it);
+			mnStatementCacheHits++;
+
+			return CppSQLite3Statement(mpDB, pVM, this, szSQL);
+		}
+
+		mnStatementCacheMisses++;
+	}
+
+	sqlite3_stmt* pVM = compile(szSQL);
+	return CppSQLite3Statement(mpDB, pVM, this, szSQL);
+}
+
+
+void CppSQLite3DB::releaseCachedStatement(const CString &sql, sqlite3_stmt* pVM)
+{
+	sqlite3_reset(pVM);
+	sqlite3_clear_bindings(pVM);
+
+	ATL::CCritSecLock csLock(mStatementCacheLock.m_sect);
+
+	// the db was closed or reopened while the statement was in use, or another copy was released first
+	if (sqlite3_db_handle(pVM) != mpDB ||
+		mnStatementCacheSize <= 0 ||
+		mStatementCacheIndex.find(sql) != mStatementCacheIndex.end())
+	{
+		sqlite3_finalize(pVM);
+		return;
+	}
+
+	mStatementCache.push_front(std::make_pair(sql, pVM));
+	mStatementCacheIndex[sql] = mStatementCache.begin();
+
+	while ((int)mStatementCache.size() > mnStatementCacheSize)
+	{
+		sqlite3_finalize(mStatementCache.back().second);
+		mStatementCacheIndex.erase(mStatementCache.back().first);
+		mStatementCache.pop_back();
+	}
+}
+
+
+void CppSQLite3DB::setStatementCacheSize(int nSize)
+{
+	ATL::CCritSecLock csLock(mStatementCacheLock.m_sect);
+
+	mnStatementCacheSize = nSize;
+
+	while ((int)mStatementCache.size() > max(mnStatementCacheSize, 0))
+	{
+		sqlite3_finalize(mStatementCache.back().second);
+		mStatementCacheIndex.erase(mStatementCache.back().first);
+		mStatementCache.pop_back();
+	}
+}
+
+
+void CppSQLite3DB::clearStatementCache()
+{
+	ATL::CCritSecLock csLock(mStatementCacheLock.m_sect);
+
+	for (StatementCacheList::iterator it = mStatementCache.begin(); it != mStatementCache.end(); it++)
+	{
+		sqlite3_finalize(it->second);
+	}
+	mStatementCache.clear();
+	mStatementCacheIndex.clear();
 }
 
 
@@ -923,6 +1099,8 @@ int CppSQLite3DB::execDML(const TCHAR* szSQL)
 {
 	checkDB();
 
+	WriteLock writeLock(this);
+
 	sqlite3_stmt* pVM = compile(szSQL);
 
 	int nRet = sqlite3_step(pVM);
@@ -1015,6 +1193,65 @@ sqlite_int64 CppSQLite3DB::lastRowId()
 }
 
 
+CppSQLite3DB::WriteLock::WriteLock(CppSQLite3DB* pDB)
+{
+	mpLockDB = pDB;
+	if (mpLockDB != NULL && mpLockDB->mpWriteLock != NULL)
+	{
+		mpLockDB->mpWriteLock->Lock();
+	}
+}
+
+
+CppSQLite3DB::WriteLock::~WriteLock()
+{
+	if (mpLockDB != NULL)
+	{
+		mpLockDB->unlockWrite();
+	}
+}
+
+
+void CppSQLite3DB::unlockWrite()
+{
+	if (mpWriteLock == NULL)
+	{
+		return;
+	}
+
+	bool bInTransaction = (mpDB != NULL && sqlite3_get_autocommit(mpDB) == 0);
+
+	if (bInTransaction)
+	{
+		// the first write of a transaction keeps the lock it took
+		if (mbTransactionWriteLock == false)
+		{
+			mbTransactionWriteLock = true;
+			return;
+		}
+	}
+	else if (mbTransactionWriteLock)
+	{
+		mbTransactionWriteLock = false;
+		mpWriteLock->Unlock();
+	}
+
+	mpWriteLock->Unlock();
+}
+
+
+void CppSQLite3DB::rollbackOpenTransaction()
+{
+	if (mpDB == NULL || sqlite3_get_autocommit(mpDB) != 0)
+	{
+		return;
+	}
+
+	WriteLock writeLock(this);
+	sqlite3_exec(mpDB, "ROLLBACK;", 0, 0, 0);
+}
+
+
 void CppSQLite3DB::setBusyTimeout(int nMillisecs)
 {
 	mnBusyTimeoutMs = nMillisecs;
@@ -32,6 +32,8 @@
 #include "sqlite3mc_amalgamation.h"
 #include <cstdio>
 #include <cstring>
+#include <list>
+#include <map>
 
 #define CPPSQLITE_ERROR 1000
 
@@ -131,6 +133,8 @@ private:
     bool mbOwnVM;
 };
 
+class CppSQLite3DB;
+
 class CppSQLite3Statement
 {
 public:
@@ -141,6 +145,8 @@ public:
 
     CppSQLite3Statement(sqlite3* pDB, sqlite3_stmt* pVM);
 
+    CppSQLite3Statement(sqlite3* pDB, sqlite3_stmt* pVM, CppSQLite3DB* pCacheDB, const TCHAR* szCacheSQL);
+
     virtual ~CppSQLite3Statement();
 
     CppSQLite3Statement& operator=(const CppSQLite3Statement& rStatement);
@@ -166,6 +172,15 @@ private:
 
     sqlite3* mpDB;
     sqlite3_stmt* mpVM;
+
+    // set for statements from CppSQLite3DB::cachedStatement(), finalize() hands the VM back to the cache
+    CppSQLite3DB* mpCacheDB;
+    CString msCacheSQL;
+
+    // the db the statement was compiled on, execDML() takes its write lock
+    CppSQLite3DB* mpWriteDB;
+
+    friend class CppSQLite3DB;
 };
 
 
@@ -177,7 +192,7 @@ public:
 
     virtual ~CppSQLite3DB();
 
-    void open(const TCHAR* szFile);
+    void open(const TCHAR* szFile, bool readOnly=false);
 
     void SetRegexCaseInsensitive(bool insensitive);
 
@@ -196,10 +211,29 @@ public:
 
     CppSQLite3Statement compileStatement(const TCHAR* szSQL);
 
+    // Returns a statement from the LRU cache of compiled statements, keyed by the sql text, or compiles it on a miss.
+    // Bind parameters instead of formatting values into the sql so the text stays the same between calls.
+    // The statement goes back to the cache when it is destroyed, destroy any query from it first.
+    CppSQLite3Statement cachedStatement(const TCHAR* szSQL);
+
+    void setStatementCacheSize(int nSize);
+    void clearStatementCache();
+
+    long statementCacheHits() { return mnStatementCacheHits; }
+    long statementCacheMisses() { return mnStatementCacheMisses; }
+
     sqlite_int64 lastRowId();
 
     void interrupt() { sqlite3_interrupt(mpDB); }
 
+    // Serializes writes from threads that share this connection. execDML() holds pLock while it runs and, once a
+    // transaction or savepoint is open, until the write that ends it, so another thread's writes are never made part of it.
+    // The lock is recursive so a thread can hold it around several writes. NULL, the default, doesn't lock
+    void setWriteLock(CCriticalSection* pLock) { mpWriteLock = pLock; }
+
+    // Rolls back a transaction left open by an exception, it would keep the write lock
+    void rollbackOpenTransaction();
+
     void setBusyTimeout(int nMillisecs);
 
     static const TCHAR* SQLiteVersion() { return _T(SQLITE_VERSION); }
@@ -215,11 +249,38 @@ private:
 
     sqlite3_stmt* compile(const TCHAR* szSQL);
 
+    friend class CppSQLite3Statement;
+    void releaseCachedStatement(const CString &sql, sqlite3_stmt* pVM);
+
     void checkDB();
 
+    // held by execDML(), see setWriteLock()
+    class WriteLock
+    {
+    public:
+        WriteLock(CppSQLite3DB* pDB);
+        ~WriteLock();
+    private:
+        CppSQLite3DB* mpLockDB;
+    };
+
+    void unlockWrite();
+
     sqlite3* mpDB;
     int mnBusyTimeoutMs;
     CString m_dbFile;
+
+    typedef std::list<std::pair<CString, sqlite3_stmt*> > StatementCacheList;
+    StatementCacheList mStatementCache;
+    std::map<CString, StatementCacheList::iterator> mStatementCacheIndex;
+    int mnStatementCacheSize;
+    long mnStatementCacheHits;
+    long mnStatementCacheMisses;
+    CCriticalSection mStatementCacheLock;
+
+    CCriticalSection* mpWriteLock;
+    // the write lock is held for the open transaction, only changed by the thread holding it
+    bool mbTransactionWriteLock;
 };
 
 #endif